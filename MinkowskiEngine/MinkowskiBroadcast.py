@@ -96,6 +96,89 @@ class MinkowskiBroadcastFunction(Function):
         return grad_in_feat, grad_in_feat_glob, None, None, None, None
 
 
+class MinkowskiSEGatingFunction(Function):
+    r"""Squeeze-excitation gating fused on CPU.
+
+    Computes :math:`\mathbf{x} \times \sigma(W_2 \, \text{relu}(W_1
+    \bar{\mathbf{x}} + b_1) + b_2)` where :math:`\bar{\mathbf{x}}` is the
+    average of the features of each batch. The features are read once for the
+    pooling and once for the gating.
+    """
+
+    @staticmethod
+    def forward(
+        ctx,
+        input_features: torch.Tensor,
+        weight1: torch.Tensor,
+        bias1: torch.Tensor,
+        weight2: torch.Tensor,
+        bias2: torch.Tensor,
+        in_coords_key: CoordinateMapKey,
+        coords_manager: CoordinateManager,
+    ):
+        assert not input_features.is_cuda, "SE gating is fused on CPU only"
+        if not input_features.is_contiguous():
+            input_features = input_features.contiguous()
+        ctx.has_bias = (bias1 is not None, bias2 is not None)
+        if bias1 is None:
+            bias1 = input_features.new_zeros(weight1.size(0))
+        if bias2 is None:
+            bias2 = input_features.new_zeros(weight2.size(0))
+
+        glob_coords_key = CoordinateMapKey(in_coords_key.get_coordinate_size())
+        fw_fn = get_minkowski_function("SEGatingForward", input_features)
+        out_feat, pooled, hidden, gate = fw_fn(
+            input_features,
+            weight1,
+            bias1,
+            weight2,
+            bias2,
+            in_coords_key,
+            glob_coords_key,
+            coords_manager._manager,
+        )
+        ctx.saved_vars = (in_coords_key, glob_coords_key, coords_manager)
+        ctx.save_for_backward(input_features, pooled, hidden, gate, weight1, weight2)
+        return out_feat
+
+    @staticmethod
+    def backward(ctx, grad_out_feat):
+        if not grad_out_feat.is_contiguous():
+            grad_out_feat = grad_out_feat.contiguous()
+
+        in_coords_key, glob_coords_key, coords_manager = ctx.saved_vars
+        input_features, pooled, hidden, gate, weight1, weight2 = ctx.saved_tensors
+
+        bw_fn = get_minkowski_function("SEGatingBackward", grad_out_feat)
+        (
+            grad_in_feat,
+            grad_weight1,
+            grad_bias1,
+            grad_weight2,
+            grad_bias2,
+        ) = bw_fn(
+            grad_out_feat,
+            input_features,
+            pooled,
+            hidden,
+            gate,
+            weight1,
+            weight2,
+            in_coords_key,
+            glob_coords_key,
+            coords_manager._manager,
+        )
+        return (
+            grad_in_feat,
+            grad_weight1,
+            grad_bias1 if ctx.has_bias[0] else None,
+            grad_weight2,
+            grad_bias2 if ctx.has_bias[1] else None,
+            None,
+            None,
+        )
+
+
 class MinkowskiBroadcastBase(MinkowskiModuleBase):
     def __init__(self, operation_type):
         MinkowskiModuleBase.__init__(self)
@@ -29,7 +29,12 @@ import torch
 from torch.autograd import Function
 from torch.nn import Parameter
 
-from MinkowskiEngineBackend._C import CoordinateMapKey, RegionType, ConvolutionMode
+from MinkowskiEngineBackend._C import (
+    CoordinateMapKey,
+    RegionType,
+    ConvolutionMode,
+    KernelArguments,
+)
 from MinkowskiSparseTensor import SparseTensor, _get_coordinate_map_key
 from MinkowskiCommon import (
     MinkowskiModuleBase,
@@ -213,6 +218,7 @@ class MinkowskiConvolutionBase(MinkowskiModuleBase):
         "kernel",
         "bias",
         "conv",
+        "kernel_arguments",
     )
 
     def __init__(
@@ -283,6 +289,22 @@ class MinkowskiConvolutionBase(MinkowskiModuleBase):
             if is_transpose
             else MinkowskiConvolutionFunction()
         )
+        self.kernel_arguments = None
+
+    def _kernel_arguments(self):
+        # The kernel region is fixed after the first forward and converted to
+        # the backend type once.
+        if self.kernel_arguments is None:
+            self.kernel_arguments = KernelArguments(
+                self.kernel_generator.kernel_size,
+                self.kernel_generator.kernel_stride,
+                self.kernel_generator.kernel_dilation,
+                self.kernel_generator.region_type,
+                self.kernel_generator.region_offsets,
+                self.kernel_generator.expand_coordinates,
+                self.convolution_mode,
+            )
+        return self.kernel_arguments
 
     def forward(
         self,
@@ -311,14 +333,18 @@ class MinkowskiConvolutionBase(MinkowskiModuleBase):
             out_coordinate_map_key = _get_coordinate_map_key(
                 input, coordinates, self.kernel_generator.expand_coordinates
             )
-            outfeat = self.conv.apply(
+            # Forward and backward run as a single C++ autograd node
+            conv_fn = get_minkowski_function(
+                "ConvolutionTranspose" if self.is_transpose else "Convolution",
+                input.F,
+            )
+            outfeat = conv_fn(
                 input.F,
                 self.kernel,
-                self.kernel_generator,
-                self.convolution_mode,
+                self._kernel_arguments(),
                 input.coordinate_map_key,
                 out_coordinate_map_key,
-                input._manager,
+                input._manager._manager,
             )
         if self.bias is not None:
             outfeat += self.bias
@@ -25,6 +25,7 @@
 import os
 import numpy as np
 from collections.abc import Sequence
+from contextlib import contextmanager
 from typing import Union, List, Tuple
 import warnings
 
@@ -37,6 +38,7 @@ from MinkowskiEngineBackend._C import (
     CoordinateMapType,
     MinkowskiAlgorithm,
     RegionType,
+    ThreadingPolicy,
 )
 
 CPU_COUNT = os.cpu_count()
@@ -48,6 +50,7 @@ _coordinate_map_type = (
     CoordinateMapType.CUDA if _C.is_cuda_available() else CoordinateMapType.CPU
 )
 _minkowski_algorithm = MinkowskiAlgorithm.DEFAULT
+_threading_policy = ThreadingPolicy.AUTO
 
 
 def set_coordinate_map_type(coordinate_map_type: CoordinateMapType):
@@ -89,6 +92,31 @@ def set_gpu_allocator(backend: GPUMemoryAllocatorType):
     _allocator_type = backend
 
 
+def set_threading_policy(threading_policy: ThreadingPolicy):
+    r"""Set the default CPU threading policy of new coordinate managers.
+
+    The CPU convolutions either split the rows of each kernel offset over the
+    OpenMP threads and run a single-threaded BLAS per chunk
+    (:attr:`ThreadingPolicy.OUTER_PARALLEL`), or run the rows serially through
+    a multithreaded BLAS (:attr:`ThreadingPolicy.BLAS_PARALLEL`). Running
+    both at once oversubscribes the cores. :attr:`ThreadingPolicy.AUTO`
+    picks per call from the number of rows and channels. Unless the extension
+    links MKL, OpenBLAS, or FlexiBLAS, whose thread count can be pinned, every
+    policy runs as :attr:`ThreadingPolicy.BLAS_PARALLEL`.
+
+    Example::
+
+       >>> import MinkowskiEngine as ME
+       >>> ME.set_threading_policy(ME.ThreadingPolicy.OUTER_PARALLEL)
+
+    """
+    assert isinstance(
+        threading_policy, ThreadingPolicy
+    ), f"Input must be an instance of ThreadingPolicy not {threading_policy}"
+    global _threading_policy
+    _threading_policy = threading_policy
+
+
 def set_memory_manager_backend(backend: GPUMemoryAllocatorType):
     r"""Alias for set_gpu_allocator. Deprecated and will be removed."""
     warnings.warn(
@@ -112,10 +140,19 @@ class CoordinateManager:
         coordinate_map_type: CoordinateMapType = None,
         allocator_type: GPUMemoryAllocatorType = None,
         minkowski_algorithm: MinkowskiAlgorithm = None,
+        cpu_affinity: List[int] = None,
     ):
         r"""
 
         :attr:`D`: The order, or dimension of the coordinates.
+
+        :attr:`num_threads`: The number of CPU threads of the map generation
+        and the CPU functions of this manager. The setting does not change
+        the threads of other managers or of the process.
+
+        :attr:`cpu_affinity`: The CPU cores the threads of this manager run
+        on. Linux only. By default, the threads run on the cores of the
+        calling thread.
         """
         global _coordinate_map_type, _allocator_type, _minkowski_algorithm
         if D < 1:
@@ -145,6 +182,9 @@ class CoordinateManager:
         self.minkowski_algorithm = minkowski_algorithm
         self._CoordinateManagerClass = getattr(_C, "CoordinateMapManager" + postfix)
         self._manager = self._CoordinateManagerClass(minkowski_algorithm, num_threads)
+        self._manager.set_threading_policy(_threading_policy)
+        if cpu_affinity is not None:
+            self.set_cpu_affinity(cpu_affinity)
 
     # TODO: insert without remap, unique_map, inverse_mapa
     #
@@ -178,6 +218,42 @@ class CoordinateManager:
         tensor_stride = convert_to_int_list(tensor_stride, self.D)
         return self._manager.insert_and_map(coordinates, tensor_stride, string_id)
 
+    def insert_dense(
+        self,
+        dense: torch.Tensor,
+        channel_dim: int = 1,
+        tensor_stride: Union[int, Sequence, np.ndarray] = 1,
+        string_id: str = "",
+    ) -> Tuple[CoordinateMapKey, Tuple[torch.Tensor, torch.Tensor, torch.Tensor]]:
+        r"""create a new coordinate map from the non-zero positions of a dense
+        tensor and returns (key, (coordinates, features, positions)).
+
+        The dense tensor is scanned once. Since the positions of a dense grid
+        are unique, the coordinates are inserted without the unique pass.
+
+        :attr:`dense`: `torch.Tensor` (CPU only) with the batch axis first.
+
+        :attr:`channel_dim` (`int`): the channel axis of the dense tensor.
+
+        :attr:`tensor_stride` (`list`): a list of `D` elements that defines the
+        tensor stride for the new order-`D + 1` sparse tensor.
+
+        :attr:`positions` are the flat indices of the non-zero positions of
+        :attr:`dense` with the channel axis removed.
+
+        Example::
+
+           >>> manager = CoordinateManager(D=2, coordinate_map_type=ME.CoordinateMapType.CPU)
+           >>> dense = torch.rand(2, 3, 4, 5)  # BxCxHxW
+           >>> key, (coordinates, features, positions) = manager.insert_dense(dense, 1)
+           >>> torch.all(features == dense.permute(0, 2, 3, 1).reshape(-1, 3)[positions])  # True
+
+        """
+        tensor_stride = convert_to_int_list(tensor_stride, self.D)
+        return self._manager.insert_dense(
+            dense.contiguous(), channel_dim, tensor_stride, string_id
+        )
+
     def insert_field(
         self,
         coordinates: torch.Tensor,
@@ -267,6 +343,29 @@ class CoordinateManager:
         stride = convert_to_int_list(stride, self.D)
         return self._manager.stride(coordinate_map_key, stride, string_id)
 
+    def build_hierarchy(
+        self, coordinate_map_key: CoordinateMapKey, strides: list
+    ) -> List[CoordinateMapKey]:
+        r"""Generate the maps of successive strides and returns their keys.
+
+        Each level is strided from the unique coordinates of the previous
+        level, and the stride maps and the parent maps between the levels are
+        cached for the downsampling and the transposed layers.
+
+        :attr:`coordinate_map_key` (:attr:`MinkowskiEngine.CoordinateMapKey`):
+        input map of the finest level.
+
+        :attr:`strides` (list): stride size of each level relative to the
+        previous one.
+
+        Example::
+
+           >>> keys = manager.build_hierarchy(sinput.coordinate_map_key, [2, 2, 2, 2])
+
+        """
+        strides = [convert_to_int_list(stride, self.D) for stride in strides]
+        return self._manager.build_hierarchy(coordinate_map_key, strides)
+
     def origin(self) -> CoordinateMapKey:
         return self._manager.origin()
 
@@ -435,9 +534,218 @@ class CoordinateManager:
     def interpolation_map_weight(
         self,
         key: CoordinateMapKey,
-        samples: torch.Tensor,
+        samples: Union[torch.Tensor, CoordinateMapKey],
     ):
-        return self._manager.interpolation_map_weight(samples, key)
+        r"""Return the interpolation (in map, out map, weights) of the samples.
+
+        When :attr:`samples` is the coordinate map key of a coordinate field,
+        the map is computed once and cached for the pair of keys.
+        """
+        if isinstance(samples, CoordinateMapKey):
+            map_weight = self._manager.field_interpolation_map_weight(samples, key)
+        else:
+            map_weight = self._manager.interpolation_map_weight(samples, key)
+        # The CPU map also has the row offsets used by the backend kernels
+        return map_weight[:3]
+
+    def release_field_interpolation_maps(self, field_key: CoordinateMapKey) -> int:
+        r"""Release the cached interpolation maps of the coordinate field."""
+        return self._manager.release_field_interpolation_maps(field_key)
+
+    def neighbor_query(
+        self,
+        key: CoordinateMapKey,
+        queries: torch.Tensor,
+        radius: float,
+        max_num_neighbors: int = 0,
+    ):
+        r"""Return the neighbors of the continuous query points within the
+        radius in increasing distance.
+
+        Args:
+            :attr:`queries` (:attr:`torch.Tensor`): a CPU float matrix of size
+            :math:`N \times (D + 1)` with the batch index in the first column.
+
+            :attr:`radius` (float): the search radius.
+
+            :attr:`max_num_neighbors` (int): the maximum number of neighbors
+            per query. 0 returns all neighbors within the radius.
+
+        Returns:
+            :attr:`(offsets, rows, distances)` in the CSR format.
+            :attr:`rows[offsets[i]:offsets[i + 1]]` are the coordinate map rows
+            of the neighbors of the query :attr:`i`.
+        """
+        return self._manager.neighbor_query(
+            queries.contiguous(), key, radius, max_num_neighbors
+        )
+
+    def crop(self, key: CoordinateMapKey, boxes: torch.Tensor, block_size: int = 8):
+        r"""Crop the coordinate map to axis-aligned boxes.
+
+        The coordinates are bucketed into blocks of :attr:`block_size` times the
+        tensor stride on the first crop and the block index is cached, so a crop
+        only visits the blocks that overlap the box.
+
+        Args:
+            :attr:`boxes` (:attr:`torch.IntTensor`): a CPU matrix of size
+            :math:`N \times (2D + 1)`. Each row is the batch index, the min
+            coordinates, and the max coordinates of a box. The bounds are
+            inclusive.
+
+            :attr:`block_size` (int): the block size of the index.
+
+        Returns:
+            :attr:`(keys, rows)`. :attr:`keys[i]` is the coordinate map key of
+            the crop :attr:`i` and :attr:`rows[i]` are the input rows in it.
+        """
+        return self._manager.crop(key, boxes.int().contiguous(), block_size)
+
+    def crop_rows(
+        self, key: CoordinateMapKey, boxes: torch.Tensor, block_size: int = 8
+    ):
+        r"""The input rows of each box of :attr:`crop` without inserting the
+        cropped coordinate maps. The block index is shared with :attr:`crop`.
+
+        Returns:
+            :attr:`rows`. :attr:`rows[i]` are the input rows in the box
+            :attr:`i`.
+        """
+        return self._manager.crop_rows(key, boxes.int().contiguous(), block_size)
+
+    @contextmanager
+    def capture(self):
+        r"""Record the coordinate map and kernel map results of the forward
+        passes in the context as the execution plan of the manager.
+
+        Example::
+
+           >>> manager = sinput.coordinate_manager
+           >>> with manager.capture():
+           >>>     soutput = model(sinput)
+           >>> sinput2 = ME.SparseTensor(features2,
+           >>>     coordinate_map_key=sinput.coordinate_map_key,
+           >>>     coordinate_manager=manager)
+           >>> with manager.replay():
+           >>>     soutput2 = model(sinput2)
+
+        """
+        self._manager.begin_capture()
+        try:
+            yield self
+        finally:
+            self._manager.end_capture()
+
+    @contextmanager
+    def replay(self):
+        r"""Replay the captured plan. The ops that follow the captured order
+        return the recorded maps directly. The ops that deviate from the plan
+        fall back to the map lookups, and the replay resumes at the next op
+        that matches the plan.
+
+        The plan matches the ops by the coordinate map keys of this manager
+        and has no fingerprint of the coordinates. Only the inputs that reuse
+        this manager and the captured input key replay the plan. To share the
+        plan with the inputs of other managers, pass :attr:`kernel_map_plan`
+        to their :attr:`set_kernel_map_hints`."""
+        self._manager.begin_replay()
+        try:
+            yield self
+        finally:
+            self._manager.end_replay()
+
+    def plan_size(self) -> int:
+        return self._manager.plan_size()
+
+    def plan_cursor(self) -> int:
+        r"""Position in the plan after the last entry returned by the last
+        replay."""
+        return self._manager.plan_cursor()
+
+    def kernel_map_plan(self) -> list:
+        r"""Kernel map keys of the captured plan. Pass them to
+        :attr:`set_kernel_map_hints` of the managers of the next inputs."""
+        return self._manager.kernel_map_plan()
+
+    def set_kernel_map_hints(self, kernel_map_keys: list):
+        r"""Build the listed kernel maps on a background worker as soon as
+        their input and output coordinate maps are inserted, so that the
+        kernel maps of the next layers are generated while the current layer
+        runs. Only the CPU managers prefetch; the hints are ignored otherwise.
+
+        Example::
+
+           >>> with sinput.coordinate_manager.capture():
+           >>>     model(sinput)
+           >>> plan = sinput.coordinate_manager.kernel_map_plan()
+           >>> sinput2 = ME.SparseTensor(features2, coordinates2)
+           >>> sinput2.coordinate_manager.set_kernel_map_hints(plan)
+           >>> soutput2 = model(sinput2)
+
+        """
+        self._manager.set_kernel_map_hints(kernel_map_keys)
+
+    def num_kernel_map_hints(self) -> int:
+        r"""Number of the hints waiting for their coordinate maps."""
+        return self._manager.num_kernel_map_hints()
+
+    def num_threads(self) -> int:
+        return self._manager.num_threads()
+
+    def set_num_threads(self, num_threads: int):
+        r"""Set the number of CPU threads of this manager. 0 uses the OpenMP
+        default."""
+        assert num_threads >= 0, f"Invalid num_threads: {num_threads}"
+        self._manager.set_num_threads(num_threads)
+
+    def cpu_affinity(self) -> list:
+        return self._manager.cpu_affinity()
+
+    def set_cpu_affinity(self, cpu_affinity: List[int]):
+        r"""Pin the CPU threads of this manager to the listed cores. An empty
+        list removes the pinning."""
+        self._manager.set_cpu_affinity([int(cpu) for cpu in cpu_affinity])
+
+    def worker_cpu_affinity(self) -> list:
+        r"""The CPUs each OpenMP thread of this manager may run on. Empty on
+        the platforms without :attr:`os.sched_getaffinity`."""
+        return self._manager.worker_cpu_affinity()
+
+    def threading_policy(self) -> ThreadingPolicy:
+        return self._manager.threading_policy()
+
+    def set_threading_policy(self, threading_policy: ThreadingPolicy):
+        r"""Set the CPU threading policy of the functions of this manager. See
+        :attr:`MinkowskiEngine.set_threading_policy`."""
+        self._manager.set_threading_policy(threading_policy)
+
+    def prefetch_kernel_map(
+        self,
+        in_key: CoordinateMapKey,
+        out_key: CoordinateMapKey,
+        stride=1,
+        kernel_size=3,
+        dilation=1,
+        region_type=RegionType.HYPER_CUBE,
+        is_transpose=False,
+        is_pool=False,
+    ) -> bool:
+        r"""Start building a kernel map on a background worker.
+        :attr:`kernel_map` with the same arguments waits for the result.
+        Returns False if :attr:`in_key` or :attr:`out_key` does not exist.
+        """
+        if isinstance(kernel_size, int) and kernel_size == 1:
+            region_type = RegionType.HYPER_CUBE
+        return self._manager.prefetch_kernel_map(
+            in_key,
+            out_key,
+            convert_to_int_list(kernel_size, self.D),  #
+            convert_to_int_list(stride, self.D),  #
+            convert_to_int_list(dilation, self.D),  #
+            region_type,
+            is_transpose,
+            is_pool,
+        )
 
     # def get_union_map(self, in_keys: List[CoordsKey], out_key: CoordsKey):
     #     r"""Generates a union of coordinate sets and returns the mapping from input sets to the new output coordinates.
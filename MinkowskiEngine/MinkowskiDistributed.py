@@ -0,0 +1,291 @@
+# Copyright (c) 2020 NVIDIA CORPORATION.
+# Copyright (c) 2018-2020 Chris Choy (chrischoy@ai.stanford.edu).
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+# of the Software, and to permit persons to whom the Software is furnished to do
+# so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+# Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+# Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+# of the code.
+from typing import List
+
+import torch
+import torch.distributed as dist
+from torch.autograd import Function
+
+from MinkowskiEngineBackend._C import CoordinateMapType
+from MinkowskiSparseTensor import SparseTensor
+from MinkowskiCommon import MinkowskiModuleBase
+from MinkowskiCoordinateManager import CoordinateManager
+from MinkowskiConvolution import MinkowskiConvolutionBase
+
+
+class _HaloPlan:
+    r"""Rows exchanged with the neighbor ranks for a coordinate map and a halo
+    width, and the key of the map extended by the received halo."""
+
+    __slots__ = ("send_rows", "recv_sizes", "num_rows", "key", "unique_map")
+
+    def __init__(self, send_rows, recv_sizes, num_rows, key, unique_map):
+        self.send_rows = send_rows
+        self.recv_sizes = recv_sizes
+        self.num_rows = num_rows
+        self.key = key
+        self.unique_map = unique_map
+
+
+class SpatialShard:
+    r"""Spatial partition of a sparse tensor across the ranks of the default
+    process group.
+
+    The coordinate space is split into slabs along :attr:`axis` and the rank
+    :math:`r` owns the coordinates :math:`x` with :math:`s_{r - 1} \le x < s_r`
+    where :math:`s` are the :attr:`splits`. Each rank keeps the owned
+    coordinates in its own CPU coordinate manager. The halos are exchanged
+    with the two neighbor slabs only, so a halo must not be wider than a
+    slab.
+
+    The splits must be multiples of the coarsest tensor stride of the network
+    for the strided layers to own the same coarse coordinates as a single
+    process.
+
+    Example::
+
+       >>> dist.init_process_group("gloo", ...)
+       >>> shard = ME.SpatialShard([64], dimension=3)
+       >>> sinput = shard.scatter(coordinates, features)
+       >>> conv = ME.MinkowskiShardedConvolution(
+       >>>     ME.MinkowskiConvolution(3, 16, kernel_size=3, dimension=3), shard)
+       >>> soutput = conv(sinput)
+
+    """
+
+    def __init__(self, splits: List[int], dimension: int, axis: int = 0):
+        assert dist.is_initialized(), "Initialize the default process group first."
+        self.rank = dist.get_rank()
+        self.world_size = dist.get_world_size()
+        assert len(splits) == self.world_size - 1, "Invalid number of splits."
+        assert all(s0 < s1 for s0, s1 in zip(splits[:-1], splits[1:]))
+        assert 0 <= axis < dimension
+        self.splits = list(splits)
+        bounds = [None] + self.splits + [None]
+        self.lower, self.upper = bounds[self.rank], bounds[self.rank + 1]
+        self.axis = axis
+        # neighbor rank and the bound of the slab it shares
+        self.neighbors = []
+        if self.lower is not None:
+            self.neighbors.append((self.rank - 1, self.lower))
+        if self.upper is not None:
+            self.neighbors.append((self.rank + 1, self.upper))
+        self.coordinate_manager = CoordinateManager(
+            D=dimension, coordinate_map_type=CoordinateMapType.CPU
+        )
+        self._plans = {}
+        self._keys = {}
+
+    def owned(self, coordinates: torch.Tensor) -> torch.Tensor:
+        r"""Mask of the coordinates owned by this rank."""
+        x = coordinates[:, self.axis + 1]
+        mask = torch.ones(len(coordinates), dtype=torch.bool)
+        if self.lower is not None:
+            mask &= x >= self.lower
+        if self.upper is not None:
+            mask &= x < self.upper
+        return mask
+
+    def scatter(
+        self, coordinates: torch.Tensor, features: torch.Tensor, tensor_stride=1
+    ) -> SparseTensor:
+        r"""Sparse tensor of the owned coordinates and features."""
+        mask = self.owned(coordinates)
+        stensor = SparseTensor(
+            features[mask],
+            coordinates=coordinates[mask],
+            tensor_stride=tensor_stride,
+            coordinate_manager=self.coordinate_manager,
+        )
+        self.register(stensor)
+        return stensor
+
+    def register(self, stensor: SparseTensor):
+        r"""Register the owned coordinate map of a tensor stride, used as the
+        output of the sharded transposed layers."""
+        self._keys.setdefault(tuple(stensor.tensor_stride), stensor.coordinate_map_key)
+
+    def owned_key(self, tensor_stride):
+        assert (
+            tuple(tensor_stride) in self._keys
+        ), f"No owned coordinate map of tensor stride {tensor_stride}."
+        return self._keys[tuple(tensor_stride)]
+
+    def _exchange(self, send: dict, recv_sizes: dict = None) -> dict:
+        r"""Send a tensor to each neighbor and receive one from each."""
+        if recv_sizes is None:
+            sizes = {peer: torch.LongTensor([len(t)]) for peer, t in send.items()}
+            recv_sizes = {peer: torch.LongTensor([0]) for peer in send}
+            requests = []
+            for peer in send:
+                requests.append(dist.isend(sizes[peer], peer))
+                requests.append(dist.irecv(recv_sizes[peer], peer))
+            for request in requests:
+                request.wait()
+            recv_sizes = {peer: int(size) for peer, size in recv_sizes.items()}
+
+        recv, requests = {}, []
+        for peer, t in send.items():
+            t = t.contiguous()
+            recv[peer] = t.new_empty((recv_sizes[peer],) + t.shape[1:])
+            if len(t) > 0:
+                requests.append(dist.isend(t, peer))
+            if recv_sizes[peer] > 0:
+                requests.append(dist.irecv(recv[peer], peer))
+        for request in requests:
+            request.wait()
+        return recv
+
+    def plan(self, coordinate_map_key, width: int) -> _HaloPlan:
+        r"""Halo exchange plan of a coordinate map, built once and cached."""
+        plan_key = (coordinate_map_key, width)
+        if plan_key in self._plans:
+            return self._plans[plan_key]
+        assert all(
+            s1 - s0 >= width for s0, s1 in zip(self.splits[:-1], self.splits[1:])
+        ), f"The halo width {width} is wider than a slab."
+
+        manager = self.coordinate_manager
+        coordinates = manager.get_coordinates(coordinate_map_key)
+        x = coordinates[:, self.axis + 1]
+        send_rows = {}
+        for peer, bound in self.neighbors:
+            mask = x < bound + width if peer < self.rank else x >= bound - width
+            send_rows[peer] = mask.nonzero().view(-1)
+        halos = self._exchange(
+            {peer: coordinates[rows] for peer, rows in send_rows.items()}
+        )
+        extended_key, (unique_map, _) = manager.insert_and_map(
+            torch.cat([coordinates] + [halos[peer] for peer, _ in self.neighbors]),
+            coordinate_map_key.get_tensor_stride(),
+            "halo",
+        )
+        plan = _HaloPlan(
+            send_rows,
+            {peer: len(halo) for peer, halo in halos.items()},
+            len(coordinates),
+            extended_key,
+            unique_map.long(),
+        )
+        self._plans[plan_key] = plan
+        return plan
+
+
+class MinkowskiHaloExchangeFunction(Function):
+    r"""Features of a coordinate map extended by the halo features of the
+    neighbor ranks. The backward returns the halo gradients to their owners."""
+
+    @staticmethod
+    def forward(ctx, in_feat: torch.Tensor, plan: _HaloPlan, shard: SpatialShard):
+        ctx.plan, ctx.shard = plan, shard
+        halos = shard._exchange(
+            {peer: in_feat[rows] for peer, rows in plan.send_rows.items()},
+            plan.recv_sizes,
+        )
+        return torch.cat(
+            [in_feat] + [halos[peer] for peer, _ in shard.neighbors]
+        )[plan.unique_map]
+
+    @staticmethod
+    def backward(ctx, grad_out_feat: torch.Tensor):
+        plan, shard = ctx.plan, ctx.shard
+        grad = torch.empty_like(grad_out_feat)
+        grad[plan.unique_map] = grad_out_feat
+        grad_in_feat = grad[: plan.num_rows].clone()
+
+        send, offset = {}, plan.num_rows
+        for peer, _ in shard.neighbors:
+            send[peer] = grad[offset : offset + plan.recv_sizes[peer]]
+            offset += plan.recv_sizes[peer]
+        grads = shard._exchange(
+            send, {peer: len(rows) for peer, rows in plan.send_rows.items()}
+        )
+        for peer, rows in plan.send_rows.items():
+            grad_in_feat.index_add_(0, rows, grads[peer])
+        return grad_in_feat, None, None
+
+
+class MinkowskiShardedConvolution(MinkowskiModuleBase):
+    r"""Run a convolution on the owned coordinates of a :attr:`SpatialShard`.
+
+    The features within the kernel reach of the slab bounds are exchanged
+    with the neighbor ranks before the convolution, so the outputs match the
+    single process convolution. The module shares the parameters of the
+    wrapped convolution.
+    """
+
+    def __init__(self, conv: MinkowskiConvolutionBase, shard: SpatialShard):
+        MinkowskiModuleBase.__init__(self)
+        assert isinstance(conv, MinkowskiConvolutionBase)
+        assert (
+            not conv.kernel_generator.expand_coordinates
+        ), "Generative convolutions are not supported."
+        self.module = conv
+        self.shard = shard
+
+    def forward(self, input: SparseTensor) -> SparseTensor:
+        assert isinstance(input, SparseTensor)
+        assert input.coordinate_manager == self.shard.coordinate_manager
+        conv, shard = self.module, self.shard
+        if conv.use_mm:
+            return conv(input)
+
+        shard.register(input)
+        kernel_generator = conv.kernel_generator
+        in_stride = input.tensor_stride
+        manager = input.coordinate_manager
+        if conv.is_transpose:
+            # the fine outputs read the coarse inputs of the next coarse voxel
+            width = (kernel_generator.max_offset + 1) * max(in_stride)
+            out_key = shard.owned_key(
+                [t // s for t, s in zip(in_stride, kernel_generator.kernel_stride)]
+            )
+        else:
+            width = kernel_generator.max_offset * max(in_stride)
+            out_key = input.coordinate_map_key
+            if max(kernel_generator.kernel_stride) > 1:
+                out_key = manager.stride(out_key, kernel_generator.kernel_stride)
+
+        plan = shard.plan(input.coordinate_map_key, width)
+        outfeat = conv.conv.apply(
+            MinkowskiHaloExchangeFunction.apply(input.F, plan, shard),
+            conv.kernel,
+            kernel_generator,
+            conv.convolution_mode,
+            plan.key,
+            out_key,
+            manager,
+        )
+        if conv.bias is not None:
+            outfeat += conv.bias
+
+        output = SparseTensor(
+            outfeat, coordinate_map_key=out_key, coordinate_manager=manager
+        )
+        shard.register(output)
+        return output
+
+    def __repr__(self):
+        return self.__class__.__name__ + f"({self.module})"
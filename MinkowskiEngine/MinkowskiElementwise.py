@@ -0,0 +1,87 @@
+# Copyright (c) Chris Choy (chrischoy@ai.stanford.edu).
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+# of the Software, and to permit persons to whom the Software is furnished to do
+# so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+# Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+# Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+# of the code.
+import torch
+from torch.autograd import Function
+
+from MinkowskiEngineBackend._C import CoordinateMapKey, BinaryMode, JoinMode
+from MinkowskiCommon import get_minkowski_function
+
+
+class MinkowskiElementwiseFunction(Function):
+    r"""Elementwise operation between the features of two sparse tensors with
+    different coordinate maps.
+
+    The output coordinates are the union or the intersection of the input
+    coordinates. For the union, a coordinate missing from one input has a zero
+    feature in that input, except for :attr:`BinaryMode.MAXIMUM` which takes
+    the feature of the other input.
+    """
+
+    @staticmethod
+    def forward(
+        ctx,
+        in_feat0: torch.Tensor,
+        in_feat1: torch.Tensor,
+        operation_type: BinaryMode,
+        join_type: JoinMode,
+        in_coords_key0: CoordinateMapKey,
+        in_coords_key1: CoordinateMapKey,
+        out_coords_key: CoordinateMapKey,
+        coords_manager,
+    ):
+        assert isinstance(operation_type, BinaryMode)
+        assert isinstance(join_type, JoinMode)
+        in_feat0, in_feat1 = in_feat0.contiguous(), in_feat1.contiguous()
+        ctx.op = (operation_type, join_type)
+        ctx.keys = (in_coords_key0, in_coords_key1, out_coords_key, coords_manager)
+        ctx.save_for_backward(in_feat0, in_feat1)
+
+        fw_fn = get_minkowski_function("ElementwiseForward", in_feat0)
+        return fw_fn(
+            in_feat0,
+            in_feat1,
+            operation_type,
+            join_type,
+            in_coords_key0,
+            in_coords_key1,
+            out_coords_key,
+            coords_manager._manager,
+        )
+
+    @staticmethod
+    def backward(ctx, grad_out_feat: torch.Tensor):
+        in_feat0, in_feat1 = ctx.saved_tensors
+        in_coords_key0, in_coords_key1, out_coords_key, coords_manager = ctx.keys
+        bw_fn = get_minkowski_function("ElementwiseBackward", grad_out_feat)
+        grad_in_feat0, grad_in_feat1 = bw_fn(
+            grad_out_feat.contiguous(),
+            in_feat0,
+            in_feat1,
+            *ctx.op,
+            in_coords_key0,
+            in_coords_key1,
+            out_coords_key,
+            coords_manager._manager,
+        )
+        return grad_in_feat0, grad_in_feat1, None, None, None, None, None, None
@@ -29,6 +29,7 @@ from torch.autograd import Function
 
 from MinkowskiEngineBackend._C import CoordinateMapKey
 from MinkowskiSparseTensor import SparseTensor
+from MinkowskiTensorField import TensorField
 from MinkowskiCoordinateManager import CoordinateManager
 from MinkowskiCommon import (
     MinkowskiModuleBase,
@@ -44,18 +45,21 @@ class MinkowskiInterpolationFunction(Function):
         tfield: torch.Tensor,
         in_coordinate_map_key: CoordinateMapKey,
         coordinate_manager: CoordinateManager = None,
+        tfield_map_key: CoordinateMapKey = None,
     ):
         input_features = input_features.contiguous()
-        # in_map, out_map, weights = coordinate_manager.interpolation_map_weight(
-        #     in_coordinate_map_key, tfield)
+        # When tfield is the coordinates of a registered TensorField, its key
+        # reuses the interpolation map cached in the coordinate manager.
         fw_fn = get_minkowski_function("InterpolationForward", input_features)
-        out_feat, in_map, out_map, weights = fw_fn(
+        # The CPU map also carries its entries grouped by the input row
+        out_feat, in_map, out_map, weights, *in_groups = fw_fn(
             input_features,
             tfield,
             in_coordinate_map_key,
+            tfield_map_key,
             coordinate_manager._manager,
         )
-        ctx.save_for_backward(in_map, out_map, weights)
+        ctx.save_for_backward(in_map, out_map, weights, *in_groups)
         ctx.inputs = (
             in_coordinate_map_key,
             coordinate_manager,
@@ -72,17 +76,13 @@ class MinkowskiInterpolationFunction(Function):
             in_coordinate_map_key,
             coordinate_manager,
         ) = ctx.inputs
-        in_map, out_map, weights = ctx.saved_tensors
-
         grad_in_feat = bw_fn(
             grad_out_feat,
-            in_map,
-            out_map,
-            weights,
+            *ctx.saved_tensors,
             in_coordinate_map_key,
             coordinate_manager._manager,
         )
-        return grad_in_feat, None, None, None
+        return grad_in_feat, None, None, None, None
 
 
 class MinkowskiInterpolation(MinkowskiModuleBase):
@@ -107,14 +107,22 @@ class MinkowskiInterpolation(MinkowskiModuleBase):
     def forward(
         self,
         input: SparseTensor,
-        tfield: torch.Tensor,
+        tfield: Union[torch.Tensor, TensorField],
     ):
+        tfield_map_key = None
+        if isinstance(tfield, TensorField):
+            # The cached map is only valid in the manager of the field
+            if tfield.coordinate_manager is input.coordinate_manager:
+                tfield_map_key = tfield._interpolation_field_key()
+            tfield = tfield.C
+
         # Get a new coordinate map key or extract one from the coordinates
         out_feat, in_map, out_map, weights = self.interp.apply(
             input.F,
             tfield,
             input.coordinate_map_key,
             input._manager,
+            tfield_map_key,
         )
 
         return_args = [out_feat]
@@ -309,6 +309,18 @@ class KernelGenerator:
         )
         self.expand_coordinates = expand_coordinates
 
+    @property
+    def max_offset(self) -> int:
+        r"""Largest offset of the kernel region in the unit of the tensor
+        stride."""
+        if self.region_offsets.numel() > 0:
+            return int(self.region_offsets.abs().max())
+        # odd kernels are centered, even kernels span [0, kernel_size - 1]
+        return max(
+            (k - 1) * d if k % 2 == 0 else (k - 1) // 2 * d
+            for k, d in zip(self.kernel_size, self.kernel_dilation)
+        )
+
     def get_kernel(self, tensor_stride, is_transpose):
         assert len(tensor_stride) == self.dimension
         if tuple(tensor_stride) not in self.cache:
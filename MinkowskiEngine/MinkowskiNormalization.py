@@ -30,11 +30,6 @@ from torch.autograd import Function
 from MinkowskiSparseTensor import SparseTensor
 from MinkowskiTensorField import TensorField
 
-from MinkowskiPooling import MinkowskiGlobalAvgPooling
-from MinkowskiBroadcast import (
-    MinkowskiBroadcastAddition,
-    MinkowskiBroadcastMultiplication,
-)
 from MinkowskiEngineBackend._C import (
     CoordinateMapKey,
     BroadcastMode,
@@ -200,10 +195,27 @@ class MinkowskiInstanceNormFunction(Function):
         glob_coords_key: CoordinateMapKey = None,
         coords_manager: CoordinateManager = None,
         gpooling_mode=PoolingMode.GLOBAL_AVG_POOLING_KERNEL,
+        eps=1e-8,
     ):
         if glob_coords_key is None:
             glob_coords_key = CoordinateMapKey(in_coords_key.get_coordinate_size())
 
+        ctx.saved_vars = (in_coords_key, glob_coords_key, coords_manager, gpooling_mode)
+        if not in_feat.is_cuda:
+            # Fused statistics and normalization over the batch segments
+            instance_norm_forward = get_minkowski_function(
+                "InstanceNormForward", in_feat
+            )
+            norm_feat, inv_std = instance_norm_forward(
+                in_feat.contiguous(),
+                eps,
+                in_coords_key,
+                glob_coords_key,
+                coords_manager._manager,
+            )
+            ctx.save_for_backward(inv_std, norm_feat)
+            return norm_feat
+
         gpool_avg_forward = get_minkowski_function("GlobalPoolingForward", in_feat)
         broadcast_forward = get_minkowski_function("BroadcastForward", in_feat)
 
@@ -235,7 +247,7 @@ class MinkowskiInstanceNormFunction(Function):
         )
 
         # norm_feat = (X - \mu) / \sigma
-        inv_std = 1 / (variance + 1e-8).sqrt()
+        inv_std = 1 / (variance + eps).sqrt()
         norm_feat = broadcast_forward(
             centered_feat,
             inv_std,
@@ -245,7 +257,6 @@ class MinkowskiInstanceNormFunction(Function):
             coords_manager._manager,
         )
 
-        ctx.saved_vars = (in_coords_key, glob_coords_key, coords_manager, gpooling_mode)
         # For GPU tensors, must use save_for_backward.
         ctx.save_for_backward(inv_std, norm_feat)
         return norm_feat
@@ -258,6 +269,20 @@ class MinkowskiInstanceNormFunction(Function):
         # To prevent the memory leakage, compute the norm again
         inv_std, norm_feat = ctx.saved_tensors
 
+        if not out_grad.is_cuda:
+            instance_norm_backward = get_minkowski_function(
+                "InstanceNormBackward", out_grad
+            )
+            norm_din = instance_norm_backward(
+                out_grad.contiguous(),
+                norm_feat,
+                inv_std,
+                in_coords_key,
+                glob_coords_key,
+                coords_manager._manager,
+            )
+            return norm_din, None, None, None, None, None
+
         gpool_avg_forward = get_minkowski_function("GlobalPoolingForward", out_grad)
         broadcast_forward = get_minkowski_function("BroadcastForward", out_grad)
 
@@ -307,7 +332,7 @@ class MinkowskiInstanceNormFunction(Function):
             coords_manager._manager,
         )
 
-        return norm_din, None, None, None, None
+        return norm_din, None, None, None, None, None
 
 
 class MinkowskiStableInstanceNorm(MinkowskiModuleBase):
@@ -317,12 +342,7 @@ class MinkowskiStableInstanceNorm(MinkowskiModuleBase):
         self.eps = 1e-6
         self.weight = nn.Parameter(torch.ones(1, num_features))
         self.bias = nn.Parameter(torch.zeros(1, num_features))
-
-        self.mean_in = MinkowskiGlobalAvgPooling()
-        self.glob_sum = MinkowskiBroadcastAddition()
-        self.glob_sum2 = MinkowskiBroadcastAddition()
-        self.glob_mean = MinkowskiGlobalAvgPooling()
-        self.glob_times = MinkowskiBroadcastMultiplication()
+        self.inst_norm = MinkowskiInstanceNormFunction()
         self.reset_parameters()
 
     def __repr__(self):
@@ -333,26 +353,19 @@ class MinkowskiStableInstanceNorm(MinkowskiModuleBase):
         self.weight.data.fill_(1)
         self.bias.data.zero_()
 
-    def forward(self, x):
-        neg_mean_in = self.mean_in(
-            SparseTensor(-x.F, coords_key=x.coords_key, coords_manager=x.coords_man)
-        )
-        centered_in = self.glob_sum(x, neg_mean_in)
-        temp = SparseTensor(
-            centered_in.F ** 2,
-            coordinate_map_key=centered_in.coordinate_map_key,
-            coordinate_manager=centered_in.coordinate_manager,
-        )
-        var_in = self.glob_mean(temp)
-        instd_in = SparseTensor(
-            1 / (var_in.F + self.eps).sqrt(),
-            coordinate_map_key=var_in.coordinate_map_key,
-            coordinate_manager=var_in.coordinate_manager,
-        )
+    def forward(self, x: SparseTensor):
+        assert isinstance(x, SparseTensor)
 
-        x = self.glob_times(self.glob_sum2(x, neg_mean_in), instd_in)
+        output = self.inst_norm.apply(
+            x.F,
+            x.coordinate_map_key,
+            None,
+            x.coordinate_manager,
+            PoolingMode.GLOBAL_AVG_POOLING_KERNEL,
+            self.eps,
+        )
         return SparseTensor(
-            x.F * self.weight + self.bias,
+            output * self.weight + self.bias,
             coordinate_map_key=x.coordinate_map_key,
             coordinate_manager=x.coordinate_manager,
         )
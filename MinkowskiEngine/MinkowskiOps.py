@@ -31,10 +31,21 @@ from MinkowskiSparseTensor import SparseTensor
 from MinkowskiTensor import (
     COORDINATE_MANAGER_DIFFERENT_ERROR,
     COORDINATE_KEY_DIFFERENT_ERROR,
+    SparseTensorOperationMode,
+    sparse_tensor_operation_mode,
+    global_coordinate_manager,
+    set_global_coordinate_manager,
 )
 from MinkowskiTensorField import TensorField
 from MinkowskiCommon import MinkowskiModuleBase
-from MinkowskiEngineBackend._C import CoordinateMapKey
+from MinkowskiCoordinateManager import CoordinateManager
+from MinkowskiElementwise import MinkowskiElementwiseFunction
+from MinkowskiEngineBackend._C import (
+    CoordinateMapKey,
+    CoordinateMapType,
+    BinaryMode,
+    JoinMode,
+)
 
 
 class MinkowskiLinear(Module):
@@ -243,6 +254,76 @@ def var(*sparse_tensors):
     return _tuple_operator(*sparse_tensors, operator=lambda xs: return_var(xs))
 
 
+def elementwise(
+    input0: SparseTensor,
+    input1: SparseTensor,
+    operation_type: BinaryMode,
+    join_type: JoinMode = JoinMode.UNION,
+):
+    r"""Elementwise operation between two sparse tensors with different
+    coordinates.
+
+    The output coordinates are the union or the intersection of the input
+    coordinates. For the union, a coordinate missing from one input has a zero
+    feature in that input, except for :attr:`BinaryMode.MAXIMUM` which takes
+    the feature of the other input. Only available for CPU sparse tensors.
+
+    Example::
+
+       >>> import MinkowskiEngine as ME
+       >>> sout = ME.elementwise(decoder_out, skip, ME.BinaryMode.ADDITION,
+       >>>                       ME.JoinMode.INTERSECTION)
+
+    """
+    assert isinstance(input0, SparseTensor) and isinstance(input1, SparseTensor)
+    assert (
+        input0.coordinate_manager == input1.coordinate_manager
+    ), COORDINATE_MANAGER_DIFFERENT_ERROR
+    out_key = CoordinateMapKey(input0.coordinate_map_key.get_coordinate_size())
+    out_F = MinkowskiElementwiseFunction.apply(
+        input0.F,
+        input1.F,
+        operation_type,
+        join_type,
+        input0.coordinate_map_key,
+        input1.coordinate_map_key,
+        out_key,
+        input0.coordinate_manager,
+    )
+    return SparseTensor(
+        out_F, coordinate_map_key=out_key, coordinate_manager=input0.coordinate_manager
+    )
+
+
+def crop(sparse_tensor: SparseTensor, boxes: torch.Tensor, block_size: int = 8):
+    r"""Crop a sparse tensor to axis-aligned boxes.
+
+    Each row of :attr:`boxes` is the batch index, the min coordinates, and the
+    max coordinates of a box with inclusive bounds. Returns a list of sparse
+    tensors, one per box, that share the coordinate manager of the input. Only
+    available for CPU sparse tensors.
+
+    Example::
+
+       >>> import MinkowskiEngine as ME
+       >>> boxes = torch.IntTensor([[0, 0, 0, 0, 63, 63, 63]])
+       >>> crops = ME.crop(sinput, boxes)
+
+    """
+    assert isinstance(sparse_tensor, SparseTensor)
+    keys, rows = sparse_tensor.coordinate_manager.crop(
+        sparse_tensor.coordinate_map_key, boxes, block_size
+    )
+    return [
+        SparseTensor(
+            sparse_tensor.F[row],
+            coordinate_map_key=key,
+            coordinate_manager=sparse_tensor.coordinate_manager,
+        )
+        for key, row in zip(keys, rows)
+    ]
+
+
 def dense_coordinates(shape: Union[list, torch.Size]):
     """
     coordinates = dense_coordinates(tensor.shape)
@@ -305,6 +386,12 @@ def to_sparse(x: torch.Tensor, format: str = None, coordinates=None, device=None
     if device is None:
         device = x.device
     ch_dim = format.find("C")
+    if (
+        not x.is_cuda
+        and torch.device(device).type == "cpu"
+        and x.dtype in (torch.float32, torch.float64)
+    ):
+        return _to_sparse_cpu(x, ch_dim)
     reduced_x = torch.abs(x).sum(ch_dim)
     bcoords = torch.where(reduced_x != 0)
     stacked_bcoords = torch.stack(bcoords, dim=1).int()
@@ -317,6 +404,48 @@ def to_sparse(x: torch.Tensor, format: str = None, coordinates=None, device=None
     return SparseTensor(features=features, coordinates=stacked_bcoords, device=device)
 
 
+def _to_sparse_cpu(x: torch.Tensor, ch_dim: int):
+    r"""Single pass conversion of a CPU dense tensor to a SparseTensor.
+
+    The backend scans the dense tensor once and inserts the non-zero positions
+    directly into a new coordinate map.
+    """
+    coordinate_manager = None
+    if (
+        sparse_tensor_operation_mode()
+        == SparseTensorOperationMode.SHARE_COORDINATE_MANAGER
+    ):
+        coordinate_manager = global_coordinate_manager()
+    if coordinate_manager is None:
+        coordinate_manager = CoordinateManager(
+            D=x.ndim - 2, coordinate_map_type=CoordinateMapType.CPU
+        )
+        if (
+            sparse_tensor_operation_mode()
+            == SparseTensorOperationMode.SHARE_COORDINATE_MANAGER
+        ):
+            set_global_coordinate_manager(coordinate_manager)
+
+    coordinate_map_key, (
+        coordinates,
+        features,
+        positions,
+    ) = coordinate_manager.insert_dense(x, ch_dim)
+    if x.requires_grad:
+        # Gather through autograd. The positions index the channel-last view.
+        dims = [d for d in range(x.ndim) if d != ch_dim] + [ch_dim]
+        features = x.permute(*dims).reshape(-1, x.size(ch_dim))[positions]
+
+    stensor = SparseTensor(
+        features=features,
+        coordinate_map_key=coordinate_map_key,
+        coordinate_manager=coordinate_manager,
+    )
+    # The coordinates are already generated by the scan.
+    stensor._C = coordinates
+    return stensor
+
+
 def to_sparse_all(dense_tensor: torch.Tensor, coordinates: torch.Tensor = None):
     r"""Converts a (differentiable) dense tensor to a sparse tensor with all coordinates.
 
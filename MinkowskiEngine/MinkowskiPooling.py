@@ -392,7 +392,13 @@ class MinkowskiMaxPooling(MinkowskiPoolingBase):
     """
 
     def __init__(
-        self, kernel_size, stride=1, dilation=1, kernel_generator=None, dimension=None
+        self,
+        kernel_size,
+        stride=1,
+        dilation=1,
+        kernel_generator=None,
+        dimension=None,
+        compact_index=False,
     ):
         r"""a high-dimensional max pooling layer for sparse tensors.
 
@@ -420,6 +426,11 @@ class MinkowskiMaxPooling(MinkowskiPoolingBase):
             all the inputs and the network are defined. For example, images are
             in a 2D space, meshes and 3D shapes are in a 3D space.
 
+            :attr:`compact_index` (bool, optional): on CPU, save the index of
+            the max element for the backward pass as a uint8 position within
+            the pooling window instead of an int32 input index. This reduces
+            the saved memory by 4x. Ignored on GPU. False by default.
+
         .. warning::
 
            Custom kernel shapes are not supported when kernel_size == stride.
@@ -433,7 +444,9 @@ class MinkowskiMaxPooling(MinkowskiPoolingBase):
             dilation,
             kernel_generator,
             is_transpose=False,
-            pooling_mode=PoolingMode.LOCAL_MAX_POOLING,
+            pooling_mode=PoolingMode.LOCAL_MAX_POOLING_COMPACT_INDEX
+            if compact_index
+            else PoolingMode.LOCAL_MAX_POOLING,
             dimension=dimension,
         )
 
@@ -566,6 +566,23 @@ class SparseTensor(Tensor):
             features = MinkowskiSPMMFunction().apply(
                 field_map, tensor_map, weights, size, self._F
             )
+        elif X.coordinate_manager is self.coordinate_manager:
+            from MinkowskiInterpolation import MinkowskiInterpolationFunction
+
+            assert (
+                self.dtype == X.C.dtype
+            ), f"Invalid field coordinates dtype. use {self.dtype}"
+            assert (
+                X.C.device == self.device
+            ), f"field coordinates device ({X.C.device}) does not match the sparse tensor device ({self.device})."
+            # The interpolation map of the field is cached in the manager
+            features = MinkowskiInterpolationFunction().apply(
+                self._F,
+                X.C,
+                self.coordinate_map_key,
+                self.coordinate_manager,
+                X._interpolation_field_key(),
+            )[0]
         else:
             features = self.features_at_coordinates(X.C)
         return TensorField(
@@ -717,6 +734,34 @@ class SparseTensor(Tensor):
             self.coordinate_manager,
         )[0]
 
+    def neighbors_at_coordinates(
+        self,
+        query_coordinates: torch.Tensor,
+        radius: float,
+        max_num_neighbors: int = 0,
+    ):
+        r"""Find the neighbors of the continuous query coordinates within the
+        radius.
+
+        Args:
+           :attr:`query_coordinates` (:attr:`torch.FloatTensor`): a CPU
+           coordinate matrix of size :math:`N \times (D + 1)` where :math:`D`
+           is the size of the spatial dimension.
+
+           :attr:`radius` (float): the search radius.
+
+           :attr:`max_num_neighbors` (int): the maximum number of neighbors per
+           query. 0 returns all neighbors within the radius.
+
+        Returns:
+           :attr:`(offsets, rows, distances)` in the CSR format.
+           :attr:`self.F[rows[offsets[i]:offsets[i + 1]]]` are the features of
+           the neighbors of the query :attr:`i` in increasing distance.
+        """
+        return self.coordinate_manager.neighbor_query(
+            self.coordinate_map_key, query_coordinates, radius, max_num_neighbors
+        )
+
     def __repr__(self):
         return (
             self.__class__.__name__
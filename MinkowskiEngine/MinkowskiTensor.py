@@ -27,7 +27,8 @@ import torch
 import copy
 from enum import Enum
 
-from MinkowskiEngineBackend._C import CoordinateMapKey
+from MinkowskiEngineBackend._C import CoordinateMapKey, BinaryMode, JoinMode
+from MinkowskiElementwise import MinkowskiElementwiseFunction
 
 
 class SparseTensorOperationMode(Enum):
@@ -508,7 +509,7 @@ class Tensor:
         self._F /= other.F
         return self
 
-    def _binary_functor(self, other, binary_fn):
+    def _binary_functor(self, other, binary_fn, binary_mode=None):
         assert isinstance(other, (self.__class__, torch.Tensor))
         if isinstance(other, self.__class__):
             assert self._manager == other._manager, COORDINATE_MANAGER_DIFFERENT_ERROR
@@ -520,10 +521,28 @@ class Tensor:
                     coordinate_manager=self._manager,
                 )
             else:
-                # Generate union maps
                 out_key = CoordinateMapKey(
                     self.coordinate_map_key.get_coordinate_size()
                 )
+                if binary_mode is not None and not self._F.is_cuda:
+                    # Join the maps and the features in one pass
+                    out_F = MinkowskiElementwiseFunction.apply(
+                        self._F,
+                        other._F,
+                        binary_mode,
+                        JoinMode.UNION,
+                        self.coordinate_map_key,
+                        other.coordinate_map_key,
+                        out_key,
+                        self._manager,
+                    )
+                    return self.__class__(
+                        out_F,
+                        coordinate_map_key=out_key,
+                        coordinate_manager=self._manager,
+                    )
+
+                # Generate union maps
                 union_maps = self.coordinate_manager.union_map(
                     [self.coordinate_map_key, other.coordinate_map_key], out_key
                 )
@@ -531,12 +550,13 @@ class Tensor:
                 out_F = torch.zeros(
                     (N_out, self._F.size(1)), dtype=self.dtype, device=self.device
                 )
+                other_F = torch.zeros_like(out_F)
                 out_F[union_maps[0][1]] = self._F[union_maps[0][0]]
-                out_F[union_maps[1][1]] = binary_fn(
-                    out_F[union_maps[1][1]], other._F[union_maps[1][0]]
-                )
+                other_F[union_maps[1][1]] = other._F[union_maps[1][0]]
                 return self.__class__(
-                    out_F, coordinate_map_key=out_key, coordinate_manager=self._manager
+                    binary_fn(out_F, other_F),
+                    coordinate_map_key=out_key,
+                    coordinate_manager=self._manager,
                 )
         else:  # when it is a torch.Tensor
             return self.__class__(
@@ -553,7 +573,7 @@ class Tensor:
         on the other, features of the counterpart that do not exist will be set
         to 0.
         """
-        return self._binary_functor(other, lambda x, y: x + y)
+        return self._binary_functor(other, lambda x, y: x + y, BinaryMode.ADDITION)
 
     def __sub__(self, other):
         r"""
@@ -562,7 +582,7 @@ class Tensor:
         For coordinates that exist on one sparse tensor but not on the other,
         features of the counterpart that do not exist will be set to 0.
         """
-        return self._binary_functor(other, lambda x, y: x - y)
+        return self._binary_functor(other, lambda x, y: x - y, BinaryMode.SUBTRACTION)
 
     def __mul__(self, other):
         r"""
@@ -572,7 +592,9 @@ class Tensor:
         on the other, features of the counterpart that do not exist will be set
         to 0.
         """
-        return self._binary_functor(other, lambda x, y: x * y)
+        return self._binary_functor(
+            other, lambda x, y: x * y, BinaryMode.MULTIPLICATION
+        )
 
     def __truediv__(self, other):
         r"""
@@ -22,6 +22,7 @@
 # Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
 # of the code.
 import os
+import weakref
 import numpy as np
 from collections.abc import Sequence
 from typing import Union, List, Tuple
@@ -247,11 +248,27 @@ class TensorField(Tensor):
         self._batch_rows = None
         self._inverse_mapping = {}
         self._splat = {}
+        self._interpolation_finalizer = None
 
     @property
     def coordinate_key(self):
         return self.coordinate_field_map_key
 
+    def _interpolation_field_key(self):
+        r"""The field key for the interpolation maps cached in the manager.
+
+        The cached maps of the field are released when this tensor field is
+        garbage collected.
+        """
+        if self._interpolation_finalizer is None:
+            self._interpolation_finalizer = weakref.finalize(
+                self,
+                self._manager.release_field_interpolation_maps,
+                self.coordinate_field_map_key,
+            )
+            self._interpolation_finalizer.atexit = False
+        return self.coordinate_field_map_key
+
     @property
     def C(self):
         r"""The alias of :attr:`coords`."""
@@ -389,7 +406,7 @@ class TensorField(Tensor):
 
         tensor_map, field_map, weights = self._manager.interpolation_map_weight(
             coordinate_map_key, self._C
-        )
+        )[:3]
         # features
         N = len(self._F)
         assert weights.dtype == self._F.dtype
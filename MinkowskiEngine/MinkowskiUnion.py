@@ -27,6 +27,7 @@ from torch.autograd import Function
 
 from MinkowskiEngineBackend._C import CoordinateMapKey
 from MinkowskiSparseTensor import SparseTensor
+from MinkowskiCommon import get_minkowski_function
 from MinkowskiCoordinateManager import CoordinateManager
 
 
@@ -47,6 +48,17 @@ class MinkowskiUnionFunction(Function):
             in_coords_keys
         ), "The input features and keys must have the same length"
 
+        ctx.keys = (in_coords_keys, out_coords_key, coordinate_manager)
+        if not in_feats[0].is_cuda:
+            # The union rows are cached in the manager for the backward.
+            fw_fn = get_minkowski_function("UnionForward", in_feats[0])
+            return fw_fn(
+                [in_feat.contiguous() for in_feat in in_feats],
+                in_coords_keys,
+                out_coords_key,
+                coordinate_manager._manager,
+            )
+
         union_maps = coordinate_manager.union_map(in_coords_keys, out_coords_key)
         out_feat = torch.zeros(
             (coordinate_manager.size(out_coords_key), in_feats[0].shape[1]),
@@ -55,8 +67,8 @@ class MinkowskiUnionFunction(Function):
         )
         for in_feat, union_map in zip(in_feats, union_maps):
             out_feat[union_map[1]] += in_feat[union_map[0]]
-        ctx.keys = (in_coords_keys, coordinate_manager)
-        ctx.save_for_backward(*union_maps)
+        if any(ctx.needs_input_grad[3:]):
+            ctx.save_for_backward(*union_maps)
         return out_feat
 
     @staticmethod
@@ -64,8 +76,18 @@ class MinkowskiUnionFunction(Function):
         if not grad_out_feat.is_contiguous():
             grad_out_feat = grad_out_feat.contiguous()
 
+        in_coords_keys, out_coords_key, coordinate_manager = ctx.keys
+        if not grad_out_feat.is_cuda:
+            bw_fn = get_minkowski_function("UnionBackward", grad_out_feat)
+            grad_in_feats = bw_fn(
+                grad_out_feat,
+                in_coords_keys,
+                out_coords_key,
+                coordinate_manager._manager,
+            )
+            return (None, None, None, *grad_in_feats)
+
         union_maps = ctx.saved_tensors
-        in_coords_keys, coordinate_manager = ctx.keys
         num_ch, dtype, device = (
             grad_out_feat.shape[1],
             grad_out_feat.dtype,
@@ -58,6 +58,9 @@ from MinkowskiEngineBackend._C import (
     RegionType,
     PoolingMode,
     BroadcastMode,
+    BinaryMode,
+    JoinMode,
+    ThreadingPolicy,
     is_cuda_available,
     cuda_version,
     cudart_version,
@@ -93,6 +96,7 @@ from MinkowskiCommon import (
 from MinkowskiCoordinateManager import (
     set_memory_manager_backend,
     set_gpu_allocator,
+    set_threading_policy,
     CoordsManager,
     CoordinateManager,
 )
@@ -125,6 +129,7 @@ from MinkowskiPooling import (
 
 from MinkowskiBroadcast import (
     MinkowskiBroadcastFunction,
+    MinkowskiSEGatingFunction,
     MinkowskiBroadcastAddition,
     MinkowskiBroadcastMultiplication,
     MinkowskiBroadcast,
@@ -176,6 +181,14 @@ from MinkowskiPruning import MinkowskiPruning, MinkowskiPruningFunction
 
 from MinkowskiUnion import MinkowskiUnion, MinkowskiUnionFunction
 
+from MinkowskiElementwise import MinkowskiElementwiseFunction
+
+from MinkowskiDistributed import (
+    SpatialShard,
+    MinkowskiHaloExchangeFunction,
+    MinkowskiShardedConvolution,
+)
+
 from MinkowskiInterpolation import (
     MinkowskiInterpolation,
     MinkowskiInterpolationFunction,
@@ -200,6 +213,8 @@ from MinkowskiOps import (
     to_sparse,
     to_sparse_all,
     dense_coordinates,
+    elementwise,
+    crop,
 )
 
 from MinkowskiOps import _sum as sum
@@ -41,7 +41,48 @@ class SELayer(nn.Module):
         self.pooling = ME.MinkowskiGlobalPooling()
         self.broadcast_mul = ME.MinkowskiBroadcastMultiplication()
 
+    def _can_fuse(self, x):
+        # The fused path computes linear-relu-linear-sigmoid directly, so it
+        # only applies to that layout without any module hooks
+        if x.F.is_cuda or self.pooling.pooling_mode not in (
+            ME.PoolingMode.GLOBAL_AVG_POOLING_DEFAULT,
+            ME.PoolingMode.GLOBAL_AVG_POOLING_KERNEL,
+            ME.PoolingMode.GLOBAL_AVG_POOLING_PYTORCH_INDEX,
+        ):
+            return False
+        layout = (
+            ME.MinkowskiLinear,
+            ME.MinkowskiReLU,
+            ME.MinkowskiLinear,
+            ME.MinkowskiSigmoid,
+        )
+        if len(self.fc) != len(layout) or not all(
+            type(module) is module_type
+            for module, module_type in zip(self.fc, layout)
+        ):
+            return False
+        return not any(
+            module._forward_hooks or module._forward_pre_hooks
+            for module in self.fc.modules()
+        )
+
     def forward(self, x):
+        if self._can_fuse(x):
+            # Pooling, MLP, and gating in one pass over the batch segments
+            fc1, fc2 = self.fc[0].linear, self.fc[2].linear
+            return ME.SparseTensor(
+                ME.MinkowskiSEGatingFunction.apply(
+                    x.F,
+                    fc1.weight,
+                    fc1.bias,
+                    fc2.weight,
+                    fc2.bias,
+                    x.coordinate_map_key,
+                    x.coordinate_manager,
+                ),
+                coordinate_map_key=x.coordinate_map_key,
+                coordinate_manager=x.coordinate_manager,
+            )
         y = self.pooling(x)
         y = self.fc(y)
         return self.broadcast_mul(x, y)
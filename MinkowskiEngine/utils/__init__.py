@@ -25,4 +25,5 @@ from .quantization import sparse_quantize, ravel_hash_vec, fnv_hash_vec, unique_
 from .collation import SparseCollation, batched_coordinates, sparse_collate, batch_sparse_collate
 # from .coords import get_coords_map
 from .init import kaiming_normal_
-from .summary import summary
\ No newline at end of file
+from .summary import summary
+from .tiling import TiledInference, receptive_field
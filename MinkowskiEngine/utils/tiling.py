@@ -0,0 +1,203 @@
+# Copyright (c) Chris Choy (chrischoy@ai.stanford.edu).
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+# of the Software, and to permit persons to whom the Software is furnished to do
+# so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+# Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+# Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+# of the code.
+from concurrent.futures import ThreadPoolExecutor
+from typing import Tuple
+
+import torch
+import torch.nn as nn
+
+from MinkowskiEngineBackend._C import CoordinateMapType
+from MinkowskiCoordinateManager import CoordinateManager
+from MinkowskiSparseTensor import SparseTensor
+from MinkowskiPooling import MinkowskiGlobalPooling
+
+
+def receptive_field(model: nn.Module, tensor_stride: int = 1) -> Tuple[int, int]:
+    r"""Conservative halo of a network and its coarsest tensor stride.
+
+    The spatial layers are visited in the registration order, which is the
+    execution order for the encoder-decoder networks. The halo sums the kernel
+    reach of each layer at its tensor stride, plus the quantization slack of
+    the strided layers.
+
+    Args:
+        :attr:`model` (:attr:`torch.nn.Module`): a network without the global
+        layers.
+
+        :attr:`tensor_stride` (int): the tensor stride of the input.
+
+    Returns:
+        :attr:`(halo, max_tensor_stride)` in the unit of the input coordinates.
+    """
+    halo, curr_stride, max_stride = 0, tensor_stride, tensor_stride
+    for module in model.modules():
+        assert not isinstance(
+            module, MinkowskiGlobalPooling
+        ), "Tiled inference does not support the global pooling layers."
+        if not hasattr(module, "kernel_generator"):
+            continue
+        kernel_generator = module.kernel_generator
+        stride = max(kernel_generator.kernel_stride)
+        halo += kernel_generator.max_offset * curr_stride
+        if getattr(module, "is_transpose", False):
+            curr_stride = max(curr_stride // stride, 1)
+            halo += (stride - 1) * curr_stride
+        else:
+            halo += (stride - 1) * curr_stride
+            curr_stride *= stride
+        max_stride = max(max_stride, curr_stride)
+    return halo, max_stride
+
+
+class TiledInference:
+    r"""Run a network on a large scene tile by tile and stitch the outputs.
+
+    The input is split into cubic tiles of :attr:`tile_size`. Each tile is
+    cropped with a halo of the receptive field of the network, runs through
+    the network in its own coordinate manager, and keeps the outputs whose
+    coordinates fall in the tile interior. The peak memory is bounded by the
+    largest tile. The result matches the single pass for networks whose
+    outputs only depend on the receptive field, i.e. without the global
+    layers or the batch statistics.
+
+    Example::
+
+       >>> tiled = ME.utils.TiledInference(model.eval(), tile_size=256)
+       >>> soutput = tiled(sinput)
+
+    """
+
+    def __init__(
+        self,
+        model: nn.Module,
+        tile_size: int,
+        halo: int = None,
+        device=None,
+        max_workers: int = 1,
+    ):
+        r"""
+        Args:
+            :attr:`model` (:attr:`torch.nn.Module`): the network.
+
+            :attr:`tile_size` (int): the tile size in the unit of the input
+            coordinates. It is rounded up to a multiple of the coarsest tensor
+            stride of the network.
+
+            :attr:`halo` (int, optional): the halo of each tile. Computed by
+            :attr:`receptive_field` if not given.
+
+            :attr:`device` (:attr:`torch.device`, optional): the device that
+            runs the tiles. The stitched output is on the device of the input.
+
+            :attr:`max_workers` (int): the number of tiles in flight. 1
+            streams the tiles to cap the peak memory.
+        """
+        assert tile_size > 0
+        assert max_workers > 0
+        self.model = model
+        self.tile_size = tile_size
+        self.halo = halo
+        self.device = device
+        self.max_workers = max_workers
+
+    def _tile_rows(self, sinput: SparseTensor, boxes: torch.Tensor):
+        # crop_rows leaves no crop maps in the input manager
+        if not sinput.F.is_cuda:
+            return sinput.coordinate_manager.crop_rows(
+                sinput.coordinate_map_key, boxes
+            )
+        # The crop is CPU only. Index a CPU copy of the coordinates once.
+        manager = CoordinateManager(
+            D=sinput.D, coordinate_map_type=CoordinateMapType.CPU
+        )
+        key, (unique_map, _) = manager.insert_and_map(
+            sinput.C.cpu(), sinput.tensor_stride
+        )
+        unique_map = unique_map.long().to(sinput.device)
+        return [
+            unique_map[rows.to(sinput.device)]
+            for rows in manager.crop_rows(key, boxes)
+        ]
+
+    def _run_tile(self, sinput, tensor_stride, tile_size, tile, rows):
+        device = sinput.device if self.device is None else self.device
+        tile_input = SparseTensor(
+            sinput.F[rows].to(device),
+            coordinates=sinput.C[rows].to(device),
+            tensor_stride=tensor_stride,
+            device=device,
+        )
+        # no_grad is thread local and the tiles may run on the worker threads
+        with torch.no_grad():
+            tile_output = self.model(tile_input)
+        coordinates = tile_output.C
+        tile = tile.to(coordinates.device)
+        interior = (coordinates[:, 0] == tile[0]) & (
+            torch.floor(coordinates[:, 1:].double() / tile_size).long() == tile[1:]
+        ).all(dim=1)
+        return (
+            coordinates[interior].to(sinput.device),
+            tile_output.F[interior].to(sinput.device),
+            tile_output.tensor_stride,
+        )
+
+    def __call__(self, sinput: SparseTensor) -> SparseTensor:
+        assert isinstance(sinput, SparseTensor)
+        tensor_stride = sinput.tensor_stride
+        halo, max_stride = receptive_field(self.model, max(tensor_stride))
+        if self.halo is not None:
+            halo = self.halo
+        # align the tiles and the halos to the coarsest voxels
+        tile_size = (self.tile_size + max_stride - 1) // max_stride * max_stride
+        halo = (halo + max_stride - 1) // max_stride * max_stride
+
+        coordinates = sinput.C.cpu().long()
+        tiles = torch.cat(
+            (
+                coordinates[:, :1],
+                torch.floor(coordinates[:, 1:].double() / tile_size).long(),
+            ),
+            dim=1,
+        ).unique(dim=0)
+        lower = tiles[:, 1:] * tile_size - halo
+        upper = (tiles[:, 1:] + 1) * tile_size - 1 + halo
+        boxes = torch.cat((tiles[:, :1], lower, upper), dim=1).int()
+        rows = self._tile_rows(sinput, boxes)
+
+        def run(args):
+            return self._run_tile(sinput, tensor_stride, tile_size, *args)
+
+        if self.max_workers == 1:
+            outputs = [run(args) for args in zip(tiles, rows)]
+        else:
+            with ThreadPoolExecutor(self.max_workers) as executor:
+                outputs = list(executor.map(run, zip(tiles, rows)))
+
+        out_coordinates, out_features, out_stride = zip(*outputs)
+        return SparseTensor(
+            torch.cat(out_features, dim=0),
+            coordinates=torch.cat(out_coordinates, dim=0),
+            tensor_stride=out_stride[0],
+            device=sinput.device,
+        )
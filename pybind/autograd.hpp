@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2020 NVIDIA Corporation.
+ * Copyright (c) 2018-2020 Chris Choy (chrischoy@ai.stanford.edu).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+ * Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+ * of the code.
+ */
+#include "coordinate_map_key.hpp"
+#include "coordinate_map_manager.hpp"
+#include "types.hpp"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <torch/extension.h>
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+/*
+ * C++ autograd functions of the convolution and the transposed convolution.
+ * A module converts its kernel arguments to a KernelArguments once, and each
+ * forward is a single call into C++ that records a C++ backward node.
+ *
+ * Must be included after extern.hpp, which declares the CPU and GPU functions.
+ */
+namespace minkowski {
+
+// The kernel region arguments of a convolution module.
+struct KernelArguments {
+  default_types::stride_type kernel_size;
+  default_types::stride_type kernel_stride;
+  default_types::stride_type kernel_dilation;
+  RegionType::Type region_type;
+  at::Tensor offset;
+  bool expand_coordinates;
+  ConvolutionMode::Type convolution_mode;
+};
+
+namespace detail {
+
+template <typename manager_type> struct convolution_backend;
+
+template <typename coordinate_type>
+struct convolution_backend<cpu_manager_type<coordinate_type>> {
+  using manager_type = cpu_manager_type<coordinate_type>;
+
+  static at::Tensor forward(at::Tensor const &in_feat,
+                            at::Tensor const &kernel,
+                            KernelArguments const &args,
+                            CoordinateMapKey *p_in_map_key,
+                            CoordinateMapKey *p_out_map_key,
+                            manager_type *p_map_manager, bool is_transpose) {
+    return is_transpose ? ConvolutionTransposeForwardCPU<coordinate_type>(
+                              in_feat, kernel, args.kernel_size,
+                              args.kernel_stride, args.kernel_dilation,
+                              args.region_type, args.offset,
+                              args.expand_coordinates, args.convolution_mode,
+                              p_in_map_key, p_out_map_key, p_map_manager)
+                        : ConvolutionForwardCPU<coordinate_type>(
+                              in_feat, kernel, args.kernel_size,
+                              args.kernel_stride, args.kernel_dilation,
+                              args.region_type, args.offset,
+                              args.expand_coordinates, args.convolution_mode,
+                              p_in_map_key, p_out_map_key, p_map_manager);
+  }
+
+  static std::pair<at::Tensor, at::Tensor>
+  backward(at::Tensor const &in_feat, at::Tensor &grad_out_feat,
+           at::Tensor const &kernel, KernelArguments const &args,
+           CoordinateMapKey *p_in_map_key, CoordinateMapKey *p_out_map_key,
+           manager_type *p_map_manager, bool is_transpose) {
+    return is_transpose ? ConvolutionTransposeBackwardCPU<coordinate_type>(
+                              in_feat, grad_out_feat, kernel, args.kernel_size,
+                              args.kernel_stride, args.kernel_dilation,
+                              args.region_type, args.offset,
+                              args.convolution_mode, p_in_map_key,
+                              p_out_map_key, p_map_manager)
+                        : ConvolutionBackwardCPU<coordinate_type>(
+                              in_feat, grad_out_feat, kernel, args.kernel_size,
+                              args.kernel_stride, args.kernel_dilation,
+                              args.region_type, args.offset,
+                              args.convolution_mode, p_in_map_key,
+                              p_out_map_key, p_map_manager);
+  }
+};
+
+#ifndef CPU_ONLY
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator>
+struct convolution_backend<
+    gpu_manager_type<coordinate_type, TemplatedAllocator>> {
+  using manager_type = gpu_manager_type<coordinate_type, TemplatedAllocator>;
+
+  static at::Tensor forward(at::Tensor const &in_feat,
+                            at::Tensor const &kernel,
+                            KernelArguments const &args,
+                            CoordinateMapKey *p_in_map_key,
+                            CoordinateMapKey *p_out_map_key,
+                            manager_type *p_map_manager, bool is_transpose) {
+    return is_transpose
+               ? ConvolutionTransposeForwardGPU<coordinate_type,
+                                                TemplatedAllocator>(
+                     in_feat, kernel, args.kernel_size, args.kernel_stride,
+                     args.kernel_dilation, args.region_type, args.offset,
+                     args.expand_coordinates, args.convolution_mode,
+                     p_in_map_key, p_out_map_key, p_map_manager)
+               : ConvolutionForwardGPU<coordinate_type, TemplatedAllocator>(
+                     in_feat, kernel, args.kernel_size, args.kernel_stride,
+                     args.kernel_dilation, args.region_type, args.offset,
+                     args.expand_coordinates, args.convolution_mode,
+                     p_in_map_key, p_out_map_key, p_map_manager);
+  }
+
+  static std::pair<at::Tensor, at::Tensor>
+  backward(at::Tensor const &in_feat, at::Tensor &grad_out_feat,
+           at::Tensor const &kernel, KernelArguments const &args,
+           CoordinateMapKey *p_in_map_key, CoordinateMapKey *p_out_map_key,
+           manager_type *p_map_manager, bool is_transpose) {
+    return is_transpose
+               ? ConvolutionTransposeBackwardGPU<coordinate_type,
+                                                 TemplatedAllocator>(
+                     in_feat, grad_out_feat, kernel, args.kernel_size,
+                     args.kernel_stride, args.kernel_dilation,
+                     args.region_type, args.offset, args.convolution_mode,
+                     p_in_map_key, p_out_map_key, p_map_manager)
+               : ConvolutionBackwardGPU<coordinate_type, TemplatedAllocator>(
+                     in_feat, grad_out_feat, kernel, args.kernel_size,
+                     args.kernel_stride, args.kernel_dilation,
+                     args.region_type, args.offset, args.convolution_mode,
+                     p_in_map_key, p_out_map_key, p_map_manager);
+  }
+};
+#endif
+
+/*
+ * Non-tensor state of a convolution node. The node owns copies of the keys
+ * and a reference to the python manager so that the backward does not depend
+ * on the lifetime of the python objects.
+ */
+template <typename manager_type>
+struct convolution_context : torch::CustomClassHolder {
+  convolution_context(std::shared_ptr<KernelArguments const> args_,
+                      CoordinateMapKey const &in_map_key_,
+                      CoordinateMapKey const &out_map_key_,
+                      manager_type *p_map_manager_, bool is_transpose_)
+      : args(std::move(args_)), in_map_key(in_map_key_),
+        out_map_key(out_map_key_),
+        manager(py::cast(p_map_manager_, py::return_value_policy::reference)),
+        p_map_manager(p_map_manager_), is_transpose(is_transpose_) {}
+
+  ~convolution_context() {
+    py::gil_scoped_acquire acquire;
+    manager = py::object();
+  }
+
+  std::shared_ptr<KernelArguments const> args;
+  CoordinateMapKey in_map_key;
+  CoordinateMapKey out_map_key;
+  py::object manager;
+  manager_type *p_map_manager;
+  bool is_transpose;
+};
+
+} // namespace detail
+
+template <typename manager_type>
+class ConvolutionAutograd
+    : public torch::autograd::Function<ConvolutionAutograd<manager_type>> {
+  using context_type = detail::convolution_context<manager_type>;
+  using backend = detail::convolution_backend<manager_type>;
+
+public:
+  static at::Tensor forward(torch::autograd::AutogradContext *ctx,
+                            at::Tensor in_feat, at::Tensor kernel,
+                            c10::intrusive_ptr<context_type> context) {
+    in_feat = in_feat.contiguous();
+    at::Tensor out_feat = backend::forward(
+        in_feat, kernel, *context->args, &context->in_map_key,
+        &context->out_map_key, context->p_map_manager, context->is_transpose);
+    ctx->save_for_backward({in_feat, kernel});
+    ctx->saved_data["context"] = at::IValue::make_capsule(context);
+    return out_feat;
+  }
+
+  static torch::autograd::variable_list
+  backward(torch::autograd::AutogradContext *ctx,
+           torch::autograd::variable_list grad_outputs) {
+    auto const saved = ctx->get_saved_variables();
+    auto const context = c10::static_intrusive_pointer_cast<context_type>(
+        ctx->saved_data["context"].toCapsule());
+    at::Tensor grad_out_feat = grad_outputs[0].contiguous();
+    auto const grads = backend::backward(
+        saved[0], grad_out_feat, saved[1], *context->args,
+        &context->in_map_key, &context->out_map_key, context->p_map_manager,
+        context->is_transpose);
+    return {grads.first, grads.second, at::Tensor()};
+  }
+
+  // The output key is set on the python key, as the forward functions do.
+  static at::Tensor apply_module(at::Tensor const &in_feat,
+                                 at::Tensor const &kernel,
+                                 std::shared_ptr<KernelArguments const> args,
+                                 CoordinateMapKey *p_in_map_key,
+                                 CoordinateMapKey *p_out_map_key,
+                                 manager_type *p_map_manager,
+                                 bool is_transpose) {
+    auto context = c10::make_intrusive<context_type>(
+        std::move(args), *p_in_map_key, *p_out_map_key, p_map_manager,
+        is_transpose);
+    py::gil_scoped_release release;
+    at::Tensor out_feat = ConvolutionAutograd::apply(in_feat, kernel, context);
+    if (!p_out_map_key->is_key_set())
+      p_out_map_key->set_key(context->out_map_key.get_key());
+    return out_feat;
+  }
+};
+
+} // namespace minkowski
+
+void initialize_kernel_arguments(py::module &m) {
+  py::class_<minkowski::KernelArguments,
+             std::shared_ptr<minkowski::KernelArguments>>(m, "KernelArguments")
+      .def(py::init<minkowski::default_types::stride_type,
+                    minkowski::default_types::stride_type,
+                    minkowski::default_types::stride_type,
+                    minkowski::RegionType::Type, at::Tensor, bool,
+                    minkowski::ConvolutionMode::Type>())
+      .def_readonly("kernel_size", &minkowski::KernelArguments::kernel_size)
+      .def_readonly("kernel_stride", &minkowski::KernelArguments::kernel_stride)
+      .def_readonly("kernel_dilation",
+                    &minkowski::KernelArguments::kernel_dilation)
+      .def_readonly("region_type", &minkowski::KernelArguments::region_type)
+      .def_readonly("expand_coordinates",
+                    &minkowski::KernelArguments::expand_coordinates)
+      .def_readonly("convolution_mode",
+                    &minkowski::KernelArguments::convolution_mode)
+      .def(py::pickle(
+          [](minkowski::KernelArguments const &args) {
+            return py::make_tuple(args.kernel_size, args.kernel_stride,
+                                  args.kernel_dilation, args.region_type,
+                                  args.offset, args.expand_coordinates,
+                                  args.convolution_mode);
+          },
+          [](py::tuple state) {
+            ASSERT(state.size() == 7, "Invalid KernelArguments state.");
+            return std::make_shared<minkowski::KernelArguments>(
+                minkowski::KernelArguments{
+                    state[0].cast<minkowski::default_types::stride_type>(),
+                    state[1].cast<minkowski::default_types::stride_type>(),
+                    state[2].cast<minkowski::default_types::stride_type>(),
+                    state[3].cast<minkowski::RegionType::Type>(),
+                    state[4].cast<at::Tensor>(), state[5].cast<bool>(),
+                    state[6].cast<minkowski::ConvolutionMode::Type>()});
+          }));
+}
+
+template <typename manager_type>
+void instantiate_autograd_func(py::module &m, std::string const &postfix) {
+  m.def(
+      (std::string("Convolution") + postfix).c_str(),
+      [](at::Tensor const &in_feat, at::Tensor const &kernel,
+         std::shared_ptr<minkowski::KernelArguments> args,
+         minkowski::CoordinateMapKey *p_in_map_key,
+         minkowski::CoordinateMapKey *p_out_map_key,
+         manager_type *p_map_manager) {
+        return minkowski::ConvolutionAutograd<manager_type>::apply_module(
+            in_feat, kernel, std::move(args), p_in_map_key, p_out_map_key,
+            p_map_manager, false);
+      });
+  m.def(
+      (std::string("ConvolutionTranspose") + postfix).c_str(),
+      [](at::Tensor const &in_feat, at::Tensor const &kernel,
+         std::shared_ptr<minkowski::KernelArguments> args,
+         minkowski::CoordinateMapKey *p_in_map_key,
+         minkowski::CoordinateMapKey *p_out_map_key,
+         manager_type *p_map_manager) {
+        return minkowski::ConvolutionAutograd<manager_type>::apply_module(
+            in_feat, kernel, std::move(args), p_in_map_key, p_out_map_key,
+            p_map_manager, true);
+      });
+}
@@ -371,6 +371,44 @@ BroadcastBackwardCPU(at::Tensor const &in_feat, at::Tensor const &in_feat_glob,
                      CoordinateMapKey *p_glob_map_key, //
                      cpu_manager_type<coordinate_type> *p_map_manager);
 
+template <typename coordinate_type>
+std::vector<at::Tensor>
+SEGatingForwardCPU(at::Tensor const &in_feat,                         //
+                   at::Tensor const &weight1, at::Tensor const &bias1, //
+                   at::Tensor const &weight2, at::Tensor const &bias2, //
+                   CoordinateMapKey *p_in_map_key,                     //
+                   CoordinateMapKey *p_glob_map_key,                   //
+                   cpu_manager_type<coordinate_type> *p_map_manager);
+
+template <typename coordinate_type>
+std::vector<at::Tensor>
+SEGatingBackwardCPU(at::Tensor const &grad_out_feat, //
+                    at::Tensor const &in_feat,       //
+                    at::Tensor const &pooled,        //
+                    at::Tensor const &hidden,        //
+                    at::Tensor const &gate,          //
+                    at::Tensor const &weight1,       //
+                    at::Tensor const &weight2,       //
+                    CoordinateMapKey *p_in_map_key,  //
+                    CoordinateMapKey *p_glob_map_key,
+                    cpu_manager_type<coordinate_type> *p_map_manager);
+
+template <typename coordinate_type>
+std::pair<at::Tensor, at::Tensor>
+InstanceNormForwardCPU(at::Tensor const &in_feat, double const eps,
+                       CoordinateMapKey *p_in_map_key,   //
+                       CoordinateMapKey *p_glob_map_key, //
+                       cpu_manager_type<coordinate_type> *p_map_manager);
+
+template <typename coordinate_type>
+at::Tensor
+InstanceNormBackwardCPU(at::Tensor const &grad_out_feat,  //
+                        at::Tensor const &out_feat,       //
+                        at::Tensor const &inv_std,        //
+                        CoordinateMapKey *p_in_map_key,   //
+                        CoordinateMapKey *p_glob_map_key, //
+                        cpu_manager_type<coordinate_type> *p_map_manager);
+
 #ifndef CPU_ONLY
 template <typename coordinate_type,
           template <typename C> class TemplatedAllocator>
@@ -427,6 +465,49 @@ at::Tensor PruningBackwardGPU(
     gpu_manager_type<coordinate_type, TemplatedAllocator> *p_map_manager);
 #endif
 
+/*************************************
+ * Union
+ *************************************/
+template <typename coordinate_type>
+at::Tensor
+UnionForwardCPU(std::vector<at::Tensor> const &in_feats,              // CPU feats
+                std::vector<CoordinateMapKey *> const &p_in_map_keys, //
+                CoordinateMapKey *p_out_map_key,                      //
+                cpu_manager_type<coordinate_type> *p_map_manager);
+
+template <typename coordinate_type>
+std::vector<at::Tensor>
+UnionBackwardCPU(at::Tensor &grad_out_feat,                            // CPU
+                 std::vector<CoordinateMapKey *> const &p_in_map_keys, //
+                 CoordinateMapKey *p_out_map_key,                      //
+                 cpu_manager_type<coordinate_type> *p_map_manager);
+
+/*************************************
+ * Elementwise
+ *************************************/
+template <typename coordinate_type>
+at::Tensor
+ElementwiseForwardCPU(at::Tensor const &in_feat0,       // CPU feat
+                      at::Tensor const &in_feat1,       // CPU feat
+                      BinaryMode::Type const op,        //
+                      JoinMode::Type const join,        //
+                      CoordinateMapKey *p_in_map_key0,  //
+                      CoordinateMapKey *p_in_map_key1,  //
+                      CoordinateMapKey *p_out_map_key,  //
+                      cpu_manager_type<coordinate_type> *p_map_manager);
+
+template <typename coordinate_type>
+std::pair<at::Tensor, at::Tensor>
+ElementwiseBackwardCPU(at::Tensor &grad_out_feat,        // CPU grad
+                       at::Tensor const &in_feat0,       // CPU feat
+                       at::Tensor const &in_feat1,       // CPU feat
+                       BinaryMode::Type const op,        //
+                       JoinMode::Type const join,        //
+                       CoordinateMapKey *p_in_map_key0,  //
+                       CoordinateMapKey *p_in_map_key1,  //
+                       CoordinateMapKey *p_out_map_key,  //
+                       cpu_manager_type<coordinate_type> *p_map_manager);
+
 /*************************************
  * Interpolation
  *************************************/
@@ -435,6 +516,7 @@ std::vector<at::Tensor>
 InterpolationForwardCPU(at::Tensor const &in_feat,      //
                         at::Tensor const &tfield,       //
                         CoordinateMapKey *p_in_map_key, //
+                        CoordinateMapKey *p_field_map_key,
                         cpu_manager_type<coordinate_type> *p_map_manager);
 
 template <typename coordinate_type>
@@ -443,6 +525,8 @@ InterpolationBackwardCPU(at::Tensor &grad_out_feat,      //
                          at::Tensor const &in_map,       //
                          at::Tensor const &out_map,      //
                          at::Tensor const &weight,       //
+                         at::Tensor const &in_offsets,   //
+                         at::Tensor const &in_entries,   //
                          CoordinateMapKey *p_in_map_key, //
                          cpu_manager_type<coordinate_type> *p_map_manager);
 
@@ -453,6 +537,7 @@ std::vector<at::Tensor> InterpolationForwardGPU(
     at::Tensor const &in_feat,      //
     at::Tensor const &tfield,       //
     CoordinateMapKey *p_in_map_key, //
+    CoordinateMapKey *p_field_map_key,
     gpu_manager_type<coordinate_type, TemplatedAllocator> *p_map_manager);
 
 template <typename coordinate_type,
@@ -557,12 +642,38 @@ void instantiate_cpu_func(py::module &m, const std::string &dtypestr) {
         &minkowski::PruningBackwardCPU<coordinate_type>,
         py::call_guard<py::gil_scoped_release>());
 
+  m.def((std::string("UnionForwardCPU") + dtypestr).c_str(),
+        &minkowski::UnionForwardCPU<coordinate_type>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def((std::string("UnionBackwardCPU") + dtypestr).c_str(),
+        &minkowski::UnionBackwardCPU<coordinate_type>,
+        py::call_guard<py::gil_scoped_release>());
+
+  m.def((std::string("ElementwiseForwardCPU") + dtypestr).c_str(),
+        &minkowski::ElementwiseForwardCPU<coordinate_type>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def((std::string("ElementwiseBackwardCPU") + dtypestr).c_str(),
+        &minkowski::ElementwiseBackwardCPU<coordinate_type>,
+        py::call_guard<py::gil_scoped_release>());
+
   m.def((std::string("BroadcastForwardCPU") + dtypestr).c_str(),
         &minkowski::BroadcastForwardCPU<coordinate_type>,
         py::call_guard<py::gil_scoped_release>());
   m.def((std::string("BroadcastBackwardCPU") + dtypestr).c_str(),
         &minkowski::BroadcastBackwardCPU<coordinate_type>,
         py::call_guard<py::gil_scoped_release>());
+  m.def((std::string("SEGatingForwardCPU") + dtypestr).c_str(),
+        &minkowski::SEGatingForwardCPU<coordinate_type>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def((std::string("SEGatingBackwardCPU") + dtypestr).c_str(),
+        &minkowski::SEGatingBackwardCPU<coordinate_type>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def((std::string("InstanceNormForwardCPU") + dtypestr).c_str(),
+        &minkowski::InstanceNormForwardCPU<coordinate_type>,
+        py::call_guard<py::gil_scoped_release>());
+  m.def((std::string("InstanceNormBackwardCPU") + dtypestr).c_str(),
+        &minkowski::InstanceNormBackwardCPU<coordinate_type>,
+        py::call_guard<py::gil_scoped_release>());
 
   m.def((std::string("InterpolationForwardCPU") + dtypestr).c_str(),
         &minkowski::InterpolationForwardCPU<coordinate_type>,
@@ -647,10 +758,13 @@ void instantiate_gpu_func(py::module &m, const std::string &dtypestr) {
 #endif
 
 void non_templated_cpu_func(py::module &m) {
+  // quantize_np and quantize_label_np release the GIL after reading the arrays
   m.def("quantize_np", &minkowski::quantize_np);
-  m.def("quantize_th", &minkowski::quantize_th);
+  m.def("quantize_th", &minkowski::quantize_th,
+        py::call_guard<py::gil_scoped_release>());
   m.def("quantize_label_np", &minkowski::quantize_label_np);
-  m.def("quantize_label_th", &minkowski::quantize_label_th);
+  m.def("quantize_label_th", &minkowski::quantize_label_th,
+        py::call_guard<py::gil_scoped_release>());
   m.def("direct_max_pool_fw", &minkowski::max_pool_fw,
         py::call_guard<py::gil_scoped_release>());
   m.def("direct_max_pool_bw", &minkowski::max_pool_bw,
@@ -689,6 +803,12 @@ void initialize_non_templated_classes(py::module &m) {
              minkowski::MinkowskiAlgorithm::Mode::SPEED_OPTIMIZED)
       .export_values();
 
+  py::enum_<minkowski::ThreadingPolicy::Type>(m, "ThreadingPolicy")
+      .value("AUTO", minkowski::ThreadingPolicy::Type::AUTO)
+      .value("OUTER_PARALLEL", minkowski::ThreadingPolicy::Type::OUTER_PARALLEL)
+      .value("BLAS_PARALLEL", minkowski::ThreadingPolicy::Type::BLAS_PARALLEL)
+      .export_values();
+
   py::enum_<minkowski::CoordinateMapBackend::Type>(m, "CoordinateMapType")
       .value("CPU", minkowski::CoordinateMapBackend::Type::CPU)
       .value("CUDA", minkowski::CoordinateMapBackend::Type::CUDA)
@@ -725,6 +845,8 @@ void initialize_non_templated_classes(py::module &m) {
              minkowski::PoolingMode::Type::GLOBAL_AVG_POOLING_PYTORCH_INDEX)
       .value("GLOBAL_MAX_POOLING_PYTORCH_INDEX",
              minkowski::PoolingMode::Type::GLOBAL_MAX_POOLING_PYTORCH_INDEX)
+      .value("LOCAL_MAX_POOLING_COMPACT_INDEX",
+             minkowski::PoolingMode::Type::LOCAL_MAX_POOLING_COMPACT_INDEX)
       .export_values();
 
   py::enum_<minkowski::BroadcastMode::Type>(m, "BroadcastMode")
@@ -734,6 +856,18 @@ void initialize_non_templated_classes(py::module &m) {
              minkowski::BroadcastMode::Type::ELEMENTWISE_MULTIPLICATION)
       .export_values();
 
+  py::enum_<minkowski::BinaryMode::Type>(m, "BinaryMode")
+      .value("ADDITION", minkowski::BinaryMode::Type::ADDITION)
+      .value("SUBTRACTION", minkowski::BinaryMode::Type::SUBTRACTION)
+      .value("MULTIPLICATION", minkowski::BinaryMode::Type::MULTIPLICATION)
+      .value("MAXIMUM", minkowski::BinaryMode::Type::MAXIMUM)
+      .export_values();
+
+  py::enum_<minkowski::JoinMode::Type>(m, "JoinMode")
+      .value("UNION", minkowski::JoinMode::Type::UNION)
+      .value("INTERSECTION", minkowski::JoinMode::Type::INTERSECTION)
+      .export_values();
+
   py::enum_<minkowski::ConvolutionMode::Type>(m, "ConvolutionMode")
       .value("DEFAULT", minkowski::ConvolutionMode::Type::DEFAULT)
       .value("DIRECT_GEMM", minkowski::ConvolutionMode::Type::DIRECT_GEMM)
@@ -775,34 +909,91 @@ void instantiate_manager(py::module &m, const std::string &dtypestr) {
            py::overload_cast<>(&manager_type::to_string, py::const_))
       .def("print_coordinate_map",
            py::overload_cast<minkowski::CoordinateMapKey const *>(
-               &manager_type::to_string, py::const_))
-      .def("insert_and_map", &manager_type::insert_and_map)
-      .def("insert_field", &manager_type::insert_field)
-      .def("field_to_sparse_map", &manager_type::field_to_sparse_map)
+               &manager_type::to_string, py::const_),
+           py::call_guard<py::gil_scoped_release>())
+      .def("insert_and_map", &manager_type::py_insert_and_map,
+           py::call_guard<py::gil_scoped_release>())
+      .def("insert_dense", &manager_type::insert_dense,
+           py::call_guard<py::gil_scoped_release>())
+      .def("insert_field", &manager_type::insert_field,
+           py::call_guard<py::gil_scoped_release>())
+      .def("field_to_sparse_map", &manager_type::field_to_sparse_map,
+           py::call_guard<py::gil_scoped_release>())
       .def("field_to_sparse_insert_and_map",
-           &manager_type::field_to_sparse_insert_and_map)
+           &manager_type::field_to_sparse_insert_and_map,
+           py::call_guard<py::gil_scoped_release>())
       .def("exists_field_to_sparse",
            py::overload_cast<minkowski::CoordinateMapKey const *,
                              minkowski::CoordinateMapKey const *>(
-               &manager_type::exists_field_to_sparse, py::const_))
-      .def("get_field_to_sparse_map", &manager_type::get_field_to_sparse_map)
-      .def("stride", &manager_type::py_stride)
-      .def("origin", &manager_type::py_origin)
-      .def("origin_field", &manager_type::py_origin_field)
-      .def("get_coordinates", &manager_type::get_coordinates)
-      .def("get_coordinate_field", &manager_type::get_coordinate_field)
-      .def("get_coordinate_map_keys", &manager_type::get_coordinate_map_keys)
-      .def("field_to_sparse_keys", &manager_type::field_to_sparse_keys)
+               &manager_type::exists_field_to_sparse, py::const_),
+           py::call_guard<py::gil_scoped_release>())
+      .def("get_field_to_sparse_map", &manager_type::get_field_to_sparse_map,
+           py::call_guard<py::gil_scoped_release>())
+      .def("stride", &manager_type::py_stride,
+           py::call_guard<py::gil_scoped_release>())
+      .def("origin", &manager_type::py_origin,
+           py::call_guard<py::gil_scoped_release>())
+      .def("origin_field", &manager_type::py_origin_field,
+           py::call_guard<py::gil_scoped_release>())
+      .def("get_coordinates", &manager_type::get_coordinates,
+           py::call_guard<py::gil_scoped_release>())
+      .def("get_coordinate_field", &manager_type::get_coordinate_field,
+           py::call_guard<py::gil_scoped_release>())
+      .def("get_coordinate_map_keys", &manager_type::get_coordinate_map_keys,
+           py::call_guard<py::gil_scoped_release>())
+      .def("field_to_sparse_keys", &manager_type::field_to_sparse_keys,
+           py::call_guard<py::gil_scoped_release>())
       .def("size", py::overload_cast<minkowski::CoordinateMapKey const *>(
-                       &manager_type::size, py::const_))
+                       &manager_type::size, py::const_),
+           py::call_guard<py::gil_scoped_release>())
       .def("get_random_string_id", &manager_type::get_random_string_id)
-      .def("origin_map_size", &manager_type::origin_map_size)
-      .def("origin_map", &manager_type::origin_map_th)
-      .def("origin_field_map", &manager_type::origin_field_map_th)
-      .def("union_map", &manager_type::union_map_th)
-      .def("stride_map", &manager_type::stride_map_th)
-      .def("kernel_map", &manager_type::kernel_map_th)
-      .def("interpolation_map_weight", &manager_type::interpolation_map_weight);
+      .def("origin_map_size", &manager_type::origin_map_size,
+           py::call_guard<py::gil_scoped_release>())
+      .def("origin_map", &manager_type::origin_map_th,
+           py::call_guard<py::gil_scoped_release>())
+      .def("origin_field_map", &manager_type::origin_field_map_th,
+           py::call_guard<py::gil_scoped_release>())
+      .def("union_map", &manager_type::union_map_th,
+           py::call_guard<py::gil_scoped_release>())
+      .def("stride_map", &manager_type::stride_map_th,
+           py::call_guard<py::gil_scoped_release>())
+      .def("kernel_map", &manager_type::kernel_map_th,
+           py::call_guard<py::gil_scoped_release>())
+      .def("interpolation_map_weight", &manager_type::interpolation_map_weight,
+           py::call_guard<py::gil_scoped_release>())
+      .def("field_interpolation_map_weight",
+           &manager_type::field_interpolation_map_weight,
+           py::call_guard<py::gil_scoped_release>())
+      .def("release_field_interpolation_maps",
+           &manager_type::release_field_interpolation_maps,
+           py::call_guard<py::gil_scoped_release>())
+      .def("neighbor_query", &manager_type::neighbor_query,
+           py::call_guard<py::gil_scoped_release>())
+      .def("crop", &manager_type::crop,
+           py::call_guard<py::gil_scoped_release>())
+      .def("crop_rows", &manager_type::crop_rows,
+           py::call_guard<py::gil_scoped_release>())
+      .def("build_hierarchy", &manager_type::build_hierarchy,
+           py::call_guard<py::gil_scoped_release>())
+      .def("begin_capture", &manager_type::begin_capture)
+      .def("end_capture", &manager_type::end_capture)
+      .def("begin_replay", &manager_type::begin_replay)
+      .def("end_replay", &manager_type::end_replay)
+      .def("plan_size", &manager_type::plan_size)
+      .def("plan_cursor", &manager_type::plan_cursor)
+      .def("kernel_map_plan", &manager_type::kernel_map_plan)
+      .def("prefetch_kernel_map", &manager_type::py_prefetch_kernel_map,
+           py::call_guard<py::gil_scoped_release>())
+      .def("set_kernel_map_hints", &manager_type::set_kernel_map_hints,
+           py::call_guard<py::gil_scoped_release>())
+      .def("num_kernel_map_hints", &manager_type::num_kernel_map_hints)
+      .def("num_threads", &manager_type::num_threads)
+      .def("set_num_threads", &manager_type::set_num_threads)
+      .def("cpu_affinity", &manager_type::cpu_affinity)
+      .def("set_cpu_affinity", &manager_type::set_cpu_affinity)
+      .def("threading_policy", &manager_type::threading_policy)
+      .def("set_threading_policy", &manager_type::set_threading_policy)
+      .def("worker_cpu_affinity", &manager_type::worker_cpu_affinity);
 }
 
 bool is_cuda_available() {
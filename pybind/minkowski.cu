@@ -25,6 +25,8 @@
  * of the code.
  */
 #include "extern.hpp"
+#include "torch_library.hpp"
+#include "autograd.hpp"
 
 #include <string>
 
@@ -41,6 +43,7 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
   m.def("get_gpu_memory_info", &get_gpu_memory_info);
 
   initialize_non_templated_classes(m);
+  initialize_kernel_arguments(m);
 
   // Manager
   instantiate_manager<minkowski::cpu_manager_type<int32_t>>(m,
@@ -55,6 +58,7 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
   // Functions
   non_templated_cpu_func(m);
   instantiate_cpu_func<int32_t>(m, "");
+  instantiate_autograd_func<minkowski::cpu_manager_type<int32_t>>(m, "CPU");
 
 #ifndef CPU_ONLY
   instantiate_gpu_func<int32_t, minkowski::detail::default_allocator>(
@@ -63,6 +67,11 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
   instantiate_gpu_func<int32_t, minkowski::detail::c10_allocator>(
       m, std::string(""));
 
+  instantiate_autograd_func<minkowski::gpu_default_manager_type<int32_t>>(
+      m, std::string("GPU"));
+  instantiate_autograd_func<minkowski::gpu_c10_manager_type<int32_t>>(
+      m, std::string("GPU"));
+
   non_templated_gpu_func(m);
 #endif
 }
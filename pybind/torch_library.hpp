@@ -0,0 +1,413 @@
+/*
+ * Copyright (c) 2020 NVIDIA Corporation.
+ * Copyright (c) 2018-2020 Chris Choy (chrischoy@ai.stanford.edu).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+ * Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+ * of the code.
+ */
+#include "coordinate_map_key.hpp"
+#include "coordinate_map_manager.hpp"
+#include "types.hpp"
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <torch/custom_class.h>
+#include <torch/library.h>
+
+/*
+ * TorchScript registration of the CPU sparse ops. The ops and the custom
+ * classes are registered under the MinkowskiEngine namespace:
+ *
+ *   torch.classes.MinkowskiEngine.CoordinateManager
+ *   torch.classes.MinkowskiEngine.CoordinateMapKey
+ *   torch.ops.MinkowskiEngine.convolution_forward, ...
+ *
+ * None of them touches the python interpreter, so a scripted network runs
+ * from libtorch without python. Enum arguments are passed as int.
+ *
+ * Must be included after extern.hpp, which declares the CPU functions.
+ */
+namespace minkowski {
+namespace script {
+
+using coordinate_type = default_types::dcoordinate_type;
+using manager_type = cpu_manager_type<coordinate_type>;
+using int_list = std::vector<int64_t>;
+
+inline default_types::stride_type to_stride(int_list const &values) {
+  return default_types::stride_type(values.begin(), values.end());
+}
+
+inline int_list to_int_list(default_types::stride_type const &values) {
+  return int_list(values.begin(), values.end());
+}
+
+struct CoordinateMapKeyHolder : torch::CustomClassHolder {
+  explicit CoordinateMapKeyHolder(int64_t coordinate_size)
+      : key(coordinate_size) {}
+  CoordinateMapKeyHolder(int64_t coordinate_size,
+                         coordinate_map_key_type const &map_key)
+      : key(coordinate_size, map_key) {}
+
+  int64_t get_coordinate_size() const { return key.get_coordinate_size(); }
+  bool is_key_set() const { return key.is_key_set(); }
+  int_list get_tensor_stride() const {
+    return to_int_list(key.get_tensor_stride());
+  }
+
+  CoordinateMapKey key;
+};
+
+using key_ptr = c10::intrusive_ptr<CoordinateMapKeyHolder>;
+
+inline key_ptr make_key(coordinate_map_key_type const &map_key) {
+  return c10::make_intrusive<CoordinateMapKeyHolder>(map_key.first.size() + 1,
+                                                     map_key);
+}
+
+struct CoordinateManagerHolder : torch::CustomClassHolder {
+  explicit CoordinateManagerHolder(int64_t num_threads)
+      : manager(MinkowskiAlgorithm::DEFAULT, num_threads) {}
+
+  std::tuple<key_ptr, at::Tensor, at::Tensor>
+  insert_and_map(at::Tensor const &coordinates, int_list const &tensor_stride,
+                 std::string const &string_id) {
+    auto const key_map_inverse_map = manager.insert_and_map(
+        coordinates, to_stride(tensor_stride), string_id);
+    return std::make_tuple(make_key(key_map_inverse_map.first),
+                           key_map_inverse_map.second.first,
+                           key_map_inverse_map.second.second);
+  }
+
+  key_ptr stride(key_ptr const &in_key, int_list const &kernel_stride) {
+    return make_key(std::get<0>(
+        manager.stride(in_key->key.get_key(), to_stride(kernel_stride))));
+  }
+
+  int64_t size(key_ptr const &key) const { return manager.size(&key->key); }
+
+  at::Tensor get_coordinates(key_ptr const &key) const {
+    return manager.get_coordinates(&key->key);
+  }
+
+  void set_num_threads(int64_t num_threads) {
+    manager.set_num_threads(num_threads);
+  }
+
+  void set_threading_policy(int64_t threading_policy) {
+    manager.set_threading_policy(
+        static_cast<ThreadingPolicy::Type>(threading_policy));
+  }
+
+  manager_type manager;
+};
+
+using manager_ptr = c10::intrusive_ptr<CoordinateManagerHolder>;
+
+/*************************************
+ * Convolution
+ *************************************/
+inline at::Tensor
+convolution_forward(at::Tensor const &in_feat, at::Tensor const &kernel,
+                    int_list const &kernel_size, int_list const &kernel_stride,
+                    int_list const &kernel_dilation, int64_t region_type,
+                    at::Tensor const &offset, bool expand_coordinates,
+                    int64_t convolution_mode, key_ptr const &in_key,
+                    key_ptr const &out_key, manager_ptr const &manager) {
+  return ConvolutionForwardCPU<coordinate_type>(
+      in_feat, kernel, to_stride(kernel_size), to_stride(kernel_stride),
+      to_stride(kernel_dilation), static_cast<RegionType::Type>(region_type),
+      offset, expand_coordinates,
+      static_cast<ConvolutionMode::Type>(convolution_mode), &in_key->key,
+      &out_key->key, &manager->manager);
+}
+
+inline std::tuple<at::Tensor, at::Tensor>
+convolution_backward(at::Tensor const &in_feat, at::Tensor grad_out_feat,
+                     at::Tensor const &kernel, int_list const &kernel_size,
+                     int_list const &kernel_stride,
+                     int_list const &kernel_dilation, int64_t region_type,
+                     at::Tensor const &offset, int64_t convolution_mode,
+                     key_ptr const &in_key, key_ptr const &out_key,
+                     manager_ptr const &manager) {
+  return ConvolutionBackwardCPU<coordinate_type>(
+      in_feat, grad_out_feat, kernel, to_stride(kernel_size),
+      to_stride(kernel_stride), to_stride(kernel_dilation),
+      static_cast<RegionType::Type>(region_type), offset,
+      static_cast<ConvolutionMode::Type>(convolution_mode), &in_key->key,
+      &out_key->key, &manager->manager);
+}
+
+inline at::Tensor convolution_transpose_forward(
+    at::Tensor const &in_feat, at::Tensor const &kernel,
+    int_list const &kernel_size, int_list const &kernel_stride,
+    int_list const &kernel_dilation, int64_t region_type,
+    at::Tensor const &offset, bool expand_coordinates,
+    int64_t convolution_mode, key_ptr const &in_key, key_ptr const &out_key,
+    manager_ptr const &manager) {
+  return ConvolutionTransposeForwardCPU<coordinate_type>(
+      in_feat, kernel, to_stride(kernel_size), to_stride(kernel_stride),
+      to_stride(kernel_dilation), static_cast<RegionType::Type>(region_type),
+      offset, expand_coordinates,
+      static_cast<ConvolutionMode::Type>(convolution_mode), &in_key->key,
+      &out_key->key, &manager->manager);
+}
+
+inline std::tuple<at::Tensor, at::Tensor> convolution_transpose_backward(
+    at::Tensor const &in_feat, at::Tensor const &grad_out_feat,
+    at::Tensor const &kernel, int_list const &kernel_size,
+    int_list const &kernel_stride, int_list const &kernel_dilation,
+    int64_t region_type, at::Tensor const &offset, int64_t convolution_mode,
+    key_ptr const &in_key, key_ptr const &out_key,
+    manager_ptr const &manager) {
+  return ConvolutionTransposeBackwardCPU<coordinate_type>(
+      in_feat, grad_out_feat, kernel, to_stride(kernel_size),
+      to_stride(kernel_stride), to_stride(kernel_dilation),
+      static_cast<RegionType::Type>(region_type), offset,
+      static_cast<ConvolutionMode::Type>(convolution_mode), &in_key->key,
+      &out_key->key, &manager->manager);
+}
+
+/*************************************
+ * Local Pooling
+ *************************************/
+inline std::tuple<at::Tensor, at::Tensor>
+local_pooling_forward(at::Tensor const &in_feat, int_list const &kernel_size,
+                      int_list const &kernel_stride,
+                      int_list const &kernel_dilation, int64_t region_type,
+                      at::Tensor const &offset, int64_t pooling_mode,
+                      key_ptr const &in_key, key_ptr const &out_key,
+                      manager_ptr const &manager) {
+  return LocalPoolingForwardCPU<coordinate_type>(
+      in_feat, to_stride(kernel_size), to_stride(kernel_stride),
+      to_stride(kernel_dilation), static_cast<RegionType::Type>(region_type),
+      offset, static_cast<PoolingMode::Type>(pooling_mode), &in_key->key,
+      &out_key->key, &manager->manager);
+}
+
+inline at::Tensor local_pooling_backward(
+    at::Tensor const &in_feat, at::Tensor const &grad_out_feat,
+    at::Tensor const &num_nonzero, int_list const &kernel_size,
+    int_list const &kernel_stride, int_list const &kernel_dilation,
+    int64_t region_type, at::Tensor const &offset, int64_t pooling_mode,
+    key_ptr const &in_key, key_ptr const &out_key,
+    manager_ptr const &manager) {
+  return LocalPoolingBackwardCPU<coordinate_type>(
+      in_feat, grad_out_feat, num_nonzero, to_stride(kernel_size),
+      to_stride(kernel_stride), to_stride(kernel_dilation),
+      static_cast<RegionType::Type>(region_type), offset,
+      static_cast<PoolingMode::Type>(pooling_mode), &in_key->key,
+      &out_key->key, &manager->manager);
+}
+
+inline std::tuple<at::Tensor, at::Tensor> local_pooling_transpose_forward(
+    at::Tensor const &in_feat, int_list const &kernel_size,
+    int_list const &kernel_stride, int_list const &kernel_dilation,
+    int64_t region_type, at::Tensor const &offset,
+    bool generate_new_coordinates, int64_t pooling_mode,
+    key_ptr const &in_key, key_ptr const &out_key,
+    manager_ptr const &manager) {
+  return LocalPoolingTransposeForwardCPU<coordinate_type>(
+      in_feat, to_stride(kernel_size), to_stride(kernel_stride),
+      to_stride(kernel_dilation), static_cast<RegionType::Type>(region_type),
+      offset, generate_new_coordinates,
+      static_cast<PoolingMode::Type>(pooling_mode), &in_key->key,
+      &out_key->key, &manager->manager);
+}
+
+inline at::Tensor local_pooling_transpose_backward(
+    at::Tensor const &in_feat, at::Tensor const &grad_out_feat,
+    at::Tensor const &num_nonzero, int_list const &kernel_size,
+    int_list const &kernel_stride, int_list const &kernel_dilation,
+    int64_t region_type, at::Tensor const &offset, int64_t pooling_mode,
+    key_ptr const &in_key, key_ptr const &out_key,
+    manager_ptr const &manager) {
+  return LocalPoolingTransposeBackwardCPU<coordinate_type>(
+      in_feat, grad_out_feat, num_nonzero, to_stride(kernel_size),
+      to_stride(kernel_stride), to_stride(kernel_dilation),
+      static_cast<RegionType::Type>(region_type), offset,
+      static_cast<PoolingMode::Type>(pooling_mode), &in_key->key,
+      &out_key->key, &manager->manager);
+}
+
+/*************************************
+ * Global Pooling
+ *************************************/
+inline std::tuple<at::Tensor, at::Tensor>
+global_pooling_forward(at::Tensor const &in_feat, int64_t pooling_mode,
+                       key_ptr const &in_key, key_ptr const &out_key,
+                       manager_ptr const &manager) {
+  return GlobalPoolingForwardCPU<coordinate_type>(
+      in_feat, static_cast<PoolingMode::Type>(pooling_mode), &in_key->key,
+      &out_key->key, &manager->manager);
+}
+
+inline at::Tensor
+global_pooling_backward(at::Tensor const &in_feat, at::Tensor grad_out_feat,
+                        at::Tensor const &num_nonzero, int64_t pooling_mode,
+                        key_ptr const &in_key, key_ptr const &out_key,
+                        manager_ptr const &manager) {
+  return GlobalPoolingBackwardCPU<coordinate_type>(
+      in_feat, grad_out_feat, num_nonzero,
+      static_cast<PoolingMode::Type>(pooling_mode), &in_key->key,
+      &out_key->key, &manager->manager);
+}
+
+/*************************************
+ * Broadcast
+ *************************************/
+inline at::Tensor broadcast_forward(at::Tensor const &in_feat,
+                                    at::Tensor const &in_feat_glob,
+                                    int64_t broadcast_mode,
+                                    key_ptr const &in_key,
+                                    key_ptr const &glob_key,
+                                    manager_ptr const &manager) {
+  return BroadcastForwardCPU<coordinate_type>(
+      in_feat, in_feat_glob, static_cast<BroadcastMode::Type>(broadcast_mode),
+      &in_key->key, &glob_key->key, &manager->manager);
+}
+
+inline std::tuple<at::Tensor, at::Tensor>
+broadcast_backward(at::Tensor const &in_feat, at::Tensor const &in_feat_glob,
+                   at::Tensor const &grad_out_feat, int64_t broadcast_mode,
+                   key_ptr const &in_key, key_ptr const &glob_key,
+                   manager_ptr const &manager) {
+  return BroadcastBackwardCPU<coordinate_type>(
+      in_feat, in_feat_glob, grad_out_feat,
+      static_cast<BroadcastMode::Type>(broadcast_mode), &in_key->key,
+      &glob_key->key, &manager->manager);
+}
+
+/*************************************
+ * Pruning
+ *************************************/
+inline at::Tensor pruning_forward(at::Tensor const &in_feat,
+                                  at::Tensor const &keep,
+                                  key_ptr const &in_key,
+                                  key_ptr const &out_key,
+                                  manager_ptr const &manager) {
+  return PruningForwardCPU<coordinate_type>(in_feat, keep, &in_key->key,
+                                            &out_key->key, &manager->manager);
+}
+
+inline at::Tensor pruning_backward(at::Tensor grad_out_feat,
+                                   key_ptr const &in_key,
+                                   key_ptr const &out_key,
+                                   manager_ptr const &manager) {
+  return PruningBackwardCPU<coordinate_type>(grad_out_feat, &in_key->key,
+                                             &out_key->key, &manager->manager);
+}
+
+/*************************************
+ * Union
+ *************************************/
+inline std::vector<CoordinateMapKey *>
+to_key_pointers(std::vector<key_ptr> const &keys) {
+  std::vector<CoordinateMapKey *> p_keys;
+  p_keys.reserve(keys.size());
+  for (auto const &key : keys)
+    p_keys.push_back(&key->key);
+  return p_keys;
+}
+
+inline at::Tensor union_forward(std::vector<at::Tensor> const &in_feats,
+                                std::vector<key_ptr> const &in_keys,
+                                key_ptr const &out_key,
+                                manager_ptr const &manager) {
+  return UnionForwardCPU<coordinate_type>(in_feats, to_key_pointers(in_keys),
+                                          &out_key->key, &manager->manager);
+}
+
+inline std::vector<at::Tensor> union_backward(
+    at::Tensor grad_out_feat, std::vector<key_ptr> const &in_keys,
+    key_ptr const &out_key, manager_ptr const &manager) {
+  return UnionBackwardCPU<coordinate_type>(grad_out_feat,
+                                           to_key_pointers(in_keys),
+                                           &out_key->key, &manager->manager);
+}
+
+/*************************************
+ * Interpolation
+ *************************************/
+inline std::vector<at::Tensor>
+interpolation_forward(at::Tensor const &in_feat, at::Tensor const &tfield,
+                      key_ptr const &in_key, key_ptr const &field_key,
+                      manager_ptr const &manager) {
+  return InterpolationForwardCPU<coordinate_type>(
+      in_feat, tfield, &in_key->key, &field_key->key, &manager->manager);
+}
+
+inline at::Tensor
+interpolation_backward(at::Tensor grad_out_feat, at::Tensor const &in_map,
+                       at::Tensor const &out_map, at::Tensor const &weight,
+                       at::Tensor const &in_offsets,
+                       at::Tensor const &in_entries, key_ptr const &in_key,
+                       manager_ptr const &manager) {
+  return InterpolationBackwardCPU<coordinate_type>(
+      grad_out_feat, in_map, out_map, weight, in_offsets, in_entries,
+      &in_key->key, &manager->manager);
+}
+
+} // namespace script
+} // namespace minkowski
+
+TORCH_LIBRARY(MinkowskiEngine, m) {
+  using namespace minkowski::script;
+
+  m.class_<CoordinateMapKeyHolder>("CoordinateMapKey")
+      .def(torch::init<int64_t>())
+      .def("get_coordinate_size", &CoordinateMapKeyHolder::get_coordinate_size)
+      .def("is_key_set", &CoordinateMapKeyHolder::is_key_set)
+      .def("get_tensor_stride", &CoordinateMapKeyHolder::get_tensor_stride);
+
+  m.class_<CoordinateManagerHolder>("CoordinateManager")
+      .def(torch::init<int64_t>())
+      .def("insert_and_map", &CoordinateManagerHolder::insert_and_map)
+      .def("stride", &CoordinateManagerHolder::stride)
+      .def("size", &CoordinateManagerHolder::size)
+      .def("get_coordinates", &CoordinateManagerHolder::get_coordinates)
+      .def("set_num_threads", &CoordinateManagerHolder::set_num_threads)
+      .def("set_threading_policy",
+           &CoordinateManagerHolder::set_threading_policy);
+
+  m.def("convolution_forward", &convolution_forward);
+  m.def("convolution_backward", &convolution_backward);
+  m.def("convolution_transpose_forward", &convolution_transpose_forward);
+  m.def("convolution_transpose_backward", &convolution_transpose_backward);
+  m.def("local_pooling_forward", &local_pooling_forward);
+  m.def("local_pooling_backward", &local_pooling_backward);
+  m.def("local_pooling_transpose_forward", &local_pooling_transpose_forward);
+  m.def("local_pooling_transpose_backward",
+        &local_pooling_transpose_backward);
+  m.def("global_pooling_forward", &global_pooling_forward);
+  m.def("global_pooling_backward", &global_pooling_backward);
+  m.def("broadcast_forward", &broadcast_forward);
+  m.def("broadcast_backward", &broadcast_backward);
+  m.def("pruning_forward", &pruning_forward);
+  m.def("pruning_backward", &pruning_backward);
+  m.def("union_forward", &union_forward);
+  m.def("union_backward", &union_backward);
+  m.def("interpolation_forward", &interpolation_forward);
+  m.def("interpolation_backward", &interpolation_backward);
+}
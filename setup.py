@@ -217,6 +217,11 @@ else:
 
 print(f"\nUsing BLAS={BLAS}")
 
+# The thread count of these libraries is pinned inside the OpenMP regions.
+if BLAS in ["openblas", "flexiblas"]:
+    CC_FLAGS.append(f"-DUSE_{BLAS.upper()}")
+    NVCC_FLAGS.append(f"-DUSE_{BLAS.upper()}")
+
 # The Ninja cannot compile the files that have the same name with different
 # extensions correctly and uses the nvcc/CC based on the extension. Import a
 # .cpp file to the corresponding .cu file to force the nvcc compilation.
@@ -233,6 +238,8 @@ SOURCE_SETS = {
             "global_pooling_cpu.cpp",
             "broadcast_cpu.cpp",
             "pruning_cpu.cpp",
+            "union_cpu.cpp",
+            "elementwise_cpu.cpp",
             "interpolation_cpu.cpp",
             "quantization.cpp",
             "direct_max_pool.cpp",
@@ -258,6 +265,8 @@ SOURCE_SETS = {
             "broadcast_kernel.cu",
             "broadcast_gpu.cu",
             "pruning_gpu.cu",
+            "union_gpu.cu",
+            "elementwise_gpu.cu",
             "interpolation_gpu.cu",
             "spmm.cu",
             "gpu.cu",
@@ -29,10 +29,12 @@
 #include "coordinate_map_key.hpp"
 #include "coordinate_map_manager.hpp"
 #include "errors.hpp"
+#include "math_functions.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
 #include "broadcast_kernel.hpp"
+#include "pooling_avg_kernel.hpp"
 
 #include <pybind11/pybind11.h>
 #include <torch/extension.h>
@@ -46,6 +48,7 @@ BroadcastForwardCPU(at::Tensor const &in_feat, at::Tensor const &in_feat_glob,
                     CoordinateMapKey *p_in_map_key,   //
                     CoordinateMapKey *p_glob_map_key, //
                     cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
 
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
   ASSERT(!in_feat.is_cuda(), "in_feat must be on CPU");
@@ -75,18 +78,18 @@ BroadcastForwardCPU(at::Tensor const &in_feat, at::Tensor const &in_feat_glob,
          "Incompatible scalar_type. Use the same float type for both in_feat "
          "and in_feat_glob.")
 
-  cpu_kernel_map const &kernel_map = p_map_manager->origin_map(p_in_map_key);
+  cpu_parent_map const &segments = p_map_manager->batch_segments(p_in_map_key);
 
   auto out_feat =
       torch::empty({in_feat.size(0), in_feat.size(1)}, in_feat.options());
 
   AT_DISPATCH_FLOATING_TYPES(
       in_feat.scalar_type(), "broadcast_forward_cpu", [&] {
-        BroadcastForwardKernelCPU<scalar_t, int>(
-            in_feat.template data_ptr<scalar_t>(), in_feat.size(0),
-            in_feat_glob.template data_ptr<scalar_t>(), in_feat_glob.size(0),
+        BroadcastForwardKernelCPU<scalar_t>(
+            in_feat.template data_ptr<scalar_t>(),
+            in_feat_glob.template data_ptr<scalar_t>(),
             out_feat.template data_ptr<scalar_t>(), in_feat.size(1),
-            broadcast_mode, kernel_map.first, kernel_map.second);
+            broadcast_mode, segments);
       });
 
   return out_feat;
@@ -100,6 +103,7 @@ BroadcastBackwardCPU(at::Tensor const &in_feat, at::Tensor const &in_feat_glob,
                      CoordinateMapKey *p_in_map_key,   //
                      CoordinateMapKey *p_glob_map_key, //
                      cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
 
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
   ASSERT(!in_feat.is_cuda(), "in_feat must be on CPU");
@@ -136,27 +140,286 @@ BroadcastBackwardCPU(at::Tensor const &in_feat, at::Tensor const &in_feat_glob,
          "Incompatible scalar_type. Use the same float type for both in_feat "
          "and grad_out_feat.")
 
-  cpu_kernel_map const &kernel_map = p_map_manager->origin_map(p_in_map_key);
+  cpu_parent_map const &segments = p_map_manager->batch_segments(p_in_map_key);
 
   auto grad_in_feat =
-      torch::zeros({in_feat.size(0), in_feat.size(1)}, in_feat.options());
-  auto grad_glob_feat = torch::zeros(
+      torch::empty({in_feat.size(0), in_feat.size(1)}, in_feat.options());
+  auto grad_glob_feat = torch::empty(
       {in_feat_glob.size(0), in_feat_glob.size(1)}, in_feat_glob.options());
 
   AT_DISPATCH_FLOATING_TYPES(
       in_feat.scalar_type(), "broadcast_backward_cpu", [&] {
-        BroadcastBackwardKernelCPU<scalar_t, int>(
+        BroadcastBackwardKernelCPU<scalar_t>(
             in_feat.template data_ptr<scalar_t>(),
-            grad_in_feat.template data_ptr<scalar_t>(), in_feat.size(0),
+            grad_in_feat.template data_ptr<scalar_t>(),
             in_feat_glob.template data_ptr<scalar_t>(),
-            grad_glob_feat.template data_ptr<scalar_t>(), in_feat_glob.size(0),
+            grad_glob_feat.template data_ptr<scalar_t>(),
             grad_out_feat.template data_ptr<scalar_t>(), in_feat.size(1), op,
-            kernel_map.first, kernel_map.second);
+            segments);
       });
 
   return {grad_in_feat, grad_glob_feat};
 }
 
+namespace detail {
+
+template <typename manager_type>
+cpu_parent_map const &glob_segments(at::Tensor const &in_feat,
+                                    CoordinateMapKey *p_in_map_key,
+                                    CoordinateMapKey *p_glob_map_key,
+                                    manager_type *p_map_manager) {
+  ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
+  ASSERT(!in_feat.is_cuda(), "in_feat must be on CPU");
+  ASSERT(in_feat.dim() == 2, "Invalid in_feat.dim():", in_feat.dim());
+
+  coordinate_map_key_type in_key = p_in_map_key->get_key();
+  ASSERT(p_map_manager->exists(in_key), ERROR_MAP_NOT_FOUND);
+  ASSERT(in_feat.size(0) == p_map_manager->size(in_key), "Invalid in_feat size",
+         in_feat.size(0), "!=", p_map_manager->size(in_key));
+
+  if (!p_glob_map_key->is_key_set())
+    p_glob_map_key->set_key(std::get<0>(p_map_manager->origin()));
+  ASSERT(p_map_manager->exists(p_glob_map_key->get_key()),
+         ERROR_MAP_NOT_FOUND);
+
+  return p_map_manager->batch_segments(p_in_map_key);
+}
+
+/*
+ * C = op(A) op(B) + beta C through the linked BLAS on the row-major tensors of
+ * the gating MLP. The GEMMs are batch_size x nchannel and run outside of the
+ * OpenMP regions. BLAS_PARALLEL leaves the threads to the BLAS and the other
+ * policies keep it single-threaded, like the outer-parallel convolutions.
+ */
+template <typename Dtype>
+void se_gemm(ThreadingPolicy::Type const policy, at::Tensor const &A,
+             bool const trans_a, at::Tensor const &B, bool const trans_b,
+             Dtype const beta, at::Tensor &C) {
+  bool const serial = policy != ThreadingPolicy::BLAS_PARALLEL;
+  blas_serial_scope const blas_serial(serial);
+  blas_thread_scope const blas_scope(serial ? 1 : 0);
+  int const M = C.size(0);
+  int const N = C.size(1);
+  int const K = trans_a ? A.size(0) : A.size(1);
+  cpu_gemm<Dtype>(CblasRowMajor, trans_a ? CblasTrans : CblasNoTrans,
+                  trans_b ? CblasTrans : CblasNoTrans, M, N, K, 1,
+                  A.template data_ptr<Dtype>(), B.template data_ptr<Dtype>(),
+                  beta, C.template data_ptr<Dtype>());
+}
+
+} // namespace detail
+
+/*
+ * Squeeze-excitation: out = in * sigmoid(W2 relu(W1 avg_pool(in) + b1) + b2)
+ * with the gate broadcasted to the rows of each batch.
+ *
+ * return {out_feat, pooled, hidden, gate}
+ */
+template <typename coordinate_type>
+std::vector<at::Tensor>
+SEGatingForwardCPU(at::Tensor const &in_feat,                         //
+                   at::Tensor const &weight1, at::Tensor const &bias1, //
+                   at::Tensor const &weight2, at::Tensor const &bias2, //
+                   CoordinateMapKey *p_in_map_key,                     //
+                   CoordinateMapKey *p_glob_map_key,                   //
+                   cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
+  cpu_parent_map const &segments = detail::glob_segments(
+      in_feat, p_in_map_key, p_glob_map_key, p_map_manager);
+  int64_t const batch_size = segments.out_nrows();
+  int64_t const nchannel = in_feat.size(1);
+
+  ASSERT(weight1.dim() == 2 && weight1.size(1) == nchannel,
+         "Invalid weight1 size");
+  ASSERT(weight2.dim() == 2 && weight2.size(0) == nchannel &&
+             weight2.size(1) == weight1.size(0),
+         "Invalid weight2 size");
+
+  auto pooled = torch::empty({batch_size, nchannel}, in_feat.options());
+  auto num_nonzero = torch::empty({batch_size}, in_feat.options());
+  AT_DISPATCH_FLOATING_TYPES(
+      in_feat.scalar_type(), "se_gating_forward_cpu", [&] {
+        StrideAvgPoolingForwardKernelCPU<scalar_t>(
+            in_feat.template data_ptr<scalar_t>(),
+            pooled.template data_ptr<scalar_t>(),
+            num_nonzero.template data_ptr<scalar_t>(), nchannel, segments,
+            true /* avg */);
+      });
+
+  // The gating MLP follows the threading policy of the manager
+  auto const policy = p_map_manager->threading_policy();
+  auto const w1 = weight1.contiguous();
+  auto const w2 = weight2.contiguous();
+  auto hidden = bias1.expand({batch_size, w1.size(0)}).contiguous();
+  auto gate = bias2.expand({batch_size, nchannel}).contiguous();
+  AT_DISPATCH_FLOATING_TYPES(
+      in_feat.scalar_type(), "se_gating_forward_cpu", [&] {
+        detail::se_gemm<scalar_t>(policy, pooled, false, w1, true, 1, hidden);
+        hidden.relu_();
+        detail::se_gemm<scalar_t>(policy, hidden, false, w2, true, 1, gate);
+      });
+  gate.sigmoid_();
+
+  auto out_feat = torch::empty_like(in_feat);
+  AT_DISPATCH_FLOATING_TYPES(
+      in_feat.scalar_type(), "se_gating_forward_cpu", [&] {
+        GatingForwardKernelCPU<scalar_t>(
+            in_feat.template data_ptr<scalar_t>(),
+            gate.template data_ptr<scalar_t>(),
+            out_feat.template data_ptr<scalar_t>(), nchannel, segments);
+      });
+
+  return {out_feat, pooled, hidden, gate};
+}
+
+/*
+ * return {grad_in_feat, grad_weight1, grad_bias1, grad_weight2, grad_bias2}
+ */
+template <typename coordinate_type>
+std::vector<at::Tensor>
+SEGatingBackwardCPU(at::Tensor const &grad_out_feat, //
+                    at::Tensor const &in_feat,       //
+                    at::Tensor const &pooled,        //
+                    at::Tensor const &hidden,        //
+                    at::Tensor const &gate,          //
+                    at::Tensor const &weight1,       //
+                    at::Tensor const &weight2,       //
+                    CoordinateMapKey *p_in_map_key,  //
+                    CoordinateMapKey *p_glob_map_key,
+                    cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
+  ASSERT(grad_out_feat.is_contiguous(), "grad_out_feat must be contiguous");
+  ASSERT(grad_out_feat.sizes() == in_feat.sizes(), "Invalid grad_out_feat");
+  ASSERT(in_feat.scalar_type() == grad_out_feat.scalar_type(),
+         "type mismatch");
+
+  cpu_parent_map const &segments = detail::glob_segments(
+      in_feat, p_in_map_key, p_glob_map_key, p_map_manager);
+  int64_t const batch_size = segments.out_nrows();
+  int64_t const nchannel = in_feat.size(1);
+
+  // d gate = sum over the rows of the batch of grad_out * in
+  auto grad_gate = torch::empty({batch_size, nchannel}, in_feat.options());
+  AT_DISPATCH_FLOATING_TYPES(
+      in_feat.scalar_type(), "se_gating_backward_cpu", [&] {
+        scalar_t const *p_grad_out = grad_out_feat.template data_ptr<scalar_t>();
+        scalar_t const *p_in = in_feat.template data_ptr<scalar_t>();
+        segment_reduce_cpu<scalar_t>(
+            segments, nchannel, grad_gate.template data_ptr<scalar_t>(),
+            [&](auto row, scalar_t *p_acc) {
+              for (int64_t j = 0; j < nchannel; ++j)
+                p_acc[j] += p_grad_out[row * nchannel + j] *
+                            p_in[row * nchannel + j];
+            });
+      });
+
+  // Backward through the gating MLP on batch_size x nchannel tensors
+  ASSERT(pooled.is_contiguous() && hidden.is_contiguous(),
+         "pooled and hidden must be contiguous");
+  auto const policy = p_map_manager->threading_policy();
+  auto const w1 = weight1.contiguous();
+  auto const w2 = weight2.contiguous();
+  auto const grad_z2 = (grad_gate * gate * (1 - gate)).contiguous();
+  auto grad_weight2 = torch::empty_like(w2);
+  auto grad_z1 = torch::empty_like(hidden);
+  auto grad_weight1 = torch::empty_like(w1);
+  auto grad_pooled = torch::empty_like(pooled);
+  AT_DISPATCH_FLOATING_TYPES(
+      in_feat.scalar_type(), "se_gating_backward_cpu", [&] {
+        detail::se_gemm<scalar_t>(policy, grad_z2, true, hidden, false, 0,
+                                  grad_weight2);
+        detail::se_gemm<scalar_t>(policy, grad_z2, false, w2, false, 0,
+                                  grad_z1);
+        grad_z1.mul_((hidden > 0).to(hidden.dtype()));
+        detail::se_gemm<scalar_t>(policy, grad_z1, true, pooled, false, 0,
+                                  grad_weight1);
+        detail::se_gemm<scalar_t>(policy, grad_z1, false, w1, false, 0,
+                                  grad_pooled);
+      });
+  auto const grad_bias2 = grad_z2.sum(0);
+  auto const grad_bias1 = grad_z1.sum(0);
+
+  auto counts = torch::empty({batch_size, 1},
+                             in_feat.options().dtype(torch::kFloat64));
+  auto counts_accessor = counts.accessor<double, 2>();
+  for (int64_t s = 0; s < batch_size; ++s)
+    counts_accessor[s][0] = std::max<int64_t>(segments.num_children(s), 1);
+  grad_pooled.div_(counts.to(in_feat.scalar_type()));
+
+  auto grad_in_feat = torch::empty_like(in_feat);
+  AT_DISPATCH_FLOATING_TYPES(
+      in_feat.scalar_type(), "se_gating_backward_cpu", [&] {
+        GatingBackwardKernelCPU<scalar_t>(
+            grad_out_feat.template data_ptr<scalar_t>(),
+            gate.template data_ptr<scalar_t>(),
+            grad_pooled.template data_ptr<scalar_t>(),
+            grad_in_feat.template data_ptr<scalar_t>(), nchannel, segments);
+      });
+
+  return {grad_in_feat, grad_weight1, grad_bias1, grad_weight2, grad_bias2};
+}
+
+/*
+ * Instance normalization with the statistics of each batch.
+ *
+ * return {out_feat, inv_std}
+ */
+template <typename coordinate_type>
+std::pair<at::Tensor, at::Tensor>
+InstanceNormForwardCPU(at::Tensor const &in_feat, double const eps,
+                       CoordinateMapKey *p_in_map_key,   //
+                       CoordinateMapKey *p_glob_map_key, //
+                       cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
+  cpu_parent_map const &segments = detail::glob_segments(
+      in_feat, p_in_map_key, p_glob_map_key, p_map_manager);
+  int64_t const batch_size = segments.out_nrows();
+
+  auto out_feat = torch::empty_like(in_feat);
+  auto inv_std = torch::empty({batch_size, in_feat.size(1)}, in_feat.options());
+  AT_DISPATCH_FLOATING_TYPES(
+      in_feat.scalar_type(), "instance_norm_forward_cpu", [&] {
+        InstanceNormForwardKernelCPU<scalar_t>(
+            in_feat.template data_ptr<scalar_t>(),
+            out_feat.template data_ptr<scalar_t>(),
+            inv_std.template data_ptr<scalar_t>(), in_feat.size(1), eps,
+            segments);
+      });
+  return {out_feat, inv_std};
+}
+
+template <typename coordinate_type>
+at::Tensor
+InstanceNormBackwardCPU(at::Tensor const &grad_out_feat,  //
+                        at::Tensor const &out_feat,       //
+                        at::Tensor const &inv_std,        //
+                        CoordinateMapKey *p_in_map_key,   //
+                        CoordinateMapKey *p_glob_map_key, //
+                        cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
+  ASSERT(grad_out_feat.is_contiguous(), "grad_out_feat must be contiguous");
+  ASSERT(grad_out_feat.sizes() == out_feat.sizes(), "Invalid grad_out_feat");
+  ASSERT(out_feat.scalar_type() == grad_out_feat.scalar_type(),
+         "type mismatch");
+  ASSERT(inv_std.is_contiguous(), "inv_std must be contiguous");
+
+  cpu_parent_map const &segments = detail::glob_segments(
+      out_feat, p_in_map_key, p_glob_map_key, p_map_manager);
+  ASSERT(inv_std.size(0) == segments.out_nrows(), "Invalid inv_std size");
+
+  auto grad_in_feat = torch::empty_like(out_feat);
+  AT_DISPATCH_FLOATING_TYPES(
+      out_feat.scalar_type(), "instance_norm_backward_cpu", [&] {
+        InstanceNormBackwardKernelCPU<scalar_t>(
+            grad_out_feat.template data_ptr<scalar_t>(),
+            out_feat.template data_ptr<scalar_t>(),
+            inv_std.template data_ptr<scalar_t>(),
+            grad_in_feat.template data_ptr<scalar_t>(), out_feat.size(1),
+            segments);
+      });
+  return grad_in_feat;
+}
+
 template at::Tensor BroadcastForwardCPU<default_types::dcoordinate_type>(
     at::Tensor const &in_feat, at::Tensor const &in_feat_glob,
     BroadcastMode::Type const op,
@@ -172,4 +435,36 @@ BroadcastBackwardCPU<default_types::dcoordinate_type>(
     CoordinateMapKey *p_glob_map_key, //
     cpu_manager_type<default_types::dcoordinate_type> *p_map_manager);
 
+template std::vector<at::Tensor>
+SEGatingForwardCPU<default_types::dcoordinate_type>(
+    at::Tensor const &in_feat,                          //
+    at::Tensor const &weight1, at::Tensor const &bias1, //
+    at::Tensor const &weight2, at::Tensor const &bias2, //
+    CoordinateMapKey *p_in_map_key,                     //
+    CoordinateMapKey *p_glob_map_key,                   //
+    cpu_manager_type<default_types::dcoordinate_type> *p_map_manager);
+
+template std::vector<at::Tensor>
+SEGatingBackwardCPU<default_types::dcoordinate_type>(
+    at::Tensor const &grad_out_feat, at::Tensor const &in_feat,
+    at::Tensor const &pooled, at::Tensor const &hidden, at::Tensor const &gate,
+    at::Tensor const &weight1, at::Tensor const &weight2,
+    CoordinateMapKey *p_in_map_key,   //
+    CoordinateMapKey *p_glob_map_key, //
+    cpu_manager_type<default_types::dcoordinate_type> *p_map_manager);
+
+template std::pair<at::Tensor, at::Tensor>
+InstanceNormForwardCPU<default_types::dcoordinate_type>(
+    at::Tensor const &in_feat, double const eps,
+    CoordinateMapKey *p_in_map_key,   //
+    CoordinateMapKey *p_glob_map_key, //
+    cpu_manager_type<default_types::dcoordinate_type> *p_map_manager);
+
+template at::Tensor InstanceNormBackwardCPU<default_types::dcoordinate_type>(
+    at::Tensor const &grad_out_feat, at::Tensor const &out_feat,
+    at::Tensor const &inv_std,
+    CoordinateMapKey *p_in_map_key,   //
+    CoordinateMapKey *p_glob_map_key, //
+    cpu_manager_type<default_types::dcoordinate_type> *p_map_manager);
+
 } // namespace minkowski
@@ -25,132 +25,150 @@
 #ifndef CPU_BROADCAST
 #define CPU_BROADCAST
 
+#include "kernel_map.hpp"
 #include "math_functions.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <omp.h>
+#include <vector>
+
 namespace minkowski {
 
-template <typename Dtype, typename Itype>
-void BroadcastForwardKernelCPU(const Dtype *p_in_feat, uint32_t in_nrows,
-                               const Dtype *p_in_feat_global,
-                               uint32_t in_nrows_global, Dtype *p_out_feat,
-                               uint32_t nchannel, BroadcastMode::Type const op,
-                               const cpu_in_maps &in_maps,
-                               const cpu_out_maps &glob_maps) {
-  Dtype *p_curr_out_feat;
-  const Dtype *p_curr_in_feat_global;
-
-  // Compute the size
-  uint32_t num_map = 0;
-  for (const auto &in_map : in_maps)
-    num_map += in_map.size();
-  ASSERT(num_map == in_nrows, "The number of in-out map,", num_map,
-         " mismatches the number of features,", in_nrows);
-
-  // Copy all in_feat to out_feat
-  std::memcpy(p_out_feat, p_in_feat, sizeof(Dtype) * in_nrows * nchannel);
+/*
+ * Reduce the rows of each segment (batch) into p_out[segment * width:
+ * (segment + 1) * width]. row_fn(row, p_acc) adds the contribution of the row
+ * to p_acc.
+ *
+ * Segments are distributed over threads when there are enough of them.
+ * Otherwise, the rows of each segment are split over threads and the partial
+ * sums are added at the end.
+ */
+template <typename Acc, typename RowFn>
+void segment_reduce_cpu(cpu_parent_map const &segments, size_t const width,
+                        Acc *p_out, RowFn row_fn) {
+  int64_t const nsegments = segments.out_nrows();
+  auto const &offsets = segments.offsets;
+  auto const &children = segments.children;
+  std::fill(p_out, p_out + nsegments * width, 0);
+
+  if (nsegments >= omp_get_max_threads()) {
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t s = 0; s < nsegments; ++s) {
+      for (auto i = offsets[s]; i < offsets[s + 1]; ++i)
+        row_fn(children[i], p_out + s * width);
+    }
+  } else {
+    for (int64_t s = 0; s < nsegments; ++s) {
+      Acc *p_curr_out = p_out + s * width;
+#pragma omp parallel
+      {
+        std::vector<Acc> partial(width, 0);
+#pragma omp for nowait
+        for (int64_t i = offsets[s]; i < (int64_t)offsets[s + 1]; ++i)
+          row_fn(children[i], partial.data());
+#pragma omp critical
+        for (size_t j = 0; j < width; ++j)
+          p_curr_out[j] += partial[j];
+      }
+    }
+  }
+}
+
+/*
+ * out = in (op) in_glob of the batch of the row.
+ */
+template <typename Dtype>
+void BroadcastForwardKernelCPU(Dtype const *p_in_feat,
+                               Dtype const *p_in_feat_global, Dtype *p_out_feat,
+                               size_t const nchannel,
+                               BroadcastMode::Type const op,
+                               cpu_parent_map const &segments) {
+  auto const &parents = segments.parents;
+  int64_t const in_nrows = parents.size();
 
   // To speed up, put switch outside for loops
   switch (op) {
   case BroadcastMode::ELEMENTWISE_ADDITON: // +
-    for (uint32_t k = 0; k < in_maps.size(); ++k) {
-      for (uint32_t row = 0; row < in_maps[k].size(); ++row) {
-        p_curr_out_feat = p_out_feat + in_maps[k][row] * nchannel;
-        p_curr_in_feat_global = p_in_feat_global + glob_maps[k][row] * nchannel;
-        cpu_add<Dtype>(nchannel, p_curr_in_feat_global, p_curr_out_feat,
-                       p_curr_out_feat);
-      }
+#pragma omp parallel for
+    for (int64_t row = 0; row < in_nrows; ++row) {
+      Dtype const *p_curr_in = p_in_feat + row * nchannel;
+      Dtype const *p_curr_glob = p_in_feat_global + parents[row] * nchannel;
+      Dtype *p_curr_out = p_out_feat + row * nchannel;
+#pragma omp simd
+      for (size_t j = 0; j < nchannel; ++j)
+        p_curr_out[j] = p_curr_in[j] + p_curr_glob[j];
     }
     break;
   case BroadcastMode::ELEMENTWISE_MULTIPLICATION: // *
-    for (uint32_t k = 0; k < in_maps.size(); ++k) {
-      for (uint32_t row = 0; row < in_maps[k].size(); ++row) {
-        p_curr_out_feat = p_out_feat + in_maps[k][row] * nchannel;
-        p_curr_in_feat_global = p_in_feat_global + glob_maps[k][row] * nchannel;
-        cpu_mul<Dtype>(nchannel, p_curr_in_feat_global, p_curr_out_feat,
-                       p_curr_out_feat);
-      }
-    }
-    break;
-  /*
-  case 2: // division
-    for (int k = 0; k < in_maps.size(); ++k) {
-      for (int row = 0; row < in_maps[k].size(); ++row) {
-        p_curr_out_feat = p_out_feat + in_maps[k][row] * nchannel;
-        p_curr_in_feat_global = p_in_feat_global + glob_maps[k][row] * nchannel;
-        cpu_div<Dtype>(nchannel, p_curr_in_feat_global, p_curr_out_feat,
-                       p_curr_out_feat);
-      }
+#pragma omp parallel for
+    for (int64_t row = 0; row < in_nrows; ++row) {
+      Dtype const *p_curr_in = p_in_feat + row * nchannel;
+      Dtype const *p_curr_glob = p_in_feat_global + parents[row] * nchannel;
+      Dtype *p_curr_out = p_out_feat + row * nchannel;
+#pragma omp simd
+      for (size_t j = 0; j < nchannel; ++j)
+        p_curr_out[j] = p_curr_in[j] * p_curr_glob[j];
     }
     break;
-  */
   default:
     throw std::invalid_argument(Formatter() << "Operation not supported: "
                                             << std::to_string(op));
   }
 }
 
-template <typename Dtype, typename Itype>
-void BroadcastBackwardKernelCPU(const Dtype *p_in_feat,                   //
-                                Dtype *p_grad_in_feat, uint32_t in_nrows, //
-                                const Dtype *p_in_feat_global,
+/*
+ * The gradient of the global features is reduced over the rows of each batch
+ * with segment_reduce_cpu and written to p_grad_in_feat_global.
+ */
+template <typename Dtype>
+void BroadcastBackwardKernelCPU(Dtype const *p_in_feat,
+                                Dtype *p_grad_in_feat, //
+                                Dtype const *p_in_feat_global,
                                 Dtype *p_grad_in_feat_global,
-                                uint32_t in_nrows_global,     //
-                                const Dtype *p_grad_out_feat, //
-                                uint32_t nchannel,
+                                Dtype const *p_grad_out_feat, //
+                                size_t const nchannel,
                                 BroadcastMode::Type const op, //
-                                const cpu_in_maps &in_maps,
-                                const cpu_out_maps &glob_maps) {
-  Dtype *p_curr_grad_in_feat, *p_curr_grad_in_feat_global;
-  const Dtype *p_curr_in_feat_global, *p_curr_in_feat, *p_curr_grad_out_feat;
-
-  // Assume that the memory is cleared
-  /*
-  // Clear grad memory
-  std::memset(p_grad_in_feat_global, 0,
-              sizeof(Dtype) * in_nrows_global * nchannel);
-  */
-
-  // Initialize the grad_in_feat as grad_out_feat
-  std::memcpy(p_grad_in_feat, p_grad_out_feat,
-              sizeof(Dtype) * in_nrows * nchannel);
+                                cpu_parent_map const &segments) {
+  auto const &parents = segments.parents;
+  int64_t const in_nrows = parents.size();
 
   // To speed up, put switch outside for loops
   switch (op) {
   case BroadcastMode::ELEMENTWISE_ADDITON: // +
-    // For p_grad_in_feat, copy all grad_out
-    for (uint32_t k = 0; k < in_maps.size(); ++k) {
-      for (uint32_t row = 0; row < in_maps[k].size(); ++row) {
-        p_curr_grad_out_feat = p_grad_out_feat + in_maps[k][row] * nchannel;
-        p_curr_grad_in_feat_global =
-            p_grad_in_feat_global + glob_maps[k][row] * nchannel;
-        cpu_add<Dtype>(nchannel, p_curr_grad_out_feat,
-                       p_curr_grad_in_feat_global, p_curr_grad_in_feat_global);
-      }
-    }
+    std::memcpy(p_grad_in_feat, p_grad_out_feat,
+                sizeof(Dtype) * in_nrows * nchannel);
+    segment_reduce_cpu<Dtype>(
+        segments, nchannel, p_grad_in_feat_global,
+        [&](auto row, Dtype *p_acc) {
+          Dtype const *p_curr_grad_out = p_grad_out_feat + row * nchannel;
+#pragma omp simd
+          for (size_t j = 0; j < nchannel; ++j)
+            p_acc[j] += p_curr_grad_out[j];
+        });
     break;
   case BroadcastMode::ELEMENTWISE_MULTIPLICATION: // *
-    for (uint32_t k = 0; k < in_maps.size(); ++k) {
-      for (uint32_t row = 0; row < in_maps[k].size(); ++row) {
-        // In feat global
-        p_curr_in_feat = p_in_feat + in_maps[k][row] * nchannel;
-        p_curr_grad_in_feat = p_grad_in_feat + in_maps[k][row] * nchannel;
-        p_curr_grad_in_feat_global =
-            p_grad_in_feat_global + glob_maps[k][row] * nchannel;
-        p_curr_grad_out_feat = p_grad_out_feat + in_maps[k][row] * nchannel;
-        p_curr_in_feat_global = p_in_feat_global + glob_maps[k][row] * nchannel;
-
-        // In feat
-        cpu_mul<Dtype>(nchannel, p_curr_in_feat_global, p_curr_grad_out_feat,
-                       p_curr_grad_in_feat);
-        // In feat glob
-        for (uint32_t j = 0; j < nchannel; j++) {
-          p_curr_grad_in_feat_global[j] +=
-              p_curr_grad_out_feat[j] * p_curr_in_feat[j];
-        }
-      }
+#pragma omp parallel for
+    for (int64_t row = 0; row < in_nrows; ++row) {
+      Dtype const *p_curr_grad_out = p_grad_out_feat + row * nchannel;
+      Dtype const *p_curr_glob = p_in_feat_global + parents[row] * nchannel;
+      Dtype *p_curr_grad_in = p_grad_in_feat + row * nchannel;
+#pragma omp simd
+      for (size_t j = 0; j < nchannel; ++j)
+        p_curr_grad_in[j] = p_curr_grad_out[j] * p_curr_glob[j];
     }
+    segment_reduce_cpu<Dtype>(
+        segments, nchannel, p_grad_in_feat_global,
+        [&](auto row, Dtype *p_acc) {
+          Dtype const *p_curr_grad_out = p_grad_out_feat + row * nchannel;
+          Dtype const *p_curr_in = p_in_feat + row * nchannel;
+#pragma omp simd
+          for (size_t j = 0; j < nchannel; ++j)
+            p_acc[j] += p_curr_grad_out[j] * p_curr_in[j];
+        });
     break;
   default:
     throw std::invalid_argument(Formatter() << "Operation not supported: "
@@ -158,6 +176,149 @@ void BroadcastBackwardKernelCPU(const Dtype *p_in_feat,                   //
   }
 }
 
+/*
+ * Squeeze-excitation gating. out = in * gate of the batch of the row.
+ */
+template <typename Dtype>
+void GatingForwardKernelCPU(Dtype const *p_in_feat, Dtype const *p_gate,
+                            Dtype *p_out_feat, size_t const nchannel,
+                            cpu_parent_map const &segments) {
+  auto const &parents = segments.parents;
+#pragma omp parallel for
+  for (int64_t row = 0; row < (int64_t)parents.size(); ++row) {
+    Dtype const *p_curr_in = p_in_feat + row * nchannel;
+    Dtype const *p_curr_gate = p_gate + parents[row] * nchannel;
+    Dtype *p_curr_out = p_out_feat + row * nchannel;
+    for (size_t j = 0; j < nchannel; ++j)
+      p_curr_out[j] = p_curr_in[j] * p_curr_gate[j];
+  }
+}
+
+/*
+ * grad_in = grad_out * gate + grad_pooled, where grad_pooled is the gradient
+ * of the average pooled features already divided by the batch size.
+ */
+template <typename Dtype>
+void GatingBackwardKernelCPU(Dtype const *p_grad_out_feat, Dtype const *p_gate,
+                             Dtype const *p_grad_pooled, Dtype *p_grad_in_feat,
+                             size_t const nchannel,
+                             cpu_parent_map const &segments) {
+  auto const &parents = segments.parents;
+#pragma omp parallel for
+  for (int64_t row = 0; row < (int64_t)parents.size(); ++row) {
+    Dtype const *p_curr_grad_out = p_grad_out_feat + row * nchannel;
+    Dtype const *p_curr_gate = p_gate + parents[row] * nchannel;
+    Dtype const *p_curr_grad_pooled = p_grad_pooled + parents[row] * nchannel;
+    Dtype *p_curr_grad_in = p_grad_in_feat + row * nchannel;
+    for (size_t j = 0; j < nchannel; ++j)
+      p_curr_grad_in[j] =
+          p_curr_grad_out[j] * p_curr_gate[j] + p_curr_grad_pooled[j];
+  }
+}
+
+/*
+ * out = (in - mean) / sqrt(var + eps) with the statistics of the batch of the
+ * row. The variance is centered on the mean of the first pass so that inputs
+ * with a large offset do not cancel. p_inv_std (batch_size x nchannel) is
+ * saved for the backward pass.
+ */
+template <typename Dtype>
+void InstanceNormForwardKernelCPU(Dtype const *p_in_feat, Dtype *p_out_feat,
+                                  Dtype *p_inv_std, size_t const nchannel,
+                                  double const eps,
+                                  cpu_parent_map const &segments) {
+  auto const nsegments = segments.out_nrows();
+  auto const &parents = segments.parents;
+
+  // sum x
+  std::vector<double> mean(nsegments * nchannel);
+  segment_reduce_cpu<double>(
+      segments, nchannel, mean.data(), [&](auto row, double *p_acc) {
+        Dtype const *p_curr_in = p_in_feat + row * nchannel;
+        for (size_t j = 0; j < nchannel; ++j)
+          p_acc[j] += p_curr_in[j];
+      });
+  for (default_types::index_type s = 0; s < nsegments; ++s) {
+    double const n = std::max<double>(segments.num_children(s), 1);
+    for (size_t j = 0; j < nchannel; ++j)
+      mean[s * nchannel + j] /= n;
+  }
+
+  // sum (x - mean)^2
+  std::vector<double> var(nsegments * nchannel);
+  segment_reduce_cpu<double>(
+      segments, nchannel, var.data(), [&](auto row, double *p_acc) {
+        Dtype const *p_curr_in = p_in_feat + row * nchannel;
+        double const *p_curr_mean = mean.data() + parents[row] * nchannel;
+        for (size_t j = 0; j < nchannel; ++j) {
+          double const diff = p_curr_in[j] - p_curr_mean[j];
+          p_acc[j] += diff * diff;
+        }
+      });
+  for (default_types::index_type s = 0; s < nsegments; ++s) {
+    double const n = std::max<double>(segments.num_children(s), 1);
+    for (size_t j = 0; j < nchannel; ++j)
+      p_inv_std[s * nchannel + j] =
+          1. / std::sqrt(var[s * nchannel + j] / n + eps);
+  }
+
+#pragma omp parallel for
+  for (int64_t row = 0; row < (int64_t)parents.size(); ++row) {
+    Dtype const *p_curr_in = p_in_feat + row * nchannel;
+    Dtype *p_curr_out = p_out_feat + row * nchannel;
+    double const *p_curr_mean = mean.data() + parents[row] * nchannel;
+    Dtype const *p_curr_inv_std = p_inv_std + parents[row] * nchannel;
+    for (size_t j = 0; j < nchannel; ++j)
+      p_curr_out[j] = (p_curr_in[j] - p_curr_mean[j]) * p_curr_inv_std[j];
+  }
+}
+
+/*
+ * grad_in = inv_std * (grad_out - mean(grad_out) - out * mean(grad_out * out))
+ * with the means over the batch of the row.
+ */
+template <typename Dtype>
+void InstanceNormBackwardKernelCPU(Dtype const *p_grad_out_feat,
+                                   Dtype const *p_out_feat,
+                                   Dtype const *p_inv_std,
+                                   Dtype *p_grad_in_feat, size_t const nchannel,
+                                   cpu_parent_map const &segments) {
+  auto const nsegments = segments.out_nrows();
+  auto const &parents = segments.parents;
+
+  // sum dout, sum dout * out
+  std::vector<double> sums(nsegments * 2 * nchannel);
+  segment_reduce_cpu<double>(
+      segments, 2 * nchannel, sums.data(), [&](auto row, double *p_acc) {
+        Dtype const *p_curr_grad_out = p_grad_out_feat + row * nchannel;
+        Dtype const *p_curr_out = p_out_feat + row * nchannel;
+        for (size_t j = 0; j < nchannel; ++j) {
+          p_acc[j] += p_curr_grad_out[j];
+          p_acc[nchannel + j] += (double)p_curr_grad_out[j] * p_curr_out[j];
+        }
+      });
+
+  std::vector<Dtype> means(nsegments * 2 * nchannel);
+  for (default_types::index_type s = 0; s < nsegments; ++s) {
+    double const n = std::max<double>(segments.num_children(s), 1);
+    for (size_t j = 0; j < 2 * nchannel; ++j)
+      means[s * 2 * nchannel + j] = sums[s * 2 * nchannel + j] / n;
+  }
+
+#pragma omp parallel for
+  for (int64_t row = 0; row < (int64_t)parents.size(); ++row) {
+    Dtype const *p_curr_grad_out = p_grad_out_feat + row * nchannel;
+    Dtype const *p_curr_out = p_out_feat + row * nchannel;
+    Dtype *p_curr_grad_in = p_grad_in_feat + row * nchannel;
+    Dtype const *p_curr_means = means.data() + parents[row] * 2 * nchannel;
+    Dtype const *p_curr_inv_std = p_inv_std + parents[row] * nchannel;
+    for (size_t j = 0; j < nchannel; ++j)
+      p_curr_grad_in[j] =
+          p_curr_inv_std[j] * (p_curr_grad_out[j] - p_curr_means[j] -
+                               p_curr_out[j] * p_curr_means[nchannel + j]);
+  }
+}
+
 } // namespace minkowski
 
 #endif
@@ -53,6 +53,8 @@ ConvolutionForwardCPU(at::Tensor const &in_feat,                         //
                       CoordinateMapKey *p_in_map_key,                    //
                       CoordinateMapKey *p_out_map_key,                   //
                       cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_config const threads = p_map_manager->threads();
+  thread_scope const scope(threads);
 
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
   ASSERT(kernel.is_contiguous(), "kernel must be contiguous");
@@ -120,6 +122,8 @@ ConvolutionForwardCPU(at::Tensor const &in_feat,                         //
   at::Tensor out_feat =
       torch::zeros({out_nrows, kernel.size(2)}, in_feat.options());
   LOG_DEBUG("Allocated", out_nrows, "x", kernel.size(2), "out_features.");
+  bool const outer_parallel = convolution_outer_parallel(
+      threads.threading_policy, in_out.first, kernel.size(1), kernel.size(2));
 
   if (out_nrows > 0)
     AT_DISPATCH_FLOATING_TYPES(
@@ -128,7 +132,7 @@ ConvolutionForwardCPU(at::Tensor const &in_feat,                         //
               in_feat.template data_ptr<scalar_t>(), in_feat.size(1),
               out_feat.template data_ptr<scalar_t>(), out_feat.size(1),
               kernel.template data_ptr<scalar_t>(), in_out.first,
-              in_out.second);
+              in_out.second, outer_parallel);
         });
 
   return out_feat;
@@ -148,6 +152,8 @@ ConvolutionBackwardCPU(at::Tensor const &in_feat,                         //
                        CoordinateMapKey *p_in_map_key,                    //
                        CoordinateMapKey *p_out_map_key,                   //
                        cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_config const threads = p_map_manager->threads();
+  thread_scope const scope(threads);
 
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
   // ASSERT(grad_out_feat.is_contiguous(), "grad_out_feata must be contiguous");
@@ -186,6 +192,8 @@ ConvolutionBackwardCPU(at::Tensor const &in_feat,                         //
       torch::zeros({in_feat.size(0), in_feat.size(1)}, in_feat.options());
   at::Tensor grad_kernel = torch::zeros(
       {kernel.size(0), kernel.size(1), kernel.size(2)}, kernel.options());
+  bool const outer_parallel = convolution_outer_parallel(
+      threads.threading_policy, in_out.first, kernel.size(1), kernel.size(2));
 
   if (in_feat.size(0) > 0)
     AT_DISPATCH_FLOATING_TYPES(
@@ -196,7 +204,7 @@ ConvolutionBackwardCPU(at::Tensor const &in_feat,                         //
               grad_out_feat.template data_ptr<scalar_t>(),
               grad_out_feat.size(1), kernel.template data_ptr<scalar_t>(),
               grad_kernel.template data_ptr<scalar_t>(), in_out.first,
-              in_out.second);
+              in_out.second, outer_parallel);
         });
 
   return std::make_pair(grad_in_feat, grad_kernel);
@@ -25,121 +25,250 @@
 #ifndef CPU_CONVOLUTION
 #define CPU_CONVOLUTION
 
+#include "kernel_map.hpp"
 #include "math_functions.hpp"
 #include "types.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <omp.h>
+#include <vector>
+
 namespace minkowski {
 
+/*
+ * Resolves the threading policy of a convolution. The outer parallel loop
+ * splits the rows of each kernel offset over the OpenMP threads and runs a
+ * single-threaded GEMM per chunk, which wins for narrow channels where a
+ * multithreaded GEMM has too little work per thread. Wide channels or few
+ * rows leave the parallelism to the BLAS. Without a BLAS whose threads can
+ * be pinned, every policy leaves the parallelism to the BLAS, since each
+ * thread of the outer loop would run a multithreaded GEMM.
+ */
+inline bool convolution_outer_parallel(ThreadingPolicy::Type const policy,
+                                       cpu_in_maps const &in_maps,
+                                       int in_nchannel, int out_nchannel) {
+  if (!blas_threads_pinnable())
+    return false;
+  if (policy != ThreadingPolicy::AUTO)
+    return policy == ThreadingPolicy::OUTER_PARALLEL;
+
+  int const num_threads = omp_get_max_threads();
+  if (num_threads < 2 || in_maps.empty())
+    return false;
+
+  size_t num_rows = 0;
+  for (auto const &in_map : in_maps)
+    num_rows += in_map.size();
+  return in_nchannel * out_nchannel <= 128 * 128 &&
+         num_rows / in_maps.size() >= 64 * size_t(num_threads);
+}
+
+namespace detail {
+
+// Rows [begin, end) of a kernel offset: gather, GEMM, and scatter-add.
+template <typename Dtype>
+void convolution_forward_rows(const Dtype *p_in_feat, int in_nchannel,
+                              Dtype *p_out_feat, int out_nchannel,
+                              const Dtype *p_kernel, cpu_in_map const &in_map,
+                              cpu_out_map const &out_map, int begin, int end,
+                              std::vector<Dtype> &input_buffer,
+                              std::vector<Dtype> &output_buffer) {
+  int const nrows = end - begin;
+  input_buffer.resize(nrows * in_nchannel);
+  output_buffer.resize(nrows * out_nchannel);
+
+  // Gather all features (im2col)
+  for (int row = 0; row < nrows; row++)
+    std::memcpy(&input_buffer[row * in_nchannel],
+                p_in_feat + in_map[begin + row] * in_nchannel,
+                sizeof(Dtype) * in_nchannel);
+
+  // C := alpha*op(A)*op(B) + beta*C
+  cpu_gemm<Dtype>(CblasColMajor, CblasNoTrans, CblasNoTrans,
+                  out_nchannel,       // M
+                  nrows,              // N
+                  in_nchannel,        // K
+                  1,                  // alpha
+                  p_kernel,           // A
+                  &input_buffer[0],   // B
+                  0,                  // beta
+                  &output_buffer[0]); // C
+
+  // Put it back to the correct index
+  for (int row = 0; row < nrows; row++) {
+    Dtype *dst = &p_out_feat[out_map[begin + row] * out_nchannel];
+    Dtype *src = &output_buffer[row * out_nchannel];
+    cpu_add<Dtype>(out_nchannel, src, dst, dst);
+  }
+}
+
+// Rows [begin, end) of a kernel offset: the input gradient is scatter-added
+// and the kernel gradient accumulated into p_grad_kernel.
+template <typename Dtype>
+void convolution_backward_rows(const Dtype *p_in_feat, Dtype *p_grad_in_feat,
+                               int in_nchannel, const Dtype *p_grad_out_feat,
+                               int out_nchannel, const Dtype *p_kernel,
+                               Dtype *p_grad_kernel, cpu_in_map const &in_map,
+                               cpu_out_map const &out_map, int begin, int end,
+                               std::vector<Dtype> &input_buffer,
+                               std::vector<Dtype> &output_buffer) {
+  int const nrows = end - begin;
+  input_buffer.resize(nrows * in_nchannel);
+  output_buffer.resize(nrows * out_nchannel);
+
+  // Gather all features for a matrix multiplication (im2col)
+  for (int row = 0; row < nrows; row++)
+    std::memcpy(&output_buffer[row * out_nchannel],
+                &p_grad_out_feat[out_map[begin + row] * out_nchannel],
+                sizeof(Dtype) * out_nchannel);
+
+  cpu_gemm<Dtype>(CblasColMajor, CblasTrans, CblasNoTrans,
+                  in_nchannel,       // M
+                  nrows,             // N
+                  out_nchannel,      // K
+                  1,                 // alpha
+                  p_kernel,          // A
+                  &output_buffer[0], // B
+                  0,                 // beta
+                  &input_buffer[0]   // C
+  );
+
+  // Accumulate gradients back to the input grad feat
+  for (int row = 0; row < nrows; row++) {
+    Dtype *src = &input_buffer[row * in_nchannel];
+    Dtype *dst = &p_grad_in_feat[in_map[begin + row] * in_nchannel];
+    cpu_add<Dtype>(in_nchannel, src, dst, dst);
+  }
+
+  // Compute gradient for kernel
+  for (int row = 0; row < nrows; row++)
+    std::memcpy(&input_buffer[row * in_nchannel],
+                p_in_feat + in_map[begin + row] * in_nchannel,
+                sizeof(Dtype) * in_nchannel);
+
+  cpu_gemm<Dtype>(CblasColMajor, CblasNoTrans, CblasTrans,
+                  out_nchannel,      // M
+                  in_nchannel,       // N
+                  nrows,             // K
+                  1,                 // alpha
+                  &output_buffer[0], // A
+                  &input_buffer[0],  // B
+                  1,                 // beta
+                  p_grad_kernel      // C
+  );
+}
+
+} // namespace detail
+
+/*
+ * With outer_parallel, the threads split the rows of each kernel offset. The
+ * rows of one offset map to distinct outputs, so the scatter needs no lock,
+ * and a barrier separates the offsets. The GEMMs inside the parallel region
+ * run single-threaded.
+ */
 template <typename Dtype, typename Itype>
 void ConvolutionForwardKernelCPU(const Dtype *p_in_feat, int in_nchannel,
                                  Dtype *p_out_feat, int out_nchannel,
                                  const Dtype *p_kernel,
                                  const cpu_in_maps &in_maps,
-                                 const cpu_out_maps &out_maps) {
-  int kernel_volume, n_active_in_volume, row;
-  std::vector<Dtype> input_buffer, output_buffer;
-
+                                 const cpu_out_maps &out_maps,
+                                 bool const outer_parallel) {
   // Number of weights
-  kernel_volume = in_maps.size();
-
-  // Iterate through each spatial kernel out of filter_volume spatial kernels
-  // for (auto &current_in2out : in2out) {
-  for (int k = 0; k < kernel_volume; k++) {
-    n_active_in_volume = in_maps[k].size();
-    if (n_active_in_volume == 0)
-      continue;
-
-    input_buffer.resize(n_active_in_volume * in_nchannel);
-    output_buffer.resize(n_active_in_volume * out_nchannel);
-
-    // Gather all features (im2col)
-    for (row = 0; row < n_active_in_volume; row++)
-      std::memcpy(&input_buffer[row * in_nchannel],
-                  p_in_feat + in_maps[k][row] * in_nchannel,
-                  sizeof(Dtype) * in_nchannel);
-
-    // C := alpha*op(A)*op(B) + beta*C
-    cpu_gemm<Dtype>(CblasColMajor, CblasNoTrans, CblasNoTrans,
-                    out_nchannel,                              // M
-                    n_active_in_volume,                        // N
-                    in_nchannel,                               // K
-                    1,                                         // alpha
-                    &p_kernel[k * in_nchannel * out_nchannel], // A
-                    &input_buffer[0],                          // B
-                    0,                                         // beta
-                    &output_buffer[0]);                        // C
-
-    // Put it back to the correct index
-    for (row = 0; row < n_active_in_volume; row++) {
-      Dtype *dst = &p_out_feat[out_maps[k][row] * out_nchannel];
-      Dtype *src = &output_buffer[row * out_nchannel];
-      cpu_add<Dtype>(out_nchannel, src, dst, dst);
+  int const kernel_volume = in_maps.size();
+
+  if (!outer_parallel) {
+    std::vector<Dtype> input_buffer, output_buffer;
+    // Iterate through each spatial kernel out of filter_volume spatial kernels
+    for (int k = 0; k < kernel_volume; k++) {
+      int const n_active_in_volume = in_maps[k].size();
+      if (n_active_in_volume == 0)
+        continue;
+      detail::convolution_forward_rows<Dtype>(
+          p_in_feat, in_nchannel, p_out_feat, out_nchannel,
+          &p_kernel[k * in_nchannel * out_nchannel], in_maps[k], out_maps[k],
+          0, n_active_in_volume, input_buffer, output_buffer);
+    }
+    return;
+  }
+
+  blas_serial_scope const blas_serial;
+#pragma omp parallel
+  {
+    blas_thread_scope const blas_scope(1);
+    std::vector<Dtype> input_buffer, output_buffer;
+    int const num_threads = omp_get_num_threads();
+    int const thread_id = omp_get_thread_num();
+    for (int k = 0; k < kernel_volume; k++) {
+      int const n_active_in_volume = in_maps[k].size();
+      int const begin = int64_t(n_active_in_volume) * thread_id / num_threads;
+      int const end =
+          int64_t(n_active_in_volume) * (thread_id + 1) / num_threads;
+      if (end > begin)
+        detail::convolution_forward_rows<Dtype>(
+            p_in_feat, in_nchannel, p_out_feat, out_nchannel,
+            &p_kernel[k * in_nchannel * out_nchannel], in_maps[k],
+            out_maps[k], begin, end, input_buffer, output_buffer);
+#pragma omp barrier
     }
   }
 }
 
+/*
+ * With outer_parallel, each thread accumulates the kernel gradient of its
+ * rows in a private buffer that is added to p_grad_kernel at the end.
+ */
 template <typename Dtype, typename Itype>
 void ConvolutionBackwardKernelCPU(const Dtype *p_in_feat, Dtype *p_grad_in_feat,
                                   int in_nchannel, const Dtype *p_grad_out_feat,
                                   int out_nchannel, const Dtype *p_kernel,
                                   Dtype *p_grad_kernel,
                                   const cpu_in_maps &in_maps,
-                                  const cpu_out_maps &out_maps) {
-  int kernel_volume, n_active_in_volume, row;
-  std::vector<Dtype> input_buffer, output_buffer;
-
+                                  const cpu_out_maps &out_maps,
+                                  bool const outer_parallel) {
   // Number of weights
-  kernel_volume = in_maps.size();
-
-  // for (auto &current_in2out : in2out) {
-  for (int k = 0; k < kernel_volume; k++) {
-    n_active_in_volume = in_maps[k].size();
-    if (n_active_in_volume == 0)
-      continue;
-
-    input_buffer.resize(n_active_in_volume * in_nchannel);
-    output_buffer.resize(n_active_in_volume * out_nchannel);
-
-    // Gather all features for a matrix multiplication (im2col)
-    for (row = 0; row < n_active_in_volume; row++)
-      std::memcpy(&output_buffer[row * out_nchannel],
-                  &p_grad_out_feat[out_maps[k][row] * out_nchannel],
-                  sizeof(Dtype) * out_nchannel);
-
-    cpu_gemm<Dtype>(CblasColMajor, CblasTrans, CblasNoTrans,
-                    in_nchannel,                               // M
-                    n_active_in_volume,                        // N
-                    out_nchannel,                              // K
-                    1,                                         // alpha
-                    &p_kernel[k * in_nchannel * out_nchannel], // A
-                    &output_buffer[0],                         // B
-                    0,                                         // beta
-                    &input_buffer[0]                           // C
-    );
-
-    // Accumulate gradients back to the input grad feat
-    for (row = 0; row < n_active_in_volume; row++) {
-      Dtype *src = &input_buffer[row * in_nchannel];
-      Dtype *dst = &p_grad_in_feat[in_maps[k][row] * in_nchannel];
-      cpu_add<Dtype>(in_nchannel, src, dst, dst);
+  int const kernel_volume = in_maps.size();
+  int const kernel_size = in_nchannel * out_nchannel;
+
+  if (!outer_parallel) {
+    std::vector<Dtype> input_buffer, output_buffer;
+    for (int k = 0; k < kernel_volume; k++) {
+      int const n_active_in_volume = in_maps[k].size();
+      if (n_active_in_volume == 0)
+        continue;
+      detail::convolution_backward_rows<Dtype>(
+          p_in_feat, p_grad_in_feat, in_nchannel, p_grad_out_feat,
+          out_nchannel, &p_kernel[k * kernel_size],
+          &p_grad_kernel[k * kernel_size], in_maps[k], out_maps[k], 0,
+          n_active_in_volume, input_buffer, output_buffer);
     }
+    return;
+  }
 
-    // Compute gradient for kernel
-    for (row = 0; row < n_active_in_volume; row++)
-      std::memcpy(&input_buffer[row * in_nchannel],
-                  p_in_feat + in_maps[k][row] * in_nchannel,
-                  sizeof(Dtype) * in_nchannel);
-
-    cpu_gemm<Dtype>(CblasColMajor, CblasNoTrans, CblasTrans,
-                    out_nchannel,                                  // M
-                    in_nchannel,                                   // N
-                    n_active_in_volume,                            // K
-                    1,                                             // alpha
-                    &output_buffer[0],                             // A
-                    &input_buffer[0],                              // B
-                    1,                                             // beta
-                    &p_grad_kernel[k * in_nchannel * out_nchannel] // C
-    );
+  blas_serial_scope const blas_serial;
+#pragma omp parallel
+  {
+    blas_thread_scope const blas_scope(1);
+    std::vector<Dtype> input_buffer, output_buffer;
+    std::vector<Dtype> grad_kernel(kernel_volume * kernel_size, 0);
+    int const num_threads = omp_get_num_threads();
+    int const thread_id = omp_get_thread_num();
+    for (int k = 0; k < kernel_volume; k++) {
+      int const n_active_in_volume = in_maps[k].size();
+      int const begin = int64_t(n_active_in_volume) * thread_id / num_threads;
+      int const end =
+          int64_t(n_active_in_volume) * (thread_id + 1) / num_threads;
+      if (end > begin)
+        detail::convolution_backward_rows<Dtype>(
+            p_in_feat, p_grad_in_feat, in_nchannel, p_grad_out_feat,
+            out_nchannel, &p_kernel[k * kernel_size],
+            &grad_kernel[k * kernel_size], in_maps[k], out_maps[k], begin,
+            end, input_buffer, output_buffer);
+#pragma omp barrier
+    }
+#pragma omp critical
+    cpu_add<Dtype>(kernel_volume * kernel_size, &grad_kernel[0],
+                   p_grad_kernel, p_grad_kernel);
   }
 }
 
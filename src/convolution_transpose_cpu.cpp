@@ -52,6 +52,8 @@ at::Tensor ConvolutionTransposeForwardCPU(
     CoordinateMapKey *p_in_map_key,                    //
     CoordinateMapKey *p_out_map_key,                   //
     cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_config const threads = p_map_manager->threads();
+  thread_scope const scope(threads);
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
   ASSERT(kernel.is_contiguous(), "kernel must be contiguous");
 
@@ -112,13 +114,16 @@ at::Tensor ConvolutionTransposeForwardCPU(
       torch::zeros({out_nrows, kernel.size(2)}, in_feat.options());
   LOG_DEBUG("In feat:", in_feat.size(0), "x", in_feat.size(1), "-> out feat",
             out_feat.size(0), "x", out_feat.size(1));
+  bool const outer_parallel = convolution_outer_parallel(
+      threads.threading_policy, in_out.first, kernel.size(1), kernel.size(2));
 
   AT_DISPATCH_FLOATING_TYPES(
       in_feat.scalar_type(), "convolution_transpose_forward_cpu", [&] {
         ConvolutionForwardKernelCPU<scalar_t, default_types::index_type>(
             in_feat.template data_ptr<scalar_t>(), in_feat.size(1),
             out_feat.template data_ptr<scalar_t>(), out_feat.size(1),
-            kernel.template data_ptr<scalar_t>(), in_out.first, in_out.second);
+            kernel.template data_ptr<scalar_t>(), in_out.first, in_out.second,
+            outer_parallel);
       });
 
   return out_feat;
@@ -137,6 +142,8 @@ std::pair<at::Tensor, at::Tensor> ConvolutionTransposeBackwardCPU(
     CoordinateMapKey *p_in_map_key,                    //
     CoordinateMapKey *p_out_map_key,                   //
     cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_config const threads = p_map_manager->threads();
+  thread_scope const scope(threads);
 
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
   ASSERT(grad_out_feat.is_contiguous(), "grad_out_feat must be contiguous");
@@ -174,6 +181,8 @@ std::pair<at::Tensor, at::Tensor> ConvolutionTransposeBackwardCPU(
       torch::zeros({in_feat.size(0), in_feat.size(1)}, in_feat.options());
   at::Tensor grad_kernel = torch::zeros(
       {kernel.size(0), kernel.size(1), kernel.size(2)}, kernel.options());
+  bool const outer_parallel = convolution_outer_parallel(
+      threads.threading_policy, in_out.first, kernel.size(1), kernel.size(2));
 
   AT_DISPATCH_FLOATING_TYPES(
       in_feat.scalar_type(), "convolution_transpose_backward_cpu", [&] {
@@ -184,7 +193,7 @@ std::pair<at::Tensor, at::Tensor> ConvolutionTransposeBackwardCPU(
             grad_out_feat.size(1), //
             kernel.template data_ptr<scalar_t>(),
             grad_kernel.template data_ptr<scalar_t>(), in_out.first,
-            in_out.second);
+            in_out.second, outer_parallel);
       });
 
   return std::make_pair(grad_in_feat, grad_kernel);
@@ -28,6 +28,7 @@
 #include "coordinate_map.hpp"
 #include "kernel_map.hpp"
 #include "kernel_region.hpp"
+#include <limits>
 #include <numeric>
 #include <omp.h>
 #include <torch/extension.h>
@@ -135,6 +136,34 @@ field_map_kernel(uint32_t const num_tfield,      //
   return std::make_pair(final_in_map, final_out_map);
 }
 
+/*
+ * Group the map entries by the input row with a counting sort. The entries of
+ * the input row i are entries[offsets[i]:offsets[i + 1]].
+ */
+template <typename Itype>
+void interpolation_group_by_input_cpu(Itype const *const in_maps,
+                                      uint32_t const in_nrows,
+                                      uint32_t const nnz, Itype *offsets,
+                                      Itype *entries) {
+  std::fill_n(offsets, in_nrows + 1, 0);
+  for (uint32_t k = 0; k < nnz; ++k)
+    ++offsets[in_maps[k] + 1];
+  for (uint32_t i = 0; i < in_nrows; ++i)
+    offsets[i + 1] += offsets[i];
+
+  std::vector<Itype> cursor(offsets, offsets + in_nrows);
+  for (uint32_t k = 0; k < nnz; ++k)
+    entries[cursor[in_maps[k]]++] = k;
+}
+
+/*
+ * Returns (in_map, out_map, weights, out_offsets, in_offsets, in_entries).
+ *
+ * The map is sorted by the output (tfield) row, and by the neighbor index
+ * within an output row. The entries of the output row i are
+ * [out_offsets[i], out_offsets[i + 1]). in_entries[in_offsets[j]:in_offsets[j
+ * + 1]] are the entries of the input row j for the backward pass.
+ */
 template <typename coordinate_type, typename Dtype, typename MapType>
 std::vector<at::Tensor> interpolation_map_weight_kernel(
     uint32_t const num_tfield,      //
@@ -148,21 +177,11 @@ std::vector<at::Tensor> interpolation_map_weight_kernel(
   uint32_t const neighbor_volume = std::pow(2, (coordinate_size - 1));
   LOG_DEBUG("neighbor_volume :", neighbor_volume, "num_tfield:", num_tfield);
 
-  cpu_in_maps in_maps =
-      initialize_maps<cpu_in_map>(neighbor_volume, num_tfield);
-  cpu_out_maps out_maps =
-      initialize_maps<cpu_out_map>(neighbor_volume, num_tfield);
-
-  std::vector<std::vector<Dtype>> weights =
-      initialize_maps<std::vector<Dtype>>(neighbor_volume, num_tfield);
-
-  std::vector<uint32_t> num_used(neighbor_volume);
-  std::for_each(num_used.begin(), num_used.end(), [](auto &i) { i = 0; });
-
-  // OMP
-  // size_t stride = max((size_t)100, numElements / (2 *
-  // omp_get_max_threads())); size_t N = (numElements + stride - 1) /
-  // stride;
+  // neighbors of the row i at [i * neighbor_volume, i * neighbor_volume +
+  // row_sizes[i])
+  std::vector<default_types::index_type> in_rows(num_tfield * neighbor_volume);
+  std::vector<Dtype> weights(num_tfield * neighbor_volume);
+  std::vector<uint32_t> row_sizes(num_tfield);
 
   // compute the chunk size per thread.
   // There's a trade-off between the thread initialization overhead and
@@ -172,13 +191,15 @@ std::vector<at::Tensor> interpolation_map_weight_kernel(
   const size_t stride = (num_tfield + N - 1) / N;
   LOG_DEBUG("kernel map with", N, "chunks and", stride, "stride.");
 
+  // number of map entries of each chunk
+  std::vector<uint32_t> num_used(N + 1, 0);
+
 #pragma omp parallel for
   for (uint32_t n = 0; n < N; n++) {
     // temporary variables for each thread
     std::vector<coordinate_type> curr_vec(coordinate_size), lb(coordinate_size),
         ub(coordinate_size);
     coordinate<coordinate_type> curr_coordinate(curr_vec.data());
-    uint32_t curr_index_begin;
 
     for (auto i = stride * n;
          i < std::min<uint64_t>((n + 1) * stride, uint64_t(num_tfield)); ++i) {
@@ -194,6 +215,7 @@ std::vector<at::Tensor> interpolation_map_weight_kernel(
         curr_vec[j] = lb[j];
       }
 
+      uint32_t curr_size = 0;
       // For elements in the current region
       for (uint32_t neighbor_ind = 0; neighbor_ind < neighbor_volume;
            ++neighbor_ind) {
@@ -208,17 +230,7 @@ std::vector<at::Tensor> interpolation_map_weight_kernel(
         }
 
         const auto iter_in = in_map.find(curr_coordinate);
-        // LOG_DEBUG(kernel_ind, ":",
-        //           PtrToString(iter_out->first.data(),
-        //           coordinate_size),
-        //           "->", PtrToString(point.data(),
-        //           coordinate_size));
         if (iter_in != in_map.end()) {
-#pragma omp atomic capture
-          {
-            curr_index_begin = num_used[neighbor_ind];
-            num_used[neighbor_ind] += 1;
-          }
           // Compute weights
           Dtype weight = 1.0;
           for (uint32_t j = 1; j < coordinate_size; ++j) {
@@ -226,24 +238,20 @@ std::vector<at::Tensor> interpolation_map_weight_kernel(
                 1 - std::abs(p_tfield[coordinate_size * i + j] - curr_vec[j]) /
                         tensor_stride[j - 1];
           }
-
-          // Ensure that in_maps and out_maps are resized accordingly
-          in_maps[neighbor_ind][curr_index_begin] = iter_in->second;
-          out_maps[neighbor_ind][curr_index_begin] = i;
-          weights[neighbor_ind][curr_index_begin] = weight;
-          // LOG_DEBUG(kernel_ind, ":",
-          //           PtrToString(iter_in->first.data(),
-          //           coordinate_size),
-          //           "->",
-          //           PtrToString(iter_out->first.data(),
-          //           coordinate_size));
+          in_rows[i * neighbor_volume + curr_size] = iter_in->second;
+          weights[i * neighbor_volume + curr_size] = weight;
+          ++curr_size;
         }
       }
+      row_sizes[i] = curr_size;
+      num_used[n + 1] += curr_size;
     }
   }
 
-  auto const total_num_used =
-      std::accumulate(num_used.begin(), num_used.end(), 0);
+  // exclusive prefix sum over the chunks
+  for (uint32_t n = 0; n < N; ++n)
+    num_used[n + 1] += num_used[n];
+  auto const total_num_used = num_used[N];
 
   auto final_in_map = torch::empty(
       {total_num_used},
@@ -255,21 +263,201 @@ std::vector<at::Tensor> interpolation_map_weight_kernel(
       {total_num_used},
       torch::TensorOptions().dtype(float_type).requires_grad(false));
 
-  uint32_t final_begin = 0;
-  for (uint32_t i = 0; i < neighbor_volume; ++i) {
-    uint32_t const max_num = num_used[i];
-    LOG_DEBUG("kernel index", i, "size:", max_num);
+  auto out_offsets = torch::empty(
+      {num_tfield + 1},
+      torch::TensorOptions().dtype(torch::kInt32).requires_grad(false));
+  uint32_t const in_nrows = in_map.size();
+  auto in_offsets = torch::empty(
+      {in_nrows + 1},
+      torch::TensorOptions().dtype(torch::kInt32).requires_grad(false));
+  auto in_entries = torch::empty(
+      {total_num_used},
+      torch::TensorOptions().dtype(torch::kInt32).requires_grad(false));
+
+  int *p_in_map = final_in_map.template data_ptr<int>();
+  int *p_out_map = final_out_map.template data_ptr<int>();
+  Dtype *p_weights = final_weights.template data_ptr<Dtype>();
+  int *p_out_offsets = out_offsets.template data_ptr<int>();
+
+#pragma omp parallel for
+  for (uint32_t n = 0; n < N; n++) {
+    uint32_t curr_begin = num_used[n];
+    for (auto i = stride * n;
+         i < std::min<uint64_t>((n + 1) * stride, uint64_t(num_tfield)); ++i) {
+      p_out_offsets[i] = curr_begin;
+      for (uint32_t k = 0; k < row_sizes[i]; ++k, ++curr_begin) {
+        p_in_map[curr_begin] = in_rows[i * neighbor_volume + k];
+        p_out_map[curr_begin] = i;
+        p_weights[curr_begin] = weights[i * neighbor_volume + k];
+      }
+    }
+  }
+  p_out_offsets[num_tfield] = total_num_used;
+
+  interpolation_group_by_input_cpu<int>(
+      p_in_map, in_nrows, total_num_used, in_offsets.template data_ptr<int>(),
+      in_entries.template data_ptr<int>());
+
+  return {final_in_map, final_out_map, final_weights,
+          out_offsets,  in_offsets,    in_entries};
+}
+
+/*
+ * Neighbors of the query points within the radius in increasing distance, at
+ * most max_num_neighbors per query if it is positive.
+ *
+ * The lattice offsets that can be within the radius are sorted by their
+ * Chebyshev shell once. Each query visits the shells outwards from its lower
+ * lattice point and stops when the next shell cannot have a closer neighbor.
+ *
+ * Returns (offsets, rows, distances) in CSR format. rows[offsets[i]:offsets[i
+ * + 1]] are the rows of the neighbors of the query i.
+ */
+template <typename coordinate_type, typename Dtype, typename MapType>
+std::vector<at::Tensor>
+neighbor_query_kernel(uint32_t const num_query,       //
+                      uint32_t const coordinate_size, //
+                      Dtype const *const p_query,     //
+                      MapType const &in_map,          //
+                      default_types::stride_type const &tensor_stride,
+                      Dtype const radius, uint32_t const max_num_neighbors) {
+  constexpr bool is_float32 = std::is_same<Dtype, float>::value;
+  at::ScalarType const float_type =
+      is_float32 ? at::ScalarType::Float : at::ScalarType::Double;
+  using neighbor_type = std::pair<Dtype, default_types::index_type>;
+  uint32_t const D = coordinate_size - 1;
+
+  // a point in the shell r is farther than (r - 1) * min_stride
+  Dtype const min_stride =
+      *std::min_element(tensor_stride.begin(), tensor_stride.end());
+  int const max_shell = std::floor(radius / min_stride) + 1;
+  uint32_t const shell_width = 2 * max_shell + 1;
+  uint32_t const num_offsets = std::pow(shell_width, D);
+  LOG_DEBUG("max_shell:", max_shell, "num_offsets:", num_offsets);
+
+  // offsets[i * D:(i + 1) * D] sorted by the shell
+  std::vector<int> shells(num_offsets), offsets(num_offsets * D);
+  std::vector<uint32_t> shell_ends(max_shell + 1, 0);
+  {
+    std::vector<uint32_t> order(num_offsets);
+    std::iota(order.begin(), order.end(), 0);
+    for (uint32_t i = 0; i < num_offsets; ++i) {
+      uint32_t curr = i;
+      for (uint32_t j = 0; j < D; ++j) {
+        shells[i] = std::max(shells[i], std::abs(int(curr % shell_width) -
+                                                 max_shell));
+        curr /= shell_width;
+      }
+      ++shell_ends[shells[i]];
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      return shells[a] < shells[b];
+    });
+    std::partial_sum(shell_ends.begin(), shell_ends.end(), shell_ends.begin());
+    for (uint32_t i = 0; i < num_offsets; ++i) {
+      uint32_t curr = order[i];
+      for (uint32_t j = 0; j < D; ++j) {
+        offsets[i * D + j] = int(curr % shell_width) - max_shell;
+        curr /= shell_width;
+      }
+    }
+  }
+
+  const size_t N = 2 * omp_get_max_threads();
+  const size_t stride = (num_query + N - 1) / N;
+
+  // neighbors of each chunk in the order of the queries
+  std::vector<std::vector<neighbor_type>> chunk_neighbors(N);
+  std::vector<int64_t> row_sizes(num_query + 1, 0);
+
+#pragma omp parallel for
+  for (uint32_t n = 0; n < N; n++) {
+    // temporary variables for each thread
+    std::vector<coordinate_type> curr_vec(coordinate_size), lb(coordinate_size);
+    coordinate<coordinate_type> curr_coordinate(curr_vec.data());
+    std::vector<neighbor_type> candidates;
+
+    for (auto i = stride * n;
+         i < std::min<uint64_t>((n + 1) * stride, uint64_t(num_query)); ++i) {
+      Dtype const *p_curr_query = p_query + i * coordinate_size;
+      // batch index
+      curr_vec[0] = std::lroundf(p_curr_query[0]);
+      for (uint32_t j = 1; j < coordinate_size; ++j) {
+        lb[j] = tensor_stride[j - 1] *
+                std::floor(p_curr_query[j] / tensor_stride[j - 1]);
+      }
+
+      candidates.clear();
+      for (int shell = 0; shell <= max_shell; ++shell) {
+        for (uint32_t o = shell == 0 ? 0 : shell_ends[shell - 1];
+             o < shell_ends[shell]; ++o) {
+          Dtype dist2 = 0;
+          for (uint32_t j = 1; j < coordinate_size; ++j) {
+            curr_vec[j] =
+                lb[j] + offsets[o * D + j - 1] * int(tensor_stride[j - 1]);
+            Dtype const diff = p_curr_query[j] - curr_vec[j];
+            dist2 += diff * diff;
+          }
+          if (dist2 > radius * radius)
+            continue;
+          const auto iter_in = in_map.find(curr_coordinate);
+          if (iter_in != in_map.end())
+            candidates.emplace_back(std::sqrt(dist2), iter_in->second);
+        }
 
-    std::copy_n(in_maps[i].data(), max_num,
-                &final_in_map.template data_ptr<int>()[final_begin]);
-    std::copy_n(out_maps[i].data(), max_num,
-                &final_out_map.template data_ptr<int>()[final_begin]);
-    std::copy_n(weights[i].data(), max_num,
-                final_weights.template data_ptr<Dtype>() + final_begin);
+        // the next shell is farther than shell * min_stride
+        if (max_num_neighbors > 0 && candidates.size() >= max_num_neighbors) {
+          std::nth_element(candidates.begin(),
+                           candidates.begin() + max_num_neighbors - 1,
+                           candidates.end());
+          if (candidates[max_num_neighbors - 1].first <= shell * min_stride)
+            break;
+        }
+      }
 
-    final_begin += max_num;
+      if (max_num_neighbors > 0 && candidates.size() > max_num_neighbors) {
+        std::nth_element(candidates.begin(),
+                         candidates.begin() + max_num_neighbors - 1,
+                         candidates.end());
+        candidates.resize(max_num_neighbors);
+      }
+      std::sort(candidates.begin(), candidates.end());
+      row_sizes[i + 1] = candidates.size();
+      chunk_neighbors[n].insert(chunk_neighbors[n].end(), candidates.begin(),
+                                candidates.end());
+    }
   }
-  return {final_in_map, final_out_map, final_weights};
+
+  std::partial_sum(row_sizes.begin(), row_sizes.end(), row_sizes.begin());
+  int64_t const total_num_neighbors = row_sizes[num_query];
+
+  auto final_offsets = torch::empty(
+      {int64_t(num_query) + 1},
+      torch::TensorOptions().dtype(torch::kInt64).requires_grad(false));
+  auto final_rows = torch::empty(
+      {total_num_neighbors},
+      torch::TensorOptions().dtype(torch::kInt64).requires_grad(false));
+  auto final_distances = torch::empty(
+      {total_num_neighbors},
+      torch::TensorOptions().dtype(float_type).requires_grad(false));
+
+  std::copy(row_sizes.begin(), row_sizes.end(),
+            final_offsets.template data_ptr<int64_t>());
+  int64_t *p_rows = final_rows.template data_ptr<int64_t>();
+  Dtype *p_distances = final_distances.template data_ptr<Dtype>();
+
+#pragma omp parallel for
+  for (uint32_t n = 0; n < N; n++) {
+    if (stride * n >= num_query)
+      continue;
+    int64_t curr_begin = row_sizes[stride * n];
+    for (auto const &neighbor : chunk_neighbors[n]) {
+      p_distances[curr_begin] = neighbor.first;
+      p_rows[curr_begin] = neighbor.second;
+      ++curr_begin;
+    }
+  }
+  return {final_offsets, final_rows, final_distances};
 }
 
 } // namespace detail
@@ -436,6 +624,54 @@ public:
     return stride_map;
   }
 
+  /*
+   * @brief strided maps of successive strides and the parent row of each row
+   * of the previous level. Each level strides the unique coordinates of the
+   * previous level in parallel, and the parents come from the insertions, so
+   * no level is probed again.
+   */
+  std::vector<std::pair<self_type, index_vector_type>>
+  stride_hierarchy(std::vector<stride_type> const &strides) const {
+    std::vector<std::pair<self_type, index_vector_type>> levels;
+    // the levels must not move while the next level reads them
+    levels.reserve(strides.size());
+    std::vector<coordinate_type> strided_coordinates;
+    self_type const *p_prev = this;
+    for (auto const &stride : strides) {
+      ASSERT(stride.size() == m_coordinate_size - 1, "Invalid stride", stride);
+      size_type const N = p_prev->size();
+      auto const out_tensor_stride =
+          detail::stride_tensor_stride(p_prev->m_tensor_stride, stride);
+      coordinate_type const *p_coordinates = p_prev->const_coordinate_data();
+      strided_coordinates.resize(N * m_coordinate_size);
+#pragma omp parallel for
+      for (int64_t i = 0; i < (int64_t)N; ++i) {
+        coordinate_type const *p_src = p_coordinates + i * m_coordinate_size;
+        coordinate_type *p_dst =
+            strided_coordinates.data() + i * m_coordinate_size;
+        p_dst[0] = p_src[0];
+        for (index_type j = 0; j < m_coordinate_size - 1; ++j)
+          p_dst[j + 1] =
+              std::floor((float)p_src[j + 1] / out_tensor_stride[j]) *
+              out_tensor_stride[j];
+      }
+
+      self_type out_map(N, m_coordinate_size, out_tensor_stride,
+                        base_type::m_byte_allocator);
+      index_vector_type parents(N);
+      index_type c = 0;
+      for (index_type i = 0; i < N; ++i) {
+        auto result = out_map.insert(
+            key_type(strided_coordinates.data() + i * m_coordinate_size), c);
+        parents[i] = result.first->second;
+        c += result.second;
+      }
+      levels.emplace_back(std::move(out_map), std::move(parents));
+      p_prev = &levels.back().first;
+    }
+    return levels;
+  }
+
   /*****************************************************************************
    * Map generation
    ****************************************************************************/
@@ -513,28 +749,96 @@ public:
   }
 
   /*
-   * @brief generate a new coordinate map that only keeps coordinates with true
-   * keep mask
+   * @brief rows with true keep mask in increasing order. The row of the i-th
+   * kept coordinate is found with a parallel exclusive prefix sum over the
+   * mask.
    */
-  self_type prune(bool const *keep_begin, bool const *keep_end) const {
+  index_vector_type prune_rows(bool const *keep_begin,
+                               bool const *keep_end) const {
     ASSERT(keep_end - keep_begin == size(), "Invalid range for pruning");
 
-    // Over estimate the reserve size to be size();
-    self_type pruned_map(size(), m_coordinate_size, base_type::m_tensor_stride,
+    index_type const N = size();
+    index_type const num_chunks = std::max<index_type>(
+        1, std::min<index_type>(omp_get_max_threads(), N / 4096));
+    index_type const chunk_size = (N + num_chunks - 1) / num_chunks;
+
+    std::vector<index_type> offsets(num_chunks + 1, 0);
+#pragma omp parallel for num_threads(num_chunks)
+    for (index_type n = 0; n < num_chunks; ++n) {
+      bool const *p_begin = keep_begin + std::min(N, n * chunk_size);
+      bool const *p_end = keep_begin + std::min(N, (n + 1) * chunk_size);
+      offsets[n + 1] = std::count(p_begin, p_end, true);
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    index_vector_type rows(offsets[num_chunks]);
+#pragma omp parallel for num_threads(num_chunks)
+    for (index_type n = 0; n < num_chunks; ++n) {
+      index_type curr_row = offsets[n];
+      index_type const end = std::min(N, (n + 1) * chunk_size);
+      for (index_type i = n * chunk_size; i < end; ++i) {
+        if (keep_begin[i])
+          rows[curr_row++] = i;
+      }
+    }
+    return rows;
+  }
+
+  /*
+   * @brief generate a new coordinate map with the coordinates of the rows.
+   * The row i of the new map is the row rows[i] of this map.
+   */
+  self_type prune(index_vector_type const &rows) const {
+    size_type const N = rows.size();
+    self_type pruned_map(N, m_coordinate_size, base_type::m_tensor_stride,
                          base_type::m_byte_allocator);
 
-    index_type c = 0;
-    for (auto const &kv : m_map) {
-      // Use the row index defined
-      if (keep_begin[kv.second]) {
-        auto result = pruned_map.insert(kv.first, c);
-        c += result.second;
-      }
+    coordinate_type const *p_src = base_type::const_coordinate_data();
+    coordinate_type *p_dst = pruned_map.coordinate_data();
+#pragma omp parallel for
+    for (int64_t i = 0; i < (int64_t)N; ++i) {
+      std::copy_n(p_src + rows[i] * m_coordinate_size, m_coordinate_size,
+                  p_dst + i * m_coordinate_size);
+    }
+
+    // coordinates are unique; insert without copying them again
+    for (index_type i = 0; i < N; ++i) {
+      pruned_map.m_map.insert(value_type(
+          coordinate<coordinate_type>{p_dst + i * m_coordinate_size}, i));
     }
     LOG_DEBUG("size:", pruned_map.size(), "capacity:", pruned_map.capacity());
     return pruned_map;
   }
 
+  /*
+   * @brief generate a new coordinate map that only keeps coordinates with true
+   * keep mask
+   */
+  self_type prune(bool const *keep_begin, bool const *keep_end) const {
+    return prune(prune_rows(keep_begin, keep_end));
+  }
+
+  /*
+   * @brief the row in the other map of each row of this map, or
+   * std::numeric_limits<index_type>::max() if the coordinate is not in the
+   * other map. The other map is only read, so the rows are probed in parallel.
+   */
+  index_vector_type find_rows(self_type const &other) const {
+    index_type const N = size();
+    index_vector_type rows(N);
+
+    coordinate_type const *p_coordinate = base_type::const_coordinate_data();
+#pragma omp parallel for
+    for (int64_t i = 0; i < (int64_t)N; ++i) {
+      auto const iter = other.find(coordinate<coordinate_type>(
+          p_coordinate + i * m_coordinate_size));
+      rows[i] = iter == other.m_map.cend()
+                    ? std::numeric_limits<index_type>::max()
+                    : iter->second;
+    }
+    return rows;
+  }
+
   self_type merge(const self_type &other) const {
     std::vector<std::reference_wrapper<self_type>> maps{*this, other};
     // maps.push_back(*this);
@@ -563,6 +867,37 @@ public:
     return merged_map;
   }
 
+  /*
+   * @brief merge the maps and return the merged row of each row of the maps.
+   *
+   * The merged row of an existing coordinate is returned by the insertion, so
+   * no second lookup pass over the merged map is required.
+   */
+  std::pair<self_type, std::vector<index_vector_type>>
+  merge_rows(const std::vector<std::reference_wrapper<self_type>> &maps) const {
+    size_t all_size = std::accumulate(
+        maps.begin(), maps.end(), 0,
+        [](size_t sum, const self_type &map) { return sum + map.size(); });
+    self_type merged_map(all_size, m_coordinate_size,
+                         base_type::m_tensor_stride,
+                         base_type::m_byte_allocator);
+    std::vector<index_vector_type> merged_rows;
+    merged_rows.reserve(maps.size());
+
+    index_type c = 0;
+    for (self_type const &map : maps) {
+      index_vector_type rows(map.size());
+      for (auto const &kv : map.m_map) {
+        auto result = merged_map.insert(kv.first, c);
+        rows[kv.second] = result.first->second;
+        c += result.second;
+      }
+      merged_rows.push_back(std::move(rows));
+    }
+
+    return std::make_pair(std::move(merged_map), std::move(merged_rows));
+  }
+
   /*****************************************************************************
    * Kernel map
    ****************************************************************************/
@@ -721,40 +1056,62 @@ public:
     return std::make_pair(move(in_maps), move(out_maps));
   }
 
-  cpu_kernel_map origin_map(self_type const &origin_coordinate_map) const {
-    // generate an in-out (kernel) map that maps all input points in the same
-    // voxel to strided output voxel.
-    ASSERT(std::all_of(origin_coordinate_map.get_tensor_stride().begin(),
-                       origin_coordinate_map.get_tensor_stride().end(),
-                       [](auto const &i) { return i == 0; }),
-           "Invalid origin tensor stride",
-           origin_coordinate_map.get_tensor_stride());
-
-    size_type const in_size = size();
-    size_type const out_size = origin_coordinate_map.size();
-    LOG_DEBUG("Generate origin_map with in NNZ:", in_size,
-              "out NNZ:", out_size);
-    ASSERT(in_size > out_size, "Invalid out_coordinate_map");
-
-    std::vector<std::pair<index_type, index_type>> in_out(in_size);
+  /*
+   * @brief the parent (strided output) row of each input row.
+   *
+   * Every input row maps to exactly one output row in a stride map. Each
+   * input row writes its own slot, so no output slot needs to be claimed.
+   */
+  index_vector_type
+  stride_parent_map(self_type const &out_coordinate_map,
+                    stride_type const &out_tensor_stride) const {
+    LOG_DEBUG("Generate stride_parent_map with in NNZ:", size(),
+              "out NNZ:", out_coordinate_map.size(),
+              "out_tensor_stride:", out_tensor_stride);
+    index_vector_type parents(size());
 
-    // compute the chunk size per thread.
-    // There's a trade-off between the thread initialization overhead and the
-    // job sizes. If some jobs finish earlier than others due to imbalance in
-    // hash distribution, these threads will be idle.
-    size_t const in_map_num_elements = m_map.capacity();
+    const size_t in_map_num_elements = m_map.capacity();
     size_t N = 2 * omp_get_max_threads();
-    size_t const stride = (in_map_num_elements + N - 1) / N;
+    const size_t stride = (in_map_num_elements + N - 1) / N;
     N = (in_map_num_elements + stride - 1) / stride;
-    LOG_DEBUG("kernel map with", N, "chunks.");
 
-    size_type num_used = 0;
 #pragma omp parallel for
     for (index_type n = 0; n < N; ++n) {
-      index_type curr_index_begin;
       std::vector<coordinate_type> dst(m_coordinate_size);
-      std::for_each(dst.begin(), dst.end(), [](auto &i) { i = 0; });
+      for (auto iter_in = m_map.begin(stride * n);
+           iter_in.num_steps() <
+           std::min(stride, in_map_num_elements - n * stride);
+           ++iter_in) {
+        detail::stride_coordinate<coordinate_type>(iter_in->first, dst,
+                                                   out_tensor_stride);
+        const auto iter_out =
+            out_coordinate_map.find(coordinate<coordinate_type>(dst.data()));
+        ASSERT(iter_out != out_coordinate_map.m_map.cend(),
+               "Invalid out_coordinate_map");
+        parents[iter_in->second] = iter_out->second;
+      }
+    }
+
+    return parents;
+  }
 
+  /*
+   * @brief the origin (batch) row of each row.
+   */
+  index_vector_type
+  origin_parent_map(self_type const &origin_coordinate_map) const {
+    LOG_DEBUG("Generate origin_parent_map with in NNZ:", size(),
+              "out NNZ:", origin_coordinate_map.size());
+    index_vector_type parents(size());
+
+    const size_t in_map_num_elements = m_map.capacity();
+    size_t N = 2 * omp_get_max_threads();
+    const size_t stride = (in_map_num_elements + N - 1) / N;
+    N = (in_map_num_elements + stride - 1) / stride;
+
+#pragma omp parallel for
+    for (index_type n = 0; n < N; ++n) {
+      std::vector<coordinate_type> dst(m_coordinate_size, 0);
       for (auto iter_in = m_map.begin(stride * n);
            iter_in.num_steps() <
            std::min(stride, in_map_num_elements - n * stride);
@@ -764,22 +1121,25 @@ public:
             origin_coordinate_map.find(coordinate<coordinate_type>(dst.data()));
         ASSERT(iter_origin != origin_coordinate_map.m_map.cend(),
                "Invalid origin_coordinate_map");
-        index_type origin_row_index = iter_origin->second;
-
-#pragma omp atomic capture
-        {
-          curr_index_begin = num_used;
-          num_used += 1;
-        }
-
-        in_out[curr_index_begin] =
-            std::make_pair(iter_in->second, origin_row_index);
+        parents[iter_in->second] = iter_origin->second;
       }
     }
 
-    // Decomposed kernel map
-    auto batch_indices = origin_coordinate_map.batch_indices();
-    return cpu_kernel_map(in_out, batch_indices);
+    return parents;
+  }
+
+  cpu_kernel_map origin_map(self_type const &origin_coordinate_map) const {
+    // generate an in-out (kernel) map that maps all input points in the same
+    // voxel to strided output voxel.
+    ASSERT(std::all_of(origin_coordinate_map.get_tensor_stride().begin(),
+                       origin_coordinate_map.get_tensor_stride().end(),
+                       [](auto const &i) { return i == 0; }),
+           "Invalid origin tensor stride",
+           origin_coordinate_map.get_tensor_stride());
+
+    // Decomposed kernel map by the origin row
+    return cpu_kernel_map(origin_parent_map(origin_coordinate_map),
+                          origin_coordinate_map.size());
   }
 
   /*****************************************************************************
@@ -820,6 +1180,38 @@ public:
     }
   }
 
+  /*
+   * Given continuous query points, return the neighbors within the radius in
+   * CSR format (offsets, rows, distances). max_num_neighbors = 0 returns all
+   * neighbors within the radius.
+   */
+  std::vector<at::Tensor>
+  neighbor_query(at::Tensor const &queries, double const radius,
+                 uint32_t const max_num_neighbors) const {
+    ASSERT(queries.dim() == 2, "Invalid queries dimension");
+    ASSERT(queries.size(1) == m_coordinate_size, "Invalid queries size");
+    ASSERT(radius > 0, "Invalid radius:", radius);
+
+    switch (queries.scalar_type()) {
+    case at::ScalarType::Double:
+      return detail::neighbor_query_kernel<coordinate_type, double, map_type>(
+          queries.size(0),                     //
+          m_coordinate_size,                   //
+          queries.template data_ptr<double>(), //
+          m_map,                               //
+          base_type::m_tensor_stride, radius, max_num_neighbors);
+    case at::ScalarType::Float:
+      return detail::neighbor_query_kernel<coordinate_type, float, map_type>(
+          queries.size(0),                    //
+          m_coordinate_size,                  //
+          queries.template data_ptr<float>(), //
+          m_map,                              //
+          base_type::m_tensor_stride, radius, max_num_neighbors);
+    default:
+      ASSERT(false, "Unsupported float type");
+    }
+  }
+
   template <typename coordinate_field_type>
   std::pair<at::Tensor, at::Tensor>
   field_map(coordinate_field_type const *p_tfield,
@@ -1064,6 +1456,33 @@ public:
     return origin_map;
   }
 
+  /*
+   * @brief the origin (batch) row of each row.
+   */
+  std::vector<index_type>
+  origin_parent_map(coordinate_map_type const &origin_coordinate_map) const {
+    LOG_DEBUG("Generate origin_parent_map with in NNZ:", size(),
+              "out NNZ:", origin_coordinate_map.size());
+    std::vector<index_type> parents(size());
+    coordinate_field_type const *const p_tfield = const_coordinate_data();
+
+#pragma omp parallel
+    {
+      std::vector<coordinate_int_type> dst(m_coordinate_size, 0);
+#pragma omp for
+      for (int64_t i = 0; i < (int64_t)size(); ++i) {
+        dst[0] = p_tfield[i * m_coordinate_size];
+        const auto iter_origin = origin_coordinate_map.find(
+            coordinate<coordinate_int_type>(dst.data()));
+        ASSERT(iter_origin != origin_coordinate_map.cend(),
+               "Invalid origin_coordinate_map");
+        parents[i] = iter_origin->second;
+      }
+    }
+
+    return parents;
+  }
+
   cpu_kernel_map
   origin_map(coordinate_map_type const &origin_coordinate_map) const {
     // generate an in-out (kernel) map that maps all input points in the same
@@ -1074,63 +1493,9 @@ public:
            "Invalid origin tensor stride",
            origin_coordinate_map.get_tensor_stride());
 
-    size_type const in_size = size();
-    size_type const out_size = origin_coordinate_map.size();
-    LOG_DEBUG("Generate origin_map with in NNZ:", in_size,
-              "out NNZ:", out_size);
-    ASSERT(in_size > out_size, "Invalid out_coordinate_map");
-
-    std::vector<std::pair<index_type, index_type>> in_out(in_size);
-
-    // compute the chunk size per thread.
-    // There's a trade-off between the thread initialization overhead and the
-    // job sizes. If some jobs finish earlier than others due to imbalance in
-    // hash distribution, these threads will be idle.
-    size_t const in_map_num_elements = size();
-    size_t N = 2 * omp_get_max_threads();
-    size_t const stride = (in_map_num_elements + N - 1) / N;
-    N = (in_map_num_elements + stride - 1) / stride;
-    LOG_DEBUG("kernel map with", N, "chunks", stride, "stride");
-    coordinate_field_type const *const p_tfield = const_coordinate_data();
-    size_type num_used = 0;
-#pragma omp parallel for
-    for (index_type n = 0; n < N; ++n) {
-      index_type curr_index_begin;
-      std::vector<coordinate_int_type> dst(m_coordinate_size);
-      std::for_each(dst.begin(), dst.end(), [](auto &i) { i = 0; });
-      // LOG_DEBUG(n, "th chunk contains",
-      //           std::min((n + 1) * stride, in_map_num_elements) - n * stride,
-      //           "elements");
-
-      for (size_t i = stride * n;
-           i < std::min((n + 1) * stride, in_map_num_elements); ++i) {
-        dst[0] = p_tfield[i * m_coordinate_size];
-        // LOG_DEBUG(i, "th row batch index", dst[0]);
-        const auto iter_origin = origin_coordinate_map.find(
-            coordinate<coordinate_int_type>(dst.data()));
-        ASSERT(iter_origin != origin_coordinate_map.cend(),
-               "Invalid origin_coordinate_map");
-        index_type origin_row_index = iter_origin->second;
-
-#pragma omp atomic capture
-        {
-          curr_index_begin = num_used;
-          num_used += 1;
-        }
-
-        in_out[curr_index_begin] = std::make_pair(i, origin_row_index);
-      }
-    }
-
-    // #ifdef DEBUG
-    //     LOG_DEBUG("Kernel map");
-    //     for (auto iter : in_out) {
-    //       std::cout << iter.first << ":" << iter.second << "\n";
-    //     }
-    // #endif
-    // Decomposed kernel map
-    auto batch_indices = origin_coordinate_map.batch_indices();
-    return cpu_kernel_map(in_out, batch_indices);
+    // Decomposed kernel map by the origin row
+    return cpu_kernel_map(origin_parent_map(origin_coordinate_map),
+                          origin_coordinate_map.size());
   }
 
   inline size_type size() const noexcept { return m_size; }
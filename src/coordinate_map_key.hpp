@@ -97,7 +97,7 @@ public:
     m_key_set = true;
   }
 
-  coordinate_map_key_type get_key() const {
+  coordinate_map_key_type const &get_key() const {
     ASSERT(is_key_set(), "Key not set");
     return m_key;
   }
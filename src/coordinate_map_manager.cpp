@@ -31,6 +31,11 @@
 #include "utils.hpp"
 
 #include <pybind11/pybind11.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <numeric>
 #include <string>
 #include <unordered_map>
 
@@ -70,8 +75,8 @@ struct insert_and_map_functor<coordinate_type, coordinate_field_type,
         p_coordinate, p_coordinate + N * coordinate_size);
     LOG_DEBUG("mapping size:", map_inverse_map.first.size());
 
-    // insert moves map
-    THRUST_CHECK(manager.insert(map_key, map));
+    // insert moves map and may rename map_key on a collision
+    manager.insert_unique(map_key, map);
 
     auto const &mapping = map_inverse_map.first;
     auto const &inverse_mapping = map_inverse_map.second;
@@ -120,7 +125,134 @@ struct insert_field_functor<
     THRUST_CHECK(map.insert(p_coordinate, p_coordinate + N * coordinate_size));
 
     LOG_DEBUG("insert map with tensor_stride", map_key.first);
-    manager.insert_field_map(map_key, map);
+    manager.insert_unique_field_map(map_key, map);
+  }
+};
+
+template <typename coordinate_type, typename coordinate_field_type>
+struct insert_dense_functor<coordinate_type, coordinate_field_type,
+                            std::allocator, CoordinateMapCPU> {
+
+  std::tuple<at::Tensor, at::Tensor, at::Tensor>
+  operator()(coordinate_map_key_type &map_key, at::Tensor const &th_dense,
+             default_types::index_type const channel_dim,
+             CoordinateMapManager<coordinate_type, coordinate_field_type,
+                                  std::allocator, CoordinateMapCPU> &manager) {
+    LOG_DEBUG("insert dense");
+    using index_type = default_types::index_type;
+    int64_t const ndim = th_dense.dim();
+    int64_t const nchannel = th_dense.size(channel_dim);
+    index_type const coordinate_size = ndim - 1;
+    auto const &tensor_stride = map_key.first;
+
+    // View the dense tensor as [outer, C, inner]. Removing the channel axis
+    // keeps the row-major order of all other axes, so a flat position
+    // p = o * inner + i unravels directly over the non-channel shape.
+    std::vector<int64_t> shape;
+    int64_t outer = 1, inner = 1;
+    for (int64_t d = 0; d < ndim; ++d) {
+      if (d < channel_dim)
+        outer *= th_dense.size(d);
+      else if (d > channel_dim)
+        inner *= th_dense.size(d);
+      if (d != channel_dim)
+        shape.push_back(th_dense.size(d));
+    }
+    int64_t const num_positions = outer * inner;
+
+    // Chunk the positions, count non-zero positions per chunk and fill each
+    // chunk from its exclusive prefix sum.
+    int64_t num_chunks = 2 * omp_get_max_threads();
+    int64_t const stride =
+        std::max<int64_t>((num_positions + num_chunks - 1) / num_chunks, 1);
+    num_chunks = (num_positions + stride - 1) / stride;
+    std::vector<int64_t> chunk_offsets(num_chunks + 1, 0);
+    std::vector<uint8_t> nonzero(num_positions);
+
+    at::Tensor th_coordinate, th_feature, th_position;
+    AT_DISPATCH_FLOATING_TYPES(
+        th_dense.scalar_type(), "insert_dense_cpu", [&] {
+          scalar_t const *p_dense = th_dense.data_ptr<scalar_t>();
+
+#pragma omp parallel for
+          for (int64_t k = 0; k < num_chunks; ++k) {
+            int64_t const end = std::min(num_positions, (k + 1) * stride);
+            int64_t count = 0;
+            for (int64_t p = k * stride; p < end; ++p) {
+              scalar_t const *p_curr =
+                  p_dense + (p / inner) * nchannel * inner + p % inner;
+              uint8_t is_nonzero = 0;
+              for (int64_t c = 0; c < nchannel; ++c) {
+                if (p_curr[c * inner] != 0) {
+                  is_nonzero = 1;
+                  break;
+                }
+              }
+              nonzero[p] = is_nonzero;
+              count += is_nonzero;
+            }
+            chunk_offsets[k + 1] = count;
+          }
+
+          for (int64_t k = 0; k < num_chunks; ++k)
+            chunk_offsets[k + 1] += chunk_offsets[k];
+          int64_t const N = chunk_offsets[num_chunks];
+          LOG_DEBUG("number of non-zero positions:", N);
+
+          th_coordinate = torch::empty(
+              {N, (int64_t)coordinate_size},
+              torch::TensorOptions().requires_grad(false).dtype(torch::kInt));
+          th_feature = torch::empty({N, nchannel}, th_dense.options());
+          th_position = torch::empty(
+              {N},
+              torch::TensorOptions().requires_grad(false).dtype(torch::kInt64));
+          coordinate_type *p_coordinate =
+              th_coordinate.data_ptr<coordinate_type>();
+          scalar_t *p_feature = th_feature.data_ptr<scalar_t>();
+          int64_t *p_position = th_position.data_ptr<int64_t>();
+
+#pragma omp parallel for
+          for (int64_t k = 0; k < num_chunks; ++k) {
+            int64_t const end = std::min(num_positions, (k + 1) * stride);
+            int64_t row = chunk_offsets[k];
+            for (int64_t p = k * stride; p < end; ++p) {
+              if (!nonzero[p])
+                continue;
+              // unravel the position, batch index first
+              coordinate_type *p_curr_coordinate =
+                  p_coordinate + row * coordinate_size;
+              int64_t rem = p;
+              for (int64_t d = coordinate_size - 1; d > 0; --d) {
+                p_curr_coordinate[d] =
+                    (rem % shape[d]) * tensor_stride[d - 1];
+                rem /= shape[d];
+              }
+              p_curr_coordinate[0] = rem;
+
+              scalar_t const *p_curr =
+                  p_dense + (p / inner) * nchannel * inner + p % inner;
+              for (int64_t c = 0; c < nchannel; ++c)
+                p_feature[row * nchannel + c] = p_curr[c * inner];
+              p_position[row] = p;
+              ++row;
+            }
+          }
+        });
+
+    // Positions of a dense grid are unique. Insert without the remapping.
+    int64_t const N = th_coordinate.size(0);
+    coordinate_type const *p_coordinate =
+        th_coordinate.data_ptr<coordinate_type>();
+    auto map = CoordinateMapCPU<coordinate_type, std::allocator>(
+        N, coordinate_size, map_key.first);
+    map.insert(p_coordinate, p_coordinate + N * coordinate_size);
+    LOG_DEBUG("dense map size:", map.size());
+
+    // insert moves map and may rename map_key on a collision
+    manager.insert_unique(map_key, map);
+
+    return std::make_tuple(std::move(th_coordinate), std::move(th_feature),
+                           std::move(th_position));
   }
 };
 
@@ -145,6 +277,7 @@ py::object CoordinateMapManager<coordinate_type, coordinate_field_type,
     insert_field(at::Tensor const &coordinates,
                  default_types::stride_type const tensor_stride,
                  std::string const string_id) {
+  thread_scope const scope(threads());
 
   torch::TensorArg arg_coordinate(coordinates, "coordinates", 0);
   torch::CheckedFrom c = "initialize";
@@ -165,13 +298,8 @@ py::object CoordinateMapManager<coordinate_type, coordinate_field_type,
          "The coordinate dimension (coordinate_size - 1):", coordinate_size - 1,
          " must match the size of tensor stride:", ArrToString(tensor_stride));
 
-  // generate the map_key
+  // generate the map_key. The insertion renames a taken key.
   coordinate_map_key_type map_key = std::make_pair(tensor_stride, string_id);
-  if (m_field_coordinates.find(map_key) != m_field_coordinates.end()) {
-    LOG_DEBUG("CoordinateMapKey collision detected:", map_key,
-              "generating new string id.");
-    map_key = get_random_string_id(tensor_stride, string_id);
-  }
 
   LOG_DEBUG("initializing a map with tensor stride:", map_key.first,
             "string id:", map_key.second);
@@ -180,6 +308,7 @@ py::object CoordinateMapManager<coordinate_type, coordinate_field_type,
                                TemplatedAllocator, CoordinateMapType,
                                field_map_type>()(map_key, coordinates, *this);
 
+  py::gil_scoped_acquire acquire;
   py::object py_key = py::cast(new CoordinateMapKey(coordinate_size, map_key));
 
   return py_key;
@@ -201,6 +330,7 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
         CoordinateMapKey const *p_in_field_map_key,
         default_types::stride_type const sparse_tensor_stride,
         std::string const sparse_tensor_string_id) {
+  thread_scope const scope(threads());
   auto const coordinate_size = p_in_field_map_key->get_coordinate_size();
   // Basic assertions
   ASSERT(coordinate_size - 1 == sparse_tensor_stride.size(),
@@ -209,9 +339,7 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
          ArrToString(sparse_tensor_stride));
 
   // Find coordinate field
-  auto const it = m_field_coordinates.find(p_in_field_map_key->get_key());
-  ASSERT(it != m_field_coordinates.end(), ERROR_MAP_NOT_FOUND);
-  auto const &field_map = it->second;
+  auto const &field_map = this->field_map(p_in_field_map_key->get_key());
 
   auto options = torch::TensorOptions().dtype(torch::kInt).requires_grad(false);
 
@@ -227,7 +355,7 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
   // generate the map_key
   coordinate_map_key_type map_key =
       std::make_pair(sparse_tensor_stride, sparse_tensor_string_id);
-  if (m_coordinate_maps.find(map_key) != m_coordinate_maps.end()) {
+  if (exists(map_key)) {
     LOG_DEBUG("CoordinateMapKey collision detected:", map_key,
               "generating new string id.");
     map_key =
@@ -253,13 +381,17 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
       std::pair<coordinate_map_key_type, coordinate_map_key_type>{
           p_in_field_map_key->get_key(), map_key};
 
-  auto result = m_field_to_sparse_maps.insert(
-      std::pair<
-          const std::pair<coordinate_map_key_type, coordinate_map_key_type>,
-          const std::pair<at::Tensor, at::Tensor>>{field_to_sparse_map_key,
-                                                   map_inverse_map});
-  LOG_DEBUG("field to sparse tensor map insertion", result.second);
+  {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    auto result = m_field_to_sparse_maps.insert(
+        std::pair<
+            const std::pair<coordinate_map_key_type, coordinate_map_key_type>,
+            const std::pair<at::Tensor, at::Tensor>>{field_to_sparse_map_key,
+                                                     map_inverse_map});
+    LOG_DEBUG("field to sparse tensor map insertion", result.second);
+  }
 
+  py::gil_scoped_acquire acquire;
   py::object py_key = py::cast(new CoordinateMapKey(coordinate_size, map_key));
 
   return std::make_pair(py_key, map_inverse_map);
@@ -280,6 +412,7 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
                             CoordinateMapKey const *p_sparse_key) const {
   auto key = std::pair<coordinate_map_key_type, coordinate_map_key_type>{
       p_field_key->get_key(), p_sparse_key->get_key()};
+  std::lock_guard<std::mutex> lock(m_cache_mutex);
   auto it = m_field_to_sparse_maps.find(key);
   ASSERT(it != m_field_to_sparse_maps.end(),
          "Field To Sparse Map doesn't exist");
@@ -306,13 +439,8 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
          "!=", p_out_sparse_map_key->get_coordinate_size());
 
   // Find coordinate field
-  auto const it_field = m_field_coordinates.find(p_in_field_map_key->get_key());
-  ASSERT(it_field != m_field_coordinates.end(), ERROR_MAP_NOT_FOUND);
-  auto const &field_map = it_field->second;
-  auto const it_sparse =
-      m_coordinate_maps.find(p_out_sparse_map_key->get_key());
-  ASSERT(it_sparse != m_coordinate_maps.end(), ERROR_MAP_NOT_FOUND);
-  auto const &sparse_map = it_sparse->second;
+  auto const &field_map = this->field_map(p_in_field_map_key->get_key());
+  auto const &sparse_map = coordinate_map(p_out_sparse_map_key->get_key());
 
   auto options = torch::TensorOptions().dtype(torch::kInt).requires_grad(false);
 
@@ -332,12 +460,15 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
       std::pair<coordinate_map_key_type, coordinate_map_key_type>{
           p_in_field_map_key->get_key(), p_out_sparse_map_key->get_key()};
 
-  auto result = m_field_to_sparse_maps.insert(
-      std::pair<
-          const std::pair<coordinate_map_key_type, coordinate_map_key_type>,
-          const std::pair<at::Tensor, at::Tensor>>{field_to_sparse_map_key,
-                                                   map_inverse_map});
-  LOG_DEBUG("field to sparse tensor map insertion", result.second);
+  {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    auto result = m_field_to_sparse_maps.insert(
+        std::pair<
+            const std::pair<coordinate_map_key_type, coordinate_map_key_type>,
+            const std::pair<at::Tensor, at::Tensor>>{field_to_sparse_map_key,
+                                                     map_inverse_map});
+    LOG_DEBUG("field to sparse tensor map insertion", result.second);
+  }
 
   return map_inverse_map;
 }
@@ -350,12 +481,13 @@ template <typename coordinate_type, typename coordinate_field_type,
           template <typename C> class TemplatedAllocator,
           template <typename T, template <typename Q> class A>
           class CoordinateMapType>
-std::pair<py::object, std::pair<at::Tensor, at::Tensor>>
+std::pair<coordinate_map_key_type, std::pair<at::Tensor, at::Tensor>>
 CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
                      CoordinateMapType>::
     insert_and_map(at::Tensor const &coordinate,
                    default_types::stride_type const tensor_stride,
                    std::string const string_id) {
+  thread_scope const scope(threads());
 
   torch::TensorArg arg_coordinate(coordinate, "coordinates", 0);
   torch::CheckedFrom c = "initialize";
@@ -375,13 +507,8 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
          "The coordinate dimension (coordinate_size - 1):", coordinate_size - 1,
          " must match the size of tensor stride:", ArrToString(tensor_stride));
 
-  // generate the map_key
+  // generate the map_key. The insertion renames a taken key.
   coordinate_map_key_type map_key = std::make_pair(tensor_stride, string_id);
-  if (m_coordinate_maps.find(map_key) != m_coordinate_maps.end()) {
-    LOG_DEBUG("CoordinateMapKey collision detected:", map_key,
-              "generating new string id.");
-    map_key = get_random_string_id(tensor_stride, string_id);
-  }
 
   LOG_DEBUG("initializing a map with tensor stride:", map_key.first,
             "string id:", map_key.second);
@@ -392,10 +519,60 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
           map_key, coordinate, *this);
 
   LOG_DEBUG("map_inverse_map initialized");
-  py::object py_key = py::cast(new CoordinateMapKey(coordinate_size, map_key));
-  LOG_DEBUG("py key initialized");
 
-  return std::make_pair(py_key, map_inverse_map);
+  return std::make_pair(map_key, map_inverse_map);
+}
+
+/*
+ * dense: a dense tensor with the batch axis first
+ * channel_dim: the channel axis of the dense tensor
+ * tensor_strides: current tensor strides this coords will be initializeds
+ */
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+std::pair<py::object, std::tuple<at::Tensor, at::Tensor, at::Tensor>>
+CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
+                     CoordinateMapType>::
+    insert_dense(at::Tensor const &dense, index_type const channel_dim,
+                 default_types::stride_type const tensor_stride,
+                 std::string const string_id) {
+  thread_scope const scope(threads());
+
+  torch::TensorArg arg_dense(dense, "dense", 0);
+  torch::CheckedFrom c = "insert_dense";
+  torch::checkContiguous(c, arg_dense);
+  torch::checkBackend(c, arg_dense.tensor,
+                      detail::is_cpu_coordinate_map<CoordinateMapType>::value
+                          ? torch::Backend::CPU
+                          : torch::Backend::CUDA);
+
+  ASSERT(dense.dim() > 2, "The dense tensor must have at least one spatial "
+                          "dimension. dense.dim():",
+         dense.dim());
+  ASSERT(channel_dim > 0 && channel_dim < dense.dim(),
+         "Invalid channel dimension:", channel_dim,
+         ". The first dimension must be the batch dimension.");
+
+  auto const coordinate_size = (index_type)dense.dim() - 1;
+  ASSERT(coordinate_size - 1 == tensor_stride.size(),
+         "The coordinate dimension (coordinate_size - 1):", coordinate_size - 1,
+         " must match the size of tensor stride:", ArrToString(tensor_stride));
+
+  // generate the map_key. The insertion renames a taken key.
+  coordinate_map_key_type map_key = std::make_pair(tensor_stride, string_id);
+
+  LOG_DEBUG("initializing a dense map with tensor stride:", map_key.first,
+            "string id:", map_key.second);
+  auto const coordinate_feature_position =
+      detail::insert_dense_functor<coordinate_type, coordinate_field_type,
+                                   TemplatedAllocator, CoordinateMapType>()(
+          map_key, dense, channel_dim, *this);
+
+  py::gil_scoped_acquire acquire;
+  py::object py_key = py::cast(new CoordinateMapKey(coordinate_size, map_key));
+  return std::make_pair(py_key, coordinate_feature_position);
 }
 
 // stride
@@ -408,6 +585,15 @@ std::pair<coordinate_map_key_type, bool> CoordinateMapManager<
     CoordinateMapType>::stride(coordinate_map_key_type const &in_map_key,
                                stride_type const &kernel_stride,
                                std::string const string_id) {
+  if (string_id == "") {
+    if (auto const *p_entry = match_plan_entry([&](plan_entry const &entry) {
+          return entry.p_kernel_map == nullptr &&
+                 std::get<0>(entry.key) == in_map_key &&
+                 std::get<3>(entry.key) == kernel_stride;
+        }))
+      return std::make_pair(std::get<1>(p_entry->key), false);
+  }
+
   ASSERT(exists(in_map_key), ERROR_MAP_NOT_FOUND);
   // check if the key exists.
   LOG_DEBUG("In tensor stride:", in_map_key.first,
@@ -420,10 +606,16 @@ std::pair<coordinate_map_key_type, bool> CoordinateMapManager<
   if (!exists_out_map) {
     // operator[] required mapped_type(), which is not defined.
     // ASSERTION already checked that in_map_key exists.
-    map_type const &in_map = m_coordinate_maps.find(in_map_key)->second;
+    map_type const &in_map = coordinate_map(in_map_key);
+    thread_scope const scope(threads());
     map_type out_map = in_map.stride(kernel_stride);
     insert(out_map_key, out_map);
   }
+  if (m_plan_mode == plan_mode::CAPTURE && string_id == "")
+    m_plan.push_back(
+        {std::make_tuple(in_map_key, out_map_key, stride_type{}, kernel_stride,
+                         stride_type{}, RegionType::HYPER_CUBE, false, false),
+         nullptr});
   // (key, new map generated flag)
   return std::make_pair(out_map_key, !exists_out_map);
 }
@@ -439,6 +631,7 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
                   cpu_kernel_region<coordinate_type> &kernel,
                   stride_type const &out_tensor_stride,
                   bool const expand_coordinates) {
+  thread_scope const scope(threads());
   ASSERT(exists(in_map_key), ERROR_MAP_NOT_FOUND);
   LOG_DEBUG("stride_region");
   // kernel.tensor_stride must be set to out tensor stride.
@@ -452,7 +645,7 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
   if (!exists_out_map || expand_coordinates) {
     LOG_DEBUG("Create a new stride region map for tensor_stride:",
               out_tensor_stride);
-    map_type const &in_map = m_coordinate_maps.find(in_map_key)->second;
+    map_type const &in_map = coordinate_map(in_map_key);
     map_type out_map = in_map.stride_region(kernel, out_tensor_stride);
     if (exists_out_map) {
       LOG_DEBUG("coordinate map exists for tensor_stride:", out_tensor_stride);
@@ -472,10 +665,14 @@ template <typename coordinate_type, typename coordinate_field_type,
 std::pair<coordinate_map_key_type, bool>
 CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
                      CoordinateMapType>::origin() {
-  ASSERT(m_coordinate_maps.size() > 0, "No coordinate map found");
+  size_type coordinate_size;
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
+    ASSERT(m_coordinate_maps.size() > 0, "No coordinate map found");
+    coordinate_size = m_coordinate_maps.begin()->second.coordinate_size();
+  }
   // check if the key exists.
-  map_type const &random_map = m_coordinate_maps.begin()->second;
-  stride_type origin_tensor_stride(random_map.coordinate_size() - 1);
+  stride_type origin_tensor_stride(coordinate_size - 1);
   std::for_each(origin_tensor_stride.begin(), origin_tensor_stride.end(),
                 [](auto &i) { i = 0; });
   LOG_DEBUG("origin tensor stride:", origin_tensor_stride);
@@ -486,10 +683,13 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
     LOG_DEBUG("origin coordinate map not found");
     map_type const *p_min_coordinate_map{nullptr};
     size_type min_size = std::numeric_limits<size_type>::max();
-    for (auto map_it = m_coordinate_maps.begin();
-         map_it != m_coordinate_maps.end(); ++map_it) {
-      if (min_size > map_it->second.size()) {
-        p_min_coordinate_map = &(map_it->second);
+    {
+      std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
+      for (auto map_it = m_coordinate_maps.begin();
+           map_it != m_coordinate_maps.end(); ++map_it) {
+        if (min_size > map_it->second.size()) {
+          p_min_coordinate_map = &(map_it->second);
+        }
       }
     }
 
@@ -514,10 +714,14 @@ template <typename coordinate_type, typename coordinate_field_type,
 std::pair<coordinate_map_key_type, bool>
 CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
                      CoordinateMapType>::origin_field() {
-  ASSERT(m_field_coordinates.size() > 0, "No coordinate map found");
+  size_type coordinate_size;
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
+    ASSERT(m_field_coordinates.size() > 0, "No coordinate map found");
+    coordinate_size = m_field_coordinates.begin()->second.coordinate_size();
+  }
   // check if the key exists.
-  field_map_type const &random_map = m_field_coordinates.begin()->second;
-  stride_type origin_tensor_stride(random_map.coordinate_size() - 1);
+  stride_type origin_tensor_stride(coordinate_size - 1);
   std::for_each(origin_tensor_stride.begin(), origin_tensor_stride.end(),
                 [](auto &i) { i = 0; });
   LOG_DEBUG("origin tensor stride:", origin_tensor_stride);
@@ -529,10 +733,13 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
     LOG_DEBUG("origin coordinate map not found");
     field_map_type const *p_min_coordinate_map{nullptr};
     size_type min_size = std::numeric_limits<size_type>::max();
-    for (auto map_it = m_field_coordinates.begin();
-         map_it != m_field_coordinates.end(); ++map_it) {
-      if (min_size > map_it->second.size()) {
-        p_min_coordinate_map = &(map_it->second);
+    {
+      std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
+      for (auto map_it = m_field_coordinates.begin();
+           map_it != m_field_coordinates.end(); ++map_it) {
+        if (min_size > map_it->second.size()) {
+          p_min_coordinate_map = &(map_it->second);
+        }
       }
     }
 
@@ -559,18 +766,25 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
                                                    &in_key,
                                                bool const *keep_begin,
                                                bool const *keep_end) {
-  auto const map_it = m_coordinate_maps.find(in_key);
-  ASSERT(map_it != m_coordinate_maps.end(), ERROR_MAP_NOT_FOUND);
+  map_type const &in_map = coordinate_map(in_key);
 
   // create a coordinate_map_key
+  // The insertion renames a taken key
   coordinate_map_key_type map_key = std::make_pair(in_key.first, "pruned");
-  if (m_coordinate_maps.find(map_key) != m_coordinate_maps.end()) {
-    map_key = get_random_string_id(map_key.first, map_key.second);
-  }
 
-  map_type pruned_map = map_it->second.prune(keep_begin, keep_end);
-  LOG_DEBUG("pruned map with size:", pruned_map.size(), " inserted");
-  insert(map_key, pruned_map);
+  auto pruned = detail::prune_functor<coordinate_type, TemplatedAllocator,
+                                      CoordinateMapType>()(in_map, keep_begin,
+                                                           keep_end);
+  LOG_DEBUG("pruned map with size:", pruned.first.size(), " inserted");
+  insert_unique(map_key, pruned.first);
+
+  if (detail::is_cpu_coordinate_map<CoordinateMapType>::value) {
+    // cache the pruned to input rows for stride_parent_map(pruned, in)
+    insert_parent_map(
+        std::pair<coordinate_map_key_type, coordinate_map_key_type>{map_key,
+                                                                    in_key},
+        std::move(pruned.second));
+  }
 
   return map_key;
 }
@@ -604,6 +818,119 @@ struct stride_map_functor<coordinate_type, std::allocator, CoordinateMapCPU,
   }
 };
 
+template <typename coordinate_type>
+struct stride_hierarchy_functor<coordinate_type, std::allocator,
+                                CoordinateMapCPU, cpu_kernel_map> {
+  using map_type = CoordinateMapCPU<coordinate_type, std::allocator>;
+
+  std::vector<std::tuple<map_type, cpu_kernel_map, cpu_parent_map>>
+  operator()(map_type const &in_map,
+             std::vector<default_types::stride_type> const &strides) {
+    auto levels = in_map.stride_hierarchy(strides);
+    std::vector<std::tuple<map_type, cpu_kernel_map, cpu_parent_map>> results;
+    results.reserve(levels.size());
+    for (auto &level : levels) {
+      auto &parents = level.second;
+      cpu_kernel_map stride_map;
+      stride_map.first.emplace_back(parents.size());
+      std::iota(stride_map.first[0].begin(), stride_map.first[0].end(), 0);
+      stride_map.second.push_back(parents);
+      auto const out_nrows = level.first.size();
+      results.emplace_back(std::move(level.first), std::move(stride_map),
+                           cpu_parent_map(std::move(parents), out_nrows));
+    }
+    return results;
+  }
+};
+
+template <typename coordinate_type>
+struct stride_parent_map_functor<coordinate_type, std::allocator,
+                                 CoordinateMapCPU> {
+
+  cpu_parent_map
+  operator()(CoordinateMapCPU<coordinate_type, std::allocator> const &in_map,
+             CoordinateMapCPU<coordinate_type, std::allocator> const &out_map) {
+    return cpu_parent_map(
+        in_map.stride_parent_map(out_map, out_map.get_tensor_stride()),
+        out_map.size());
+  }
+};
+
+template <typename coordinate_type>
+struct prune_functor<coordinate_type, std::allocator, CoordinateMapCPU> {
+
+  std::pair<CoordinateMapCPU<coordinate_type, std::allocator>, cpu_parent_map>
+  operator()(CoordinateMapCPU<coordinate_type, std::allocator> const &in_map,
+             bool const *keep_begin, bool const *keep_end) {
+    auto rows = in_map.prune_rows(keep_begin, keep_end);
+    auto pruned_map = in_map.prune(rows);
+    // the source row of each pruned row is its parent in the input map
+    return std::make_pair(std::move(pruned_map),
+                          cpu_parent_map(std::move(rows), in_map.size()));
+  }
+};
+
+template <typename coordinate_type>
+struct intersection_functor<coordinate_type, std::allocator, CoordinateMapCPU> {
+
+  std::pair<CoordinateMapCPU<coordinate_type, std::allocator>,
+            std::vector<cpu_parent_map>>
+  operator()(CoordinateMapCPU<coordinate_type, std::allocator> const &map0,
+             CoordinateMapCPU<coordinate_type, std::allocator> const &map1) {
+    using index_type = default_types::index_type;
+    index_type const N = map0.size();
+    // hash-join: probe map1 with every row of map0 in parallel
+    auto const rows_in_map1 = map0.find_rows(map1);
+    std::unique_ptr<bool[]> keep(new bool[N]);
+#pragma omp parallel for
+    for (int64_t i = 0; i < (int64_t)N; ++i)
+      keep[i] = rows_in_map1[i] != std::numeric_limits<index_type>::max();
+
+    auto rows0 = map0.prune_rows(keep.get(), keep.get() + N);
+    std::vector<index_type> rows1(rows0.size());
+#pragma omp parallel for
+    for (int64_t i = 0; i < (int64_t)rows0.size(); ++i)
+      rows1[i] = rows_in_map1[rows0[i]];
+
+    auto intersection_map = map0.prune(rows0);
+    std::vector<cpu_parent_map> parent_maps;
+    parent_maps.emplace_back(std::move(rows0), N);
+    parent_maps.emplace_back(std::move(rows1), map1.size());
+    return std::make_pair(std::move(intersection_map), std::move(parent_maps));
+  }
+};
+
+template <typename coordinate_type>
+struct merge_functor<coordinate_type, std::allocator, CoordinateMapCPU> {
+
+  std::pair<CoordinateMapCPU<coordinate_type, std::allocator>,
+            std::vector<cpu_parent_map>>
+  operator()(std::vector<std::reference_wrapper<
+                 CoordinateMapCPU<coordinate_type, std::allocator>>> const
+                 &maps) {
+    auto merged = maps[0].get().merge_rows(maps);
+    default_types::index_type const merged_nrows = merged.first.size();
+    // the merged row of each input row is its parent in the merged map
+    std::vector<cpu_parent_map> parent_maps;
+    parent_maps.reserve(maps.size());
+    for (auto &rows : merged.second)
+      parent_maps.emplace_back(std::move(rows), merged_nrows);
+    return std::make_pair(std::move(merged.first), std::move(parent_maps));
+  }
+};
+
+template <typename coordinate_type, typename in_map_type>
+struct origin_parent_map_functor<coordinate_type, std::allocator,
+                                 CoordinateMapCPU, in_map_type> {
+
+  cpu_parent_map operator()(
+      in_map_type const &in_map,
+      CoordinateMapCPU<coordinate_type, std::allocator> const &origin_map) {
+    return cpu_parent_map(in_map.origin_parent_map(origin_map),
+                          origin_map.size());
+  }
+};
+
 // a partial specialization functor for kernel map in/out swap
 template <> struct swap_in_out_map_functor<cpu_kernel_map> {
 
@@ -637,9 +964,8 @@ CoordinateMapManager<
     CoordinateMapType>::kernel_map(CoordinateMapKey const *p_in_map_key,
                                    CoordinateMapKey const *p_out_map_key) {
   // when kernel has volume 1
-  auto const &map_it = m_coordinate_maps.find(p_in_map_key->get_key());
-  ASSERT(map_it != m_coordinate_maps.end(), ERROR_MAP_NOT_FOUND);
-  auto const coordinate_size = map_it->second.coordinate_size();
+  auto const coordinate_size =
+      coordinate_map(p_in_map_key->get_key()).coordinate_size();
   auto const one_vec = detail::ones(coordinate_size - 1);
   auto const offset = torch::empty(
       {0}, torch::TensorOptions().dtype(torch::kInt32).requires_grad(false));
@@ -669,6 +995,19 @@ CoordinateMapManager<
                                    RegionType::Type const region_type,
                                    at::Tensor const &offset, bool is_transpose,
                                    bool is_pool) {
+  if (auto const *p_entry = match_plan_entry([&](plan_entry const &entry) {
+        auto const &key = entry.key;
+        return entry.p_kernel_map != nullptr &&
+               std::get<0>(key) == p_in_map_key->get_key() &&
+               std::get<1>(key) == p_out_map_key->get_key() &&
+               std::get<2>(key) == kernel_size &&
+               std::get<3>(key) == kernel_stride &&
+               std::get<4>(key) == kernel_dilation &&
+               std::get<5>(key) == region_type &&
+               std::get<6>(key) == is_transpose && std::get<7>(key) == is_pool;
+      }))
+    return *p_entry->p_kernel_map;
+
   ASSERT(region_type != RegionType::CUSTOM, "Not implemented yet.");
   if (region_type == RegionType::CUSTOM)
     ASSERT(offset.is_cuda() ==
@@ -688,138 +1027,304 @@ CoordinateMapManager<
                       kernel_size, kernel_stride, kernel_dilation, // kernels
                       region_type, is_transpose, is_pool);
 
-  const auto &kernel_map_iter = m_kernel_maps.find(kernel_map_key);
   LOG_DEBUG("set kernel map key for kernel map:", p_in_map_key->get_key(), "->",
             p_out_map_key->get_key());
 
-  if (kernel_map_iter == m_kernel_maps.end()) {
-    // create a kernel map if it exists
-    auto const in_map_it = m_coordinate_maps.find(p_in_map_key->get_key());
-    auto const out_map_it = m_coordinate_maps.find(p_out_map_key->get_key());
+  kernel_map_type const *p_kernel_map = find_kernel_map(kernel_map_key);
+  while (p_kernel_map == nullptr) {
+    // The first thread that misses builds the kernel map. The others,
+    // including the callers of a prefetched map, wait on the pending build.
+    std::promise<void> built;
+    std::shared_future<void> pending;
+    {
+      std::unique_lock<std::shared_timed_mutex> lock(m_kernel_map_mutex);
+      auto const it = m_kernel_maps.find(kernel_map_key);
+      if (it != m_kernel_maps.end()) {
+        p_kernel_map = &it->second;
+        break;
+      }
+      auto const pending_it = m_pending_kernel_maps.find(kernel_map_key);
+      if (pending_it != m_pending_kernel_maps.end())
+        pending = pending_it->second;
+      else
+        m_pending_kernel_maps.emplace(kernel_map_key,
+                                      built.get_future().share());
+    }
+
+    if (pending.valid()) {
+      LOG_DEBUG("waiting on the pending kernel map");
+      pending.get();
+      p_kernel_map = find_kernel_map(kernel_map_key);
+      continue;
+    }
 
-    ASSERT(in_map_it != m_coordinate_maps.end(), "in_map", ERROR_MAP_NOT_FOUND);
-    ASSERT(out_map_it != m_coordinate_maps.end(), "out_map",
-           ERROR_MAP_NOT_FOUND);
+    try {
+      p_kernel_map = &build_kernel_map(kernel_map_key, offset);
+    } catch (...) {
+      built.set_exception(std::current_exception());
+      throw;
+    }
+    built.set_value();
+  }
 
-    auto const &in_map = in_map_it->second;
-    auto const &out_map = out_map_it->second;
+  if (m_plan_mode == plan_mode::CAPTURE)
+    m_plan.push_back({kernel_map_key, p_kernel_map});
+  return *p_kernel_map;
+}
+
+/*
+ * Build and cache the kernel map of a pending key, and release the pending
+ * entry.
+ */
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+typename CoordinateMapManager<coordinate_type, coordinate_field_type,
+                              TemplatedAllocator,
+                              CoordinateMapType>::kernel_map_type const &
+CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
+                     CoordinateMapType>::
+    build_kernel_map(kernel_map_key_type const &kernel_map_key,
+                     at::Tensor const &offset) {
+  thread_scope const scope(threads());
+  auto const release_pending = [this, &kernel_map_key]() {
+    std::unique_lock<std::shared_timed_mutex> lock(m_kernel_map_mutex);
+    m_pending_kernel_maps.erase(kernel_map_key);
+  };
+
+  kernel_map_type const *p_kernel_map;
+  try {
+    auto const &kernel_size = std::get<2>(kernel_map_key);
+    bool const is_transpose = std::get<6>(kernel_map_key);
+    bool const is_pool = std::get<7>(kernel_map_key);
+
+    auto const &in_map = coordinate_map(std::get<0>(kernel_map_key));
+    auto const &out_map = coordinate_map(std::get<1>(kernel_map_key));
 
     LOG_DEBUG("coordinate_size:", in_map.coordinate_size(),
               "in tensor_stride:", in_map.get_tensor_stride(),
               "out tensor_stride:", out_map.get_tensor_stride());
 
     // +1 for batch index
-    ASSERT(kernel_dim + 1 == in_map.coordinate_size(), "kernel size mismatch");
-    ASSERT(kernel_dim + 1 == out_map.coordinate_size(), "kernel size mismatch");
+    ASSERT(kernel_size.size() + 1 == in_map.coordinate_size(),
+           "kernel size mismatch");
+    ASSERT(kernel_size.size() + 1 == out_map.coordinate_size(),
+           "kernel size mismatch");
+
+    // Check first if the out2in kernel map exists
+    //
+    // Create temporary key for the flipped in/out
+    kernel_map_key_type const swapped_kernel_map_key = std::make_tuple(
+        std::get<1>(kernel_map_key), std::get<0>(kernel_map_key), // maps
+        kernel_size, std::get<3>(kernel_map_key), std::get<4>(kernel_map_key),
+        std::get<5>(kernel_map_key), false, is_pool);
+    kernel_map_type const *p_swapped_kernel_map =
+        is_transpose ? find_kernel_map(swapped_kernel_map_key) : nullptr;
 
-    // If either coordinate map is empty
     if (in_map.size() == 0 || out_map.size() == 0) {
-      return detail::empty_map_functor<coordinate_type, TemplatedAllocator,
-                                       CoordinateMapType, kernel_map_type>()();
+      // If either coordinate map is empty
+      p_kernel_map = &insert_kernel_map(
+          kernel_map_key,
+          detail::empty_map_functor<coordinate_type, TemplatedAllocator,
+                                    CoordinateMapType, kernel_map_type>()());
+    } else if (p_swapped_kernel_map != nullptr) {
+      // copy the in out maps from the existing maps
+      LOG_DEBUG("found existing kernel_map_key for transposed kernel map");
+      p_kernel_map = &insert_kernel_map(
+          kernel_map_key, detail::swap_in_out_map_functor<kernel_map_type>()(
+                              *p_swapped_kernel_map));
+    } else {
+      p_kernel_map = &insert_kernel_map(
+          kernel_map_key,
+          create_kernel_map(in_map, out_map, kernel_size,
+                            std::get<3>(kernel_map_key),
+                            std::get<4>(kernel_map_key),
+                            std::get<5>(kernel_map_key), offset, is_transpose,
+                            is_pool));
+      LOG_DEBUG("kernel_map saved");
     }
+  } catch (...) {
+    release_pending();
+    throw;
+  }
+  release_pending();
+  return *p_kernel_map;
+}
 
-    if (!is_transpose) {
-      if (is_pool && (kernel_stride == kernel_size)) {
-        LOG_DEBUG("generating stride_map");
-        auto const stride_map =
-            detail::stride_map_functor<coordinate_type, TemplatedAllocator,
-                                       CoordinateMapType, kernel_map_type>()(
-                in_map, out_map, out_map.get_tensor_stride());
-
-        m_kernel_maps[kernel_map_key] = std::move(stride_map);
-
-      } else {
-        LOG_DEBUG("generating kernel map");
-
-        // Default kernel map
-        LOG_DEBUG(
-            "kernel region with kernel: ",
-            PtrToString(kernel_size.data(), in_map.coordinate_size() - 1));
-        LOG_DEBUG(
-            "kernel region with dilation: ",
-            PtrToString(kernel_dilation.data(), in_map.coordinate_size() - 1));
-
-        auto kernel_region = cpu_kernel_region<coordinate_type>(
-            region_type,                       //
-            in_map.coordinate_size(),          //
-            in_map.get_tensor_stride().data(), //
-            kernel_size.data(),                //
-            kernel_dilation.data(),            //
-            0, offset.data_ptr<coordinate_type>(), offset.size(0));
-
-        auto const kernel_map =
-            detail::kernel_map_functor<coordinate_type, TemplatedAllocator,
-                                       CoordinateMapType, kernel_map_type>()(
-                in_map, out_map, m_kernel_map_mode, kernel_region);
-
-        LOG_DEBUG("kernel_map done");
-        m_kernel_maps[kernel_map_key] = std::move(kernel_map);
-        LOG_DEBUG("kernel_map saved");
-      }
-    } else { // is_transpose == true
-      // Check first if the out2in kernel map exists
-      //
-      // Create temporary key for the flipped in/out
-      kernel_map_key_type const swapped_kernel_map_key = std::make_tuple(
-          p_out_map_key->get_key(), p_in_map_key->get_key(), // maps
-          kernel_size, kernel_stride, kernel_dilation,       // kernels
-          region_type, false, is_pool);
-
-      // Check if the temporary key exists and return swapped in/out
-      if (m_kernel_maps.find(swapped_kernel_map_key) != m_kernel_maps.end()) {
-        // copy the in out maps from the existing maps
-        LOG_DEBUG("found existing kernel_map_key for transposed kernel map");
-        m_kernel_maps[kernel_map_key] =
-            detail::swap_in_out_map_functor<kernel_map_type>()(
-                m_kernel_maps[swapped_kernel_map_key]);
-      } else { // create in out kernel if it doesn't exist
-        LOG_DEBUG("No existing kernel_map_key for transposed kernel map");
-        if (is_pool && kernel_stride == kernel_size) {
-          // e.g. out_map has tensor stride 2 in_map has tensor stride 4.
-          // Thus, create a stride map from 2 to 4, out to in.
-          auto const stride_map =
-              detail::stride_map_functor<coordinate_type, TemplatedAllocator,
-                                         CoordinateMapType, kernel_map_type>()(
-                  out_map, in_map, in_map.get_tensor_stride());
-
-          // TODO Replace the kernel_map values to shared pointers.
-          m_kernel_maps[kernel_map_key] =
-              detail::swap_in_out_map_functor<kernel_map_type>()(stride_map);
-        } else {
-          // Default kernel map
-          auto kernel_region = cpu_kernel_region<coordinate_type>(
-              region_type,                        //
-              out_map.coordinate_size(),          //
-              out_map.get_tensor_stride().data(), //
-              kernel_size.data(),                 //
-              kernel_dilation.data(),             //
-              0, offset.data_ptr<coordinate_type>(), offset.size(0),
-              true // is_transpose
-          );
-
-          // out to in kernel map
-          auto const kernel_map =
-              detail::kernel_map_functor<coordinate_type, TemplatedAllocator,
-                                         CoordinateMapType, kernel_map_type>()(
-                  out_map, in_map, m_kernel_map_mode, kernel_region);
-
-          LOG_DEBUG("kernel_map done");
-          m_kernel_maps[kernel_map_key] =
-              detail::swap_in_out_map_functor<kernel_map_type>()(
-                  std::move(kernel_map));
-          LOG_DEBUG("kernel_map saved");
-        }
-      }
+/*
+ * Build a kernel map without touching the caches. Both maps must be non-empty.
+ */
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+typename CoordinateMapManager<coordinate_type, coordinate_field_type,
+                              TemplatedAllocator,
+                              CoordinateMapType>::kernel_map_type
+CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
+                     CoordinateMapType>::
+    create_kernel_map(map_type const &in_map, map_type const &out_map,
+                      stride_type const &kernel_size,
+                      stride_type const &kernel_stride,
+                      stride_type const &kernel_dilation,
+                      RegionType::Type const region_type,
+                      at::Tensor const &offset, bool is_transpose,
+                      bool is_pool) const {
+  if (!is_transpose) {
+    if (is_pool && (kernel_stride == kernel_size)) {
+      LOG_DEBUG("generating stride_map");
+      return detail::stride_map_functor<coordinate_type, TemplatedAllocator,
+                                        CoordinateMapType, kernel_map_type>()(
+          in_map, out_map, out_map.get_tensor_stride());
     }
+
+    LOG_DEBUG("generating kernel map");
+    // Default kernel map
+    LOG_DEBUG("kernel region with kernel: ",
+              PtrToString(kernel_size.data(), in_map.coordinate_size() - 1));
+    LOG_DEBUG(
+        "kernel region with dilation: ",
+        PtrToString(kernel_dilation.data(), in_map.coordinate_size() - 1));
+
+    auto kernel_region = cpu_kernel_region<coordinate_type>(
+        region_type,                       //
+        in_map.coordinate_size(),          //
+        in_map.get_tensor_stride().data(), //
+        kernel_size.data(),                //
+        kernel_dilation.data(),            //
+        0, offset.data_ptr<coordinate_type>(), offset.size(0));
+
+    return detail::kernel_map_functor<coordinate_type, TemplatedAllocator,
+                                      CoordinateMapType, kernel_map_type>()(
+        in_map, out_map, m_kernel_map_mode, kernel_region);
   }
-#ifdef DEBUG
-  else {
-    LOG_DEBUG("kernel map found");
+
+  // is_transpose == true
+  LOG_DEBUG("No existing kernel_map_key for transposed kernel map");
+  if (is_pool && kernel_stride == kernel_size) {
+    // e.g. out_map has tensor stride 2 in_map has tensor stride 4.
+    // Thus, create a stride map from 2 to 4, out to in.
+    auto const stride_map =
+        detail::stride_map_functor<coordinate_type, TemplatedAllocator,
+                                   CoordinateMapType, kernel_map_type>()(
+            out_map, in_map, in_map.get_tensor_stride());
+
+    // TODO Replace the kernel_map values to shared pointers.
+    return detail::swap_in_out_map_functor<kernel_map_type>()(stride_map);
   }
-#endif
 
-  // TODO check if it copies or moves the internal data
-  return m_kernel_maps[kernel_map_key];
+  // Default kernel map
+  auto kernel_region = cpu_kernel_region<coordinate_type>(
+      region_type,                        //
+      out_map.coordinate_size(),          //
+      out_map.get_tensor_stride().data(), //
+      kernel_size.data(),                 //
+      kernel_dilation.data(),             //
+      0, offset.data_ptr<coordinate_type>(), offset.size(0),
+      true // is_transpose
+  );
+
+  // out to in kernel map
+  auto kernel_map =
+      detail::kernel_map_functor<coordinate_type, TemplatedAllocator,
+                                 CoordinateMapType, kernel_map_type>()(
+          out_map, in_map, m_kernel_map_mode, kernel_region);
+
+  LOG_DEBUG("kernel_map done");
+  return detail::swap_in_out_map_functor<kernel_map_type>()(
+      std::move(kernel_map));
+}
+
+/*
+ * Enqueue a kernel map on the prefetch worker. Only the CPU kernel maps are
+ * built in the background; the others are left to kernel_map.
+ */
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+bool CoordinateMapManager<coordinate_type, coordinate_field_type,
+                          TemplatedAllocator, CoordinateMapType>::
+    prefetch_kernel_map(kernel_map_key_type const &kernel_map_key) {
+  // dropped for the GPU maps
+  if (!detail::is_cpu_coordinate_map<CoordinateMapType>::value)
+    return true;
+
+  auto const region_type = std::get<5>(kernel_map_key);
+  bool const is_transpose = std::get<6>(kernel_map_key);
+  ASSERT(region_type != RegionType::CUSTOM, "Not implemented yet.");
+  if (!exists(std::get<0>(kernel_map_key)) ||
+      !exists(std::get<1>(kernel_map_key)))
+    return false;
+  // left to kernel_map, which handles them without building a map
+  if (coordinate_map(std::get<0>(kernel_map_key)).size() == 0 ||
+      coordinate_map(std::get<1>(kernel_map_key)).size() == 0)
+    return true;
+  if (is_transpose &&
+      find_kernel_map(std::make_tuple(
+          std::get<1>(kernel_map_key), std::get<0>(kernel_map_key),
+          std::get<2>(kernel_map_key), std::get<3>(kernel_map_key),
+          std::get<4>(kernel_map_key), region_type, false,
+          std::get<7>(kernel_map_key))) != nullptr)
+    return true;
+
+  std::unique_lock<std::shared_timed_mutex> lock(m_kernel_map_mutex);
+  if (m_kernel_maps.find(kernel_map_key) != m_kernel_maps.end() ||
+      m_pending_kernel_maps.find(kernel_map_key) !=
+          m_pending_kernel_maps.end())
+    return true;
+
+  if (!m_prefetch_pool)
+    m_prefetch_pool.reset(new thread_pool(1));
+
+  // build_kernel_map releases the pending entry, which the callers of
+  // kernel_map wait on
+  m_pending_kernel_maps.emplace(
+      kernel_map_key,
+      m_prefetch_pool
+          ->enqueue([this, kernel_map_key] {
+            auto const offset =
+                torch::empty({0}, torch::TensorOptions()
+                                      .dtype(torch::kInt32)
+                                      .requires_grad(false));
+            build_kernel_map(kernel_map_key, offset);
+          })
+          .share());
+  return true;
+}
+
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+void CoordinateMapManager<coordinate_type, coordinate_field_type,
+                          TemplatedAllocator, CoordinateMapType>::
+    set_kernel_map_hints(std::vector<kernel_map_key_type> const &hints) {
+  {
+    std::lock_guard<std::mutex> lock(m_kernel_map_hint_mutex);
+    m_kernel_map_hints = hints;
+  }
+  dispatch_kernel_map_hints();
+}
+
+// enqueue the hints whose input and output maps exist
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+void CoordinateMapManager<coordinate_type, coordinate_field_type,
+                          TemplatedAllocator,
+                          CoordinateMapType>::dispatch_kernel_map_hints() {
+  std::lock_guard<std::mutex> lock(m_kernel_map_hint_mutex);
+  if (m_kernel_map_hints.empty())
+    return;
+  m_kernel_map_hints.erase(
+      std::remove_if(m_kernel_map_hints.begin(), m_kernel_map_hints.end(),
+                     [this](kernel_map_key_type const &hint) {
+                       return prefetch_kernel_map(hint);
+                     }),
+      m_kernel_map_hints.end());
 }
 
 namespace detail {
@@ -901,15 +1406,14 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
       origin_map_key(p_in_map_key->get_key());
   coordinate_map_key_type const origin_key = std::get<1>(kernel_map_key);
 
-  if (m_kernel_maps.find(kernel_map_key) == m_kernel_maps.end()) {
-    auto const key = origin().first;
-    auto const &origin_coordinate_map = m_coordinate_maps.find(key)->second;
-    auto origin_map = m_coordinate_maps.find(p_in_map_key->get_key())
-                          ->second.origin_map(origin_coordinate_map);
-    m_kernel_maps[kernel_map_key] = std::move(origin_map);
-  }
+  if (auto const *p_kernel_map = find_kernel_map(kernel_map_key))
+    return *p_kernel_map;
 
-  return m_kernel_maps[kernel_map_key];
+  auto const key = origin().first;
+  auto const &origin_coordinate_map = coordinate_map(key);
+  auto origin_map = coordinate_map(p_in_map_key->get_key())
+                        .origin_map(origin_coordinate_map);
+  return insert_kernel_map(kernel_map_key, std::move(origin_map));
 }
 
 template <typename coordinate_type, typename coordinate_field_type,
@@ -927,16 +1431,57 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
       origin_map_key(p_in_map_key->get_key());
   coordinate_map_key_type const origin_key = std::get<1>(kernel_map_key);
 
-  if (m_field_kernel_maps.find(kernel_map_key) == m_field_kernel_maps.end()) {
-    auto const key = origin_field().first;
-    auto const &origin_coordinate_map = m_coordinate_maps.find(key)->second;
-    auto origin_map = m_field_coordinates.find(p_in_map_key->get_key())
-                          ->second.origin_map(origin_coordinate_map);
-    m_field_kernel_maps[kernel_map_key] = std::move(origin_map);
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(m_kernel_map_mutex);
+    auto const it = m_field_kernel_maps.find(kernel_map_key);
+    if (it != m_field_kernel_maps.end())
+      return it->second;
   }
 
-  return m_field_kernel_maps[kernel_map_key];
+  auto const key = origin_field().first;
+  auto const &origin_coordinate_map = coordinate_map(key);
+  auto origin_map =
+      field_map(p_in_map_key->get_key()).origin_map(origin_coordinate_map);
+  std::unique_lock<std::shared_timed_mutex> lock(m_kernel_map_mutex);
+  return m_field_kernel_maps.emplace(kernel_map_key, std::move(origin_map))
+      .first->second;
 }
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+cpu_parent_map const &
+CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
+                     CoordinateMapType>::batch_segments(CoordinateMapKey const
+                                                            *p_in_map_key) {
+  bool const is_field = exists_field(p_in_map_key);
+  ASSERT(is_field || exists(p_in_map_key), ERROR_MAP_NOT_FOUND);
+
+  coordinate_map_key_type const origin_key =
+      is_field ? origin_field().first : origin().first;
+  auto const parent_map_key =
+      std::make_pair(p_in_map_key->get_key(), origin_key);
+  if (auto const *p_parent_map = find_parent_map(parent_map_key, is_field))
+    return *p_parent_map;
+
+  map_type const &origin_map = coordinate_map(origin_key);
+  LOG_DEBUG("Creating batch segments");
+  if (is_field) {
+    return insert_parent_map(
+        parent_map_key,
+        detail::origin_parent_map_functor<coordinate_type, TemplatedAllocator,
+                                          CoordinateMapType, field_map_type>()(
+            field_map(p_in_map_key->get_key()), origin_map),
+        true);
+  } else {
+    return insert_parent_map(
+        parent_map_key,
+        detail::origin_parent_map_functor<coordinate_type, TemplatedAllocator,
+                                          CoordinateMapType, map_type>()(
+            coordinate_map(p_in_map_key->get_key()), origin_map));
+  }
+}
+
 namespace detail {
 
 template <typename coordinate_type>
@@ -988,10 +1533,8 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
   ASSERT(exists(p_in_map_key), ERROR_MAP_NOT_FOUND);
   ASSERT(exists(p_strided_map_key), ERROR_MAP_NOT_FOUND);
 
-  map_type const &in_map =
-      m_coordinate_maps.find(p_in_map_key->get_key())->second;
-  map_type const &strided_map =
-      m_coordinate_maps.find(p_strided_map_key->get_key())->second;
+  map_type const &in_map = coordinate_map(p_in_map_key->get_key());
+  map_type const &strided_map = coordinate_map(p_strided_map_key->get_key());
 
   // Get tensor strides and find kernel stride size
   // Check if the kernel map key exists
@@ -1015,22 +1558,60 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
       RegionType::HYPER_CUBE /* region_type */, 0 /* is_transpose */,
       true /* is_pool */);
 
-  if (m_kernel_maps.find(kernel_map_key) == m_kernel_maps.end()) {
+  kernel_map_type const *p_kernel_map = find_kernel_map(kernel_map_key);
+  if (p_kernel_map == nullptr) {
     LOG_DEBUG("Creating stride kernel map with kernel size:",
               ArrToString(kernel_stride));
-    auto const stride_map =
+    auto stride_map =
         detail::stride_map_functor<coordinate_type, TemplatedAllocator,
                                    CoordinateMapType, kernel_map_type>()(
             in_map, strided_map, strided_map.get_tensor_stride());
 
-    m_kernel_maps[kernel_map_key] = std::move(stride_map);
+    p_kernel_map = &insert_kernel_map(kernel_map_key, std::move(stride_map));
   }
 
   // copy the kernel map to tensors
   return detail::stride_map2tensor_functor<coordinate_type, TemplatedAllocator,
                                            CoordinateMapType,
-                                           kernel_map_type>()(
-      m_kernel_maps[kernel_map_key]);
+                                           kernel_map_type>()(*p_kernel_map);
+}
+
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+cpu_parent_map const &
+CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
+                     CoordinateMapType>::
+    stride_parent_map(CoordinateMapKey const *p_in_map_key,
+                      CoordinateMapKey const *p_strided_map_key) {
+  ASSERT(exists(p_in_map_key), ERROR_MAP_NOT_FOUND);
+  ASSERT(exists(p_strided_map_key), ERROR_MAP_NOT_FOUND);
+
+  auto const parent_map_key =
+      std::make_pair(p_in_map_key->get_key(), p_strided_map_key->get_key());
+  if (auto const *p_parent_map = find_parent_map(parent_map_key))
+    return *p_parent_map;
+
+  map_type const &in_map = coordinate_map(p_in_map_key->get_key());
+  map_type const &strided_map = coordinate_map(p_strided_map_key->get_key());
+
+  auto const &in_map_stride = in_map.get_tensor_stride();
+  auto const &strided_map_stride = strided_map.get_tensor_stride();
+  for (index_type i = 0; i < in_map_stride.size(); ++i) {
+    ASSERT(strided_map_stride[i] % in_map_stride[i] == 0,
+           "The tensor stride of the strided map must be divisible by the "
+           "tensor stride of the input map. strided_map_stride:",
+           ArrToString(strided_map_stride),
+           " in_map_stride:", ArrToString(in_map_stride));
+  }
+
+  LOG_DEBUG("Creating stride parent map");
+  return insert_parent_map(
+      parent_map_key,
+      detail::stride_parent_map_functor<coordinate_type, TemplatedAllocator,
+                                        CoordinateMapType>()(in_map,
+                                                             strided_map));
 }
 
 template <typename coordinate_type, typename coordinate_field_type,
@@ -1044,7 +1625,7 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
   kernel_map_type const &kernel_map = origin_map(p_in_map_key);
 
   coordinate_map_key_type const origin_key = origin().first;
-  map_type const &origin_map = m_coordinate_maps.find(origin_key)->second;
+  map_type const &origin_map = coordinate_map(origin_key);
 
   return detail::origin_map_functor<coordinate_type, TemplatedAllocator,
                                     CoordinateMapType, kernel_map_type>()(
@@ -1062,7 +1643,7 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
   kernel_map_type const &kernel_map = origin_field_map(p_in_map_key);
 
   coordinate_map_key_type const origin_key = origin_field().first;
-  map_type const &origin_map = m_coordinate_maps.find(origin_key)->second;
+  map_type const &origin_map = coordinate_map(origin_key);
 
   return detail::origin_map_functor<coordinate_type, TemplatedAllocator,
                                     CoordinateMapType, kernel_map_type>()(
@@ -1079,9 +1660,349 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
                      CoordinateMapType>::
     interpolation_map_weight(at::Tensor const &tfield,
                              CoordinateMapKey const *p_in_map_key) {
+  thread_scope const scope(threads());
+  ASSERT(exists(p_in_map_key), ERROR_MAP_NOT_FOUND);
+  return coordinate_map(p_in_map_key->get_key())
+      .interpolation_map_weight(tfield);
+}
+
+namespace detail {
+
+template <typename coordinate_type>
+struct neighbor_query_functor<coordinate_type, std::allocator,
+                              CoordinateMapCPU> {
+
+  std::vector<at::Tensor>
+  operator()(CoordinateMapCPU<coordinate_type, std::allocator> const &map,
+             at::Tensor const &queries, double const radius,
+             default_types::index_type const max_num_neighbors) {
+    return map.neighbor_query(queries, radius, max_num_neighbors);
+  }
+};
+
+template <typename coordinate_type>
+struct crop_rows_functor<coordinate_type, std::allocator, CoordinateMapCPU> {
+  using map_type = CoordinateMapCPU<coordinate_type, std::allocator>;
+  using index_type = default_types::index_type;
+
+  std::vector<default_types::index_vector_type>
+  operator()(map_type const &in_map, map_type const &block_map,
+             cpu_parent_map const &block_parent_map, at::Tensor const &boxes) {
+    index_type const coordinate_size = in_map.coordinate_size();
+    index_type const D = coordinate_size - 1;
+    int64_t const num_boxes = boxes.size(0);
+    coordinate_type const *p_boxes = boxes.template data_ptr<coordinate_type>();
+    coordinate_type const *p_coordinates = in_map.const_coordinate_data();
+    auto const &block_stride = block_map.get_tensor_stride();
+
+    std::vector<default_types::index_vector_type> rows(num_boxes);
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t b = 0; b < num_boxes; ++b) {
+      coordinate_type const *p_box = p_boxes + b * (2 * D + 1);
+      coordinate_type const *p_lb = p_box + 1, *p_ub = p_box + 1 + D;
+      std::vector<coordinate_type> block(coordinate_size), block_lb(D),
+          block_ub(D);
+      block[0] = p_box[0];
+      bool empty = false;
+      for (index_type j = 0; j < D; ++j) {
+        block_lb[j] = std::floor((float)p_lb[j] / block_stride[j]) *
+                      block_stride[j];
+        block_ub[j] = std::floor((float)p_ub[j] / block_stride[j]) *
+                      block_stride[j];
+        empty |= p_lb[j] > p_ub[j];
+        block[j + 1] = block_lb[j];
+      }
+      if (empty)
+        continue;
+
+      auto &curr_rows = rows[b];
+      // visit the blocks that overlap the box
+      while (block[D] <= block_ub[D - 1]) {
+        auto const block_it =
+            block_map.find(coordinate<coordinate_type>(block.data()));
+        if (block_it != block_map.end()) {
+          index_type const block_row = block_it->second;
+          bool inside = true;
+          for (index_type j = 0; j < D; ++j)
+            inside &= block[j + 1] >= p_lb[j] &&
+                      block[j + 1] + coordinate_type(block_stride[j]) - 1 <=
+                          p_ub[j];
+          for (index_type k = block_parent_map.offsets[block_row];
+               k < block_parent_map.offsets[block_row + 1]; ++k) {
+            index_type const row = block_parent_map.children[k];
+            bool keep = inside;
+            if (!inside) {
+              coordinate_type const *p_coordinate =
+                  p_coordinates + row * coordinate_size + 1;
+              keep = true;
+              for (index_type j = 0; j < D; ++j)
+                keep &=
+                    p_coordinate[j] >= p_lb[j] && p_coordinate[j] <= p_ub[j];
+            }
+            if (keep)
+              curr_rows.push_back(row);
+          }
+        }
+
+        // next block
+        index_type j = 0;
+        for (; j < D - 1 && block[j + 1] + coordinate_type(block_stride[j]) >
+                                block_ub[j];
+             ++j)
+          block[j + 1] = block_lb[j];
+        block[j + 1] += block_stride[j];
+      }
+      std::sort(curr_rows.begin(), curr_rows.end());
+    }
+
+    return rows;
+  }
+};
+
+template <typename coordinate_type>
+struct crop_functor<coordinate_type, std::allocator, CoordinateMapCPU> {
+  using map_type = CoordinateMapCPU<coordinate_type, std::allocator>;
+
+  std::vector<std::pair<map_type, default_types::index_vector_type>>
+  operator()(map_type const &in_map, map_type const &block_map,
+             cpu_parent_map const &block_parent_map, at::Tensor const &boxes) {
+    auto rows = crop_rows_functor<coordinate_type, std::allocator,
+                                  CoordinateMapCPU>()(in_map, block_map,
+                                                      block_parent_map, boxes);
+
+    std::vector<std::pair<map_type, default_types::index_vector_type>> crops;
+    crops.reserve(rows.size());
+    for (auto &curr_rows : rows) {
+      auto crop_map = in_map.prune(curr_rows);
+      crops.emplace_back(std::move(crop_map), std::move(curr_rows));
+    }
+    return crops;
+  }
+};
+
+} // namespace detail
+
+// Neighbor query
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+std::vector<at::Tensor>
+CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
+                     CoordinateMapType>::
+    neighbor_query(at::Tensor const &queries,
+                   CoordinateMapKey const *p_in_map_key, double const radius,
+                   index_type const max_num_neighbors) {
+  thread_scope const scope(threads());
   ASSERT(exists(p_in_map_key), ERROR_MAP_NOT_FOUND);
-  return m_coordinate_maps.find(p_in_map_key->get_key())
-      ->second.interpolation_map_weight(tfield);
+  ASSERT(!queries.is_cuda(), "queries must be CPU");
+  ASSERT(queries.is_contiguous(), "queries must be contiguous");
+  return detail::neighbor_query_functor<coordinate_type, TemplatedAllocator,
+                                        CoordinateMapType>()(
+      coordinate_map(p_in_map_key->get_key()), queries, radius,
+      max_num_neighbors);
+}
+
+// Multi-resolution hierarchy
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+std::vector<py::object>
+CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
+                     CoordinateMapType>::
+    build_hierarchy(CoordinateMapKey const *p_in_map_key,
+                    std::vector<stride_type> const &strides) {
+  thread_scope const scope(threads());
+  ASSERT(exists(p_in_map_key), ERROR_MAP_NOT_FOUND);
+  coordinate_map_key_type in_key = p_in_map_key->get_key();
+  size_type const coordinate_size = in_key.first.size() + 1;
+
+  std::vector<coordinate_map_key_type> level_keys;
+  // reuse the existing levels
+  size_type num_existing = 0;
+  for (; num_existing < strides.size(); ++num_existing) {
+    coordinate_map_key_type const level_key(
+        detail::stride_tensor_stride(in_key.first, strides[num_existing]),
+        in_key.second);
+    if (!exists(level_key))
+      break;
+    level_keys.push_back(level_key);
+    in_key = level_key;
+  }
+
+  if (num_existing < strides.size()) {
+    auto levels = detail::stride_hierarchy_functor<
+        coordinate_type, TemplatedAllocator, CoordinateMapType,
+        kernel_map_type>()(
+        coordinate_map(in_key),
+        std::vector<stride_type>(strides.begin() + num_existing,
+                                 strides.end()));
+
+    auto stride_it = strides.begin() + num_existing;
+    for (auto &level : levels) {
+      auto const &kernel_stride = *stride_it++;
+      coordinate_map_key_type const level_key(
+          std::get<0>(level).get_tensor_stride(), in_key.second);
+      insert(level_key, std::get<0>(level));
+
+      // the stride map of the pooling with kernel_size == kernel_stride
+      kernel_map_key_type const kernel_map_key = std::make_tuple(
+          in_key, level_key, kernel_stride, kernel_stride,
+          detail::ones(coordinate_size - 1), RegionType::HYPER_CUBE,
+          false /* is_transpose */, true /* is_pool */);
+      insert_kernel_map(kernel_map_key, std::move(std::get<1>(level)));
+      if (detail::is_cpu_coordinate_map<CoordinateMapType>::value)
+        insert_parent_map(std::make_pair(in_key, level_key),
+                          std::move(std::get<2>(level)));
+
+      level_keys.push_back(level_key);
+      in_key = level_key;
+    }
+  }
+
+  py::gil_scoped_acquire acquire;
+  std::vector<py::object> keys;
+  for (auto const &level_key : level_keys)
+    keys.push_back(py::cast(new CoordinateMapKey(coordinate_size, level_key)));
+  return keys;
+}
+
+// Crop
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+coordinate_map_key_type
+CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
+                     CoordinateMapType>::
+    crop_block_index(CoordinateMapKey const *p_in_map_key,
+                     at::Tensor const &boxes, index_type const block_size) {
+  ASSERT(exists(p_in_map_key), ERROR_MAP_NOT_FOUND);
+  ASSERT(!boxes.is_cuda(), "boxes must be CPU");
+  ASSERT(boxes.is_contiguous(), "boxes must be contiguous");
+  ASSERT(boxes.scalar_type() == torch::kInt32, "boxes must be an int tensor");
+  ASSERT(block_size > 0, "Invalid block_size:", block_size);
+
+  coordinate_map_key_type const &in_key = p_in_map_key->get_key();
+  size_type const coordinate_size = in_key.first.size() + 1;
+  ASSERT(boxes.dim() == 2 && boxes.size(1) == 2 * coordinate_size - 1,
+         "boxes must be a (num_boxes, 2 * D + 1) matrix of (batch index, min "
+         "coordinates, max coordinates)");
+
+  // block index
+  return stride(in_key, stride_type(in_key.first.size(), block_size)).first;
+}
+
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+std::vector<at::Tensor>
+CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
+                     CoordinateMapType>::crop_rows(CoordinateMapKey const
+                                                       *p_in_map_key,
+                                                   at::Tensor const &boxes,
+                                                   index_type const
+                                                       block_size) {
+  auto const block_key = crop_block_index(p_in_map_key, boxes, block_size);
+  CoordinateMapKey const block_map_key(block_key.first, block_key.second);
+  cpu_parent_map const &block_parent_map =
+      stride_parent_map(p_in_map_key, &block_map_key);
+
+  auto const box_rows = detail::crop_rows_functor<
+      coordinate_type, TemplatedAllocator, CoordinateMapType>()(
+      coordinate_map(p_in_map_key->get_key()), coordinate_map(block_key),
+      block_parent_map, boxes);
+
+  std::vector<at::Tensor> rows;
+  for (auto const &curr_rows : box_rows) {
+    at::Tensor th_rows = torch::empty(
+        {(int64_t)curr_rows.size()},
+        torch::TensorOptions().dtype(torch::kInt64).requires_grad(false));
+    std::copy(curr_rows.begin(), curr_rows.end(),
+              th_rows.template data_ptr<int64_t>());
+    rows.push_back(std::move(th_rows));
+  }
+  return rows;
+}
+
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+std::pair<std::vector<py::object>, std::vector<at::Tensor>>
+CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
+                     CoordinateMapType>::crop(CoordinateMapKey const
+                                                  *p_in_map_key,
+                                              at::Tensor const &boxes,
+                                              index_type const block_size) {
+  coordinate_map_key_type const &in_key = p_in_map_key->get_key();
+  size_type const coordinate_size = in_key.first.size() + 1;
+  auto const block_key = crop_block_index(p_in_map_key, boxes, block_size);
+  CoordinateMapKey const block_map_key(block_key.first, block_key.second);
+  cpu_parent_map const &block_parent_map =
+      stride_parent_map(p_in_map_key, &block_map_key);
+
+  auto crops = detail::crop_functor<coordinate_type, TemplatedAllocator,
+                                    CoordinateMapType>()(
+      coordinate_map(in_key), coordinate_map(block_key), block_parent_map,
+      boxes);
+
+  std::vector<coordinate_map_key_type> crop_keys;
+  std::vector<at::Tensor> rows;
+  for (auto &crop : crops) {
+    auto const &crop_rows = crop.second;
+    at::Tensor th_rows = torch::empty(
+        {(int64_t)crop_rows.size()},
+        torch::TensorOptions().dtype(torch::kInt64).requires_grad(false));
+    std::copy(crop_rows.begin(), crop_rows.end(),
+              th_rows.template data_ptr<int64_t>());
+    rows.push_back(std::move(th_rows));
+
+    coordinate_map_key_type crop_key =
+        get_random_string_id(in_key.first, "crop");
+    insert_unique(crop_key, crop.first);
+    crop_keys.push_back(crop_key);
+  }
+
+  py::gil_scoped_acquire acquire;
+  std::vector<py::object> keys;
+  for (auto const &crop_key : crop_keys)
+    keys.push_back(py::cast(new CoordinateMapKey(coordinate_size, crop_key)));
+  return std::make_pair(std::move(keys), std::move(rows));
+}
+
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+std::vector<at::Tensor>
+CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
+                     CoordinateMapType>::
+    field_interpolation_map_weight(CoordinateMapKey const *p_field_map_key,
+                                   CoordinateMapKey const *p_in_map_key) {
+  thread_scope const scope(threads());
+  ASSERT(exists(p_in_map_key), ERROR_MAP_NOT_FOUND);
+  ASSERT(exists_field(p_field_map_key), ERROR_MAP_NOT_FOUND);
+
+  auto const key = std::pair<coordinate_map_key_type, coordinate_map_key_type>{
+      p_field_map_key->get_key(), p_in_map_key->get_key()};
+  {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    auto const it = m_field_interpolation_maps.find(key);
+    if (it != m_field_interpolation_maps.end())
+      return it->second;
+  }
+
+  LOG_DEBUG("field interpolation map not found. Generating one.");
+  auto const tfield = get_coordinate_field(p_field_map_key);
+  auto interpolation_map_weight =
+      coordinate_map(p_in_map_key->get_key()).interpolation_map_weight(tfield);
+  std::lock_guard<std::mutex> lock(m_cache_mutex);
+  return m_field_interpolation_maps
+      .insert({key, std::move(interpolation_map_weight)})
+      .first->second;
 }
 
 /*********************************/
@@ -1256,7 +2177,7 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
   stride_type merged_map_tensor_stride{map_keys[0].first};
   for (const auto &key : map_keys) {
     ASSERT(exists(key), ERROR_MAP_NOT_FOUND);
-    auto &map = m_coordinate_maps.find(key)->second;
+    auto &map = coordinate_map(key);
     maps.push_back(map);
     for (int k = 0; k < tensor_stride_size; ++k) {
       merged_map_tensor_stride[k] =
@@ -1267,12 +2188,56 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
   // Create a merged map with the smallest tensor stride
   coordinate_map_key_type merged_map_key =
       get_random_string_id(merged_map_tensor_stride, "merge");
-  map_type const &map = m_coordinate_maps.find(map_keys[0])->second;
-  map_type merged_map = map.merge(maps);
-  insert(merged_map_key, merged_map);
+  auto merged = detail::merge_functor<coordinate_type, TemplatedAllocator,
+                                      CoordinateMapType>()(maps);
+  insert_unique(merged_map_key, merged.first);
+
+  if (detail::is_cpu_coordinate_map<CoordinateMapType>::value) {
+    // cache the merged row of each input row for stride_parent_map(in, merged)
+    for (index_type i = 0; i < map_keys.size(); ++i) {
+      insert_parent_map(
+          std::pair<coordinate_map_key_type, coordinate_map_key_type>{
+              map_keys[i], merged_map_key},
+          std::move(merged.second[i]));
+    }
+  }
   return merged_map_key;
 }
 
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+coordinate_map_key_type
+CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
+                     CoordinateMapType>::
+    intersection(coordinate_map_key_type const &map_key0,
+                 coordinate_map_key_type const &map_key1) {
+  map_type const &map0 = coordinate_map(map_key0);
+  map_type const &map1 = coordinate_map(map_key1);
+
+  coordinate_map_key_type map_key =
+      get_random_string_id(map_key0.first, "intersection");
+  auto intersected =
+      detail::intersection_functor<coordinate_type, TemplatedAllocator,
+                                   CoordinateMapType>()(map0, map1);
+  LOG_DEBUG("intersection map with size:", intersected.first.size());
+  insert_unique(map_key, intersected.first);
+
+  if (detail::is_cpu_coordinate_map<CoordinateMapType>::value) {
+    // cache the input rows for stride_parent_map(intersection, in)
+    insert_parent_map(
+        std::pair<coordinate_map_key_type, coordinate_map_key_type>{map_key,
+                                                                    map_key0},
+        std::move(intersected.second[0]));
+    insert_parent_map(
+        std::pair<coordinate_map_key_type, coordinate_map_key_type>{map_key,
+                                                                    map_key1},
+        std::move(intersected.second[1]));
+  }
+  return map_key;
+}
+
 template <typename coordinate_type, typename coordinate_field_type,
           template <typename C> class TemplatedAllocator,
           template <typename T, template <typename Q> class A>
@@ -1283,12 +2248,12 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
     union_map(std::vector<coordinate_map_key_type> const &map_keys) {
   // Create a merged map
   auto const merged_key = merge(map_keys);
-  map_type const &merged_map = m_coordinate_maps.find(merged_key)->second;
+  map_type const &merged_map = coordinate_map(merged_key);
 
   std::vector<std::reference_wrapper<map_type>> maps;
   for (const auto &key : map_keys) {
     ASSERT(exists(key), ERROR_MAP_NOT_FOUND);
-    maps.push_back(std::ref(m_coordinate_maps.find(key)->second));
+    maps.push_back(std::ref(coordinate_map(key)));
   }
 
   return std::make_pair(merged_key, merged_map.union_map(maps));
@@ -1326,9 +2291,7 @@ CoordinateMapManager<coordinate_type, coordinate_field_type, TemplatedAllocator,
                      CoordinateMapType>::get_coordinates(CoordinateMapKey const
                                                              *p_key) const {
   ASSERT(exists(p_key), ERROR_MAP_NOT_FOUND);
-  auto const it = m_coordinate_maps.find(p_key->get_key());
-  ASSERT(it != m_coordinate_maps.end(), ERROR_MAP_NOT_FOUND);
-  auto const &map = it->second;
+  auto const &map = coordinate_map(p_key->get_key());
   auto const nrows = map.size();
   auto const ncols = map.coordinate_size();
   LOG_DEBUG("coordinate map nrows:", nrows, "ncols:", ncols);
@@ -1420,9 +2383,7 @@ template <typename coordinate_type, typename coordinate_field_type,
 at::Tensor CoordinateMapManager<coordinate_type, coordinate_field_type,
                                 TemplatedAllocator, CoordinateMapType>::
     get_coordinate_field(CoordinateMapKey const *p_key) const {
-  auto const it = m_field_coordinates.find(p_key->get_key());
-  ASSERT(it != m_field_coordinates.end(), ERROR_MAP_NOT_FOUND);
-  auto const &map = it->second;
+  auto const &map = field_map(p_key->get_key());
   auto const nrows = map.size();
   auto const ncols = map.coordinate_size();
 
@@ -70,8 +70,8 @@ struct insert_and_map_functor<coordinate_type, coordinate_field_type,
         input_coordinate_range.begin(), input_coordinate_range.end());
     LOG_DEBUG("mapping size:", map_inverse_map.first.size());
 
-    // insert moves map
-    manager.insert(map_key, coordinate_map);
+    // insert moves map and may rename map_key on a collision
+    manager.insert_unique(map_key, coordinate_map);
 
     auto const &mapping = map_inverse_map.first;
     auto const &inverse_mapping = map_inverse_map.second;
@@ -184,7 +184,23 @@ struct insert_field_functor<
     map.insert(p_coordinate, p_coordinate + N * coordinate_size);
 
     LOG_DEBUG("insert map with tensor_stride", map_key.first);
-    manager.insert_field_map(map_key, map);
+    manager.insert_unique_field_map(map_key, map);
+  }
+};
+
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator>
+struct insert_dense_functor<coordinate_type, coordinate_field_type,
+                            TemplatedAllocator, CoordinateMapGPU> {
+
+  std::tuple<at::Tensor, at::Tensor, at::Tensor> operator()(
+      coordinate_map_key_type &map_key, at::Tensor const &th_dense,
+      default_types::index_type const channel_dim,
+      CoordinateMapManager<coordinate_type, coordinate_field_type,
+                           TemplatedAllocator, CoordinateMapGPU> &manager) {
+    // The python side falls back to torch ops for CUDA dense tensors.
+    ASSERT(false, ERROR_NOT_IMPLEMENTED);
+    return std::make_tuple(at::Tensor(), at::Tensor(), at::Tensor());
   }
 };
 
@@ -210,6 +226,34 @@ struct kernel_map_functor<
   }
 };
 
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator>
+struct stride_hierarchy_functor<
+    coordinate_type, TemplatedAllocator, CoordinateMapGPU,
+    gpu_kernel_map<default_types::index_type, TemplatedAllocator<char>>> {
+  using map_type = CoordinateMapGPU<coordinate_type, TemplatedAllocator>;
+  using kernel_map_type =
+      gpu_kernel_map<default_types::index_type, TemplatedAllocator<char>>;
+
+  // stride each level from the previous one
+  std::vector<std::tuple<map_type, kernel_map_type, cpu_parent_map>>
+  operator()(map_type const &in_map,
+             std::vector<default_types::stride_type> const &strides) {
+    std::vector<std::tuple<map_type, kernel_map_type, cpu_parent_map>> levels;
+    levels.reserve(strides.size());
+    map_type const *p_prev = &in_map;
+    for (auto const &stride : strides) {
+      map_type level_map = p_prev->stride(stride);
+      kernel_map_type stride_map = p_prev->stride_map(
+          level_map, level_map.get_tensor_stride(), CUDA_NUM_THREADS);
+      levels.emplace_back(std::move(level_map), std::move(stride_map),
+                          cpu_parent_map());
+      p_prev = &std::get<0>(levels.back());
+    }
+    return levels;
+  }
+};
+
 template <typename coordinate_type,
           template <typename C> class TemplatedAllocator>
 struct stride_map_functor<
@@ -225,6 +269,120 @@ struct stride_map_functor<
   }
 };
 
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator>
+struct stride_parent_map_functor<coordinate_type, TemplatedAllocator,
+                                 CoordinateMapGPU> {
+
+  cpu_parent_map operator()(
+      CoordinateMapGPU<coordinate_type, TemplatedAllocator> const &in_map,
+      CoordinateMapGPU<coordinate_type, TemplatedAllocator> const &out_map) {
+    // GPU pooling uses the stride kernel map.
+    ASSERT(false, ERROR_NOT_IMPLEMENTED);
+    return cpu_parent_map{};
+  }
+};
+
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator>
+struct prune_functor<coordinate_type, TemplatedAllocator, CoordinateMapGPU> {
+
+  std::pair<CoordinateMapGPU<coordinate_type, TemplatedAllocator>,
+            cpu_parent_map>
+  operator()(
+      CoordinateMapGPU<coordinate_type, TemplatedAllocator> const &in_map,
+      bool const *keep_begin, bool const *keep_end) {
+    // GPU pruning uses the kernel map.
+    return std::make_pair(in_map.prune(keep_begin, keep_end),
+                          cpu_parent_map{});
+  }
+};
+
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator>
+struct crop_rows_functor<coordinate_type, TemplatedAllocator,
+                         CoordinateMapGPU> {
+  using map_type = CoordinateMapGPU<coordinate_type, TemplatedAllocator>;
+
+  std::vector<default_types::index_vector_type>
+  operator()(map_type const &in_map, map_type const &block_map,
+             cpu_parent_map const &block_parent_map, at::Tensor const &boxes) {
+    ASSERT(false, ERROR_NOT_IMPLEMENTED);
+    return {};
+  }
+};
+
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator>
+struct crop_functor<coordinate_type, TemplatedAllocator, CoordinateMapGPU> {
+  using map_type = CoordinateMapGPU<coordinate_type, TemplatedAllocator>;
+
+  std::vector<std::pair<map_type, default_types::index_vector_type>>
+  operator()(map_type const &in_map, map_type const &block_map,
+             cpu_parent_map const &block_parent_map, at::Tensor const &boxes) {
+    ASSERT(false, ERROR_NOT_IMPLEMENTED);
+    return {};
+  }
+};
+
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator>
+struct neighbor_query_functor<coordinate_type, TemplatedAllocator,
+                              CoordinateMapGPU> {
+
+  std::vector<at::Tensor>
+  operator()(CoordinateMapGPU<coordinate_type, TemplatedAllocator> const &map,
+             at::Tensor const &queries, double const radius,
+             default_types::index_type const max_num_neighbors) {
+    ASSERT(false, ERROR_NOT_IMPLEMENTED);
+    return {};
+  }
+};
+
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator>
+struct intersection_functor<coordinate_type, TemplatedAllocator,
+                            CoordinateMapGPU> {
+
+  std::pair<CoordinateMapGPU<coordinate_type, TemplatedAllocator>,
+            std::vector<cpu_parent_map>>
+  operator()(CoordinateMapGPU<coordinate_type, TemplatedAllocator> const &map0,
+             CoordinateMapGPU<coordinate_type, TemplatedAllocator> const &map1) {
+    ASSERT(false, ERROR_NOT_IMPLEMENTED);
+    return std::make_pair(map0, std::vector<cpu_parent_map>{});
+  }
+};
+
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator>
+struct merge_functor<coordinate_type, TemplatedAllocator, CoordinateMapGPU> {
+
+  std::pair<CoordinateMapGPU<coordinate_type, TemplatedAllocator>,
+            std::vector<cpu_parent_map>>
+  operator()(std::vector<std::reference_wrapper<
+                 CoordinateMapGPU<coordinate_type, TemplatedAllocator>>> const
+                 &maps) {
+    // GPU union uses the union map.
+    return std::make_pair(maps[0].get().merge(maps),
+                          std::vector<cpu_parent_map>{});
+  }
+};
+
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator,
+          typename in_map_type>
+struct origin_parent_map_functor<coordinate_type, TemplatedAllocator,
+                                 CoordinateMapGPU, in_map_type> {
+
+  cpu_parent_map operator()(
+      in_map_type const &in_map,
+      CoordinateMapGPU<coordinate_type, TemplatedAllocator> const &origin_map) {
+    // GPU global pooling uses the origin kernel map.
+    ASSERT(false, ERROR_NOT_IMPLEMENTED);
+    return cpu_parent_map{};
+  }
+};
+
 // a partial specialization functor for kernel map in/out swap
 template <>
 struct swap_in_out_map_functor<gpu_kernel_map<
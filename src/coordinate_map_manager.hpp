@@ -31,6 +31,7 @@
 #include "coordinate_map_cpu.hpp"
 #include "coordinate_map_key.hpp"
 #include "errors.hpp"
+#include "thread_pool.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
@@ -42,10 +43,15 @@
 #include <algorithm>
 #include <array>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <iterator>
+#include <memory>
+#include <mutex>
 #include <omp.h>
+#include <shared_mutex>
 #include <string>
+#include <tuple>
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
@@ -106,6 +112,8 @@ public:
                                          TemplatedAllocator, CoordinateMapType>;
   using map_collection_type = std::map<coordinate_map_key_type, map_type,
                                        coordinate_map_key_comparator>;
+  using parent_map_key_type =
+      std::pair<coordinate_map_key_type, coordinate_map_key_type>;
   using kernel_map_type =
 #ifndef CPU_ONLY
       typename std::conditional<
@@ -131,11 +139,7 @@ public:
       MinkowskiAlgorithm::Mode algo = MinkowskiAlgorithm::DEFAULT,
       size_type num_threads = 0)
       : m_algorithm(algo) {
-    if (num_threads > 0) {
-      // Doesn't seem to work. use `export OMP_NUM_THREADS=N;` in bash.
-      omp_set_dynamic(0);
-      omp_set_num_threads(num_threads);
-    }
+    m_threads.num_threads = num_threads;
     switch (m_algorithm) {
     case MinkowskiAlgorithm::DEFAULT: {
       m_kernel_map_mode = CUDAKernelMapMode::SPEED_OPTIMIZED;
@@ -182,11 +186,37 @@ public:
    *
    * returns key and map, inverse map
    */
-  std::pair<py::object, std::pair<at::Tensor, at::Tensor>>
+  std::pair<coordinate_map_key_type, std::pair<at::Tensor, at::Tensor>>
   insert_and_map(at::Tensor const &th_coordinate,
                  stride_type const tensor_stride,
                  std::string const string_id = "");
 
+  // python-side insert_and_map function
+  std::pair<py::object, std::pair<at::Tensor, at::Tensor>>
+  py_insert_and_map(at::Tensor const &th_coordinate,
+                    stride_type const tensor_stride,
+                    std::string const string_id = "") {
+    auto key_map_inverse_map =
+        insert_and_map(th_coordinate, tensor_stride, string_id);
+    auto const &key = key_map_inverse_map.first;
+    py::gil_scoped_acquire acquire;
+    return std::make_pair(
+        py::cast(new CoordinateMapKey(key.first.size() + 1, key)),
+        std::move(key_map_inverse_map.second));
+  }
+
+  /*
+   * Scan a dense tensor once and insert the coordinates of all non-zero
+   * positions into a new coordinate map. The batch axis must be the first
+   * axis and channel_dim defines the channel axis.
+   *
+   * returns key and (coordinates, features, flat position indices)
+   */
+  std::pair<py::object, std::tuple<at::Tensor, at::Tensor, at::Tensor>>
+  insert_dense(at::Tensor const &th_dense, index_type const channel_dim,
+               stride_type const tensor_stride,
+               std::string const string_id = "");
+
   /*
    * Generate a new coordinate_map if it doesn't exists
    */
@@ -201,6 +231,7 @@ public:
                        std::string const string_id = "") {
     auto key =
         std::get<0>(stride(in_map_key->get_key(), kernel_stride, string_id));
+    py::gil_scoped_acquire acquire;
     return py::cast(new CoordinateMapKey(key.first.size() + 1, key));
   }
 
@@ -223,6 +254,7 @@ public:
   py::object py_origin() {
     auto map_key_bool = origin();
     LOG_DEBUG("Return origin map key");
+    py::gil_scoped_acquire acquire;
     return py::cast(new CoordinateMapKey(map_key_bool.first.first.size() + 1,
                                          map_key_bool.first));
   }
@@ -231,6 +263,7 @@ public:
   py::object py_origin_field() {
     auto map_key_bool = origin_field();
     LOG_DEBUG("Return origin map key");
+    py::gil_scoped_acquire acquire;
     return py::cast(new CoordinateMapKey(map_key_bool.first.first.size() + 1,
                                          map_key_bool.first));
   }
@@ -244,6 +277,13 @@ public:
   union_map_th(std::vector<CoordinateMapKey *> const &map_keys,
                CoordinateMapKey *p_out_key);
 
+  // Intersection of two maps with the tensor stride of the first map. The CPU
+  // manager caches the row of each intersection row in both maps for
+  // stride_parent_map(intersection, in).
+  coordinate_map_key_type
+  intersection(coordinate_map_key_type const &map_key0,
+               coordinate_map_key_type const &map_key1);
+
   /****************************************************************************
    * Tensor field related operations
    ****************************************************************************/
@@ -252,17 +292,52 @@ public:
   /****************************************************************************
    * Coordinate management helper functions
    ****************************************************************************/
+  // The first insertion of a key wins. The maps are never erased, so the
+  // references returned by the accessors below stay valid without the lock.
   bool insert(coordinate_map_key_type map_key, map_type &map) {
     LOG_DEBUG("insert map with tensor_stride", map_key.first);
-    auto result = m_coordinate_maps.insert(
-        std::make_pair<coordinate_map_key_type, map_type>(std::move(map_key),
-                                                          std::move(map)));
-    LOG_DEBUG("map insertion", result.second);
-    return result.second;
+    bool inserted;
+    {
+      std::unique_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
+      inserted = m_coordinate_maps
+                     .insert(std::make_pair<coordinate_map_key_type, map_type>(
+                         std::move(map_key), std::move(map)))
+                     .second;
+    }
+    LOG_DEBUG("map insertion", inserted);
+    if (inserted)
+      dispatch_kernel_map_hints();
+    return inserted;
+  }
+
+  // Inserts the map under map_key, or under a random string id derived from
+  // map_key.second when the key is taken, and updates map_key to the inserted
+  // key. The key check and the insertion hold the same unique lock, so the
+  // concurrent inserts of the same key get distinct keys.
+  void insert_unique(coordinate_map_key_type &map_key, map_type &map) {
+    {
+      std::unique_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
+      map_key = unused_key(m_coordinate_maps, map_key);
+      m_coordinate_maps.insert(
+          std::make_pair<coordinate_map_key_type, map_type>(
+              coordinate_map_key_type(map_key), std::move(map)));
+    }
+    LOG_DEBUG("map insertion with key", map_key.second);
+    dispatch_kernel_map_hints();
+  }
+
+  void insert_unique_field_map(coordinate_map_key_type &map_key,
+                               field_map_type &map) {
+    std::unique_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
+    map_key = unused_key(m_field_coordinates, map_key);
+    m_field_coordinates.insert(
+        std::make_pair<coordinate_map_key_type, field_map_type>(
+            coordinate_map_key_type(map_key), std::move(map)));
   }
 
   bool insert_field_map(coordinate_map_key_type map_key, field_map_type &map) {
     LOG_DEBUG("insert map with tensor_stride", map_key.first);
+    std::unique_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
     auto result = m_field_coordinates.insert(
         std::make_pair<coordinate_map_key_type, field_map_type>(
             std::move(map_key), std::move(map)));
@@ -272,6 +347,7 @@ public:
 
   typename map_collection_type::iterator
   find(coordinate_map_key_type const &map_key) {
+    std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
     return m_coordinate_maps.find(map_key);
   }
 
@@ -279,32 +355,60 @@ public:
     return m_coordinate_maps.cend();
   }
 
-  inline bool exists(coordinate_map_key_type const &key) const noexcept {
+  map_type const &coordinate_map(coordinate_map_key_type const &key) const {
+    std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
+    auto const it = m_coordinate_maps.find(key);
+    ASSERT(it != m_coordinate_maps.end(), ERROR_MAP_NOT_FOUND);
+    return it->second;
+  }
+
+  map_type &coordinate_map(coordinate_map_key_type const &key) {
+    std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
+    auto const it = m_coordinate_maps.find(key);
+    ASSERT(it != m_coordinate_maps.end(), ERROR_MAP_NOT_FOUND);
+    return it->second;
+  }
+
+  field_map_type const &field_map(coordinate_map_key_type const &key) const {
+    std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
+    auto const it = m_field_coordinates.find(key);
+    ASSERT(it != m_field_coordinates.end(), ERROR_MAP_NOT_FOUND);
+    return it->second;
+  }
+
+  inline bool exists(coordinate_map_key_type const &key) const {
+    std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
     return m_coordinate_maps.find(key) != m_coordinate_maps.end();
   }
 
-  inline bool exists_field(coordinate_map_key_type const &key) const noexcept {
+  inline bool exists_field(coordinate_map_key_type const &key) const {
+    std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
     return m_field_coordinates.find(key) != m_field_coordinates.end();
   }
 
-  inline bool exists_field_to_sparse(
-      coordinate_map_key_type const &field_key,
-      coordinate_map_key_type const &sparse_key) const noexcept {
+  inline bool
+  exists_field_to_sparse(coordinate_map_key_type const &field_key,
+                         coordinate_map_key_type const &sparse_key) const {
     auto key = std::pair<coordinate_map_key_type, coordinate_map_key_type>{
         field_key, sparse_key};
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
     return m_field_to_sparse_maps.find(key) != m_field_to_sparse_maps.end();
   }
 
   std::vector<py::object>
   field_to_sparse_keys(coordinate_map_key_type const &field_key) const {
-    std::vector<py::object> return_keys;
-    for (auto const &elem : m_field_to_sparse_maps) {
-      if (elem.first.first == field_key) {
-        auto const &tensor_key = elem.first.second;
-        return_keys.push_back(py::cast(
-            new CoordinateMapKey(tensor_key.first.size() + 1, tensor_key)));
-      }
+    std::vector<coordinate_map_key_type> tensor_keys;
+    {
+      std::lock_guard<std::mutex> lock(m_cache_mutex);
+      for (auto const &elem : m_field_to_sparse_maps)
+        if (elem.first.first == field_key)
+          tensor_keys.push_back(elem.first.second);
     }
+    py::gil_scoped_acquire acquire;
+    std::vector<py::object> return_keys;
+    for (auto const &tensor_key : tensor_keys)
+      return_keys.push_back(py::cast(
+          new CoordinateMapKey(tensor_key.first.size() + 1, tensor_key)));
     return return_keys;
   }
 
@@ -329,6 +433,7 @@ public:
   }
 
   inline size_type size(coordinate_map_key_type const &key) const {
+    std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
     auto const it = m_coordinate_maps.find(key);
     auto const field_it = m_field_coordinates.find(key);
     ASSERT(it != m_coordinate_maps.end() ||
@@ -345,9 +450,7 @@ public:
   }
 
   inline size_type capacity(coordinate_map_key_type const &key) const {
-    auto it = m_coordinate_maps.find(key);
-    ASSERT(it != m_coordinate_maps.end(), ERROR_MAP_NOT_FOUND);
-    return it->second.capacity();
+    return coordinate_map(key).capacity();
   }
 
   at::Tensor get_coordinates(CoordinateMapKey const *p_key) const;
@@ -360,15 +463,19 @@ public:
 
   std::vector<py::object>
   get_coordinate_map_keys(stride_type const tensor_stride) const {
-    std::vector<py::object> keys;
-    for (auto it = m_coordinate_maps.begin(); it != m_coordinate_maps.end();
-         ++it) {
-      coordinate_map_key_type const &key = it->first;
-      if (key.first == tensor_stride) {
-        keys.push_back(
-            py::cast(new CoordinateMapKey(key.first.size() + 1, key)));
+    std::vector<coordinate_map_key_type> map_keys;
+    {
+      std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
+      for (auto it = m_coordinate_maps.begin(); it != m_coordinate_maps.end();
+           ++it) {
+        if (it->first.first == tensor_stride)
+          map_keys.push_back(it->first);
       }
     }
+    py::gil_scoped_acquire acquire;
+    std::vector<py::object> keys;
+    for (auto const &key : map_keys)
+      keys.push_back(py::cast(new CoordinateMapKey(key.first.size() + 1, key)));
     return keys;
   }
 
@@ -381,13 +488,15 @@ public:
   }
 
   std::string to_string(CoordinateMapKey const *p_key) const {
-    auto it = m_coordinate_maps.find(p_key->get_key());
-    ASSERT(it != m_coordinate_maps.end(), ERROR_MAP_NOT_FOUND);
-    return print_key(it->first) + " : " + it->second.to_string();
+    return print_key(p_key->get_key()) + " : " +
+           coordinate_map(p_key->get_key()).to_string();
   }
 
   std::string to_string() const {
     Formatter o;
+    std::shared_lock<std::shared_timed_mutex> kernel_map_lock(
+        m_kernel_map_mutex);
+    std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
     for (auto const &kv : m_coordinate_maps) {
       o << "\t" << print_key(kv.first) << ":\t" << kv.second.to_string()
         << "\n";
@@ -409,6 +518,116 @@ public:
 
   MinkowskiAlgorithm::Mode algorithm() const { return m_algorithm; }
 
+  /****************************************************************************
+   * CPU threads
+   ****************************************************************************/
+
+  // The thread count and the CPU affinity apply to the CPU ops and the map
+  // builds of this manager only, through a thread_scope on the calling thread.
+  // The BLAS calls inside the ops follow the same OpenMP thread count.
+  thread_config threads() const {
+    std::lock_guard<std::mutex> lock(m_thread_mutex);
+    return m_threads;
+  }
+
+  size_type num_threads() const { return threads().num_threads; }
+
+  void set_num_threads(size_type num_threads) {
+    std::lock_guard<std::mutex> lock(m_thread_mutex);
+    m_threads.num_threads = num_threads;
+  }
+
+  std::vector<int> cpu_affinity() const { return threads().cpu_affinity; }
+
+  void set_cpu_affinity(std::vector<int> const &cpu_affinity) {
+    std::lock_guard<std::mutex> lock(m_thread_mutex);
+    m_threads.cpu_affinity = cpu_affinity;
+  }
+
+  ThreadingPolicy::Type threading_policy() const {
+    return threads().threading_policy;
+  }
+
+  void set_threading_policy(ThreadingPolicy::Type threading_policy) {
+    std::lock_guard<std::mutex> lock(m_thread_mutex);
+    m_threads.threading_policy = threading_policy;
+  }
+
+  // The CPUs each OpenMP thread of this manager may run on, read from inside
+  // a parallel region under the manager's thread_scope.
+  std::vector<std::vector<int>> worker_cpu_affinity() const {
+    thread_scope const scope(threads());
+    return omp_thread_cpu_affinity();
+  }
+
+  /****************************************************************************
+   * Plan capture
+   ****************************************************************************/
+
+  // Between begin_capture and end_capture, the stride and kernel_map results
+  // are recorded in the call order. Between begin_replay and end_replay, a
+  // call that matches a recorded entry at or after the cursor returns it
+  // without building the kernel map key or looking it up, and an extra or a
+  // missing call resynchronizes the cursor on the next match. A call that
+  // matches no entry falls back to the lookup. The plan points into
+  // m_kernel_maps, which never erases.
+  //
+  // The entries match on the coordinate map keys of this manager; there is no
+  // coordinate fingerprint. A replay only hits for the inputs that reuse the
+  // captured manager and input key, i.e. the same coordinates with new
+  // features. Other inputs share a plan through kernel_map_plan and
+  // set_kernel_map_hints instead.
+  void begin_capture() {
+    m_plan.clear();
+    m_plan_mode = plan_mode::CAPTURE;
+  }
+  void end_capture() { m_plan_mode = plan_mode::NONE; }
+  void begin_replay() {
+    m_plan_cursor = 0;
+    m_plan_mode = plan_mode::REPLAY;
+  }
+  void end_replay() { m_plan_mode = plan_mode::NONE; }
+  size_type plan_size() const { return m_plan.size(); }
+  // position after the last entry returned by the current or the last replay
+  size_type plan_cursor() const { return m_plan_cursor; }
+  // the kernel map keys of the captured plan, to prefetch on other managers
+  std::vector<kernel_map_key_type> kernel_map_plan() const {
+    std::vector<kernel_map_key_type> keys;
+    for (auto const &entry : m_plan)
+      if (entry.p_kernel_map != nullptr)
+        keys.push_back(entry.key);
+    return keys;
+  }
+
+  /****************************************************************************
+   * Kernel map prefetch
+   ****************************************************************************/
+
+  // Build the kernel map on a background worker. kernel_map waits on it only
+  // if it is not ready yet. Returns false if the input or the output map does
+  // not exist yet.
+  bool prefetch_kernel_map(kernel_map_key_type const &kernel_map_key);
+
+  bool py_prefetch_kernel_map(CoordinateMapKey const *p_in_map_key,
+                              CoordinateMapKey const *p_out_map_key,
+                              stride_type const &kernel_size,
+                              stride_type const &kernel_stride,
+                              stride_type const &kernel_dilation,
+                              RegionType::Type const region_type,
+                              bool is_transpose, bool is_pool) {
+    return prefetch_kernel_map(std::make_tuple(
+        p_in_map_key->get_key(), p_out_map_key->get_key(), kernel_size,
+        kernel_stride, kernel_dilation, region_type, is_transpose, is_pool));
+  }
+
+  // Kernel maps to prefetch as soon as their input and output maps are
+  // inserted, e.g. the kernel_map_plan captured on another input.
+  void set_kernel_map_hints(std::vector<kernel_map_key_type> const &hints);
+  size_type num_kernel_map_hints() const {
+    std::lock_guard<std::mutex> lock(m_kernel_map_hint_mutex);
+    return m_kernel_map_hints.size();
+  }
+
   /****************************************************************************
    * Kernel map related functions
    ****************************************************************************/
@@ -448,6 +667,61 @@ public:
   interpolation_map_weight(at::Tensor const &tfield,
                            CoordinateMapKey const *py_in_coords_key);
 
+  // interpolation map of a coordinate field. Cached per {field map key,
+  // sparse map key} since the field coordinates do not change.
+  std::vector<at::Tensor>
+  field_interpolation_map_weight(CoordinateMapKey const *p_field_map_key,
+                                 CoordinateMapKey const *p_in_map_key);
+
+  // Drop the cached interpolation maps of a coordinate field. Returns the
+  // number of maps released.
+  size_t
+  release_field_interpolation_maps(CoordinateMapKey const *p_field_map_key) {
+    auto const field_key = p_field_map_key->get_key();
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    size_t num_released = 0;
+    for (auto it = m_field_interpolation_maps.begin();
+         it != m_field_interpolation_maps.end();) {
+      if (it->first.first == field_key) {
+        it = m_field_interpolation_maps.erase(it);
+        ++num_released;
+      } else {
+        ++it;
+      }
+    }
+    return num_released;
+  }
+
+  // neighbors of the continuous query points within the radius in CSR format
+  // (offsets, rows, distances). Only available for the CPU coordinate maps.
+  std::vector<at::Tensor> neighbor_query(at::Tensor const &queries,
+                                         CoordinateMapKey const *p_in_map_key,
+                                         double const radius,
+                                         index_type const max_num_neighbors);
+
+  // Crop the map to axis-aligned boxes. Each box is a row of (batch index, min
+  // coordinates, max coordinates) with inclusive bounds. Returns the key and
+  // the input rows of each crop. The block index, the map strided by the block
+  // size and its parent map, is built by the first crop and cached. Only
+  // available for the CPU coordinate maps.
+  std::pair<std::vector<py::object>, std::vector<at::Tensor>>
+  crop(CoordinateMapKey const *p_in_map_key, at::Tensor const &boxes,
+       index_type const block_size);
+
+  // The input rows of each crop without inserting the cropped maps. Uses the
+  // same cached block index as crop.
+  std::vector<at::Tensor> crop_rows(CoordinateMapKey const *p_in_map_key,
+                                    at::Tensor const &boxes,
+                                    index_type const block_size);
+
+  // Build the maps of successive strides from the input map in one pass per
+  // level and cache the stride maps between the levels, and the parent maps
+  // for the CPU coordinate maps. The existing levels are reused. Returns the
+  // key of each level.
+  std::vector<py::object>
+  build_hierarchy(CoordinateMapKey const *p_in_map_key,
+                  std::vector<stride_type> const &strides);
+
   std::pair<at::Tensor, std::vector<at::Tensor>>
   origin_map_th(CoordinateMapKey const *py_out_coords_key);
 
@@ -458,15 +732,30 @@ public:
   stride_map_th(CoordinateMapKey const *p_in_map_key,
                 CoordinateMapKey const *p_strided_map_key);
 
+  // parent (strided) row of each input row for kernel_size == kernel_stride
+  // pooling. Only available for the CPU coordinate maps.
+  cpu_parent_map const &
+  stride_parent_map(CoordinateMapKey const *p_in_map_key,
+                    CoordinateMapKey const *p_strided_map_key);
+
+  // rows of each origin (batch) row for global pooling of a coordinate map or
+  // a coordinate field. Only available for the CPU coordinate maps.
+  cpu_parent_map const &batch_segments(CoordinateMapKey const *p_in_map_key);
+
   size_t origin_map_size() {
-    ASSERT(m_coordinate_maps.size() > 0 or m_field_coordinates.size() > 0,
-           "No coordinate map found.");
-    if (m_coordinate_maps.size() > 0) {
+    bool has_coordinate_maps;
+    {
+      std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
+      ASSERT(m_coordinate_maps.size() > 0 or m_field_coordinates.size() > 0,
+             "No coordinate map found.");
+      has_coordinate_maps = m_coordinate_maps.size() > 0;
+    }
+    if (has_coordinate_maps) {
       auto const key = origin().first;
-      return m_coordinate_maps.find(key)->second.size();
+      return coordinate_map(key).size();
     } else {
       auto const key = origin_field().first;
-      return m_coordinate_maps.find(key)->second.size();
+      return coordinate_map(key).size();
     }
   }
 
@@ -475,7 +764,7 @@ public:
     coordinate_map_key_type key = std::make_pair(
         tensor_stride, string_id.size() > 0 ? string_id + '-' + random_string(5)
                                             : random_string(5));
-    while (m_coordinate_maps.find(key) != m_coordinate_maps.end()) {
+    while (exists(key)) {
       key =
           std::make_pair(tensor_stride, string_id.size() > 0
                                             ? string_id + '-' + random_string(5)
@@ -491,7 +780,30 @@ private:
     ASSERT(exists(p_map_key->get_key()), "Key does not exist.");
   }
 
+  // validate the crop boxes and return the key of the block index
+  coordinate_map_key_type crop_block_index(CoordinateMapKey const *p_in_map_key,
+                                           at::Tensor const &boxes,
+                                           index_type const block_size);
+
   // random string generator
+  // map_key when the collection does not have it, a random string id derived
+  // from map_key.second otherwise. The caller holds m_coordinate_map_mutex.
+  template <typename collection_type>
+  coordinate_map_key_type
+  unused_key(collection_type const &collection,
+             coordinate_map_key_type const &map_key) {
+    coordinate_map_key_type key = map_key;
+    while (collection.find(key) != collection.end()) {
+      LOG_DEBUG("CoordinateMapKey collision detected:", key.second,
+                "generating new string id.");
+      key = std::make_pair(map_key.first,
+                           map_key.second.size() > 0
+                               ? map_key.second + '-' + random_string(5)
+                               : random_string(5));
+    }
+    return key;
+  }
+
   std::string random_string(size_t length) {
     auto randchar = []() -> char {
       const char charset[] = "0123456789"
@@ -507,8 +819,12 @@ private:
 
   kernel_map_key_type
   origin_map_key(coordinate_map_key_type const &in_key) const {
-    map_type const &random_map = m_coordinate_maps.begin()->second;
-    stride_type zero_vec(random_map.coordinate_size() - 1);
+    size_type coordinate_size;
+    {
+      std::shared_lock<std::shared_timed_mutex> lock(m_coordinate_map_mutex);
+      coordinate_size = m_coordinate_maps.begin()->second.coordinate_size();
+    }
+    stride_type zero_vec(coordinate_size - 1);
     std::for_each(zero_vec.begin(), zero_vec.end(), [](auto &i) { i = 0; });
     coordinate_map_key_type origin_key = std::make_pair(zero_vec, "");
 
@@ -553,6 +869,25 @@ private:
       field_to_sparse_map_key_hasher<coordinate_map_key_hasher>>
       m_field_to_sparse_maps;
 
+  // stride parent maps keyed by {in map key, strided map key}
+  std::unordered_map<
+      const std::pair<coordinate_map_key_type, coordinate_map_key_type>,
+      cpu_parent_map, field_to_sparse_map_key_hasher<coordinate_map_key_hasher>>
+      m_parent_maps;
+
+  std::unordered_map<
+      const std::pair<coordinate_map_key_type, coordinate_map_key_type>,
+      cpu_parent_map, field_to_sparse_map_key_hasher<coordinate_map_key_hasher>>
+      m_field_parent_maps;
+
+  // interpolation {in map, out map, weights} keyed by {field map key, sparse
+  // map key}. The entries are released with the python field that uses them.
+  std::unordered_map<
+      const std::pair<coordinate_map_key_type, coordinate_map_key_type>,
+      const std::vector<at::Tensor>,
+      field_to_sparse_map_key_hasher<coordinate_map_key_hasher>>
+      m_field_interpolation_maps;
+
 #ifndef CPU_ONLY
   TemplatedAllocator<char> m_allocator;
 #endif
@@ -562,6 +897,98 @@ private:
   // Algorithm index
   MinkowskiAlgorithm::Mode m_algorithm;
 
+  // Plan capture. A stride entry has a null kernel map and keeps the kernel
+  // stride in the key.
+  enum class plan_mode { NONE, CAPTURE, REPLAY };
+  struct plan_entry {
+    kernel_map_key_type key;
+    kernel_map_type const *p_kernel_map;
+  };
+  plan_mode m_plan_mode = plan_mode::NONE;
+  std::vector<plan_entry> m_plan;
+  size_type m_plan_cursor = 0;
+
+  kernel_map_type create_kernel_map(map_type const &in_map,
+                                    map_type const &out_map,
+                                    stride_type const &kernel_size,
+                                    stride_type const &kernel_stride,
+                                    stride_type const &kernel_dilation,
+                                    RegionType::Type const region_type,
+                                    at::Tensor const &offset,
+                                    bool is_transpose, bool is_pool) const;
+
+  void dispatch_kernel_map_hints();
+
+  kernel_map_type const &build_kernel_map(kernel_map_key_type const &key,
+                                          at::Tensor const &offset);
+
+  // Cache accessors. A lookup returns nullptr for a missing entry and an
+  // insertion keeps the first entry of a key.
+  kernel_map_type const *find_kernel_map(kernel_map_key_type const &key) const {
+    std::shared_lock<std::shared_timed_mutex> lock(m_kernel_map_mutex);
+    auto const it = m_kernel_maps.find(key);
+    return it == m_kernel_maps.end() ? nullptr : &it->second;
+  }
+
+  kernel_map_type const &insert_kernel_map(kernel_map_key_type const &key,
+                                           kernel_map_type &&kernel_map) {
+    std::unique_lock<std::shared_timed_mutex> lock(m_kernel_map_mutex);
+    return m_kernel_maps.emplace(key, std::move(kernel_map)).first->second;
+  }
+
+  cpu_parent_map const *find_parent_map(parent_map_key_type const &key,
+                                        bool is_field = false) const {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    auto const &parent_maps = is_field ? m_field_parent_maps : m_parent_maps;
+    auto const it = parent_maps.find(key);
+    return it == parent_maps.end() ? nullptr : &it->second;
+  }
+
+  cpu_parent_map const &insert_parent_map(parent_map_key_type const &key,
+                                          cpu_parent_map &&parent_map,
+                                          bool is_field = false) {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    auto &parent_maps = is_field ? m_field_parent_maps : m_parent_maps;
+    return parent_maps.emplace(key, std::move(parent_map)).first->second;
+  }
+
+  // The first entry at or after the cursor that matches the call, which moves
+  // the cursor past it. A call that deviates from the plan leaves the cursor,
+  // and the next matching call skips the entries the deviation missed.
+  template <typename match_type>
+  plan_entry const *match_plan_entry(match_type const &match) {
+    if (m_plan_mode != plan_mode::REPLAY)
+      return nullptr;
+    for (size_type i = m_plan_cursor; i < m_plan.size(); ++i) {
+      if (match(m_plan[i])) {
+        m_plan_cursor = i + 1;
+        return &m_plan[i];
+      }
+    }
+    return nullptr;
+  }
+
+  // Synchronization. m_coordinate_map_mutex guards the coordinate maps and
+  // fields, m_kernel_map_mutex the kernel maps and the pending builds, and
+  // m_cache_mutex the parent, field to sparse and interpolation maps. None of
+  // them is held while a map is built, and the coordinate map lock is taken
+  // last. Plan capture and replay are not synchronized.
+  mutable std::shared_timed_mutex m_coordinate_map_mutex;
+  mutable std::shared_timed_mutex m_kernel_map_mutex;
+  mutable std::mutex m_cache_mutex;
+  mutable std::mutex m_kernel_map_hint_mutex;
+  mutable std::mutex m_thread_mutex;
+
+  thread_config m_threads;
+
+  // Kernel map prefetch. The worker is declared last to join before the maps
+  // it reads are destroyed.
+  std::vector<kernel_map_key_type> m_kernel_map_hints;
+  std::unordered_map<kernel_map_key_type, std::shared_future<void>,
+                     kernel_map_key_hasher<coordinate_map_key_hasher>>
+      m_pending_kernel_maps;
+  std::unique_ptr<thread_pool> m_prefetch_pool;
+
 }; // coordsmanager
 
 namespace detail {
@@ -591,6 +1018,19 @@ struct insert_and_map_functor {
                            TemplatedAllocator, CoordinateMapType> &manager);
 };
 
+// a partial specialization functor for dense tensor insertion
+template <typename coordinate_type, typename coordinate_field_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+struct insert_dense_functor {
+  std::tuple<at::Tensor, at::Tensor, at::Tensor> operator()(
+      coordinate_map_key_type &map_key, at::Tensor const &th_dense,
+      default_types::index_type const channel_dim,
+      CoordinateMapManager<coordinate_type, coordinate_field_type,
+                           TemplatedAllocator, CoordinateMapType> &manager);
+};
+
 // a partial specialization functor for kernel map generation
 template <typename coordinate_type,
           template <typename C> class TemplatedAllocator,
@@ -620,6 +1060,129 @@ struct stride_map_functor {
       stride_type const &kernel);
 };
 
+// a partial specialization functor for the multi-resolution hierarchy.
+// Returns the map of each level and the stride map from the previous level,
+// and the parent map for the CPU coordinate maps.
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType,
+          typename kernel_map_type>
+struct stride_hierarchy_functor {
+  using map_type = CoordinateMapType<coordinate_type, TemplatedAllocator>;
+
+  std::vector<std::tuple<map_type, kernel_map_type, cpu_parent_map>>
+  operator()(map_type const &in_map,
+             std::vector<default_types::stride_type> const &strides);
+};
+
+// a partial specialization functor for stride parent map generation
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+struct stride_parent_map_functor {
+  cpu_parent_map operator()(
+      CoordinateMapType<coordinate_type, TemplatedAllocator> const &in_map,
+      CoordinateMapType<coordinate_type, TemplatedAllocator> const &out_map);
+};
+
+// a partial specialization functor for pruning. Returns the pruned map and,
+// for the CPU coordinate maps, the source row of each pruned row.
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+struct prune_functor {
+  std::pair<CoordinateMapType<coordinate_type, TemplatedAllocator>,
+            cpu_parent_map>
+  operator()(
+      CoordinateMapType<coordinate_type, TemplatedAllocator> const &in_map,
+      bool const *keep_begin, bool const *keep_end);
+};
+
+// a partial specialization functor for merging. Returns the merged map and,
+// for the CPU coordinate maps, the merged row of each row of the input maps.
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+struct merge_functor {
+  std::pair<CoordinateMapType<coordinate_type, TemplatedAllocator>,
+            std::vector<cpu_parent_map>>
+  operator()(std::vector<std::reference_wrapper<
+                 CoordinateMapType<coordinate_type, TemplatedAllocator>>> const
+                 &maps);
+};
+
+// a partial specialization functor for intersection. Returns the intersection
+// map and, for the CPU coordinate maps, the row of each intersection row in
+// both maps.
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+struct intersection_functor {
+  std::pair<CoordinateMapType<coordinate_type, TemplatedAllocator>,
+            std::vector<cpu_parent_map>>
+  operator()(
+      CoordinateMapType<coordinate_type, TemplatedAllocator> const &map0,
+      CoordinateMapType<coordinate_type, TemplatedAllocator> const &map1);
+};
+
+// a partial specialization functor for the neighbor query
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+struct neighbor_query_functor {
+  std::vector<at::Tensor>
+  operator()(CoordinateMapType<coordinate_type, TemplatedAllocator> const &map,
+             at::Tensor const &queries, double const radius,
+             default_types::index_type const max_num_neighbors);
+};
+
+// a partial specialization functor for cropping. Returns the cropped map and
+// the input rows of each box.
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+struct crop_functor {
+  std::vector<std::pair<CoordinateMapType<coordinate_type, TemplatedAllocator>,
+                        default_types::index_vector_type>>
+  operator()(
+      CoordinateMapType<coordinate_type, TemplatedAllocator> const &in_map,
+      CoordinateMapType<coordinate_type, TemplatedAllocator> const &block_map,
+      cpu_parent_map const &block_parent_map, at::Tensor const &boxes);
+};
+
+// a partial specialization functor for the input rows of each crop box.
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType>
+struct crop_rows_functor {
+  std::vector<default_types::index_vector_type>
+  operator()(
+      CoordinateMapType<coordinate_type, TemplatedAllocator> const &in_map,
+      CoordinateMapType<coordinate_type, TemplatedAllocator> const &block_map,
+      cpu_parent_map const &block_parent_map, at::Tensor const &boxes);
+};
+
+// a partial specialization functor for origin parent map generation
+template <typename coordinate_type,
+          template <typename C> class TemplatedAllocator,
+          template <typename T, template <typename Q> class A>
+          class CoordinateMapType,
+          typename in_map_type>
+struct origin_parent_map_functor {
+  cpu_parent_map
+  operator()(in_map_type const &in_map,
+             CoordinateMapType<coordinate_type, TemplatedAllocator> const
+                 &origin_map);
+};
+
 // a partial specialization functor for stride map generation
 template <typename coordinate_type,
           template <typename C> class TemplatedAllocator,
@@ -0,0 +1,156 @@
+/* Copyright (c) Chris Choy (chrischoy@ai.stanford.edu).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+ * Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+ * of the code.
+ */
+#ifndef CPU_ELEMENTWISE
+#define CPU_ELEMENTWISE
+
+#include "types.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace minkowski {
+
+namespace detail {
+
+// the row of an input that does not have the output coordinate
+constexpr default_types::index_type missing_row =
+    std::numeric_limits<default_types::index_type>::max();
+
+template <typename Dtype>
+inline Dtype binary_op(Dtype const x, Dtype const y,
+                       BinaryMode::Type const op) {
+  switch (op) {
+  case BinaryMode::ADDITION:
+    return x + y;
+  case BinaryMode::SUBTRACTION:
+    return x - y;
+  case BinaryMode::MULTIPLICATION:
+    return x * y;
+  default: // BinaryMode::MAXIMUM
+    return std::max(x, y);
+  }
+}
+
+} // namespace detail
+
+/*
+ * out_feat[i] = op(in_feat0[rows0[i]], in_feat1[rows1[i]]) for the joined
+ * rows. A missing row, detail::missing_row, is a zero feature except for the
+ * maximum which takes the feature of the other input.
+ */
+template <typename Dtype>
+void ElementwiseForwardKernelCPU(Dtype const *p_in_feat0,
+                                 Dtype const *p_in_feat1, Dtype *p_out_feat,
+                                 int const nchannel,
+                                 default_types::index_type const *rows0,
+                                 default_types::index_type const *rows1,
+                                 int64_t const out_nrows,
+                                 BinaryMode::Type const op) {
+#pragma omp parallel for
+  for (int64_t row = 0; row < out_nrows; ++row) {
+    Dtype *p_out = p_out_feat + row * nchannel;
+    Dtype const *p_x = rows0[row] == detail::missing_row
+                           ? nullptr
+                           : p_in_feat0 + rows0[row] * nchannel;
+    Dtype const *p_y = rows1[row] == detail::missing_row
+                           ? nullptr
+                           : p_in_feat1 + rows1[row] * nchannel;
+    if (p_x && p_y) {
+      for (int c = 0; c < nchannel; ++c)
+        p_out[c] = detail::binary_op(p_x[c], p_y[c], op);
+    } else if (op == BinaryMode::MAXIMUM) {
+      std::copy_n(p_x ? p_x : p_y, nchannel, p_out);
+    } else if (p_x) {
+      for (int c = 0; c < nchannel; ++c)
+        p_out[c] = detail::binary_op(p_x[c], Dtype(0), op);
+    } else {
+      for (int c = 0; c < nchannel; ++c)
+        p_out[c] = detail::binary_op(Dtype(0), p_y[c], op);
+    }
+  }
+}
+
+/*
+ * Each input row has at most one output row, so the scatter is race free. The
+ * gradients must be zero-initialized for the rows without an output row.
+ */
+template <typename Dtype>
+void ElementwiseBackwardKernelCPU(
+    Dtype const *p_in_feat0, Dtype const *p_in_feat1, Dtype *p_grad_in_feat0,
+    Dtype *p_grad_in_feat1, Dtype const *p_grad_out_feat, int const nchannel,
+    default_types::index_type const *rows0,
+    default_types::index_type const *rows1, int64_t const out_nrows,
+    BinaryMode::Type const op) {
+#pragma omp parallel for
+  for (int64_t row = 0; row < out_nrows; ++row) {
+    Dtype const *p_grad_out = p_grad_out_feat + row * nchannel;
+    bool const has_x = rows0[row] != detail::missing_row;
+    bool const has_y = rows1[row] != detail::missing_row;
+    Dtype const *p_x = has_x ? p_in_feat0 + rows0[row] * nchannel : nullptr;
+    Dtype const *p_y = has_y ? p_in_feat1 + rows1[row] * nchannel : nullptr;
+    Dtype *p_grad_x = has_x ? p_grad_in_feat0 + rows0[row] * nchannel : nullptr;
+    Dtype *p_grad_y = has_y ? p_grad_in_feat1 + rows1[row] * nchannel : nullptr;
+
+    for (int c = 0; c < nchannel; ++c) {
+      Dtype const g = p_grad_out[c];
+      switch (op) {
+      case BinaryMode::ADDITION:
+        if (has_x)
+          p_grad_x[c] = g;
+        if (has_y)
+          p_grad_y[c] = g;
+        break;
+      case BinaryMode::SUBTRACTION:
+        if (has_x)
+          p_grad_x[c] = g;
+        if (has_y)
+          p_grad_y[c] = -g;
+        break;
+      case BinaryMode::MULTIPLICATION:
+        if (has_x)
+          p_grad_x[c] = has_y ? g * p_y[c] : 0;
+        if (has_y)
+          p_grad_y[c] = has_x ? g * p_x[c] : 0;
+        break;
+      case BinaryMode::MAXIMUM:
+        // ties go to the first input
+        if (has_x && has_y) {
+          bool const is_x = p_x[c] >= p_y[c];
+          p_grad_x[c] = is_x ? g : 0;
+          p_grad_y[c] = is_x ? 0 : g;
+        } else if (has_x) {
+          p_grad_x[c] = g;
+        } else {
+          p_grad_y[c] = g;
+        }
+        break;
+      }
+    }
+  }
+}
+
+} // end namespace minkowski
+
+#endif // CPU_ELEMENTWISE
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2020 NVIDIA Corporation.
+ * Copyright (c) 2018-2020 Chris Choy (chrischoy@ai.stanford.edu).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+ * Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+ * of the code.
+ */
+#include "coordinate_map.hpp"
+#include "coordinate_map_cpu.hpp"
+#include "coordinate_map_key.hpp"
+#include "coordinate_map_manager.hpp"
+#include "errors.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+#include "elementwise.hpp"
+
+#include <pybind11/pybind11.h>
+#include <torch/extension.h>
+
+namespace minkowski {
+
+namespace detail {
+
+/*
+ * The row of each output row in the first and the second input.
+ *
+ * The union rows are the parents of the input rows in the union map, and the
+ * intersection rows are the parents of the intersection rows in the inputs.
+ * Both are cached when the output map is created.
+ */
+template <typename coordinate_type>
+std::pair<std::vector<default_types::index_type>,
+          std::vector<default_types::index_type>>
+join_rows(JoinMode::Type const join, CoordinateMapKey *p_in_map_key0,
+          CoordinateMapKey *p_in_map_key1, CoordinateMapKey *p_out_map_key,
+          cpu_manager_type<coordinate_type> *p_map_manager) {
+  using index_type = default_types::index_type;
+  if (join == JoinMode::INTERSECTION) {
+    return std::make_pair(
+        p_map_manager->stride_parent_map(p_out_map_key, p_in_map_key0).parents,
+        p_map_manager->stride_parent_map(p_out_map_key, p_in_map_key1)
+            .parents);
+  }
+
+  index_type const out_nrows = p_map_manager->size(p_out_map_key->get_key());
+  std::vector<index_type> rows0(out_nrows, missing_row),
+      rows1(out_nrows, missing_row);
+  for (auto in_rows :
+       {std::make_pair(p_in_map_key0, &rows0),
+        std::make_pair(p_in_map_key1, &rows1)}) {
+    auto const &parents =
+        p_map_manager->stride_parent_map(in_rows.first, p_out_map_key).parents;
+    auto &rows = *in_rows.second;
+#pragma omp parallel for
+    for (int64_t i = 0; i < (int64_t)parents.size(); ++i)
+      rows[parents[i]] = i;
+  }
+  return std::make_pair(std::move(rows0), std::move(rows1));
+}
+
+} // namespace detail
+
+template <typename coordinate_type>
+at::Tensor
+ElementwiseForwardCPU(at::Tensor const &in_feat0,       // CPU feat
+                      at::Tensor const &in_feat1,       // CPU feat
+                      BinaryMode::Type const op,        //
+                      JoinMode::Type const join,        //
+                      CoordinateMapKey *p_in_map_key0,  //
+                      CoordinateMapKey *p_in_map_key1,  //
+                      CoordinateMapKey *p_out_map_key,  //
+                      cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
+  ASSERT(in_feat0.is_contiguous(), "in_feat0 must be contiguous");
+  ASSERT(in_feat1.is_contiguous(), "in_feat1 must be contiguous");
+  ASSERT(!in_feat0.is_cuda(), "in_feat0 must be CPU");
+  ASSERT(!in_feat1.is_cuda(), "in_feat1 must be CPU");
+  ASSERT(in_feat0.dim() == 2, "in_feat0.dim():", in_feat0.dim());
+  ASSERT(in_feat1.dim() == 2, "in_feat1.dim():", in_feat1.dim());
+  ASSERT(in_feat0.size(1) == in_feat1.size(1), "Invalid in_feat1 channel size",
+         in_feat1.size(1), "!=", in_feat0.size(1));
+  ASSERT(in_feat0.scalar_type() == in_feat1.scalar_type(),
+         "The input features must have the same dtype.");
+
+  coordinate_map_key_type const &in_key0 = p_in_map_key0->get_key();
+  coordinate_map_key_type const &in_key1 = p_in_map_key1->get_key();
+  ASSERT(p_map_manager->exists(in_key0), ERROR_MAP_NOT_FOUND);
+  ASSERT(p_map_manager->exists(in_key1), ERROR_MAP_NOT_FOUND);
+  ASSERT(in_feat0.size(0) == p_map_manager->size(in_key0),
+         "Invalid in_feat0 size", in_feat0.size(0),
+         "!=", p_map_manager->size(in_key0));
+  ASSERT(in_feat1.size(0) == p_map_manager->size(in_key1),
+         "Invalid in_feat1 size", in_feat1.size(0),
+         "!=", p_map_manager->size(in_key1));
+
+  if (!p_out_map_key->is_key_set()) {
+    coordinate_map_key_type out_key =
+        join == JoinMode::UNION
+            ? p_map_manager->merge({in_key0, in_key1})
+            : p_map_manager->intersection(in_key0, in_key1);
+    p_out_map_key->set_key(out_key);
+  }
+
+  auto const rows = detail::join_rows<coordinate_type>(
+      join, p_in_map_key0, p_in_map_key1, p_out_map_key, p_map_manager);
+
+  const int64_t tot_n = rows.first.size();
+  const auto nchannel = in_feat0.size(1);
+  at::Tensor out_feat = torch::empty({tot_n, nchannel}, in_feat0.options());
+  LOG_DEBUG("out_feat", tot_n, "x", nchannel);
+
+  if (tot_n == 0) {
+    WARNING(true, "MinkowskiElementwise: Generating an empty SparseTensor");
+  } else {
+    AT_DISPATCH_FLOATING_TYPES(
+        in_feat0.scalar_type(), "elementwise_forward_cpu", [&] {
+          ElementwiseForwardKernelCPU<scalar_t>(
+              in_feat0.template data_ptr<scalar_t>(),
+              in_feat1.template data_ptr<scalar_t>(),
+              out_feat.template data_ptr<scalar_t>(), nchannel,
+              rows.first.data(), rows.second.data(), tot_n, op);
+        });
+  }
+
+  return out_feat;
+}
+
+template <typename coordinate_type>
+std::pair<at::Tensor, at::Tensor>
+ElementwiseBackwardCPU(at::Tensor &grad_out_feat,        // CPU grad
+                       at::Tensor const &in_feat0,       // CPU feat
+                       at::Tensor const &in_feat1,       // CPU feat
+                       BinaryMode::Type const op,        //
+                       JoinMode::Type const join,        //
+                       CoordinateMapKey *p_in_map_key0,  //
+                       CoordinateMapKey *p_in_map_key1,  //
+                       CoordinateMapKey *p_out_map_key,  //
+                       cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
+  if (!grad_out_feat.is_contiguous())
+    grad_out_feat = grad_out_feat.contiguous();
+
+  ASSERT(!grad_out_feat.is_cuda(), "grad_out_feat must be CPU");
+  ASSERT(grad_out_feat.dim() == 2, "grad_out_feat.dim():", grad_out_feat.dim());
+
+  auto const rows = detail::join_rows<coordinate_type>(
+      join, p_in_map_key0, p_in_map_key1, p_out_map_key, p_map_manager);
+  const int64_t tot_n = rows.first.size();
+  ASSERT(grad_out_feat.size(0) == tot_n, "Invalid grad_out_feat size",
+         grad_out_feat.size(0), "!=", tot_n);
+
+  const int nchannel = grad_out_feat.size(1);
+  at::Tensor grad_in_feat0 = torch::zeros(in_feat0.sizes(), in_feat0.options());
+  at::Tensor grad_in_feat1 = torch::zeros(in_feat1.sizes(), in_feat1.options());
+
+  if (tot_n > 0)
+    AT_DISPATCH_FLOATING_TYPES(
+        grad_out_feat.scalar_type(), "elementwise_backward_cpu", [&] {
+          ElementwiseBackwardKernelCPU<scalar_t>(
+              in_feat0.template data_ptr<scalar_t>(),
+              in_feat1.template data_ptr<scalar_t>(),
+              grad_in_feat0.template data_ptr<scalar_t>(),
+              grad_in_feat1.template data_ptr<scalar_t>(),
+              grad_out_feat.template data_ptr<scalar_t>(), nchannel,
+              rows.first.data(), rows.second.data(), tot_n, op);
+        });
+  else
+    WARNING(true,
+            "MinkowskiElementwise: Backprop from a size-0 sparse tensor.");
+
+  return std::make_pair(grad_in_feat0, grad_in_feat1);
+}
+
+template at::Tensor ElementwiseForwardCPU<default_types::dcoordinate_type>(
+    at::Tensor const &in_feat0, at::Tensor const &in_feat1,
+    BinaryMode::Type const op, JoinMode::Type const join,
+    CoordinateMapKey *p_in_map_key0, //
+    CoordinateMapKey *p_in_map_key1, //
+    CoordinateMapKey *p_out_map_key, //
+    cpu_manager_type<default_types::dcoordinate_type> *p_map_manager);
+
+template std::pair<at::Tensor, at::Tensor>
+ElementwiseBackwardCPU<default_types::dcoordinate_type>(
+    at::Tensor &grad_out_feat, at::Tensor const &in_feat0,
+    at::Tensor const &in_feat1, BinaryMode::Type const op,
+    JoinMode::Type const join,
+    CoordinateMapKey *p_in_map_key0, //
+    CoordinateMapKey *p_in_map_key1, //
+    CoordinateMapKey *p_out_map_key, //
+    cpu_manager_type<default_types::dcoordinate_type> *p_map_manager);
+
+} // end namespace minkowski
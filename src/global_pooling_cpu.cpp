@@ -47,6 +47,7 @@ GlobalPoolingForwardCPU(at::Tensor const &in_feat,
                         CoordinateMapKey *p_in_map_key,       //
                         CoordinateMapKey *p_out_map_key,      //
                         cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
 
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
   ASSERT(!in_feat.is_cuda(), "in_feat must be on CPU");
@@ -108,121 +109,42 @@ GlobalPoolingForwardCPU(at::Tensor const &in_feat,
     }
 
   } else {
-    // batch_size > 1
-    // TODO Default to specific pooling mode conversion.
-    // Regular case
-    // if (pooling_mode == 0)
-    //   pooling_mode = in_feat.size(0) / batch_size > 100 ? 1 : 2;
+    // Rows of each batch as a segment. No gather copies nor kernel maps.
+    cpu_parent_map const &segments =
+        p_map_manager->batch_segments(p_in_map_key);
+    ASSERT(segments.out_nrows() == batch_size, "Invalid batch_size");
 
-    // origin kernel map
-    if (pooling_mode == PoolingMode::GLOBAL_SUM_POOLING_KERNEL ||
-        pooling_mode == PoolingMode::GLOBAL_AVG_POOLING_KERNEL ||
-        pooling_mode == PoolingMode::GLOBAL_SUM_POOLING_PYTORCH_INDEX ||
-        pooling_mode == PoolingMode::GLOBAL_AVG_POOLING_PYTORCH_INDEX) {
-      auto out_feat =
-          torch::zeros({batch_size, in_feat.size(1)}, in_feat.options());
-      auto num_nonzero = torch::zeros({batch_size}, in_feat.options());
-
-      // If the policy is GlobalPoolingMode.INDEX_SELECT
-      switch (pooling_mode) {
-      case PoolingMode::GLOBAL_SUM_POOLING_PYTORCH_INDEX:
-      case PoolingMode::GLOBAL_AVG_POOLING_PYTORCH_INDEX: {
-        std::vector<at::Tensor> vec_maps;
-        at::Tensor batch_index;
-        LOG_DEBUG("get origin_map_th");
-        if (is_field) {
-          auto batch_map_pair =
-              p_map_manager->origin_field_map_th(p_in_map_key);
-          batch_index = batch_map_pair.first;
-          vec_maps = batch_map_pair.second;
-        } else {
-          auto batch_map_pair = p_map_manager->origin_map_th(p_in_map_key);
-          batch_index = batch_map_pair.first;
-          vec_maps = batch_map_pair.second;
-        }
-        ASSERT(batch_index.numel() == batch_size, "Invalid batch_size");
-        LOG_DEBUG("batch wise avg.", vec_maps.size());
-        for (int b = 0; b < batch_size; ++b) {
-          LOG_DEBUG("batch ", b, "size", vec_maps[b].numel());
-          if (use_avg)
-            out_feat[batch_index[b]] =
-                in_feat.index_select(0, vec_maps[b]).mean(0);
-          else
-            out_feat[batch_index[b]] =
-                in_feat.index_select(0, vec_maps[b]).sum(0);
-          num_nonzero[batch_index[b]] = vec_maps[b].numel();
-        }
-      } break;
-      case PoolingMode::GLOBAL_SUM_POOLING_KERNEL:
-      case PoolingMode::GLOBAL_AVG_POOLING_KERNEL: {
-        if (is_field) {
-          const auto &in_outs = p_map_manager->origin_field_map(p_in_map_key);
-          AT_DISPATCH_FLOATING_TYPES(
-              in_feat.scalar_type(), "global_pooling_forward_cpu", [&] {
-                NonzeroAvgPoolingForwardKernelCPU<scalar_t, int>(
-                    in_feat.template data_ptr<scalar_t>(),
-                    out_feat.template data_ptr<scalar_t>(),
-                    num_nonzero.template data_ptr<scalar_t>(), in_feat.size(1),
-                    in_outs.first, in_outs.second, batch_size, use_avg);
-              });
-        } else {
-          const auto &in_outs = p_map_manager->origin_map(p_in_map_key);
-          AT_DISPATCH_FLOATING_TYPES(
-              in_feat.scalar_type(), "global_pooling_forward_cpu", [&] {
-                NonzeroAvgPoolingForwardKernelCPU<scalar_t, int>(
-                    in_feat.template data_ptr<scalar_t>(),
-                    out_feat.template data_ptr<scalar_t>(),
-                    num_nonzero.template data_ptr<scalar_t>(), in_feat.size(1),
-                    in_outs.first, in_outs.second, batch_size, use_avg);
-              });
-        }
-      } break;
-      default:
-        ASSERT(false, "Invalid pooling mode");
-      }
-      return {out_feat, num_nonzero};
-    } else {
-      // Max pool
-      auto out_feat =
-          torch::zeros({batch_size, in_feat.size(1)}, in_feat.options());
+    auto out_feat =
+        torch::empty({batch_size, in_feat.size(1)}, in_feat.options());
+    if (pooling_mode == PoolingMode::GLOBAL_MAX_POOLING_DEFAULT ||
+        pooling_mode == PoolingMode::GLOBAL_MAX_POOLING_KERNEL ||
+        pooling_mode == PoolingMode::GLOBAL_MAX_POOLING_PYTORCH_INDEX) {
       at::Tensor max_index = torch::empty({batch_size, in_feat.size(1)},
                                           torch::TensorOptions()
                                               .device(in_feat.device())
                                               .dtype(torch::kInt)
                                               .requires_grad(false));
-
-      switch (pooling_mode) {
-      case PoolingMode::GLOBAL_MAX_POOLING_KERNEL:
-        // TODO
-      case PoolingMode::GLOBAL_MAX_POOLING_PYTORCH_INDEX: {
-        if (is_field) {
-          const auto &in_outs = p_map_manager->origin_field_map(p_in_map_key);
-          AT_DISPATCH_FLOATING_TYPES(
-              in_feat.scalar_type(), "global_pooling_forward_cpu", [&] {
-                MaxPoolingForwardKernelCPU<scalar_t, int32_t,
-                                           default_types::index_type>(
-                    in_feat.template data_ptr<scalar_t>(),
-                    out_feat.template data_ptr<scalar_t>(),
-                    max_index.template data_ptr<int32_t>(), in_feat.size(1),
-                    in_outs.first, in_outs.second, batch_size);
-              });
-        } else {
-          const auto &in_outs = p_map_manager->origin_map(p_in_map_key);
-          AT_DISPATCH_FLOATING_TYPES(
-              in_feat.scalar_type(), "global_pooling_forward_cpu", [&] {
-                MaxPoolingForwardKernelCPU<scalar_t, int32_t,
-                                           default_types::index_type>(
-                    in_feat.template data_ptr<scalar_t>(),
-                    out_feat.template data_ptr<scalar_t>(),
-                    max_index.template data_ptr<int32_t>(), in_feat.size(1),
-                    in_outs.first, in_outs.second, batch_size);
-              });
-        }
-      } break;
-      default:
-        ASSERT(false, "Invalid pooling mode");
-      }
+      AT_DISPATCH_FLOATING_TYPES(
+          in_feat.scalar_type(), "global_pooling_forward_cpu", [&] {
+            StrideMaxPoolingForwardKernelCPU<scalar_t, int32_t, false>(
+                in_feat.template data_ptr<scalar_t>(),
+                out_feat.template data_ptr<scalar_t>(),
+                max_index.template data_ptr<int32_t>(), in_feat.size(1),
+                segments);
+          });
       return {out_feat, max_index};
+    } else {
+      // num_nonzero is only filled for the average pooling
+      auto num_nonzero = torch::zeros({batch_size}, in_feat.options());
+      AT_DISPATCH_FLOATING_TYPES(
+          in_feat.scalar_type(), "global_pooling_forward_cpu", [&] {
+            StrideAvgPoolingForwardKernelCPU<scalar_t>(
+                in_feat.template data_ptr<scalar_t>(),
+                out_feat.template data_ptr<scalar_t>(),
+                num_nonzero.template data_ptr<scalar_t>(), in_feat.size(1),
+                segments, use_avg);
+          });
+      return {out_feat, num_nonzero};
     }
   }
 }
@@ -235,6 +157,7 @@ GlobalPoolingBackwardCPU(at::Tensor const &in_feat, at::Tensor &grad_out_feat,
                          CoordinateMapKey *p_in_map_key,       //
                          CoordinateMapKey *p_out_map_key,      //
                          cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
 
   ASSERT(!grad_out_feat.is_cuda(), "grad_out_feat must be on CPU");
   ASSERT(grad_out_feat.dim() == 2,
@@ -268,8 +191,6 @@ GlobalPoolingBackwardCPU(at::Tensor const &in_feat, at::Tensor &grad_out_feat,
              pooling_mode == PoolingMode::GLOBAL_MAX_POOLING_PYTORCH_INDEX,
          "Invalid pooling mode");
 
-  bool const is_field = p_map_manager->exists_field(in_key);
-
   const auto batch_size = p_map_manager->size(out_key);
   bool const use_avg =
       pooling_mode == PoolingMode::GLOBAL_AVG_POOLING_DEFAULT ||
@@ -297,41 +218,42 @@ GlobalPoolingBackwardCPU(at::Tensor const &in_feat, at::Tensor &grad_out_feat,
       } else
         grad_in_feat.copy_(grad_out_feat);
     } else {
-      if (is_field) {
-        const auto &in_outs = p_map_manager->origin_field_map(p_in_map_key);
-        grad_in_feat.zero_();
-        AT_DISPATCH_FLOATING_TYPES(
-            in_feat.scalar_type(), "global_pooling_backward_cpu", [&] {
-              NonzeroAvgPoolingBackwardKernelCPU<scalar_t, int>(
-                  grad_in_feat.template data_ptr<scalar_t>(), in_feat.size(0),
-                  grad_out_feat.template data_ptr<scalar_t>(),
-                  num_nonzero.template data_ptr<scalar_t>(), in_feat.size(1),
-                  in_outs.first, in_outs.second, use_avg);
-            });
-
-      } else {
-        const auto &in_outs = p_map_manager->origin_map(p_in_map_key);
-        grad_in_feat.zero_();
-        AT_DISPATCH_FLOATING_TYPES(
-            in_feat.scalar_type(), "global_pooling_backward_cpu", [&] {
-              NonzeroAvgPoolingBackwardKernelCPU<scalar_t, int>(
-                  grad_in_feat.template data_ptr<scalar_t>(), in_feat.size(0),
-                  grad_out_feat.template data_ptr<scalar_t>(),
-                  num_nonzero.template data_ptr<scalar_t>(), in_feat.size(1),
-                  in_outs.first, in_outs.second, use_avg);
-            });
-      }
+      // Each row copies the gradient of its batch
+      cpu_parent_map const &segments =
+          p_map_manager->batch_segments(p_in_map_key);
+      AT_DISPATCH_FLOATING_TYPES(
+          in_feat.scalar_type(), "global_pooling_backward_cpu", [&] {
+            StrideAvgPoolingBackwardKernelCPU<scalar_t>(
+                grad_in_feat.template data_ptr<scalar_t>(),
+                grad_out_feat.template data_ptr<scalar_t>(),
+                num_nonzero.template data_ptr<scalar_t>(), in_feat.size(1),
+                segments, use_avg);
+          });
     }
   } else {
     grad_in_feat.zero_();
-    AT_DISPATCH_FLOATING_TYPES(
-        in_feat.scalar_type(), "global_pooling_backward_cpu", [&] {
-          MaxPoolingBackwardKernelCPU<scalar_t, int32_t>(
-              grad_in_feat.template data_ptr<scalar_t>(), in_feat.size(0),
-              grad_out_feat.template data_ptr<scalar_t>(),
-              grad_out_feat.size(0), num_nonzero.template data_ptr<int32_t>(),
-              in_feat.size(1));
-        });
+    if (batch_size == 1) {
+      AT_DISPATCH_FLOATING_TYPES(
+          in_feat.scalar_type(), "global_pooling_backward_cpu", [&] {
+            MaxPoolingBackwardKernelCPU<scalar_t, int32_t>(
+                grad_in_feat.template data_ptr<scalar_t>(), in_feat.size(0),
+                grad_out_feat.template data_ptr<scalar_t>(),
+                grad_out_feat.size(0),
+                num_nonzero.template data_ptr<int32_t>(), in_feat.size(1));
+          });
+    } else {
+      // Each row reads the max index of its batch
+      cpu_parent_map const &segments =
+          p_map_manager->batch_segments(p_in_map_key);
+      AT_DISPATCH_FLOATING_TYPES(
+          in_feat.scalar_type(), "global_pooling_backward_cpu", [&] {
+            StrideMaxPoolingBackwardKernelCPU<scalar_t, int32_t>(
+                grad_in_feat.template data_ptr<scalar_t>(),
+                grad_out_feat.template data_ptr<scalar_t>(),
+                num_nonzero.template data_ptr<int32_t>(), in_feat.size(1),
+                segments);
+          });
+    }
   }
   return grad_in_feat;
 }
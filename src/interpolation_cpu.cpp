@@ -33,6 +33,8 @@
 
 #include "interpolation_kernel.hpp"
 
+#include <algorithm>
+
 #include <pybind11/pybind11.h>
 #include <torch/extension.h>
 
@@ -43,7 +45,9 @@ std::vector<at::Tensor>
 InterpolationForwardCPU(at::Tensor const &in_feat,      //
                         at::Tensor const &tfield,       //
                         CoordinateMapKey *p_in_map_key, //
+                        CoordinateMapKey *p_field_map_key,
                         cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
 
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
   ASSERT(!in_feat.is_cuda(), "in_feat must be CPU");
@@ -62,28 +66,45 @@ InterpolationForwardCPU(at::Tensor const &in_feat,      //
   ASSERT(in_feat.size(0) == p_map_manager->size(in_key), "Invalid in_feat size",
          in_feat.size(0), "!=", p_map_manager->size(in_key));
 
+  // Reuse the map of a registered coordinate field when available
   auto map_weight =
-      p_map_manager->interpolation_map_weight(tfield, p_in_map_key);
+      p_field_map_key != nullptr
+          ? p_map_manager->field_interpolation_map_weight(p_field_map_key,
+                                                          p_in_map_key)
+          : p_map_manager->interpolation_map_weight(tfield, p_in_map_key);
+  if (map_weight[2].scalar_type() != in_feat.scalar_type())
+    map_weight[2] = map_weight[2].to(in_feat.scalar_type());
+
+  // The output row ranges are built with the map, sorted by the output row
+  auto const &out_offsets = map_weight[3];
+  ASSERT(out_offsets.numel() == tfield.size(0) + 1,
+         "Invalid interpolation map offsets size", out_offsets.numel());
+#ifdef DEBUG
+  auto const &out_maps = map_weight[1];
+  ASSERT(std::is_sorted(out_maps.data_ptr<int>(),
+                        out_maps.data_ptr<int>() + out_maps.numel()),
+         "The interpolation map must be sorted by the output row.");
+#endif
 
   LOG_DEBUG("out_feat with size", tfield.size(0), in_feat.size(1));
   auto out_feat =
-      torch::zeros({tfield.size(0), in_feat.size(1)}, tfield.options());
+      torch::empty({tfield.size(0), in_feat.size(1)}, tfield.options());
 
   AT_DISPATCH_FLOATING_TYPES(
       in_feat.scalar_type(), "interpolation_forward_cpu", [&] {
         LOG_DEBUG("InterpolationForwardKernelCPU");
         InterpolationForwardKernelCPU<scalar_t, scalar_t, int>(
             in_feat.template data_ptr<scalar_t>(),
-            out_feat.template data_ptr<scalar_t>(), in_feat.size(1),
-            map_weight[0].template data_ptr<int>(),      // in
-            map_weight[1].template data_ptr<int>(),      // out
-            map_weight[2].template data_ptr<scalar_t>(), // weight
-            map_weight[0].numel());
+            out_feat.template data_ptr<scalar_t>(), tfield.size(0),
+            in_feat.size(1),
+            map_weight[0].template data_ptr<int>(),       // in
+            out_offsets.template data_ptr<int>(),         // offsets
+            map_weight[2].template data_ptr<scalar_t>()); // weight
       });
 
-  // to out_feats
-  map_weight.insert(map_weight.begin(), out_feat);
-  return map_weight;
+  // out_feat, in_map, out_map, weight, in_offsets, in_entries
+  return {out_feat,      map_weight[0], map_weight[1],
+          map_weight[2], map_weight[4], map_weight[5]};
 }
 
 template <typename coordinate_type>
@@ -92,8 +113,11 @@ InterpolationBackwardCPU(at::Tensor &grad_out_feat,      //
                          at::Tensor const &in_map,       //
                          at::Tensor const &out_map,      //
                          at::Tensor const &weight,       //
+                         at::Tensor const &in_offsets,   //
+                         at::Tensor const &in_entries,   //
                          CoordinateMapKey *p_in_map_key, //
                          cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
 
   if (!grad_out_feat.is_contiguous())
     grad_out_feat = grad_out_feat.contiguous();
@@ -106,9 +130,24 @@ InterpolationBackwardCPU(at::Tensor &grad_out_feat,      //
   uint32_t const in_nrows = p_map_manager->size(in_key);
   uint32_t const nchannel = grad_out_feat.size(1);
 
+  // Group the map by the input row unless the grouping of the map is given
+  at::Tensor grouped_offsets = in_offsets, grouped_entries = in_entries;
+  if (grouped_offsets.numel() == 0) {
+    grouped_offsets = torch::empty({in_nrows + 1}, in_map.options());
+    grouped_entries = torch::empty({in_map.numel()}, in_map.options());
+    detail::interpolation_group_by_input_cpu<int>(
+        in_map.template data_ptr<int>(), in_nrows, in_map.numel(),
+        grouped_offsets.template data_ptr<int>(),
+        grouped_entries.template data_ptr<int>());
+  }
+  ASSERT(grouped_offsets.numel() == in_nrows + 1,
+         "Invalid interpolation map offsets size", grouped_offsets.numel());
+  ASSERT(grouped_entries.numel() == in_map.numel(),
+         "Invalid interpolation map entries size", grouped_entries.numel());
+
   LOG_DEBUG("grad_in_feat with size", in_nrows, nchannel);
   auto grad_in_feat =
-      torch::zeros({in_nrows, nchannel}, grad_out_feat.options());
+      torch::empty({in_nrows, nchannel}, grad_out_feat.options());
 
   AT_DISPATCH_FLOATING_TYPES(
       grad_out_feat.scalar_type(), "interpolation_backward_cpu", [&] {
@@ -116,10 +155,10 @@ InterpolationBackwardCPU(at::Tensor &grad_out_feat,      //
         InterpolationBackwardKernelCPU<scalar_t, scalar_t, int>(
             grad_in_feat.template data_ptr<scalar_t>(), in_nrows, nchannel,
             grad_out_feat.template data_ptr<scalar_t>(),
-            in_map.template data_ptr<int>(),      // in
             out_map.template data_ptr<int>(),     // out
             weight.template data_ptr<scalar_t>(), // weight
-            in_map.numel());
+            grouped_offsets.template data_ptr<int>(),
+            grouped_entries.template data_ptr<int>());
       });
 
   // to out_feats
@@ -130,6 +169,7 @@ template std::vector<at::Tensor>
 InterpolationForwardCPU<int32_t>(at::Tensor const &in_feat,      //
                                  at::Tensor const &tfield,       //
                                  CoordinateMapKey *p_in_map_key, //
+                                 CoordinateMapKey *p_field_map_key,
                                  cpu_manager_type<int32_t> *p_map_manager);
 
 template at::Tensor
@@ -137,6 +177,8 @@ InterpolationBackwardCPU<int32_t>(at::Tensor &grad_out_feat,      //
                                   at::Tensor const &in_map,       //
                                   at::Tensor const &out_map,      //
                                   at::Tensor const &weight,       //
+                                  at::Tensor const &in_offsets,   //
+                                  at::Tensor const &in_entries,   //
                                   CoordinateMapKey *p_in_map_key, //
                                   cpu_manager_type<int32_t> *p_map_manager);
 } // end namespace minkowski
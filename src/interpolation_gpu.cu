@@ -45,6 +45,7 @@ std::vector<at::Tensor> InterpolationForwardGPU(
     at::Tensor const &in_feat,      //
     at::Tensor const &tfield,       //
     CoordinateMapKey *p_in_map_key, //
+    CoordinateMapKey *p_field_map_key,
     gpu_manager_type<coordinate_type, TemplatedAllocator> *p_map_manager) {
 
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
@@ -67,8 +68,14 @@ std::vector<at::Tensor> InterpolationForwardGPU(
   ASSERT(in_feat.size(0) == p_map_manager->size(in_key), "Invalid in_feat size",
          in_feat.size(0), "!=", p_map_manager->size(in_key));
 
+  // Reuse the map of a registered coordinate field when available
   auto map_weight =
-      p_map_manager->interpolation_map_weight(tfield, p_in_map_key);
+      p_field_map_key != nullptr
+          ? p_map_manager->field_interpolation_map_weight(p_field_map_key,
+                                                          p_in_map_key)
+          : p_map_manager->interpolation_map_weight(tfield, p_in_map_key);
+  if (map_weight[2].scalar_type() != in_feat.scalar_type())
+    map_weight[2] = map_weight[2].to(in_feat.scalar_type());
 
   auto const &in_maps = map_weight[0];
   auto const &out_maps = map_weight[1];
@@ -115,6 +122,7 @@ InterpolationForwardGPU<default_types::dcoordinate_type,
     at::Tensor const &in_feat,      //
     at::Tensor const &tfield,       //
     CoordinateMapKey *p_in_map_key, //
+    CoordinateMapKey *p_field_map_key,
     gpu_manager_type<default_types::dcoordinate_type, detail::default_allocator>
         *p_map_manager);
 
@@ -124,6 +132,7 @@ InterpolationForwardGPU<default_types::dcoordinate_type,
     at::Tensor const &in_feat,      //
     at::Tensor const &tfield,       //
     CoordinateMapKey *p_in_map_key, //
+    CoordinateMapKey *p_field_map_key,
     gpu_manager_type<default_types::dcoordinate_type, detail::c10_allocator>
         *p_map_manager);
 
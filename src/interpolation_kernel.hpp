@@ -27,101 +27,104 @@
 
 #include "math_functions.hpp"
 
+#include <algorithm>
 #include <limits>
+#include <vector>
 
 namespace minkowski {
 
 /**
- * CPU pooling function. The p_out_feat must be initialized and set to 0.
- * p_num_nonzero is set to 0 inside this function.
- *
- * TODO consistent memset
+ * Weighted gather for each output row. The entries of the output row i are
+ * [offsets[i], offsets[i + 1]) of a map sorted by the output row, e.g. the map
+ * from interpolation_map_weight. Every output row is written once.
  */
 template <typename Dtype, typename Wtype, typename Itype>
 void InterpolationForwardKernelCPU(Dtype const *const p_in_feat,
                                    Dtype *p_out_feat,           //
+                                   uint32_t const out_nrows,    //
                                    uint32_t const nchannel,     //
                                    Itype const *const in_maps,  //
-                                   Itype const *const out_maps, //
-                                   Wtype const *const weights,  //
-                                   uint32_t const nnz) {
-  const Dtype *p_curr_in;
-  Dtype *p_curr_out;
-
-  // Set all values to - Dtype min
-  // std::fill(p_out_feat, p_out_feat + nnz * nchannel, 0);
-
-  // Iterate through each spatial kernel out of filter_volume spatial kernels
-  for (uint32_t i = 0; i < nnz; ++i) {
-    // Define current pointers
-    p_curr_in = p_in_feat + in_maps[i] * nchannel;
-    p_curr_out = p_out_feat + out_maps[i] * nchannel;
-    cpu_axpy<Dtype>(nchannel, (Dtype)weights[i], p_curr_in, p_curr_out);
+                                   Itype const *const offsets,  //
+                                   Wtype const *const weights) {
+#pragma omp parallel for
+  for (int64_t i = 0; i < (int64_t)out_nrows; ++i) {
+    Dtype *p_curr_out = p_out_feat + i * nchannel;
+    std::fill_n(p_curr_out, nchannel, 0);
+    for (Itype k = offsets[i]; k < offsets[i + 1]; ++k) {
+      Dtype const *p_curr_in = p_in_feat + in_maps[k] * nchannel;
+      Dtype const weight = weights[k];
+#pragma omp simd
+      for (uint32_t j = 0; j < nchannel; ++j)
+        p_curr_out[j] += weight * p_curr_in[j];
+    }
   }
 }
 
+/**
+ * Each input row gradient is accumulated by a single thread. The map entries
+ * of the input row i are in_entries[in_offsets[i]:in_offsets[i + 1]].
+ */
 template <typename Dtype, typename Wtype, typename Itype>
 void InterpolationBackwardKernelCPU(Dtype *p_grad_in_feat,
                                     uint32_t const in_nrows,
                                     uint32_t const nchannel, //
                                     Dtype const *const p_grad_out_feat,
-                                    Itype const *const in_maps, //
-                                    Itype const *const out_maps,
+                                    Itype const *const out_maps, //
                                     Wtype const *const weights,
-                                    uint32_t const nnz) {
-  Dtype *p_curr_grad_in;
-  Dtype const *p_curr_grad_out;
-
-  // cleanup gradients
-  // std::fill(p_grad_in_feat, p_grad_in_feat + in_nrows * nchannel, 0);
-
-  for (uint32_t i = 0; i < nnz; ++i) {
-    // Define current pointers
-    p_curr_grad_in = p_grad_in_feat + in_maps[i] * nchannel;
-    p_curr_grad_out = p_grad_out_feat + out_maps[i] * nchannel;
-
-    cpu_axpy<Dtype>(nchannel, (Dtype)weights[i], p_curr_grad_out,
-                    p_curr_grad_in);
+                                    Itype const *const in_offsets,
+                                    Itype const *const in_entries) {
+#pragma omp parallel for
+  for (int64_t i = 0; i < (int64_t)in_nrows; ++i) {
+    Dtype *p_curr_grad_in = p_grad_in_feat + i * nchannel;
+    std::fill_n(p_curr_grad_in, nchannel, 0);
+    for (Itype e = in_offsets[i]; e < in_offsets[i + 1]; ++e) {
+      Itype const k = in_entries[e];
+      Dtype const *p_curr_grad_out = p_grad_out_feat + out_maps[k] * nchannel;
+      Dtype const weight = weights[k];
+#pragma omp simd
+      for (uint32_t j = 0; j < nchannel; ++j)
+        p_curr_grad_in[j] += weight * p_curr_grad_out[j];
+    }
   }
 }
 
 template void
 InterpolationForwardKernelCPU<float, float, int>(float const *const p_in_feat,
                                                  float *p_out_feat,          //
+                                                 uint32_t const out_nrows,   //
                                                  uint32_t const nchannel,    //
                                                  int const *const in_maps,   //
-                                                 int const *const out_maps,  //
-                                                 float const *const weights, //
-                                                 uint32_t const nnz);
+                                                 int const *const offsets,   //
+                                                 float const *const weights);
 
 template void
 InterpolationForwardKernelCPU<double, float, int>(double const *const p_in_feat,
                                                   double *p_out_feat,         //
+                                                  uint32_t const out_nrows,   //
                                                   uint32_t const nchannel,    //
                                                   int const *const in_maps,   //
-                                                  int const *const out_maps,  //
-                                                  float const *const weights, //
-                                                  uint32_t const nnz);
+                                                  int const *const offsets,   //
+                                                  float const *const weights);
 
 template void InterpolationBackwardKernelCPU<float, float, int>(
     float *p_grad_in_feat,   //
     uint32_t const in_nrows, //
     uint32_t const nchannel, //
     float const *const p_grad_out_feat,
-    int const *const in_maps,   //
-    int const *const out_maps,  //
-    float const *const weights, //
-    uint32_t const nnz);
+    int const *const out_maps,   //
+    float const *const weights,  //
+    int const *const in_offsets, //
+    int const *const in_entries);
 
 template void InterpolationBackwardKernelCPU<double, float, int>(
     double *p_grad_in_feat,  //
     uint32_t const in_nrows, //
     uint32_t const nchannel, //
     double const *const p_grad_out_feat,
-    int const *const in_maps,   //
-    int const *const out_maps,  //
-    float const *const weights, //
-    uint32_t const nnz);
+    int const *const out_maps,   //
+    float const *const weights,  //
+    int const *const in_offsets, //
+    int const *const in_entries);
 
 } // namespace minkowski
 
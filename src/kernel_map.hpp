@@ -28,8 +28,11 @@
 
 #include "types.hpp"
 
+#include <algorithm>
+#include <omp.h>
 #include <ostream>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 namespace minkowski {
@@ -53,38 +56,52 @@ struct cpu_kernel_map : std::pair<cpu_in_maps, cpu_out_maps> {
       : std::pair<cpu_in_maps, cpu_out_maps>(other) {}
 
   // origin map initialization.
-  cpu_kernel_map(std::vector<index_pair> &in_out,
-                 std::vector<default_types::dcoordinate_type> const
-                     &unique_batch_indicies) {
-    auto comp = [](std::pair<index_type, index_type> const &l,
-                   std::pair<index_type, index_type> const &r) {
-      return l.second < r.second;
-    };
-    std::sort(in_out.begin(), in_out.end(), comp);
-
-    auto const kernel_volume = unique_batch_indicies.size();
-    this->first.resize(kernel_volume);
-    this->second.resize(kernel_volume);
-
-    for (index_type k = 0; k < unique_batch_indicies.size(); ++k) {
-      auto const lb = std::lower_bound(in_out.begin(), in_out.end(),
-                                       index_pair{0, k}, comp);
-      auto const ub = std::upper_bound(in_out.begin(), in_out.end(),
-                                       index_pair{0, k}, comp);
-      auto const curr_size = ub - lb;
-      default_types::index_type start_index = lb - in_out.begin();
-      LOG_DEBUG("batch row_index:", k, "curr_size:", curr_size,
-                "start_index:", start_index);
-      // resize
-      auto &in_map = this->first[k];
-      auto &out_map = this->second[k];
-      in_map.resize(curr_size);
-      out_map.resize(curr_size);
-      // copy
-      for (uint32_t i = 0; i < curr_size; ++i) {
-        auto const &curr_pair = in_out[i + start_index];
-        in_map[i] = curr_pair.first;
-        out_map[i] = curr_pair.second;
+  //
+  // parents[i] is the origin (batch) row of the row i. The rows of each origin
+  // row are written in increasing order with a parallel counting sort: every
+  // chunk of rows counts its rows per origin row, and a prefix sum over the
+  // chunks gives each chunk a disjoint range of the final per-batch arrays.
+  cpu_kernel_map(std::vector<index_type> const &parents,
+                 index_type const origin_nrows) {
+    this->first.resize(origin_nrows);
+    this->second.resize(origin_nrows);
+
+    index_type const in_nrows = parents.size();
+    index_type const num_chunks =
+        std::max<index_type>(1, std::min<index_type>(omp_get_max_threads(),
+                                                     in_nrows / 4096));
+    index_type const chunk_size = (in_nrows + num_chunks - 1) / num_chunks;
+
+    // counts[n * origin_nrows + k]: rows of the chunk n in the origin row k
+    std::vector<index_type> counts(num_chunks * origin_nrows, 0);
+#pragma omp parallel for num_threads(num_chunks)
+    for (index_type n = 0; n < num_chunks; ++n) {
+      index_type *p_counts = counts.data() + n * origin_nrows;
+      index_type const end = std::min(in_nrows, (n + 1) * chunk_size);
+      for (index_type i = n * chunk_size; i < end; ++i)
+        ++p_counts[parents[i]];
+    }
+
+    // exclusive prefix sum over the chunks of each origin row
+    for (index_type k = 0; k < origin_nrows; ++k) {
+      index_type curr_size = 0;
+      for (index_type n = 0; n < num_chunks; ++n) {
+        index_type const count = counts[n * origin_nrows + k];
+        counts[n * origin_nrows + k] = curr_size;
+        curr_size += count;
+      }
+      LOG_DEBUG("batch row_index:", k, "curr_size:", curr_size);
+      this->first[k].resize(curr_size);
+      this->second[k].resize(curr_size, k);
+    }
+
+#pragma omp parallel for num_threads(num_chunks)
+    for (index_type n = 0; n < num_chunks; ++n) {
+      index_type *p_cursor = counts.data() + n * origin_nrows;
+      index_type const end = std::min(in_nrows, (n + 1) * chunk_size);
+      for (index_type i = n * chunk_size; i < end; ++i) {
+        index_type const k = parents[i];
+        this->first[k][p_cursor[k]++] = i;
       }
     }
   }
@@ -103,6 +120,103 @@ struct cpu_kernel_map : std::pair<cpu_in_maps, cpu_out_maps> {
 
 using cpu_kernel_map_reference = std::pair<cpu_in_maps &, cpu_out_maps &>;
 
+/*
+ * Kernel map grouped by the destination row in CSR format.
+ *
+ * rows[offsets[i]:offsets[i + 1]] are the source rows that map to the
+ * destination row i. Within a destination row, pairs are ordered by the kernel
+ * offset, which keeps reductions over a row deterministic.
+ *
+ * Use (in_maps, out_maps) to group by the output row and (out_maps, in_maps)
+ * to group by the input row.
+ */
+struct cpu_grouped_kernel_map {
+  using index_type = default_types::index_type;
+
+  cpu_grouped_kernel_map(cpu_in_maps const &src_maps,
+                         cpu_out_maps const &dst_maps,
+                         index_type const dst_nrows)
+      : offsets(dst_nrows + 1, 0) {
+    index_type const kernel_volume = src_maps.size();
+    // counting sort by the destination row
+    for (index_type k = 0; k < kernel_volume; ++k)
+      for (auto const dst : dst_maps[k])
+        ++offsets[dst + 1];
+    for (index_type i = 0; i < dst_nrows; ++i)
+      offsets[i + 1] += offsets[i];
+
+    rows.resize(offsets[dst_nrows]);
+    std::vector<index_type> cursor(offsets.begin(), offsets.end() - 1);
+    for (index_type k = 0; k < kernel_volume; ++k) {
+      auto const &src_map = src_maps[k];
+      auto const &dst_map = dst_maps[k];
+      for (index_type i = 0; i < src_map.size(); ++i) {
+        rows[cursor[dst_map[i]]++] = src_map[i];
+      }
+    }
+  }
+
+  index_type nrows() const { return offsets.size() - 1; }
+  index_type size() const { return rows.size(); }
+
+  // the maximum number of source rows of a destination row
+  index_type max_row_size() const {
+    index_type max_size = 0;
+    for (index_type i = 0; i < nrows(); ++i)
+      max_size = std::max(max_size, offsets[i + 1] - offsets[i]);
+    return max_size;
+  }
+
+  std::vector<index_type> offsets;
+  std::vector<index_type> rows;
+};
+
+/*
+ * Stride (pooling) map where each input row has exactly one output row.
+ *
+ * parents[i] is the output row of the input row i. children[offsets[j]:
+ * offsets[j + 1]] are the input rows of the output row j in increasing order,
+ * built with a counting sort over the parents.
+ *
+ * A map to the origin has the batch segments, i.e. the rows of each batch.
+ */
+struct cpu_parent_map {
+  using index_type = default_types::index_type;
+
+  cpu_parent_map() {}
+  cpu_parent_map(std::vector<index_type> &&in_parents,
+                 index_type const out_nrows)
+      : parents(std::move(in_parents)), offsets(out_nrows + 1, 0),
+        children(parents.size()) {
+    for (auto const parent : parents)
+      ++offsets[parent + 1];
+    for (index_type j = 0; j < out_nrows; ++j)
+      offsets[j + 1] += offsets[j];
+
+    std::vector<index_type> cursor(offsets.begin(), offsets.end() - 1);
+    for (index_type i = 0; i < parents.size(); ++i)
+      children[cursor[parents[i]]++] = i;
+  }
+
+  index_type in_nrows() const { return parents.size(); }
+  index_type out_nrows() const { return offsets.size() - 1; }
+  index_type num_children(index_type const out_row) const {
+    return offsets[out_row + 1] - offsets[out_row];
+  }
+
+  // the maximum number of input rows of an output row
+  index_type max_row_size() const {
+    index_type max_size = 0;
+    for (index_type j = 0; j < out_nrows(); ++j)
+      max_size = std::max(max_size, num_children(j));
+    return max_size;
+  }
+
+  std::vector<index_type> parents;
+  std::vector<index_type> offsets;
+  std::vector<index_type> children;
+};
+
 } // namespace minkowski
 
 #endif
@@ -35,11 +35,103 @@
 #include "pooling_avg_kernel.hpp"
 #include "pooling_max_kernel.hpp"
 
+#include <limits>
+
 #include <pybind11/pybind11.h>
 #include <torch/extension.h>
 
 namespace minkowski {
 
+namespace detail {
+
+// Pooling with kernel_size == kernel_stride. Each input row has a single
+// parent and the kernel map is not required.
+std::pair<at::Tensor, at::Tensor>
+stride_pooling_forward_cpu(at::Tensor const &in_feat, at::Tensor &out_feat,
+                           PoolingMode::Type pooling_mode,
+                           cpu_parent_map const &parent_map) {
+  auto const out_nrows = out_feat.size(0);
+  if (pooling_mode == PoolingMode::LOCAL_MAX_POOLING ||
+      pooling_mode == PoolingMode::LOCAL_MAX_POOLING_COMPACT_INDEX) {
+    if (pooling_mode == PoolingMode::LOCAL_MAX_POOLING_COMPACT_INDEX &&
+        parent_map.max_row_size() < std::numeric_limits<uint8_t>::max()) {
+      at::Tensor max_index = torch::empty(
+          {out_nrows, in_feat.size(1)},
+          in_feat.options().dtype(torch::kByte).requires_grad(false));
+      AT_DISPATCH_FLOATING_TYPES(
+          in_feat.scalar_type(), "local_pooling_forward_cpu", [&] {
+            StrideMaxPoolingForwardKernelCPU<scalar_t, uint8_t, true>(
+                in_feat.template data_ptr<scalar_t>(),
+                out_feat.template data_ptr<scalar_t>(),
+                max_index.data_ptr<uint8_t>(), in_feat.size(1), parent_map);
+          });
+      return std::make_pair(out_feat, max_index);
+    }
+
+    at::Tensor max_index = torch::empty(
+        {out_nrows, in_feat.size(1)},
+        in_feat.options().dtype(torch::kInt).requires_grad(false));
+    AT_DISPATCH_FLOATING_TYPES(
+        in_feat.scalar_type(), "local_pooling_forward_cpu", [&] {
+          StrideMaxPoolingForwardKernelCPU<scalar_t, int32_t, false>(
+              in_feat.template data_ptr<scalar_t>(),
+              out_feat.template data_ptr<scalar_t>(),
+              max_index.data_ptr<int32_t>(), in_feat.size(1), parent_map);
+        });
+    return std::make_pair(out_feat, max_index);
+  } else {
+    bool const use_avg = pooling_mode == PoolingMode::LOCAL_AVG_POOLING;
+    at::Tensor num_nonzero =
+        torch::empty({use_avg ? out_nrows : 0}, in_feat.options());
+    AT_DISPATCH_FLOATING_TYPES(
+        in_feat.scalar_type(), "local_pooling_forward_cpu", [&] {
+          StrideAvgPoolingForwardKernelCPU<scalar_t>(
+              in_feat.template data_ptr<scalar_t>(),
+              out_feat.template data_ptr<scalar_t>(),
+              num_nonzero.template data_ptr<scalar_t>(), in_feat.size(1),
+              parent_map, use_avg);
+        });
+    return std::make_pair(out_feat, num_nonzero);
+  }
+}
+
+void stride_pooling_backward_cpu(at::Tensor &grad_in_feat,
+                                 at::Tensor const &grad_out_feat,
+                                 at::Tensor const &num_nonzero,
+                                 PoolingMode::Type pooling_mode,
+                                 cpu_parent_map const &parent_map) {
+  if (pooling_mode == PoolingMode::LOCAL_MAX_POOLING ||
+      pooling_mode == PoolingMode::LOCAL_MAX_POOLING_COMPACT_INDEX) {
+    AT_DISPATCH_FLOATING_TYPES(
+        grad_in_feat.scalar_type(), "local_pooling_backward_cpu", [&] {
+          if (num_nonzero.scalar_type() == torch::kByte) {
+            StrideMaxPoolingCompactBackwardKernelCPU<scalar_t>(
+                grad_in_feat.template data_ptr<scalar_t>(),
+                grad_out_feat.template data_ptr<scalar_t>(),
+                num_nonzero.data_ptr<uint8_t>(), grad_in_feat.size(1),
+                parent_map);
+          } else {
+            StrideMaxPoolingBackwardKernelCPU<scalar_t, int32_t>(
+                grad_in_feat.template data_ptr<scalar_t>(),
+                grad_out_feat.template data_ptr<scalar_t>(),
+                num_nonzero.data_ptr<int32_t>(), grad_in_feat.size(1),
+                parent_map);
+          }
+        });
+  } else {
+    AT_DISPATCH_FLOATING_TYPES(
+        grad_in_feat.scalar_type(), "local_pooling_backward_cpu", [&] {
+          StrideAvgPoolingBackwardKernelCPU<scalar_t>(
+              grad_in_feat.template data_ptr<scalar_t>(),
+              grad_out_feat.template data_ptr<scalar_t>(),
+              num_nonzero.template data_ptr<scalar_t>(), grad_in_feat.size(1),
+              parent_map, pooling_mode == PoolingMode::LOCAL_AVG_POOLING);
+        });
+  }
+}
+
+} // namespace detail
+
 template <typename coordinate_type>
 std::pair<at::Tensor, at::Tensor>
 LocalPoolingForwardCPU(at::Tensor const &in_feat,
@@ -52,6 +144,7 @@ LocalPoolingForwardCPU(at::Tensor const &in_feat,
                        CoordinateMapKey *p_in_map_key,                    //
                        CoordinateMapKey *p_out_map_key,                   //
                        cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
 
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
   ASSERT(!in_feat.is_cuda(), "in_feat must be CPU");
@@ -70,6 +163,15 @@ LocalPoolingForwardCPU(at::Tensor const &in_feat,
     p_out_map_key->set_key(out_key);
   }
 
+  auto const out_nrows = p_map_manager->size(p_out_map_key->get_key());
+  if (kernel_stride == kernel_size) {
+    at::Tensor out_feat =
+        torch::empty({out_nrows, in_feat.size(1)}, in_feat.options());
+    return detail::stride_pooling_forward_cpu(
+        in_feat, out_feat, pooling_mode,
+        p_map_manager->stride_parent_map(p_in_map_key, p_out_map_key));
+  }
+
   cpu_kernel_map const &in_out = p_map_manager->kernel_map(
       p_in_map_key,    //
       p_out_map_key,   //
@@ -79,12 +181,37 @@ LocalPoolingForwardCPU(at::Tensor const &in_feat,
       region_type,     //
       offset, false /* is_transpose */, true /* is_pool */);
 
-  auto const out_nrows = p_map_manager->size(p_out_map_key->get_key());
   at::Tensor out_feat =
       torch::zeros({out_nrows, in_feat.size(1)}, in_feat.options());
   LOG_DEBUG("Allocated", out_nrows, "x", in_feat.size(1), "features.");
 
-  if (pooling_mode == PoolingMode::LOCAL_MAX_POOLING) {
+  if (pooling_mode == PoolingMode::LOCAL_MAX_POOLING ||
+      pooling_mode == PoolingMode::LOCAL_MAX_POOLING_COMPACT_INDEX) {
+    // Group the kernel map by the output row once for either max index
+    cpu_grouped_kernel_map const out_grouped_map(in_out.first, in_out.second,
+                                                 out_nrows);
+    if (pooling_mode == PoolingMode::LOCAL_MAX_POOLING_COMPACT_INDEX) {
+      // The compact max index stores the position of the max input within the
+      // output row in uint8 and is resolved through the kernel map in the
+      // backward pass.
+      if (out_grouped_map.max_row_size() <
+          std::numeric_limits<uint8_t>::max()) {
+        at::Tensor max_index = torch::empty(
+            {out_nrows, in_feat.size(1)},
+            in_feat.options().dtype(torch::kByte).requires_grad(false));
+        AT_DISPATCH_FLOATING_TYPES(
+            in_feat.scalar_type(), "local_pooling_forward_cpu", [&] {
+              MaxPoolingCompactForwardKernelCPU<scalar_t>(
+                  in_feat.template data_ptr<scalar_t>(),
+                  out_feat.template data_ptr<scalar_t>(),
+                  max_index.data_ptr<uint8_t>(), in_feat.size(1),
+                  out_grouped_map);
+            });
+        return std::make_pair(out_feat, max_index);
+      }
+      LOG_DEBUG("Too many inputs per output row. Use the int32 max index.");
+    }
+
     at::Tensor max_index = torch::empty(
         {0}, in_feat.options().dtype(torch::kInt).requires_grad(false));
     max_index.resize_({out_nrows, in_feat.size(1)});
@@ -92,12 +219,10 @@ LocalPoolingForwardCPU(at::Tensor const &in_feat,
 
     AT_DISPATCH_FLOATING_TYPES(
         in_feat.scalar_type(), "local_pooling_forward_cpu", [&] {
-          MaxPoolingForwardKernelCPU<scalar_t, int32_t,
-                                     default_types::index_type>(
+          MaxPoolingGroupedForwardKernelCPU<scalar_t, int32_t>(
               in_feat.template data_ptr<scalar_t>(),
               out_feat.template data_ptr<scalar_t>(),
-              max_index.data_ptr<int32_t>(), in_feat.size(1), in_out.first,
-              in_out.second, out_nrows);
+              max_index.data_ptr<int32_t>(), in_feat.size(1), out_grouped_map);
         });
     return std::make_pair(out_feat, max_index);
   } else {
@@ -133,6 +258,7 @@ LocalPoolingBackwardCPU(at::Tensor const &in_feat,                         //
                         CoordinateMapKey *p_in_map_key,                    //
                         CoordinateMapKey *p_out_map_key,                   //
                         cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
   ASSERT(grad_out_feat.is_contiguous(), "grad_out_feata must be contiguous");
 
@@ -149,6 +275,16 @@ LocalPoolingBackwardCPU(at::Tensor const &in_feat,                         //
   coordinate_map_key_type out_key = p_out_map_key->get_key();
   ASSERT(p_map_manager->exists(out_key), ERROR_MAP_NOT_FOUND);
 
+  at::Tensor grad_in_feat =
+      torch::zeros({in_feat.size(0), in_feat.size(1)}, in_feat.options());
+
+  if (kernel_stride == kernel_size) {
+    detail::stride_pooling_backward_cpu(
+        grad_in_feat, grad_out_feat, num_nonzero, pooling_mode,
+        p_map_manager->stride_parent_map(p_in_map_key, p_out_map_key));
+    return grad_in_feat;
+  }
+
   cpu_kernel_map const &in_out = p_map_manager->kernel_map(
       p_in_map_key,    //
       p_out_map_key,   //
@@ -158,17 +294,26 @@ LocalPoolingBackwardCPU(at::Tensor const &in_feat,                         //
       region_type,     //
       offset, false /* is_transpose */, true /* is_pool */);
 
-  at::Tensor grad_in_feat =
-      torch::zeros({in_feat.size(0), in_feat.size(1)}, in_feat.options());
-
-  if (pooling_mode == PoolingMode::LOCAL_MAX_POOLING) {
+  if (pooling_mode == PoolingMode::LOCAL_MAX_POOLING ||
+      pooling_mode == PoolingMode::LOCAL_MAX_POOLING_COMPACT_INDEX) {
+    // Each thread owns the input gradient rows it writes
+    cpu_grouped_kernel_map const out_grouped_map(in_out.first, in_out.second,
+                                                 grad_out_feat.size(0));
     AT_DISPATCH_FLOATING_TYPES(
         in_feat.scalar_type(), "local_pooling_backward_cpu", [&] {
-          MaxPoolingBackwardKernelCPU<scalar_t, int32_t>(
-              grad_in_feat.template data_ptr<scalar_t>(), in_feat.size(0),
-              grad_out_feat.template data_ptr<scalar_t>(),
-              grad_out_feat.size(0), num_nonzero.data_ptr<int32_t>(),
-              in_feat.size(1));
+          if (num_nonzero.scalar_type() == torch::kByte) {
+            MaxPoolingCompactBackwardKernelCPU<scalar_t>(
+                grad_in_feat.template data_ptr<scalar_t>(), in_feat.size(0),
+                grad_out_feat.template data_ptr<scalar_t>(),
+                num_nonzero.data_ptr<uint8_t>(), in_feat.size(1),
+                out_grouped_map);
+          } else {
+            MaxPoolingGroupedBackwardKernelCPU<scalar_t, int32_t>(
+                grad_in_feat.template data_ptr<scalar_t>(), in_feat.size(0),
+                grad_out_feat.template data_ptr<scalar_t>(),
+                num_nonzero.data_ptr<int32_t>(), in_feat.size(1),
+                out_grouped_map);
+          }
         });
   } else {
     AT_DISPATCH_FLOATING_TYPES(
@@ -90,7 +90,9 @@ std::pair<at::Tensor, at::Tensor> LocalPoolingForwardGPU(
 
   cudaStream_t stream = at::cuda::getCurrentCUDAStream().stream();
 
-  if (pooling_mode == PoolingMode::LOCAL_MAX_POOLING) {
+  // The compact max index is CPU only. Use the full max index on GPU.
+  if (pooling_mode == PoolingMode::LOCAL_MAX_POOLING ||
+      pooling_mode == PoolingMode::LOCAL_MAX_POOLING_COMPACT_INDEX) {
     at::Tensor max_index = torch::empty({0}, torch::TensorOptions()
                                                  .device(in_feat.device())
                                                  .dtype(torch::kInt)
@@ -181,7 +183,8 @@ at::Tensor LocalPoolingBackwardGPU(
 
   cudaStream_t stream = at::cuda::getCurrentCUDAStream().stream();
 
-  if (pooling_mode == PoolingMode::LOCAL_MAX_POOLING) {
+  if (pooling_mode == PoolingMode::LOCAL_MAX_POOLING ||
+      pooling_mode == PoolingMode::LOCAL_MAX_POOLING_COMPACT_INDEX) {
     AT_DISPATCH_FLOATING_TYPES(
         in_feat.scalar_type(), "local_pooling_backward_gpu", [&] {
           MaxPoolingBackwardKernelGPU<scalar_t>(
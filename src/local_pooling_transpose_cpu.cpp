@@ -52,6 +52,7 @@ std::pair<at::Tensor, at::Tensor> LocalPoolingTransposeForwardCPU(
     CoordinateMapKey *p_in_map_key,                    //
     CoordinateMapKey *p_out_map_key,                   //
     cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
 
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
   ASSERT(!in_feat.is_cuda(), "in_feat must be CPU");
@@ -87,6 +88,27 @@ std::pair<at::Tensor, at::Tensor> LocalPoolingTransposeForwardCPU(
     p_out_map_key->set_key(out_key);
   }
 
+  auto const out_nrows = p_map_manager->size(p_out_map_key->get_key());
+  at::Tensor num_nonzero =
+      torch::empty({0}, in_feat.options().requires_grad(false));
+
+  if (kernel_stride == kernel_size) {
+    // Each output row copies the features of its parent input row.
+    cpu_parent_map const &parent_map =
+        p_map_manager->stride_parent_map(p_out_map_key, p_in_map_key);
+    at::Tensor out_feat =
+        torch::empty({out_nrows, in_feat.size(1)}, in_feat.options());
+    AT_DISPATCH_FLOATING_TYPES(
+        in_feat.scalar_type(), "local_pooling_forward_cpu", [&] {
+          StrideAvgPoolingBackwardKernelCPU<scalar_t>(
+              out_feat.template data_ptr<scalar_t>(),
+              in_feat.template data_ptr<scalar_t>(),
+              num_nonzero.template data_ptr<scalar_t>(), in_feat.size(1),
+              parent_map, false /* avg */);
+        });
+    return std::make_pair(out_feat, num_nonzero);
+  }
+
   cpu_kernel_map const &in_out = p_map_manager->kernel_map(
       p_in_map_key,    //
       p_out_map_key,   //
@@ -96,13 +118,10 @@ std::pair<at::Tensor, at::Tensor> LocalPoolingTransposeForwardCPU(
       region_type,     //
       offset, true /* is_transpose */, true /* is_pool */);
 
-  auto const out_nrows = p_map_manager->size(p_out_map_key->get_key());
   at::Tensor out_feat =
       torch::zeros({out_nrows, in_feat.size(1)}, in_feat.options());
   LOG_DEBUG("Allocated", out_nrows, "x", in_feat.size(1), "features.");
 
-  at::Tensor num_nonzero =
-      torch::empty({0}, in_feat.options().requires_grad(false));
   AT_DISPATCH_FLOATING_TYPES(
       in_feat.scalar_type(), "local_pooling_forward_cpu", [&] {
         NonzeroAvgPoolingForwardKernelCPU<scalar_t, coordinate_type>(
@@ -128,6 +147,7 @@ at::Tensor LocalPoolingTransposeBackwardCPU(
     CoordinateMapKey *p_in_map_key,                    //
     CoordinateMapKey *p_out_map_key,                   //
     cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
   ASSERT(grad_out_feat.is_contiguous(), "grad_out_feata must be contiguous");
 
@@ -144,6 +164,23 @@ at::Tensor LocalPoolingTransposeBackwardCPU(
   coordinate_map_key_type out_key = p_out_map_key->get_key();
   ASSERT(p_map_manager->exists(out_key), ERROR_MAP_NOT_FOUND);
 
+  if (kernel_stride == kernel_size) {
+    // Each input row sums the gradients of its children output rows.
+    cpu_parent_map const &parent_map =
+        p_map_manager->stride_parent_map(p_out_map_key, p_in_map_key);
+    at::Tensor grad_in_feat =
+        torch::empty({in_feat.size(0), in_feat.size(1)}, in_feat.options());
+    AT_DISPATCH_FLOATING_TYPES(
+        in_feat.scalar_type(), "local_pooling_backward_cpu", [&] {
+          StrideAvgPoolingForwardKernelCPU<scalar_t>(
+              grad_out_feat.template data_ptr<scalar_t>(),
+              grad_in_feat.template data_ptr<scalar_t>(),
+              num_nonzero.template data_ptr<scalar_t>(), in_feat.size(1),
+              parent_map, false /* avg */);
+        });
+    return grad_in_feat;
+  }
+
   cpu_kernel_map const &in_out = p_map_manager->kernel_map(
       p_in_map_key,    //
       p_out_map_key,   //
@@ -29,6 +29,20 @@
 
 #include "mkl_alternate.hpp"
 
+#include <mutex>
+
+#if defined(USE_OPENBLAS)
+extern "C" {
+void openblas_set_num_threads(int num_threads);
+int openblas_get_num_threads(void);
+}
+#elif defined(USE_FLEXIBLAS)
+extern "C" {
+void flexiblas_set_num_threads(int num_threads);
+int flexiblas_get_num_threads(void);
+}
+#endif
+
 namespace minkowski {
 
 template <typename Dtype>
@@ -49,6 +63,107 @@ void cpu_div(const int N, const Dtype *a, const Dtype *b, Dtype *y);
 template <typename Dtype>
 void cpu_axpy(const int N, const Dtype alpha, const Dtype *X, Dtype *Y);
 
+/*
+ * Sets the BLAS thread count of the calling thread for the lifetime of the
+ * scope. Only MKL has a thread-local setting; each thread of an OpenMP region
+ * opens its own scope. A non-positive num_threads leaves the count unchanged.
+ */
+class blas_thread_scope {
+public:
+  explicit blas_thread_scope(int num_threads) : m_active(num_threads > 0) {
+#ifdef USE_MKL
+    if (m_active)
+      m_num_threads = mkl_set_num_threads_local(num_threads);
+#endif
+  }
+
+  blas_thread_scope(blas_thread_scope const &) = delete;
+  blas_thread_scope &operator=(blas_thread_scope const &) = delete;
+
+  ~blas_thread_scope() {
+#ifdef USE_MKL
+    if (m_active)
+      mkl_set_num_threads_local(m_num_threads);
+#endif
+  }
+
+private:
+  bool m_active;
+  int m_num_threads = 0;
+};
+
+/*
+ * Keeps the process-wide BLAS single-threaded for the lifetime of the scope.
+ * OpenBLAS and FlexiBLAS have no thread-local setting, so the thread that
+ * starts an OpenMP region opens the scope around the whole region. The scopes
+ * of all threads share a count: the first one saves the thread count and sets
+ * it to one, and the last one restores it. A BLAS call of another thread that
+ * overlaps a scope also runs single-threaded.
+ */
+class blas_serial_scope {
+public:
+  explicit blas_serial_scope(bool const active = true) : m_active(active) {
+#if defined(USE_OPENBLAS) || defined(USE_FLEXIBLAS)
+    if (!m_active)
+      return;
+    auto &state = shared_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.count++ == 0) {
+#if defined(USE_OPENBLAS)
+      state.num_threads = openblas_get_num_threads();
+      openblas_set_num_threads(1);
+#else
+      state.num_threads = flexiblas_get_num_threads();
+      flexiblas_set_num_threads(1);
+#endif
+    }
+#endif
+  }
+
+  blas_serial_scope(blas_serial_scope const &) = delete;
+  blas_serial_scope &operator=(blas_serial_scope const &) = delete;
+
+  ~blas_serial_scope() {
+#if defined(USE_OPENBLAS) || defined(USE_FLEXIBLAS)
+    if (!m_active)
+      return;
+    auto &state = shared_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (--state.count == 0) {
+#if defined(USE_OPENBLAS)
+      openblas_set_num_threads(state.num_threads);
+#else
+      flexiblas_set_num_threads(state.num_threads);
+#endif
+    }
+#endif
+  }
+
+private:
+  struct shared_state_type {
+    std::mutex mutex;
+    int count = 0;
+    int num_threads = 0;
+  };
+
+  static shared_state_type &shared_state() {
+    static shared_state_type state;
+    return state;
+  }
+
+  bool m_active;
+};
+
+// Whether the scopes above keep the BLAS single-threaded inside an OpenMP
+// region. With the other libraries, each thread may run a multithreaded GEMM.
+constexpr bool blas_threads_pinnable() {
+#if defined(USE_MKL) || defined(USE_OPENBLAS) || defined(USE_FLEXIBLAS)
+  return true;
+#else
+  return false;
+#endif
+}
+
 } // end namespace minkowski
 
 #endif // MATH_FUNCTIONS
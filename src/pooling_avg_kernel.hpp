@@ -25,17 +25,21 @@
 #ifndef CPU_POOLING_AVG
 #define CPU_POOLING_AVG
 
+#include "kernel_map.hpp"
 #include "math_functions.hpp"
 
+#include <algorithm>
 #include <limits>
+#include <omp.h>
 
 namespace minkowski {
 
 /**
- * CPU pooling function. The p_out_feat must be initialized and set to 0.
- * p_num_nonzero is set to 0 inside this function.
+ * CPU pooling function. p_out_feat and p_num_nonzero are overwritten.
  *
- * TODO consistent memset
+ * The kernel map is grouped by the output row so that each thread owns a
+ * disjoint set of output rows. Each row is reduced and written once with the
+ * average applied.
  */
 template <typename Dtype, typename Itype>
 void NonzeroAvgPoolingForwardKernelCPU(Dtype const *p_in_feat,
@@ -46,60 +50,37 @@ void NonzeroAvgPoolingForwardKernelCPU(Dtype const *p_in_feat,
                                        cpu_out_maps const &out_maps, //
                                        int const out_nrows,
                                        const bool use_avg) {
-  int kernel_volume, n_active_in_volume, row, j, k;
-  const Dtype *p_curr_in;
-  Dtype *p_curr_out;
-  Dtype *p_curr_num_nonzero;
-
-  // Number of weights
-  kernel_volume = in_maps.size();
-
-  // Set all values to - Dtype min
-  if (use_avg)
-    std::fill(p_num_nonzero, p_num_nonzero + out_nrows, 0);
-  std::fill(p_out_feat, p_out_feat + out_nrows * nchannel, 0);
-
-  // Iterate through each spatial kernel out of filter_volume spatial kernels
-  for (k = 0; k < kernel_volume; k++) {
-    n_active_in_volume = in_maps[k].size();
-    if (n_active_in_volume == 0)
-      continue;
-
-    // Put the entire for loop inside to reduce branching
-    if (use_avg) {
-      for (row = 0; row < n_active_in_volume; row++) {
-        // Define current pointers
-        p_curr_in = p_in_feat + in_maps[k][row] * nchannel;
-        p_curr_out = p_out_feat + out_maps[k][row] * nchannel;
-        p_curr_num_nonzero = p_num_nonzero + out_maps[k][row];
-        (*p_curr_num_nonzero)++;
-        cpu_add<Dtype>(nchannel, p_curr_in, p_curr_out, p_curr_out);
-      }
-    } else {
-      for (row = 0; row < n_active_in_volume; row++) {
-        // Define current pointers
-        p_curr_in = p_in_feat + in_maps[k][row] * nchannel;
-        p_curr_out = p_out_feat + out_maps[k][row] * nchannel;
-        cpu_add<Dtype>(nchannel, p_curr_in, p_curr_out, p_curr_out);
-      }
+  // Group the kernel map by the output row
+  cpu_grouped_kernel_map const out_grouped_map(in_maps, out_maps, out_nrows);
+  auto const &offsets = out_grouped_map.offsets;
+  auto const &in_rows = out_grouped_map.rows;
+
+#pragma omp parallel for
+  for (int row = 0; row < out_nrows; row++) {
+    Dtype *p_curr_out = p_out_feat + row * nchannel;
+    std::fill(p_curr_out, p_curr_out + nchannel, 0);
+
+    for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+      const Dtype *p_curr_in = p_in_feat + in_rows[i] * nchannel;
+      for (int j = 0; j < nchannel; j++)
+        p_curr_out[j] += p_curr_in[j];
     }
-  }
 
-  // Average
-  if (use_avg) {
-    p_curr_out = p_out_feat;
-    p_curr_num_nonzero = p_num_nonzero;
-    for (row = 0; row < out_nrows; row++) {
-      for (j = 0; j < nchannel; j++) {
-        if (*p_curr_num_nonzero > 0)
-          *p_curr_out /= *p_curr_num_nonzero;
-        p_curr_out++;
-      }
-      p_curr_num_nonzero++;
+    // Average
+    if (use_avg) {
+      Dtype const curr_num_nonzero = offsets[row + 1] - offsets[row];
+      p_num_nonzero[row] = curr_num_nonzero;
+      if (curr_num_nonzero > 0)
+        for (int j = 0; j < nchannel; j++)
+          p_curr_out[j] /= curr_num_nonzero;
     }
   }
 }
 
+/**
+ * The kernel map is grouped by the input row so that each thread owns a
+ * disjoint set of input gradient rows.
+ */
 template <typename Dtype, typename Itype>
 void NonzeroAvgPoolingBackwardKernelCPU(Dtype *p_grad_in_feat,
                                         int const in_nrows,
@@ -109,46 +90,96 @@ void NonzeroAvgPoolingBackwardKernelCPU(Dtype *p_grad_in_feat,
                                         cpu_in_maps const &in_maps,   //
                                         cpu_out_maps const &out_maps, //
                                         bool const use_avg) {
-  int kernel_volume, n_active_in_volume, row, j, k;
-  Dtype *p_curr_grad_in, curr_num_nonzero;
-  const Dtype *p_curr_grad_out;
-
-  // Number of weights
-  kernel_volume = in_maps.size();
-
-  // cleanup gradients
-  std::fill(p_grad_in_feat, p_grad_in_feat + in_nrows * nchannel, 0);
-
-  for (k = 0; k < kernel_volume; k++) {
-    n_active_in_volume = in_maps[k].size();
-    if (n_active_in_volume == 0)
-      continue;
-
-    for (row = 0; row < n_active_in_volume; row++) {
-      // Define current pointers
-      p_curr_grad_in = p_grad_in_feat + in_maps[k][row] * nchannel;
-      p_curr_grad_out = p_grad_out_feat + out_maps[k][row] * nchannel;
-
+  // Group the kernel map by the input row
+  cpu_grouped_kernel_map const in_grouped_map(out_maps, in_maps, in_nrows);
+  auto const &offsets = in_grouped_map.offsets;
+  auto const &out_rows = in_grouped_map.rows;
+
+#pragma omp parallel for
+  for (int row = 0; row < in_nrows; row++) {
+    Dtype *p_curr_grad_in = p_grad_in_feat + row * nchannel;
+    std::fill(p_curr_grad_in, p_curr_grad_in + nchannel, 0);
+
+    for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+      const Dtype *p_curr_grad_out = p_grad_out_feat + out_rows[i] * nchannel;
       // To speed up, create if outside for loop
       if (use_avg) {
-        curr_num_nonzero = p_num_nonzero[out_maps[k][row]];
-        for (j = 0; j < nchannel; j++) {
-          if (curr_num_nonzero > 0)
-            *p_curr_grad_in += *p_curr_grad_out / curr_num_nonzero;
-          p_curr_grad_in++;
-          p_curr_grad_out++;
-        }
+        Dtype const curr_num_nonzero = p_num_nonzero[out_rows[i]];
+        if (curr_num_nonzero > 0)
+          for (int j = 0; j < nchannel; j++)
+            p_curr_grad_in[j] += p_curr_grad_out[j] / curr_num_nonzero;
       } else {
-        for (j = 0; j < nchannel; j++) {
-          *p_curr_grad_in += *p_curr_grad_out;
-          p_curr_grad_in++;
-          p_curr_grad_out++;
-        }
+        for (int j = 0; j < nchannel; j++)
+          p_curr_grad_in[j] += p_curr_grad_out[j];
       }
     }
   }
 }
 
+/**
+ * Pooling over a stride map. Every input row has exactly one parent, so the
+ * output row is a segmented reduction over its children.
+ */
+template <typename Dtype>
+void StrideAvgPoolingForwardKernelCPU(Dtype const *p_in_feat,
+                                      Dtype *p_out_feat, //
+                                      Dtype *p_num_nonzero,
+                                      int const nchannel, //
+                                      cpu_parent_map const &parent_map,
+                                      const bool use_avg) {
+  auto const &offsets = parent_map.offsets;
+  auto const &children = parent_map.children;
+  int const out_nrows = parent_map.out_nrows();
+
+#pragma omp parallel for
+  for (int row = 0; row < out_nrows; row++) {
+    Dtype *p_curr_out = p_out_feat + row * nchannel;
+    std::fill(p_curr_out, p_curr_out + nchannel, 0);
+
+    for (auto i = offsets[row]; i < offsets[row + 1]; i++) {
+      const Dtype *p_curr_in = p_in_feat + children[i] * nchannel;
+      for (int j = 0; j < nchannel; j++)
+        p_curr_out[j] += p_curr_in[j];
+    }
+
+    if (use_avg) {
+      Dtype const curr_num_nonzero = offsets[row + 1] - offsets[row];
+      p_num_nonzero[row] = curr_num_nonzero;
+      if (curr_num_nonzero > 0)
+        for (int j = 0; j < nchannel; j++)
+          p_curr_out[j] /= curr_num_nonzero;
+    }
+  }
+}
+
+/**
+ * Each input gradient row is a copy (or an averaged copy) of the gradient of
+ * its parent row.
+ */
+template <typename Dtype>
+void StrideAvgPoolingBackwardKernelCPU(Dtype *p_grad_in_feat,
+                                       Dtype const *p_grad_out_feat,
+                                       Dtype const *p_num_nonzero,
+                                       int const nchannel, //
+                                       cpu_parent_map const &parent_map,
+                                       bool const use_avg) {
+  auto const &parents = parent_map.parents;
+  int const in_nrows = parent_map.in_nrows();
+
+#pragma omp parallel for
+  for (int row = 0; row < in_nrows; row++) {
+    Dtype *p_curr_grad_in = p_grad_in_feat + row * nchannel;
+    const Dtype *p_curr_grad_out = p_grad_out_feat + parents[row] * nchannel;
+    if (use_avg) {
+      Dtype const curr_num_nonzero = p_num_nonzero[parents[row]];
+      for (int j = 0; j < nchannel; j++)
+        p_curr_grad_in[j] = p_curr_grad_out[j] / curr_num_nonzero;
+    } else {
+      std::copy(p_curr_grad_out, p_curr_grad_out + nchannel, p_curr_grad_in);
+    }
+  }
+}
+
 template void NonzeroAvgPoolingForwardKernelCPU<float, int>(
     float const *p_in_feat, float *p_out_feat, float *p_num_nonzero,
     int const nchannel,
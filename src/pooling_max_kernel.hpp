@@ -25,13 +25,50 @@
 #ifndef CPU_POOLING_MAX
 #define CPU_POOLING_MAX
 
+#include "kernel_map.hpp"
 #include "math_functions.hpp"
+#include "utils.hpp"
 
+#include <algorithm>
 #include <limits>
 #include <omp.h>
+#include <vector>
 
 namespace minkowski {
 
+/*
+ * Max reduction over the input rows of each output row. The input rows of the
+ * output row `row` are p_in_rows[p_offsets[row]:p_offsets[row + 1]].
+ *
+ * Each thread owns a disjoint set of output rows. When rank_index is true, the
+ * mask stores the position of the max pair within the output row, otherwise
+ * the flat input index in_row * nchannel + j.
+ */
+template <typename Dtype, typename MaskItype, bool rank_index>
+void max_pooling_forward_grouped_kernel_cpu(
+    Dtype const *p_in_feat, Dtype *p_out_feat, MaskItype *p_mask_index,
+    size_t const nchannel, default_types::index_type const *p_offsets,
+    default_types::index_type const *p_in_rows, size_t const out_nrows) {
+#pragma omp parallel for
+  for (int64_t row = 0; row < (int64_t)out_nrows; ++row) {
+    Dtype *p_curr_out = p_out_feat + row * nchannel;
+    MaskItype *p_curr_mask_index = p_mask_index + row * nchannel;
+    for (auto i = p_offsets[row]; i < p_offsets[row + 1]; ++i) {
+      size_t const in_offset = p_in_rows[i] * nchannel;
+      Dtype const *p_curr_in = p_in_feat + in_offset;
+      MaskItype const mask_begin = rank_index ? i - p_offsets[row] : in_offset;
+      MaskItype const mask_step = rank_index ? 0 : 1;
+#pragma omp simd
+      for (size_t j = 0; j < nchannel; j++) {
+        bool const is_max = p_curr_out[j] < p_curr_in[j];
+        p_curr_out[j] = is_max ? p_curr_in[j] : p_curr_out[j];
+        p_curr_mask_index[j] = is_max ? (MaskItype)(mask_begin + mask_step * j)
+                                      : p_curr_mask_index[j];
+      }
+    }
+  }
+}
+
 template <typename Dtype, typename MaskItype, typename MapItype>
 void max_pooling_forward_pointer_kernel_cpu(Dtype const *p_in_feat,
                                             Dtype *p_out_feat,
@@ -40,28 +77,43 @@ void max_pooling_forward_pointer_kernel_cpu(Dtype const *p_in_feat,
                                             MapItype const *const p_in_maps,  //
                                             MapItype const *const p_out_maps, //
                                             size_t const map_size) {
-  Dtype const *p_curr_in;
-  Dtype *p_curr_out;
-  MaskItype *p_curr_mask_index;
+  using index_type = default_types::index_type;
 
-  for (size_t i = 0; i < map_size; ++i) {
-    // Define current pointers
-    MapItype in_offset = p_in_maps[i] * nchannel;
-    p_curr_in = p_in_feat + in_offset;
-    p_curr_out = p_out_feat + p_out_maps[i] * nchannel;
-    p_curr_mask_index = p_mask_index + p_out_maps[i] * nchannel;
+  // Group the pairs by the output row while keeping the map order.
+  size_t out_nrows = 0;
+  for (size_t i = 0; i < map_size; ++i)
+    out_nrows = std::max(out_nrows, (size_t)p_out_maps[i] + 1);
 
-    for (size_t j = 0; j < nchannel; j++) {
-      if (*p_curr_out < *p_curr_in) {
-        *p_curr_out = *p_curr_in;
-        *p_curr_mask_index = in_offset + j;
-      }
-      // forward all pointers
-      p_curr_in++;
-      p_curr_out++;
-      p_curr_mask_index++;
-    }
-  }
+  std::vector<index_type> offsets(out_nrows + 1, 0), in_rows(map_size);
+  for (size_t i = 0; i < map_size; ++i)
+    ++offsets[p_out_maps[i] + 1];
+  for (size_t row = 0; row < out_nrows; ++row)
+    offsets[row + 1] += offsets[row];
+  std::vector<index_type> cursor(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < map_size; ++i)
+    in_rows[cursor[p_out_maps[i]]++] = p_in_maps[i];
+
+  max_pooling_forward_grouped_kernel_cpu<Dtype, MaskItype, false>(
+      p_in_feat, p_out_feat, p_mask_index, nchannel, offsets.data(),
+      in_rows.data(), out_nrows);
+}
+
+/*
+ * Max pooling over a kernel map grouped by the output row. Rows without an
+ * input are marked with (MaskItype)-1.
+ */
+template <typename Dtype, typename MaskItype>
+void MaxPoolingGroupedForwardKernelCPU(
+    Dtype const *p_in_feat, Dtype *p_out_feat, MaskItype *p_mask_index,
+    int const nchannel, cpu_grouped_kernel_map const &out_grouped_map) {
+  auto const out_nrows = out_grouped_map.nrows();
+  std::fill(p_mask_index, p_mask_index + out_nrows * nchannel, -1);
+  std::fill(p_out_feat, p_out_feat + out_nrows * nchannel,
+            -std::numeric_limits<Dtype>::max());
+
+  max_pooling_forward_grouped_kernel_cpu<Dtype, MaskItype, false>(
+      p_in_feat, p_out_feat, p_mask_index, nchannel,
+      out_grouped_map.offsets.data(), out_grouped_map.rows.data(), out_nrows);
 }
 
 template <typename Dtype, typename MaskItype, typename MapItype>
@@ -70,23 +122,61 @@ void MaxPoolingForwardKernelCPU(Dtype const *p_in_feat, Dtype *p_out_feat,
                                 cpu_in_maps const &in_maps,   //
                                 cpu_out_maps const &out_maps, //
                                 int const out_nrows) {
-  int kernel_volume = in_maps.size();
+  // Group the kernel map by the output row
+  cpu_grouped_kernel_map const out_grouped_map(in_maps, out_maps, out_nrows);
+  MaxPoolingGroupedForwardKernelCPU<Dtype, MaskItype>(
+      p_in_feat, p_out_feat, p_mask_index, nchannel, out_grouped_map);
+}
 
-  // Set all values to - Dtype min
-  std::fill(p_mask_index, p_mask_index + out_nrows * nchannel, -1);
+/*
+ * Max pooling that stores the position of the max pair within the output row
+ * of the output grouped kernel map in uint8 instead of the flat input index.
+ * out_grouped_map.max_row_size() must be smaller than 255. Rows without an
+ * input are marked with 255.
+ */
+template <typename Dtype>
+void MaxPoolingCompactForwardKernelCPU(
+    Dtype const *p_in_feat, Dtype *p_out_feat, uint8_t *p_mask_index,
+    int const nchannel, cpu_grouped_kernel_map const &out_grouped_map) {
+  auto const out_nrows = out_grouped_map.nrows();
+  ASSERT(out_grouped_map.max_row_size() < std::numeric_limits<uint8_t>::max(),
+         "Too many inputs per output row for a compact max index.");
+
+  std::fill(p_mask_index, p_mask_index + out_nrows * nchannel,
+            std::numeric_limits<uint8_t>::max());
   std::fill(p_out_feat, p_out_feat + out_nrows * nchannel,
             -std::numeric_limits<Dtype>::max());
 
-  // Iterate through each spatial kernel out of filter_volume spatial kernels
-  for (int k = 0; k < kernel_volume; ++k) {
-    int n_active_in_volume = in_maps[k].size();
-    if (n_active_in_volume == 0)
-      continue;
+  max_pooling_forward_grouped_kernel_cpu<Dtype, uint8_t, true>(
+      p_in_feat, p_out_feat, p_mask_index, nchannel,
+      out_grouped_map.offsets.data(), out_grouped_map.rows.data(), out_nrows);
+}
 
-    max_pooling_forward_pointer_kernel_cpu<Dtype, MaskItype, MapItype>(
-        p_in_feat, p_out_feat, p_mask_index, nchannel, in_maps[k].data(),
-        out_maps[k].data(), n_active_in_volume);
-  }
+/*
+ * Max pooling over a stride map. The children of an output row are its input
+ * rows. With rank_index, the mask is the uint8 position of the max child and
+ * parent_map.max_row_size() must be smaller than 255. Rows without an input
+ * are marked with (MaskItype)-1.
+ */
+template <typename Dtype, typename MaskItype, bool rank_index>
+void StrideMaxPoolingForwardKernelCPU(Dtype const *p_in_feat,
+                                      Dtype *p_out_feat,
+                                      MaskItype *p_mask_index,
+                                      int const nchannel,
+                                      cpu_parent_map const &parent_map) {
+  auto const out_nrows = parent_map.out_nrows();
+  if (rank_index)
+    ASSERT(parent_map.max_row_size() < std::numeric_limits<uint8_t>::max(),
+           "Too many inputs per output row for a compact max index.");
+
+  std::fill(p_mask_index, p_mask_index + out_nrows * nchannel,
+            static_cast<MaskItype>(-1));
+  std::fill(p_out_feat, p_out_feat + out_nrows * nchannel,
+            -std::numeric_limits<Dtype>::max());
+
+  max_pooling_forward_grouped_kernel_cpu<Dtype, MaskItype, rank_index>(
+      p_in_feat, p_out_feat, p_mask_index, nchannel, parent_map.offsets.data(),
+      parent_map.children.data(), out_nrows);
 }
 
 template <typename Dtype, typename MaskItype>
@@ -95,25 +185,181 @@ void MaxPoolingBackwardKernelCPU(Dtype *p_grad_in_feat, size_t const in_nrows,
                                  size_t const out_nrows,
                                  MaskItype const *p_mask_index,
                                  size_t const nchannel) {
-  const Dtype *p_curr_grad_out;
-  const MaskItype *p_curr_mask_index;
-
   // cleanup gradients
   // std::fill(p_grad_in_feat, p_grad_in_feat + in_nrows * nchannel, 0);
 
-  p_curr_grad_out = p_grad_out_feat;
-  p_curr_mask_index = p_mask_index;
-
-  for (int row = 0; row < out_nrows; row++) {
-    for (int j = 0; j < nchannel; j++) {
+  // Output rows that share a max input write to the same gradient entry.
+  // Without the map, the scatter stays serial; the grouped and the stride
+  // backward kernels below split the input rows over the threads instead.
+  for (size_t row = 0; row < out_nrows; row++) {
+    Dtype const *p_curr_grad_out = p_grad_out_feat + row * nchannel;
+    MaskItype const *p_curr_mask_index = p_mask_index + row * nchannel;
+    for (size_t j = 0; j < nchannel; j++) {
       // Accumulate gradients
-      p_grad_in_feat[*p_curr_mask_index] += *p_curr_grad_out;
-      p_curr_grad_out++;
-      p_curr_mask_index++;
+      p_grad_in_feat[p_curr_mask_index[j]] += p_curr_grad_out[j];
+    }
+  }
+}
+
+namespace detail {
+
+/*
+ * The output grouped kernel map regrouped by the input row. The pairs of the
+ * input row `row` are [offsets[row], offsets[row + 1]), each with its output
+ * row and its position within the output row. The pairs keep the output row
+ * order, so the accumulation order does not depend on the thread count.
+ */
+struct cpu_input_grouped_map {
+  using index_type = default_types::index_type;
+
+  cpu_input_grouped_map(cpu_grouped_kernel_map const &out_grouped_map,
+                        size_t const in_nrows)
+      : offsets(in_nrows + 1, 0), positions(out_grouped_map.size()),
+        out_rows(out_grouped_map.size()) {
+    auto const out_nrows = out_grouped_map.nrows();
+    auto const &out_offsets = out_grouped_map.offsets;
+    auto const &out_in_rows = out_grouped_map.rows;
+
+    // counting sort the positions of the output grouped map by the input row
+    for (auto const in_row : out_in_rows)
+      ++offsets[in_row + 1];
+    for (size_t row = 0; row < in_nrows; ++row)
+      offsets[row + 1] += offsets[row];
+    std::vector<index_type> cursor(offsets.begin(), offsets.end() - 1);
+    for (index_type out_row = 0; out_row < out_nrows; ++out_row) {
+      for (auto i = out_offsets[out_row]; i < out_offsets[out_row + 1]; ++i) {
+        auto const curr_index = cursor[out_in_rows[i]]++;
+        positions[curr_index] = i - out_offsets[out_row];
+        out_rows[curr_index] = out_row;
+      }
+    }
+  }
+
+  std::vector<index_type> offsets;
+  std::vector<index_type> positions;
+  std::vector<index_type> out_rows;
+};
+
+} // namespace detail
+
+/*
+ * Backward of MaxPoolingGroupedForwardKernelCPU. Each thread owns a disjoint
+ * set of input gradient rows and adds the gradients of the output rows whose
+ * max is the flat index of the row.
+ */
+template <typename Dtype, typename MaskItype>
+void MaxPoolingGroupedBackwardKernelCPU(
+    Dtype *p_grad_in_feat, size_t const in_nrows, Dtype const *p_grad_out_feat,
+    MaskItype const *p_mask_index, size_t const nchannel,
+    cpu_grouped_kernel_map const &out_grouped_map) {
+  detail::cpu_input_grouped_map const in_grouped_map(out_grouped_map,
+                                                     in_nrows);
+  auto const &offsets = in_grouped_map.offsets;
+  auto const &out_rows = in_grouped_map.out_rows;
+
+#pragma omp parallel for
+  for (int64_t row = 0; row < (int64_t)in_nrows; ++row) {
+    Dtype *p_curr_grad_in = p_grad_in_feat + row * nchannel;
+    MaskItype const in_offset = row * nchannel;
+    for (auto i = offsets[row]; i < offsets[row + 1]; ++i) {
+      size_t const out_offset = out_rows[i] * nchannel;
+      Dtype const *p_curr_grad_out = p_grad_out_feat + out_offset;
+      MaskItype const *p_curr_mask_index = p_mask_index + out_offset;
+#pragma omp simd
+      for (size_t j = 0; j < nchannel; j++)
+        p_curr_grad_in[j] += p_curr_mask_index[j] == (MaskItype)(in_offset + j)
+                                 ? p_curr_grad_out[j]
+                                 : 0;
     }
   }
 }
 
+/*
+ * Backward of MaxPoolingCompactForwardKernelCPU. The output grouped kernel
+ * map is regrouped by the input row so that each thread owns a disjoint set of
+ * input gradient rows.
+ */
+template <typename Dtype>
+void MaxPoolingCompactBackwardKernelCPU(
+    Dtype *p_grad_in_feat, size_t const in_nrows, Dtype const *p_grad_out_feat,
+    uint8_t const *p_mask_index, size_t const nchannel,
+    cpu_grouped_kernel_map const &out_grouped_map) {
+  detail::cpu_input_grouped_map const in_grouped_map(out_grouped_map,
+                                                     in_nrows);
+  auto const &offsets = in_grouped_map.offsets;
+  auto const &positions = in_grouped_map.positions;
+  auto const &out_rows = in_grouped_map.out_rows;
+
+#pragma omp parallel for
+  for (int64_t row = 0; row < (int64_t)in_nrows; ++row) {
+    Dtype *p_curr_grad_in = p_grad_in_feat + row * nchannel;
+    for (auto i = offsets[row]; i < offsets[row + 1]; ++i) {
+      size_t const out_offset = out_rows[i] * nchannel;
+      Dtype const *p_curr_grad_out = p_grad_out_feat + out_offset;
+      uint8_t const *p_curr_mask_index = p_mask_index + out_offset;
+      uint8_t const position = positions[i];
+#pragma omp simd
+      for (size_t j = 0; j < nchannel; j++)
+        p_curr_grad_in[j] +=
+            p_curr_mask_index[j] == position ? p_curr_grad_out[j] : 0;
+    }
+  }
+}
+
+/*
+ * Backward of the compact StrideMaxPoolingForwardKernelCPU. Each input row has
+ * a single parent, so the output rows scatter to disjoint input rows.
+ */
+template <typename Dtype>
+void StrideMaxPoolingCompactBackwardKernelCPU(
+    Dtype *p_grad_in_feat, Dtype const *p_grad_out_feat,
+    uint8_t const *p_mask_index, size_t const nchannel,
+    cpu_parent_map const &parent_map) {
+  auto const out_nrows = parent_map.out_nrows();
+  auto const &offsets = parent_map.offsets;
+  auto const &children = parent_map.children;
+
+#pragma omp parallel for
+  for (int64_t row = 0; row < (int64_t)out_nrows; ++row) {
+    Dtype const *p_curr_grad_out = p_grad_out_feat + row * nchannel;
+    uint8_t const *p_curr_mask_index = p_mask_index + row * nchannel;
+    for (size_t j = 0; j < nchannel; j++) {
+      uint8_t const position = p_curr_mask_index[j];
+      if (position != std::numeric_limits<uint8_t>::max())
+        p_grad_in_feat[children[offsets[row] + position] * nchannel + j] =
+            p_curr_grad_out[j];
+    }
+  }
+}
+
+/*
+ * Backward of StrideMaxPoolingForwardKernelCPU with the flat input index. Each
+ * input row has a single parent, so each thread owns its input gradient rows.
+ */
+template <typename Dtype, typename MaskItype>
+void StrideMaxPoolingBackwardKernelCPU(Dtype *p_grad_in_feat,
+                                       Dtype const *p_grad_out_feat,
+                                       MaskItype const *p_mask_index,
+                                       size_t const nchannel,
+                                       cpu_parent_map const &parent_map) {
+  auto const in_nrows = parent_map.in_nrows();
+  auto const &parents = parent_map.parents;
+
+#pragma omp parallel for
+  for (int64_t row = 0; row < (int64_t)in_nrows; ++row) {
+    Dtype *p_curr_grad_in = p_grad_in_feat + row * nchannel;
+    size_t const out_offset = parents[row] * nchannel;
+    Dtype const *p_curr_grad_out = p_grad_out_feat + out_offset;
+    MaskItype const *p_curr_mask_index = p_mask_index + out_offset;
+    MaskItype const in_offset = row * nchannel;
+#pragma omp simd
+    for (size_t j = 0; j < nchannel; j++)
+      p_curr_grad_in[j] += p_curr_mask_index[j] == (MaskItype)(in_offset + j)
+                               ? p_curr_grad_out[j]
+                               : 0;
+  }
+}
+
 } // end namespace minkowski
 
 #endif // CPU_POOLING_MAX
@@ -46,6 +46,7 @@ PruningForwardCPU(at::Tensor const &in_feat, // CPU feat
                   CoordinateMapKey *p_in_map_key,  //
                   CoordinateMapKey *p_out_map_key, //
                   cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
   ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
   ASSERT(keep.is_contiguous(), "keep must be contiguous");
 
@@ -76,8 +77,10 @@ PruningForwardCPU(at::Tensor const &in_feat, // CPU feat
     p_out_map_key->set_key(out_key);
   }
 
-  const auto &in_out = p_map_manager->kernel_map(p_in_map_key, p_out_map_key);
-  LOG_DEBUG("Generated kernel map");
+  // input row of each pruned row. Cached by prune for a new pruned map.
+  cpu_parent_map const &pruned_map =
+      p_map_manager->stride_parent_map(p_out_map_key, p_in_map_key);
+  LOG_DEBUG("Generated pruned map");
 
   // Get the total number of coords
   const int64_t tot_n = p_map_manager->size(p_out_map_key->get_key());
@@ -89,13 +92,11 @@ PruningForwardCPU(at::Tensor const &in_feat, // CPU feat
   if (tot_n == 0) {
     WARNING(true, "MinkowskiPruning: Generating an empty SparseTensor");
   } else {
-    out_feat.zero_();
     AT_DISPATCH_FLOATING_TYPES(
         in_feat.scalar_type(), "pruning_forward_cpu", [&] {
           PruningForwardKernelCPU<scalar_t>(
               in_feat.template data_ptr<scalar_t>(),
-              out_feat.template data_ptr<scalar_t>(), nchannel,
-              std::get<0>(in_out), std::get<1>(in_out));
+              out_feat.template data_ptr<scalar_t>(), nchannel, pruned_map);
         });
   }
 
@@ -108,6 +109,7 @@ PruningBackwardCPU(at::Tensor &grad_out_feat,       // CPU out feat
                    CoordinateMapKey *p_in_map_key,  //
                    CoordinateMapKey *p_out_map_key, //
                    cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
   if (!grad_out_feat.is_contiguous())
     grad_out_feat = grad_out_feat.contiguous();
 
@@ -123,7 +125,8 @@ PruningBackwardCPU(at::Tensor &grad_out_feat,       // CPU out feat
   ASSERT(grad_out_feat.size(0) == N_out, "Invalid grad_out_feat size",
          grad_out_feat.size(0), "!=", N_out);
 
-  const auto &in_out = p_map_manager->kernel_map(p_in_map_key, p_out_map_key);
+  cpu_parent_map const &pruned_map =
+      p_map_manager->stride_parent_map(p_out_map_key, p_in_map_key);
   const int nchannel = grad_out_feat.size(1);
   at::Tensor grad_in_feat =
       torch::zeros({N_in, nchannel}, grad_out_feat.options());
@@ -134,7 +137,7 @@ PruningBackwardCPU(at::Tensor &grad_out_feat,       // CPU out feat
           PruningBackwardKernelCPU<scalar_t>(
               grad_in_feat.template data_ptr<scalar_t>(),
               grad_out_feat.template data_ptr<scalar_t>(), nchannel,
-              std::get<0>(in_out), std::get<1>(in_out));
+              pruned_map);
         });
   else
     WARNING(true, "MinkowskiPruning: Backprop from a size-0 sparse tensor.");
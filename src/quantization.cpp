@@ -75,9 +75,14 @@ std::vector<py::array> quantize_np(
   std::for_each(tensor_stride.begin(), tensor_stride.end(),
                 [](auto &i) { i = 1; });
 
-  CoordinateMapCPU<coordinate_type> map(nrows, ncols, tensor_stride);
-  LOG_DEBUG("Map nrows:", nrows, "ncols:", ncols);
-  auto results = map.insert_and_map<true>(p_coords, p_coords + nrows * ncols);
+  std::pair<std::vector<int64_t>, std::vector<int64_t>> results;
+  {
+    // coords is kept alive by the caller while the GIL is released
+    py::gil_scoped_release release;
+    CoordinateMapCPU<coordinate_type> map(nrows, ncols, tensor_stride);
+    LOG_DEBUG("Map nrows:", nrows, "ncols:", ncols);
+    results = map.insert_and_map<true>(p_coords, p_coords + nrows * ncols);
+  }
   LOG_DEBUG("insertion finished");
   auto &mapping = std::get<0>(results);
   auto &inverse_mapping = std::get<1>(results);
@@ -216,8 +221,11 @@ std::vector<py::array> quantize_label_np(
   int *p_labels = (int *)labels_info.ptr;
   int nrows = shape[0], ncols = shape[1];
 
-  auto const &results =
-      quantize_label(p_coords, p_labels, nrows, ncols, invalid_label);
+  std::vector<std::vector<int>> results;
+  {
+    py::gil_scoped_release release;
+    results = quantize_label(p_coords, p_labels, nrows, ncols, invalid_label);
+  }
   auto const &mapping = results[0];
   auto const &inverse_mapping = results[1];
   auto const &colabels = results[2];
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2020 NVIDIA Corporation.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+ * Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+ * of the code.
+ */
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include "types.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <omp.h>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace minkowski {
+
+/*
+ * A fixed number of worker threads that run the enqueued tasks in the FIFO
+ * order. The destructor runs the remaining tasks and joins the workers.
+ */
+class thread_pool {
+public:
+  explicit thread_pool(size_t const num_threads) {
+    for (size_t i = 0; i < num_threads; ++i)
+      m_workers.emplace_back([this] {
+        for (;;) {
+          std::function<void()> task;
+          {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock,
+                             [this] { return m_stop || !m_tasks.empty(); });
+            if (m_stop && m_tasks.empty())
+              return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+          }
+          task();
+        }
+      });
+  }
+
+  thread_pool(thread_pool const &) = delete;
+  thread_pool &operator=(thread_pool const &) = delete;
+
+  ~thread_pool() {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_condition.notify_all();
+    for (auto &worker : m_workers)
+      worker.join();
+  }
+
+  template <typename F>
+  std::future<typename std::result_of<F()>::type> enqueue(F &&f) {
+    using result_type = typename std::result_of<F()>::type;
+    auto task =
+        std::make_shared<std::packaged_task<result_type()>>(std::forward<F>(f));
+    std::future<result_type> result = task->get_future();
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_tasks.emplace([task] { (*task)(); });
+    }
+    m_condition.notify_one();
+    return result;
+  }
+
+  size_t size() const { return m_workers.size(); }
+
+private:
+  std::vector<std::thread> m_workers;
+  std::queue<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stop = false;
+};
+
+/*
+ * Per-manager CPU thread settings. A zero thread count keeps the OpenMP
+ * default and an empty affinity keeps the affinity of the calling thread. The
+ * threading policy picks between the OpenMP loops and a multithreaded BLAS in
+ * the ops that call the BLAS.
+ */
+struct thread_config {
+  size_t num_threads = 0;
+  std::vector<int> cpu_affinity;
+  ThreadingPolicy::Type threading_policy = ThreadingPolicy::AUTO;
+};
+
+/*
+ * Applies a thread_config to the calling thread for the lifetime of the scope
+ * and restores the previous settings on exit. omp_set_num_threads only sets
+ * the thread count of the parallel regions started by the calling thread, so
+ * concurrent scopes on different threads do not interfere.
+ *
+ * The OpenMP pool threads do not reliably inherit the affinity of the thread
+ * that starts a region: the runtime reuses the threads it created earlier and
+ * OMP_PROC_BIND overrides the inherited mask. Each thread of the team pins
+ * itself in a parallel region instead, and restores its mask on exit.
+ */
+class thread_scope {
+public:
+  explicit thread_scope(thread_config const &config) {
+    if (config.num_threads > 0) {
+      m_num_threads = omp_get_max_threads();
+      m_dynamic = omp_get_dynamic();
+      omp_set_dynamic(0);
+      omp_set_num_threads(config.num_threads);
+    }
+#ifdef __linux__
+    if (!config.cpu_affinity.empty()) {
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      for (auto const cpu : config.cpu_affinity)
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+          CPU_SET(cpu, &cpu_set);
+
+      int const team_size = omp_get_max_threads();
+      m_cpu_sets.resize(team_size);
+      m_affinity_set.assign(team_size, 0);
+#pragma omp parallel num_threads(team_size)
+      {
+        int const tid = omp_get_thread_num();
+        pthread_t const self = pthread_self();
+        m_affinity_set[tid] =
+            pthread_getaffinity_np(self, sizeof(cpu_set_t), &m_cpu_sets[tid]) ==
+                0 &&
+            pthread_setaffinity_np(self, sizeof(cpu_set_t), &cpu_set) == 0;
+      }
+    }
+#endif
+  }
+
+  thread_scope(thread_scope const &) = delete;
+  thread_scope &operator=(thread_scope const &) = delete;
+
+  ~thread_scope() {
+#ifdef __linux__
+    if (!m_cpu_sets.empty()) {
+#pragma omp parallel num_threads(m_cpu_sets.size())
+      {
+        int const tid = omp_get_thread_num();
+        if (m_affinity_set[tid])
+          pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                                 &m_cpu_sets[tid]);
+      }
+    }
+#endif
+    if (m_num_threads > 0) {
+      omp_set_num_threads(m_num_threads);
+      omp_set_dynamic(m_dynamic);
+    }
+  }
+
+private:
+  int m_num_threads = 0;
+  int m_dynamic = 0;
+#ifdef __linux__
+  // previous mask of each thread of the team, indexed by omp_get_thread_num
+  std::vector<char> m_affinity_set;
+  std::vector<cpu_set_t> m_cpu_sets;
+#endif
+};
+
+/*
+ * The CPUs each thread of an OpenMP region started by the calling thread may
+ * run on. Empty on the platforms without sched_getaffinity.
+ */
+inline std::vector<std::vector<int>> omp_thread_cpu_affinity() {
+  std::vector<std::vector<int>> affinity(omp_get_max_threads());
+#ifdef __linux__
+#pragma omp parallel num_threads(affinity.size())
+  {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &cpu_set) == 0) {
+      auto &thread_affinity = affinity[omp_get_thread_num()];
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, &cpu_set))
+          thread_affinity.push_back(cpu);
+    }
+  }
+#else
+  affinity.clear();
+#endif
+  return affinity;
+}
+
+} // namespace minkowski
+
+#endif // THREAD_POOL_HPP
@@ -129,6 +129,10 @@ namespace MinkowskiAlgorithm {
 enum Mode { DEFAULT = 0, MEMORY_EFFICIENT = 1, SPEED_OPTIMIZED = 2 };
 }
 
+namespace ThreadingPolicy {
+enum Type { AUTO = 0, OUTER_PARALLEL = 1, BLAS_PARALLEL = 2 };
+}
+
 namespace CoordinateMapBackend {
 enum Type { CPU = 0, CUDA = 1 };
 }
@@ -150,7 +154,8 @@ enum Type {
   GLOBAL_MAX_POOLING_KERNEL,
   GLOBAL_SUM_POOLING_PYTORCH_INDEX,
   GLOBAL_AVG_POOLING_PYTORCH_INDEX,
-  GLOBAL_MAX_POOLING_PYTORCH_INDEX
+  GLOBAL_MAX_POOLING_PYTORCH_INDEX,
+  LOCAL_MAX_POOLING_COMPACT_INDEX
 };
 }
 
@@ -161,6 +166,22 @@ enum Type {
 };
 }
 
+namespace BinaryMode {
+enum Type {
+  ADDITION,
+  SUBTRACTION,
+  MULTIPLICATION,
+  MAXIMUM,
+};
+}
+
+namespace JoinMode {
+enum Type {
+  UNION,
+  INTERSECTION,
+};
+}
+
 namespace ConvolutionMode {
 enum Type {
   DEFAULT,
@@ -0,0 +1,72 @@
+/* Copyright (c) Chris Choy (chrischoy@ai.stanford.edu).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+ * Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+ * of the code.
+ */
+#ifndef CPU_UNION
+#define CPU_UNION
+
+#include "kernel_map.hpp"
+#include "types.hpp"
+
+#include <cstring>
+
+namespace minkowski {
+
+/*
+ * out_feat[parents[i]] += in_feat[i] where parents is the union row of each
+ * input row. Rows of one input have distinct union rows, so the accumulation
+ * of an input is race free. out_feat must be zero-initialized.
+ */
+template <typename Dtype>
+void UnionForwardKernelCPU(const Dtype *p_in_feat, Dtype *p_out_feat,
+                           int const nchannel, cpu_parent_map const &union_map) {
+  auto const &parents = union_map.parents;
+#pragma omp parallel for
+  for (int64_t row = 0; row < (int64_t)parents.size(); ++row) {
+    Dtype const *p_in = p_in_feat + row * nchannel;
+    Dtype *p_out = p_out_feat + parents[row] * nchannel;
+#pragma omp simd
+    for (int c = 0; c < nchannel; ++c)
+      p_out[c] += p_in[c];
+  }
+}
+
+/*
+ * grad_in_feat[i] = grad_out_feat[parents[i]]
+ */
+template <typename Dtype>
+void UnionBackwardKernelCPU(Dtype *p_grad_in_feat,
+                            const Dtype *p_grad_out_feat, int const nchannel,
+                            cpu_parent_map const &union_map) {
+  auto const &parents = union_map.parents;
+#pragma omp parallel for
+  for (int64_t row = 0; row < (int64_t)parents.size(); ++row) {
+    std::memcpy(p_grad_in_feat + row * nchannel,
+                p_grad_out_feat + parents[row] * nchannel,
+                nchannel * sizeof(Dtype));
+  }
+}
+
+} // end namespace minkowski
+
+#endif // CPU_UNION
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2020 NVIDIA Corporation.
+ * Copyright (c) 2018-2020 Chris Choy (chrischoy@ai.stanford.edu).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+ * Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+ * of the code.
+ */
+#include "coordinate_map.hpp"
+#include "coordinate_map_cpu.hpp"
+#include "coordinate_map_key.hpp"
+#include "coordinate_map_manager.hpp"
+#include "errors.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+#include "union.hpp"
+
+#include <pybind11/pybind11.h>
+#include <torch/extension.h>
+
+namespace minkowski {
+
+template <typename coordinate_type>
+at::Tensor
+UnionForwardCPU(std::vector<at::Tensor> const &in_feats,              // CPU feats
+                std::vector<CoordinateMapKey *> const &p_in_map_keys, //
+                CoordinateMapKey *p_out_map_key,                      //
+                cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
+  ASSERT(in_feats.size() > 1, "Got one or zero input. Union at least 2 inputs.");
+  ASSERT(in_feats.size() == p_in_map_keys.size(),
+         "The number of input features and keys mismatch.", in_feats.size(),
+         "!=", p_in_map_keys.size());
+
+  auto const nchannel = in_feats[0].size(1);
+  for (size_t i = 0; i < in_feats.size(); ++i) {
+    at::Tensor const &in_feat = in_feats[i];
+    ASSERT(in_feat.is_contiguous(), "in_feat must be contiguous");
+    ASSERT(!in_feat.is_cuda(), "in_feat must be CPU");
+    ASSERT(in_feat.dim() == 2, "in_feat.dim():", in_feat.dim());
+    ASSERT(in_feat.size(1) == nchannel, "Invalid in_feat channel size",
+           in_feat.size(1), "!=", nchannel);
+    ASSERT(in_feat.scalar_type() == in_feats[0].scalar_type(),
+           "The input features must have the same dtype.");
+    ASSERT(p_map_manager->exists(p_in_map_keys[i]), ERROR_MAP_NOT_FOUND);
+    ASSERT(in_feat.size(0) == p_map_manager->size(p_in_map_keys[i]->get_key()),
+           "Invalid in_feat size", in_feat.size(0),
+           "!=", p_map_manager->size(p_in_map_keys[i]->get_key()));
+  }
+
+  if (!p_out_map_key->is_key_set()) {
+    std::vector<coordinate_map_key_type> in_keys;
+    in_keys.reserve(p_in_map_keys.size());
+    for (auto p_key : p_in_map_keys)
+      in_keys.push_back(p_key->get_key());
+    p_out_map_key->set_key(p_map_manager->merge(in_keys));
+  }
+
+  const int64_t tot_n = p_map_manager->size(p_out_map_key->get_key());
+  at::Tensor out_feat =
+      torch::zeros({tot_n, nchannel}, in_feats[0].options());
+  LOG_DEBUG("out_feat", tot_n, "x", nchannel);
+
+  for (size_t i = 0; i < in_feats.size(); ++i) {
+    // union row of each input row. Cached by merge for a new union map.
+    cpu_parent_map const &union_map =
+        p_map_manager->stride_parent_map(p_in_map_keys[i], p_out_map_key);
+    if (union_map.in_nrows() == 0)
+      continue;
+    AT_DISPATCH_FLOATING_TYPES(
+        in_feats[i].scalar_type(), "union_forward_cpu", [&] {
+          UnionForwardKernelCPU<scalar_t>(
+              in_feats[i].template data_ptr<scalar_t>(),
+              out_feat.template data_ptr<scalar_t>(), nchannel, union_map);
+        });
+  }
+
+  return out_feat;
+}
+
+template <typename coordinate_type>
+std::vector<at::Tensor>
+UnionBackwardCPU(at::Tensor &grad_out_feat,                              //
+                 std::vector<CoordinateMapKey *> const &p_in_map_keys, //
+                 CoordinateMapKey *p_out_map_key,                      //
+                 cpu_manager_type<coordinate_type> *p_map_manager) {
+  thread_scope const scope(p_map_manager->threads());
+  if (!grad_out_feat.is_contiguous())
+    grad_out_feat = grad_out_feat.contiguous();
+
+  ASSERT(!grad_out_feat.is_cuda(), "grad_out_feat must be CPU");
+  ASSERT(grad_out_feat.dim() == 2, "grad_out_feat.dim():", grad_out_feat.dim());
+
+  coordinate_map_key_type const &out_key = p_out_map_key->get_key();
+  const int64_t N_out = p_map_manager->size(out_key);
+  ASSERT(grad_out_feat.size(0) == N_out, "Invalid grad_out_feat size",
+         grad_out_feat.size(0), "!=", N_out);
+
+  const int nchannel = grad_out_feat.size(1);
+  std::vector<at::Tensor> grad_in_feats;
+  grad_in_feats.reserve(p_in_map_keys.size());
+  for (auto p_in_map_key : p_in_map_keys) {
+    cpu_parent_map const &union_map =
+        p_map_manager->stride_parent_map(p_in_map_key, p_out_map_key);
+    const int64_t N_in = union_map.in_nrows();
+    at::Tensor grad_in_feat =
+        torch::empty({N_in, nchannel}, grad_out_feat.options());
+    if (N_in > 0)
+      AT_DISPATCH_FLOATING_TYPES(
+          grad_out_feat.scalar_type(), "union_backward_cpu", [&] {
+            UnionBackwardKernelCPU<scalar_t>(
+                grad_in_feat.template data_ptr<scalar_t>(),
+                grad_out_feat.template data_ptr<scalar_t>(), nchannel,
+                union_map);
+          });
+    grad_in_feats.push_back(std::move(grad_in_feat));
+  }
+
+  return grad_in_feats;
+}
+
+template at::Tensor UnionForwardCPU<default_types::dcoordinate_type>(
+    std::vector<at::Tensor> const &in_feats,
+    std::vector<CoordinateMapKey *> const &p_in_map_keys, //
+    CoordinateMapKey *p_out_map_key,                      //
+    cpu_manager_type<default_types::dcoordinate_type> *p_map_manager);
+
+template std::vector<at::Tensor> UnionBackwardCPU<default_types::dcoordinate_type>(
+    at::Tensor &grad_out_feat,
+    std::vector<CoordinateMapKey *> const &p_in_map_keys, //
+    CoordinateMapKey *p_out_map_key,                      //
+    cpu_manager_type<default_types::dcoordinate_type> *p_map_manager);
+
+} // end namespace minkowski
@@ -33,13 +33,97 @@ from MinkowskiEngine import (
     MinkowskiBroadcast,
     MinkowskiBroadcastConcatenation,
     BroadcastMode,
+    MinkowskiSEGatingFunction,
 )
+from MinkowskiEngine.modules.senet_block import SELayer
 
 from utils.gradcheck import gradcheck
 from tests.python.common import data_loader
 
 
 class TestBroadcast(unittest.TestCase):
+    def test_broadcast(self):
+        in_channels = 3
+        coords, feats, labels = data_loader(in_channels, batch_size=3)
+        feats = feats.double()
+        feats.requires_grad_()
+        input = SparseTensor(feats, coords)
+        pool = MinkowskiGlobalSumPooling()
+        input_glob = pool(input).detach()
+        input_glob.F.requires_grad_()
+
+        add = MinkowskiBroadcastAddition()(input, input_glob)
+        mul = MinkowskiBroadcastMultiplication()(input, input_glob)
+        # Map each batch index to its row in the origin map
+        origin_coords = input.coordinate_manager.get_coordinates(
+            input_glob.coordinate_map_key
+        )
+        origin_rows = torch.empty(
+            int(origin_coords[:, 0].max()) + 1, dtype=torch.long
+        )
+        origin_rows[origin_coords[:, 0].long()] = torch.arange(len(origin_coords))
+        glob = input_glob.F[origin_rows[input.C[:, 0].long()]]
+        self.assertTrue(torch.allclose(add.F, input.F + glob))
+        self.assertTrue(torch.allclose(mul.F, input.F * glob))
+
+        fn = MinkowskiBroadcastFunction()
+        for mode in [
+            BroadcastMode.ELEMENTWISE_ADDITON,
+            BroadcastMode.ELEMENTWISE_MULTIPLICATION,
+        ]:
+            self.assertTrue(
+                gradcheck(
+                    fn,
+                    (
+                        input.F,
+                        input_glob.F,
+                        mode,
+                        input.coordinate_map_key,
+                        input_glob.coordinate_map_key,
+                        input.coordinate_manager,
+                    ),
+                )
+            )
+
+    def test_se_gating(self):
+        in_channels = 8
+        coords, feats, labels = data_loader(in_channels, batch_size=3)
+        feats = feats.double()
+        feats.requires_grad_()
+        input = SparseTensor(feats, coords)
+
+        se = SELayer(in_channels, reduction=4).double()
+        fused = se(input)
+
+        # Unfused reference
+        y = se.fc(se.pooling(input))
+        ref = se.broadcast_mul(input, y)
+        self.assertTrue(torch.allclose(fused.F, ref.F, atol=1e-8))
+
+        # Hooks on the MLP disable the fused path
+        calls = []
+        se.fc[0].register_forward_hook(lambda *args: calls.append(1))
+        hooked = se(input)
+        self.assertEqual(len(calls), 1)
+        self.assertTrue(torch.allclose(hooked.F, ref.F, atol=1e-8))
+
+        fc1, fc2 = se.fc[0].linear, se.fc[2].linear
+        fn = MinkowskiSEGatingFunction()
+        self.assertTrue(
+            gradcheck(
+                fn,
+                (
+                    input.F,
+                    fc1.weight,
+                    fc1.bias,
+                    fc2.weight,
+                    fc2.bias,
+                    input.coordinate_map_key,
+                    input.coordinate_manager,
+                ),
+            )
+        )
+
     def test_broadcast_gpu(self):
         in_channels, D = 2, 2
         coords, feats, labels = data_loader(in_channels)
@@ -39,6 +39,7 @@ from MinkowskiEngine import (
     MinkowskiGenerativeConvolutionTranspose,
     MinkowskiChannelwiseConvolution,
     KernelGenerator,
+    ThreadingPolicy,
 )
 
 from MinkowskiEngine.utils import batched_coordinates
@@ -245,6 +246,68 @@ class TestConvolution(unittest.TestCase):
         print(output)
 
 
+    def test_threading_policy(self):
+        print(f"{self.__class__.__name__}: test_threading_policy")
+        in_channels, out_channels, D = 4, 8, 2
+        coords, feats, labels = data_loader(in_channels, batch_size=4)
+        feats = feats.double()
+        conv = MinkowskiConvolution(
+            in_channels, out_channels, kernel_size=3, stride=1, bias=False, dimension=D
+        ).double()
+
+        results = []
+        for policy in [
+            ThreadingPolicy.BLAS_PARALLEL,
+            ThreadingPolicy.OUTER_PARALLEL,
+            ThreadingPolicy.AUTO,
+        ]:
+            input = SparseTensor(feats.clone().requires_grad_(), coordinates=coords)
+            input.coordinate_manager.set_threading_policy(policy)
+            self.assertEqual(input.coordinate_manager.threading_policy(), policy)
+            conv.zero_grad()
+            output = conv(input)
+            output.F.sum().backward()
+            results.append((output.F, input.F.grad, conv.kernel.grad.clone()))
+
+        for result in results[1:]:
+            for ref, value in zip(results[0], result):
+                self.assertTrue(torch.allclose(ref, value))
+
+    def test_autograd(self):
+        print(f"{self.__class__.__name__}: test_autograd")
+        in_channels, out_channels, D = 2, 3, 2
+        coords, feats, labels = data_loader(in_channels)
+        feats = feats.double()
+        conv = MinkowskiConvolution(
+            in_channels, out_channels, kernel_size=3, stride=2, bias=False, dimension=D
+        ).double()
+
+        # Module forward through the C++ autograd function
+        input = SparseTensor(feats.clone().requires_grad_(), coordinates=coords)
+        output = conv(input)
+        output.F.sum().backward()
+        grad_kernel = conv.kernel.grad.clone()
+        self.assertEqual(output.coordinate_map_key.get_tensor_stride(), [2, 2])
+
+        # Reference through the python function
+        conv.zero_grad()
+        ref_input = SparseTensor(feats.clone().requires_grad_(), coordinates=coords)
+        ref_output = MinkowskiConvolutionFunction().apply(
+            ref_input.F,
+            conv.kernel,
+            conv.kernel_generator,
+            conv.convolution_mode,
+            ref_input.coordinate_map_key,
+            None,
+            ref_input.coordinate_manager,
+        )
+        ref_output.sum().backward()
+
+        self.assertTrue(torch.allclose(output.F, ref_output))
+        self.assertTrue(torch.allclose(input.F.grad, ref_input.F.grad))
+        self.assertTrue(torch.allclose(grad_kernel, conv.kernel.grad))
+
+
 class TestConvolutionMode(unittest.TestCase):
     def test_gpu(self):
         print(f"{self.__class__.__name__}: test_gpu")
@@ -399,6 +462,53 @@ class TestConvolutionTranspose(unittest.TestCase):
             )
         )
 
+    def test_autograd(self):
+        print(f"{self.__class__.__name__}: test_autograd")
+        in_channels, out_channels, D = 2, 3, 2
+        coords, feats, labels = data_loader(in_channels)
+        feats = feats.double()
+        conv = MinkowskiConvolution(
+            in_channels, out_channels, kernel_size=3, stride=2, bias=False, dimension=D
+        ).double()
+        conv_tr = MinkowskiConvolutionTranspose(
+            out_channels, in_channels, kernel_size=2, stride=2, bias=False, dimension=D
+        ).double()
+        with torch.no_grad():
+            strided = conv(SparseTensor(feats, coordinates=coords))
+
+        # Module forward through the C++ autograd function
+        input = SparseTensor(
+            strided.F.clone().requires_grad_(),
+            coordinate_map_key=strided.coordinate_map_key,
+            coordinate_manager=strided.coordinate_manager,
+        )
+        output = conv_tr(input)
+        output.F.sum().backward()
+        grad_kernel = conv_tr.kernel.grad.clone()
+        self.assertEqual(output.coordinate_map_key.get_tensor_stride(), [1, 1])
+
+        # Reference through the python function
+        conv_tr.zero_grad()
+        ref_input = SparseTensor(
+            strided.F.clone().requires_grad_(),
+            coordinate_map_key=strided.coordinate_map_key,
+            coordinate_manager=strided.coordinate_manager,
+        )
+        ref_output = MinkowskiConvolutionTransposeFunction().apply(
+            ref_input.F,
+            conv_tr.kernel,
+            conv_tr.kernel_generator,
+            conv_tr.convolution_mode,
+            ref_input.coordinate_map_key,
+            output.coordinate_map_key,
+            ref_input.coordinate_manager,
+        )
+        ref_output.sum().backward()
+
+        self.assertTrue(torch.allclose(output.F, ref_output))
+        self.assertTrue(torch.allclose(input.F.grad, ref_input.F.grad))
+        self.assertTrue(torch.allclose(grad_kernel, conv_tr.kernel.grad))
+
     def test_analytic(self):
         print(f"{self.__class__.__name__}: test")
         in_channels, out_channels, D = 2, 2, 2
@@ -21,7 +21,9 @@
 # Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
 # Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
 # of the code.
+import os
 import unittest
+from concurrent.futures import ThreadPoolExecutor
 
 import torch
 import numpy as np
@@ -30,6 +32,19 @@ import MinkowskiEngine as ME
 
 
 class CoordinateManagerTestCase(unittest.TestCase):
+    def _assert_same_kernel_map(self, kernel_map, coords, stride):
+        # the kernel map of a fresh manager with the default settings
+        D = coords.size(1) - 1
+        ref_manager = ME.CoordinateManager(
+            D=D, coordinate_map_type=ME.CoordinateMapType.CPU
+        )
+        ref_key, _ = ref_manager.insert_and_map(coords, [1] * D)
+        ref_out_key = ref_manager.stride(ref_key, stride)
+        ref_kernel_map = ref_manager.kernel_map(ref_key, ref_out_key, stride, 3)
+        self.assertEqual(kernel_map.keys(), ref_kernel_map.keys())
+        for k in ref_kernel_map.keys():
+            self.assertTrue(torch.equal(kernel_map[k], ref_kernel_map[k]))
+
     def test_coordinate_manager(self):
 
         coordinates = torch.IntTensor(
@@ -236,6 +251,259 @@ class CoordinateManagerTestCase(unittest.TestCase):
         print(batch_coordinates)
         self.assertTrue(len(batch_coordinates) == 2)
 
+    def test_neighbor_query(self):
+        manager = ME.CoordinateManager(
+            D=2, coordinate_map_type=ME.CoordinateMapType.CPU
+        )
+        coords = torch.randint(-5, 5, (64, 3)).int() * 2
+        coords[:, 0] = torch.randint(0, 2, (64,))
+        key, (unique_map, inverse_map) = manager.insert_and_map(coords, [2, 2])
+        coords = manager.get_coordinates(key).double()
+        queries = torch.rand(32, 3).double() * 20 - 10
+        queries[:, 0] = torch.randint(0, 2, (32,))
+
+        for max_num_neighbors, radius in [(0, 2.5), (3, 4.0), (1, 20.0)]:
+            offsets, rows, distances = manager.neighbor_query(
+                key, queries, radius, max_num_neighbors
+            )
+            for i, query in enumerate(queries):
+                dist = (coords[:, 1:] - query[1:]).norm(dim=1)
+                dist[coords[:, 0] != query[0]] = float("inf")
+                ref = dist[dist <= radius].sort()[0]
+                if max_num_neighbors > 0:
+                    ref = ref[:max_num_neighbors]
+                curr = slice(offsets[i], offsets[i + 1])
+                self.assertTrue(torch.allclose(distances[curr], ref))
+                self.assertTrue(torch.allclose(dist[rows[curr]], ref))
+
+    def test_crop(self):
+        manager = ME.CoordinateManager(
+            D=2, coordinate_map_type=ME.CoordinateMapType.CPU
+        )
+        coords = torch.randint(-20, 20, (256, 3)).int() * 2
+        coords[:, 0] = torch.randint(0, 2, (256,))
+        key, (unique_map, inverse_map) = manager.insert_and_map(coords, [2, 2])
+        coords = manager.get_coordinates(key)
+        boxes = torch.IntTensor(
+            [[0, -9, -40, 7, 13], [1, -40, -40, 40, 40], [1, 3, 3, 2, 10]]
+        )
+
+        # the rows only crop shares the block index and inserts no maps
+        manager.crop_rows(key, boxes, block_size=4)
+        manager_state = str(manager)
+        crop_rows_only = manager.crop_rows(key, boxes, block_size=4)
+        self.assertEqual(str(manager), manager_state)
+
+        keys, rows = manager.crop(key, boxes, block_size=4)
+        for crop_rows, rows_only in zip(rows, crop_rows_only):
+            self.assertEqual(crop_rows.tolist(), rows_only.tolist())
+        for box, crop_key, crop_rows in zip(boxes, keys, rows):
+            mask = (coords[:, 0] == box[0]) & (
+                (coords[:, 1:] >= box[1:3]) & (coords[:, 1:] <= box[3:])
+            ).all(dim=1)
+            self.assertEqual(crop_rows.tolist(), mask.nonzero().view(-1).tolist())
+            self.assertEqual(crop_key.get_tensor_stride(), [2, 2])
+            self.assertTrue(
+                torch.equal(manager.get_coordinates(crop_key), coords[crop_rows])
+            )
+
+    def test_plan_replay(self):
+        coords = torch.randint(0, 16, (128, 3)).int()
+        coords[:, 0] = torch.randint(0, 2, (128,))
+        sinput = ME.SparseTensor(torch.rand(128, 3), coords)
+        manager = sinput.coordinate_manager
+        model = torch.nn.Sequential(
+            ME.MinkowskiConvolution(3, 4, kernel_size=3, stride=2, dimension=2),
+            ME.MinkowskiConvolution(4, 4, kernel_size=3, dimension=2),
+            ME.MinkowskiConvolutionTranspose(
+                4, 2, kernel_size=3, stride=2, dimension=2
+            ),
+        )
+        with manager.capture():
+            model(sinput)
+        self.assertTrue(manager.plan_size() > 0)
+
+        sinput2 = ME.SparseTensor(
+            torch.rand(len(sinput), 3),
+            coordinate_map_key=sinput.coordinate_map_key,
+            coordinate_manager=manager,
+        )
+        ref = model(sinput2)
+        with manager.replay():
+            soutput = model(sinput2)
+        self.assertEqual(manager.plan_cursor(), manager.plan_size())
+        self.assertEqual(soutput.coordinate_map_key, ref.coordinate_map_key)
+        self.assertTrue(torch.allclose(soutput.F, ref.F))
+
+        # a replay that misses the first layer resumes at the next match
+        hidden = model[0](sinput2)
+        with manager.replay():
+            manager.stride(sinput2.coordinate_map_key, 4)
+            soutput = model[1:](hidden)
+        self.assertEqual(manager.plan_cursor(), manager.plan_size())
+        self.assertTrue(torch.allclose(soutput.F, ref.F))
+
+    def test_prefetch_kernel_map(self):
+        coords = torch.randint(0, 16, (128, 3)).int()
+        coords[:, 0] = torch.randint(0, 2, (128,))
+        manager = ME.CoordinateManager(
+            D=2, coordinate_map_type=ME.CoordinateMapType.CPU
+        )
+        key, _ = manager.insert_and_map(coords, [1, 1])
+        out_key = manager.stride(key, [2, 2])
+        self.assertTrue(manager.prefetch_kernel_map(key, out_key, 2, 3))
+        kernel_map = manager.kernel_map(key, out_key, 2, 3)
+        self._assert_same_kernel_map(kernel_map, coords, 2)
+
+    def test_kernel_map_hints(self):
+        coords = torch.randint(0, 16, (128, 3)).int()
+        coords[:, 0] = torch.randint(0, 2, (128,))
+        sinput = ME.SparseTensor(torch.rand(128, 3), coords)
+        model = torch.nn.Sequential(
+            ME.MinkowskiConvolution(3, 4, kernel_size=3, stride=2, dimension=2),
+            ME.MinkowskiConvolution(4, 4, kernel_size=3, dimension=2),
+            ME.MinkowskiConvolutionTranspose(
+                4, 2, kernel_size=3, stride=2, dimension=2
+            ),
+        )
+        with sinput.coordinate_manager.capture():
+            model(sinput)
+        plan = sinput.coordinate_manager.kernel_map_plan()
+        self.assertTrue(len(plan) > 0)
+
+        features = torch.rand(128, 3)
+        ref = model(ME.SparseTensor(features, coords))
+        sinput2 = ME.SparseTensor(features, coords)
+        sinput2.coordinate_manager.set_kernel_map_hints(plan)
+        soutput = model(sinput2)
+        self.assertEqual(sinput2.coordinate_manager.num_kernel_map_hints(), 0)
+        self.assertTrue(torch.allclose(soutput.F, ref.F))
+
+    def test_concurrent_kernel_map(self):
+        coords = torch.randint(0, 32, (1024, 4)).int()
+        coords[:, 0] = torch.randint(0, 2, (1024,))
+        manager = ME.CoordinateManager(
+            D=3, coordinate_map_type=ME.CoordinateMapType.CPU
+        )
+        key, _ = manager.insert_and_map(coords, [1, 1, 1])
+
+        def build(stride):
+            out_key = manager.stride(key, stride)
+            return out_key, manager.kernel_map(key, out_key, stride, 3)
+
+        with ThreadPoolExecutor(max_workers=8) as executor:
+            results = list(executor.map(build, [2, 4] * 8))
+
+        for stride, (out_key, kernel_map) in zip([2, 4] * 8, results):
+            # every thread resolves to the same strided map
+            self.assertEqual(out_key, results[0 if stride == 2 else 1][0])
+            self._assert_same_kernel_map(kernel_map, coords, stride)
+
+    def test_concurrent_insert_and_map(self):
+        manager = ME.CoordinateManager(
+            D=3, coordinate_map_type=ME.CoordinateMapType.CPU
+        )
+        batches = []
+        for _ in range(16):
+            coords = torch.randint(0, 32, (1024, 4)).int()
+            coords[:, 0] = torch.randint(0, 2, (1024,))
+            batches.append(coords)
+
+        def insert(coords):
+            return manager.insert_and_map(coords, [1, 1, 1], "shared")
+
+        with ThreadPoolExecutor(max_workers=8) as executor:
+            results = list(executor.map(insert, batches))
+
+        # every insertion gets its own key that maps to its own coordinates
+        keys = [key.get_key() for key, _ in results]
+        self.assertEqual(len(set(str(key) for key in keys)), len(batches))
+        for coords, (key, (unique_map, inverse_map)) in zip(batches, results):
+            self.assertTrue(
+                torch.equal(coords[unique_map], manager.get_coordinates(key))
+            )
+            self.assertTrue(torch.equal(coords[unique_map][inverse_map], coords))
+
+    def test_thread_config(self):
+        coords = torch.randint(0, 32, (1024, 4)).int()
+        coords[:, 0] = torch.randint(0, 2, (1024,))
+        manager = ME.CoordinateManager(
+            D=3,
+            num_threads=1,
+            coordinate_map_type=ME.CoordinateMapType.CPU,
+            cpu_affinity=[0],
+        )
+        self.assertEqual(manager.num_threads(), 1)
+        self.assertEqual(manager.cpu_affinity(), [0])
+        # the OpenMP team of the manager's scope has a single thread
+        if hasattr(os, "sched_getaffinity"):
+            self.assertEqual(len(manager.worker_cpu_affinity()), 1)
+        # the settings of a manager do not leak into the process
+        num_threads = torch.get_num_threads()
+        key, _ = manager.insert_and_map(coords, [1, 1, 1])
+        out_key = manager.stride(key, 2)
+        kernel_map = manager.kernel_map(key, out_key, 2, 3)
+        self.assertEqual(torch.get_num_threads(), num_threads)
+        self._assert_same_kernel_map(kernel_map, coords, 2)
+
+    @unittest.skipUnless(hasattr(os, "sched_getaffinity"), "sched_getaffinity")
+    def test_worker_cpu_affinity(self):
+        cpu = min(os.sched_getaffinity(0))
+        manager = ME.CoordinateManager(
+            D=3,
+            num_threads=2,
+            coordinate_map_type=ME.CoordinateMapType.CPU,
+            cpu_affinity=[cpu],
+        )
+        worker_affinity = manager.worker_cpu_affinity()
+        self.assertEqual(len(worker_affinity), 2)
+        for affinity in worker_affinity:
+            self.assertEqual(affinity, [cpu])
+        # the workers are unpinned when the manager's scope exits
+        manager.set_cpu_affinity([])
+        for affinity in manager.worker_cpu_affinity():
+            self.assertEqual(set(affinity), os.sched_getaffinity(0))
+
+    def test_build_hierarchy(self):
+        coords = torch.randint(-32, 32, (256, 4)).int()
+        coords[:, 0] = torch.randint(0, 2, (256,))
+        manager = ME.CoordinateManager(
+            D=3, coordinate_map_type=ME.CoordinateMapType.CPU
+        )
+        key, _ = manager.insert_and_map(coords, [1, 1, 1])
+        keys = manager.build_hierarchy(key, [2, 2, 2, 2])
+        self.assertEqual(len(keys), 4)
+
+        ref_manager = ME.CoordinateManager(
+            D=3, coordinate_map_type=ME.CoordinateMapType.CPU
+        )
+        ref_key, _ = ref_manager.insert_and_map(coords, [1, 1, 1])
+        in_key = key
+        for level, level_key in enumerate(keys):
+            ref_key = ref_manager.stride(ref_key, 2)
+            self.assertEqual(
+                level_key.get_tensor_stride(), [2 ** (level + 1)] * 3
+            )
+            self.assertEqual(
+                set(map(tuple, manager.get_coordinates(level_key).tolist())),
+                set(map(tuple, ref_manager.get_coordinates(ref_key).tolist())),
+            )
+            # the strided map is cached
+            self.assertEqual(manager.stride(in_key, 2), level_key)
+            # the stride map points each row to its strided row
+            in_map, out_map = manager.stride_map(in_key, level_key)
+            in_coords = manager.get_coordinates(in_key)[in_map.long()]
+            out_coords = manager.get_coordinates(level_key)[out_map.long()]
+            tensor_stride = 2 ** (level + 1)
+            strided = torch.floor(in_coords[:, 1:].double() / tensor_stride)
+            self.assertTrue(
+                torch.equal(strided.int() * tensor_stride, out_coords[:, 1:])
+            )
+            in_key = level_key
+
+        # existing levels are reused
+        self.assertEqual(manager.build_hierarchy(key, [2, 2])[1], keys[1])
+
     def test_gpu_allocator(self):
         if not ME.is_cuda_available():
             return
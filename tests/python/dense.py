@@ -118,6 +118,43 @@ class TestDenseToSparse(unittest.TestCase):
         self.assertEqual(len(sparse_tensor), 3 * 4 * 5)
         self.assertEqual(sparse_tensor.F.size(1), 6)
 
+    def test_remove_zeros(self):
+        dense_tensor = torch.rand(3, 4, 5, 6)
+        dense_tensor[dense_tensor < 0.8] = 0
+        for format in ["BCXX", "BXCX", "BXXC"]:
+            ch_dim = format.find("C")
+            sparse_tensor = to_sparse(dense_tensor, format=format)
+            bcoords = torch.stack(
+                torch.where(dense_tensor.abs().sum(ch_dim) != 0), dim=1
+            ).int()
+            self.assertEqual(len(sparse_tensor), len(bcoords))
+            self.assertTrue(torch.all(sparse_tensor.C == bcoords))
+            dims = [d for d in range(4) if d != ch_dim] + [ch_dim]
+            feats = dense_tensor.permute(*dims)[tuple(bcoords.long().t())]
+            self.assertTrue(torch.all(sparse_tensor.F == feats))
+            # The coordinate map must match the scanned coordinates
+            self.assertTrue(
+                torch.all(
+                    sparse_tensor.coordinate_manager.get_coordinates(
+                        sparse_tensor.coordinate_map_key
+                    )
+                    == sparse_tensor.C
+                )
+            )
+
+    def test_grad(self):
+        dense_tensor = torch.rand(2, 3, 4, 5)
+        dense_tensor[dense_tensor < 0.5] = 0
+        dense_tensor.requires_grad = True
+        sparse_tensor = to_sparse(dense_tensor)
+        sparse_tensor.F.sum().backward()
+        self.assertTrue(
+            torch.all(
+                dense_tensor.grad.sum(1)
+                == 3 * (dense_tensor.detach().abs().sum(1) != 0).float()
+            )
+        )
+
     def test_network(self):
         dense_tensor = torch.rand(3, 4, 11, 11, 11, 11)  # BxCxD1xD2x....xDN
         dense_tensor.requires_grad = True
@@ -0,0 +1,121 @@
+# Copyright (c) 2020 NVIDIA CORPORATION.
+# Copyright (c) Chris Choy (chrischoy@ai.stanford.edu).
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+# of the Software, and to permit persons to whom the Software is furnished to do
+# so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+# Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+# Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+# of the code.
+import torch
+import unittest
+
+from MinkowskiEngine import (
+    SparseTensor,
+    BinaryMode,
+    JoinMode,
+    MinkowskiElementwiseFunction,
+    elementwise,
+)
+from utils.gradcheck import gradcheck
+
+
+class TestElementwise(unittest.TestCase):
+    def _inputs(self):
+        coords0 = torch.randint(0, 6, (48, 3)).int()
+        coords1 = torch.randint(0, 6, (48, 3)).int()
+        coords0[:, 0] = coords1[:, 0] = 0
+        input0 = SparseTensor(torch.rand(48, 2).double(), coords0)
+        input1 = SparseTensor(
+            torch.rand(48, 2).double() - 0.5,
+            coords1,
+            coordinate_manager=input0.coordinate_manager,
+        )
+        return input0, input1
+
+    def test_elementwise(self):
+        input0, input1 = self._inputs()
+        feats0 = {tuple(c): f for c, f in zip(input0.C.tolist(), input0.F)}
+        feats1 = {tuple(c): f for c, f in zip(input1.C.tolist(), input1.F)}
+        zero = torch.zeros(2).double()
+        fns = {
+            BinaryMode.ADDITION: lambda x, y: x + y,
+            BinaryMode.SUBTRACTION: lambda x, y: x - y,
+            BinaryMode.MULTIPLICATION: lambda x, y: x * y,
+            BinaryMode.MAXIMUM: torch.max,
+        }
+
+        for mode, fn in fns.items():
+            output = elementwise(input0, input1, mode, JoinMode.UNION)
+            self.assertEqual(len(output), len(set(feats0) | set(feats1)))
+            for coord, feat in zip(output.C.tolist(), output.F):
+                x, y = feats0.get(tuple(coord)), feats1.get(tuple(coord))
+                if mode == BinaryMode.MAXIMUM and (x is None or y is None):
+                    ref = x if y is None else y
+                else:
+                    ref = fn(zero if x is None else x, zero if y is None else y)
+                self.assertTrue(torch.allclose(feat, ref))
+
+            output = elementwise(input0, input1, mode, JoinMode.INTERSECTION)
+            self.assertEqual(len(output), len(set(feats0) & set(feats1)))
+            for coord, feat in zip(output.C.tolist(), output.F):
+                ref = fn(feats0[tuple(coord)], feats1[tuple(coord)])
+                self.assertTrue(torch.allclose(feat, ref))
+
+    def test_operator(self):
+        input0, input1 = self._inputs()
+        output = input0 * input1
+        feats0 = {tuple(c): f for c, f in zip(input0.C.tolist(), input0.F)}
+        feats1 = {tuple(c): f for c, f in zip(input1.C.tolist(), input1.F)}
+        zero = torch.zeros(2).double()
+        for coord, feat in zip(output.C.tolist(), output.F):
+            ref = feats0.get(tuple(coord), zero) * feats1.get(tuple(coord), zero)
+            self.assertTrue(torch.allclose(feat, ref))
+
+    def test_backward(self):
+        input0, input1 = self._inputs()
+        input0.F.requires_grad_()
+        input1.F.requires_grad_()
+        fn = MinkowskiElementwiseFunction()
+        for join in (JoinMode.UNION, JoinMode.INTERSECTION):
+            output = elementwise(input0, input1, BinaryMode.MULTIPLICATION, join)
+            for mode in (
+                BinaryMode.ADDITION,
+                BinaryMode.SUBTRACTION,
+                BinaryMode.MULTIPLICATION,
+                BinaryMode.MAXIMUM,
+            ):
+                self.assertTrue(
+                    gradcheck(
+                        fn,
+                        (
+                            input0.F,
+                            input1.F,
+                            mode,
+                            join,
+                            input0.coordinate_map_key,
+                            input1.coordinate_map_key,
+                            output.coordinate_map_key,
+                            input0.coordinate_manager,
+                        ),
+                    )
+                )
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -22,11 +22,13 @@
 # Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
 # Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
 # of the code.
+import gc
 import torch
 import unittest
 
 from MinkowskiEngine import (
     SparseTensor,
+    TensorField,
     MinkowskiConvolution,
     MinkowskiInterpolationFunction,
     MinkowskiInterpolation,
@@ -84,6 +86,65 @@ class TestInterpolation(unittest.TestCase):
             output, _ = interp(input, tfield)
             output.sum().backward()
 
+    def test_sorted_map(self):
+        in_channels = 3
+        coords, feats, labels = data_loader(in_channels, batch_size=2)
+        feats = feats.double()
+        input = SparseTensor(feats.requires_grad_(), coordinates=coords)
+        tfield = torch.cat(
+            (
+                torch.randint(0, 2, (100, 1)).double(),
+                torch.rand(100, 2).double() * 5,
+            ),
+            dim=1,
+        )
+        interp = MinkowskiInterpolation(return_kernel_map=True, return_weights=True)
+        output, (in_map, out_map), weights = interp(input, tfield)
+
+        # The map is grouped by the output row
+        self.assertTrue(torch.all(out_map[1:] >= out_map[:-1]))
+        ref = torch.zeros_like(output)
+        ref.index_add_(0, out_map.long(), input.F[in_map.long()] * weights[:, None])
+        self.assertTrue(torch.allclose(output, ref))
+
+        # The backward uses the input row grouping built with the map
+        grad = torch.rand_like(output)
+        output.backward(grad)
+        ref_grad = torch.zeros_like(input.F)
+        ref_grad.index_add_(0, in_map.long(), grad[out_map.long()] * weights[:, None])
+        self.assertTrue(torch.allclose(input.F.grad, ref_grad))
+
+    def test_field_cache(self):
+        in_channels = 3
+        coords, feats, labels = data_loader(in_channels, batch_size=2)
+        coords = coords.float()
+        coords[:, 1:] += torch.rand(len(coords), 2) * 0.9
+        tfield = TensorField(feats.float(), coordinates=coords)
+        sinput = tfield.sparse(tensor_stride=2)
+
+        manager = tfield.coordinate_manager
+        map_key = sinput.coordinate_map_key
+        field_key = tfield.coordinate_field_map_key
+        in_map, out_map, weights = manager.interpolation_map_weight(map_key, field_key)
+        in_map2, _, _ = manager.interpolation_map_weight(map_key, field_key)
+        # Cached
+        self.assertEqual(in_map.data_ptr(), in_map2.data_ptr())
+
+        output = sinput.interpolate(tfield)
+        ref = sinput.features_at_coordinates(tfield.C)
+        self.assertTrue(torch.allclose(output.F, ref))
+
+        # A field of another manager does not use the cache
+        other_tfield = TensorField(feats.float(), coordinates=coords)
+        self.assertIsNot(other_tfield.coordinate_manager, manager)
+        other_output = sinput.interpolate(other_tfield)
+        self.assertTrue(torch.allclose(other_output.F, ref))
+
+        # The cached maps are released with the field
+        del tfield, output
+        gc.collect()
+        self.assertEqual(manager.release_field_interpolation_maps(field_key), 0)
+
     def test_gpu(self):
         in_channels, D = 2, 2
         coords, feats, labels = data_loader(in_channels, batch_size=2)
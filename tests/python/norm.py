@@ -29,6 +29,7 @@ from MinkowskiEngine import (
     SparseTensor,
     MinkowskiInstanceNorm,
     MinkowskiInstanceNormFunction,
+    MinkowskiStableInstanceNorm,
 )
 from utils.gradcheck import gradcheck
 
@@ -54,6 +55,41 @@ class TestNormalization(unittest.TestCase):
             )
         )
 
+    def test_inst_norm_fused(self):
+        in_channels = 3
+        coords, feats, labels = data_loader(in_channels, batch_size=3)
+        feats = feats.double()
+        input = SparseTensor(feats, coords)
+        input.F.requires_grad_()
+
+        fn = MinkowskiInstanceNormFunction()
+        out = fn.apply(input.F, input.coordinate_map_key, None, input.coordinate_manager)
+
+        # Reference per batch statistics
+        batch_indices = input.C[:, 0]
+        for b in batch_indices.unique():
+            mask = batch_indices == b
+            x = input.F[mask]
+            ref = (x - x.mean(0)) / (x.var(0, unbiased=False) + 1e-8).sqrt()
+            self.assertTrue(torch.allclose(out[mask], ref, atol=1e-6))
+
+        self.assertTrue(
+            gradcheck(
+                fn, (input.F, input.coordinate_map_key, None, input.coordinate_manager)
+            )
+        )
+
+    def test_stable_inst_norm_offset(self):
+        in_channels = 3
+        coords, feats, labels = data_loader(in_channels, batch_size=3)
+        feats = feats.double()
+        norm = MinkowskiStableInstanceNorm(in_channels).double()
+
+        # E[x^2] - E[x]^2 cancels at this offset and the centered form does not
+        ref = norm(SparseTensor(feats, coords))
+        out = norm(SparseTensor(feats + 1e8, coords))
+        self.assertTrue(torch.allclose(out.F, ref.F, atol=1e-4))
+
     def test_inst_norm_gpu(self):
         in_channels = 2
         coords, feats, labels = data_loader(in_channels)
@@ -109,6 +109,46 @@ class TestLocalMaxPooling(unittest.TestCase):
             )
         )
 
+    def test_compact_index(self):
+        in_channels, D = 2, 2
+        coords, feats, labels = data_loader(in_channels)
+        feats = feats.double()
+        feats.requires_grad_()
+        input = SparseTensor(feats, coordinates=coords)
+        for kernel_size, stride in [(3, 2), (2, 2)]:
+            pool = MinkowskiMaxPooling(
+                kernel_size=kernel_size, stride=stride, dimension=D
+            )
+            compact_pool = MinkowskiMaxPooling(
+                kernel_size=kernel_size,
+                stride=stride,
+                dimension=D,
+                compact_index=True,
+            )
+            output = pool(input)
+            compact_output = compact_pool(input)
+            self.assertTrue(torch.allclose(output.F, compact_output.F))
+
+            (grad,) = torch.autograd.grad(output.F.sum(), feats)
+            (compact_grad,) = torch.autograd.grad(compact_output.F.sum(), feats)
+            self.assertTrue(torch.allclose(grad, compact_grad))
+
+            # Check backward
+            fn = MinkowskiLocalPoolingFunction()
+            self.assertTrue(
+                gradcheck(
+                    fn,
+                    (
+                        input.F,
+                        compact_pool.pooling_mode,
+                        compact_pool.kernel_generator,
+                        input.coordinate_map_key,
+                        compact_output.coordinate_map_key,
+                        input._manager,
+                    ),
+                )
+            )
+
 
 class TestLocalSumPooling(unittest.TestCase):
     def test_sumpooling(self):
@@ -195,6 +235,60 @@ class TestLocalSumPooling(unittest.TestCase):
             )
         )
 
+    def test_stride_map(self):
+        in_channels, D = 2, 2
+        coords, feats, labels = data_loader(in_channels)
+        feats = feats.double()
+        input = SparseTensor(feats, coords)
+        pool = MinkowskiSumPooling(kernel_size=2, stride=2, dimension=D)
+        output = pool(input)
+
+        # Reference from the stride kernel map
+        in_map, out_map = input.coordinate_manager.stride_map(
+            input.coordinate_map_key, output.coordinate_map_key
+        )
+        in_map, out_map = in_map.long(), out_map.long()
+        sum_feats = torch.zeros_like(output.F).index_add_(
+            0, out_map, feats[in_map]
+        )
+        self.assertTrue(torch.allclose(output.F, sum_feats))
+
+        avg_pool = MinkowskiAvgPooling(kernel_size=2, stride=2, dimension=D)
+        counts = torch.zeros(len(output), dtype=feats.dtype).index_add_(
+            0, out_map, torch.ones(len(out_map), dtype=feats.dtype)
+        )
+        self.assertTrue(
+            torch.allclose(avg_pool(input).F, sum_feats / counts.unsqueeze(1))
+        )
+
+        # Unpooling copies the parent features to the children
+        unpool = MinkowskiPoolingTranspose(kernel_size=2, stride=2, dimension=D)
+        fn = MinkowskiLocalPoolingTransposeFunction()
+        unpool_feats = fn.apply(
+            output.F,
+            unpool.pooling_mode,
+            unpool.kernel_generator,
+            output.coordinate_map_key,
+            input.coordinate_map_key,
+            input.coordinate_manager,
+        )
+        self.assertTrue(torch.allclose(unpool_feats[in_map], output.F[out_map]))
+
+        out_feats = output.F.detach().requires_grad_()
+        self.assertTrue(
+            gradcheck(
+                fn,
+                (
+                    out_feats,
+                    unpool.pooling_mode,
+                    unpool.kernel_generator,
+                    output.coordinate_map_key,
+                    input.coordinate_map_key,
+                    input.coordinate_manager,
+                ),
+            )
+        )
+
 
 class TestLocalAvgPooling(unittest.TestCase):
     def test_gpu(self):
@@ -445,6 +539,24 @@ class TestGlobalAvgPooling(unittest.TestCase):
             )
         )
 
+    def test_batch_segments(self):
+        in_channels = 2
+        coords, feats, labels = data_loader(in_channels, batch_size=3)
+        feats = feats.double()
+        input = SparseTensor(feats, coords)
+        output_coords = input.coordinate_manager.get_coordinates(
+            MinkowskiGlobalAvgPooling()(input).coordinate_map_key
+        )
+        for pool, reduce in [
+            (MinkowskiGlobalSumPooling(), lambda x: x.sum(0)),
+            (MinkowskiGlobalAvgPooling(), lambda x: x.mean(0)),
+            (MinkowskiGlobalMaxPooling(), lambda x: x.max(0)[0]),
+        ]:
+            output = pool(input)
+            for row, batch_index in enumerate(output_coords[:, 0]):
+                batch_feats = input.F[input.C[:, 0] == batch_index]
+                self.assertTrue(torch.allclose(output.F[row], reduce(batch_feats)))
+
 
 class TestGlobalMaxPooling(unittest.TestCase):
     def test_batch_size(self):
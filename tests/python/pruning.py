@@ -66,6 +66,17 @@ class TestPruning(unittest.TestCase):
             )
         )
 
+    def test_order(self):
+        in_channels = 3
+        coords, feats, labels = data_loader(in_channels, batch_size=2)
+        input = SparseTensor(feats, coords)
+        keep = torch.rand(feats.size(0)) < 0.5
+        output = MinkowskiPruning()(input, keep)
+
+        # Pruned rows keep the input order
+        self.assertTrue(torch.equal(output.C, input.C[keep]))
+        self.assertTrue(torch.equal(output.F, input.F[keep]))
+
     def test_device(self):
         in_channels = 2
         coords, feats, labels = data_loader(in_channels, batch_size=1)
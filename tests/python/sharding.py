@@ -0,0 +1,103 @@
+# Copyright (c) 2020 NVIDIA CORPORATION.
+# Copyright (c) Chris Choy (chrischoy@ai.stanford.edu).
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+# of the Software, and to permit persons to whom the Software is furnished to do
+# so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+# Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+# Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+# of the code.
+import os
+import tempfile
+import unittest
+
+import torch
+import torch.distributed as dist
+import torch.multiprocessing as mp
+import torch.nn as nn
+
+import MinkowskiEngine as ME
+from MinkowskiEngine import SparseTensor
+
+
+def _network(D):
+    return nn.ModuleList(
+        [
+            ME.MinkowskiConvolution(3, 4, kernel_size=3, dimension=D),
+            ME.MinkowskiConvolution(4, 4, kernel_size=2, stride=2, dimension=D),
+            ME.MinkowskiConvolution(4, 4, kernel_size=3, dimension=D),
+            ME.MinkowskiConvolutionTranspose(
+                4, 2, kernel_size=2, stride=2, dimension=D
+            ),
+        ]
+    ).double()
+
+
+def _forward(layers, x):
+    for i, layer in enumerate(layers):
+        x = layer(x)
+        if i < len(layers) - 1:
+            x = ME.MinkowskiFunctional.relu(x)
+    return x
+
+
+def _sharded_conv(rank, world_size, init_file):
+    dist.init_process_group(
+        "gloo", init_method=f"file://{init_file}", rank=rank, world_size=world_size
+    )
+    D = 2
+    torch.manual_seed(0)
+    coordinates = torch.randint(0, 32, (256, 3)).int()
+    coordinates[:, 0] = torch.randint(0, 2, (256,))
+    features = torch.rand(256, 3).double()
+    layers = _network(D)
+
+    # single process reference
+    sinput = SparseTensor(features, coordinates)
+    sinput.F.requires_grad_()
+    soutput = _forward(layers, sinput)
+    soutput.F.sum().backward()
+    ref = {tuple(c): f for c, f in zip(soutput.C.tolist(), soutput.F.detach())}
+    ref_grad = {tuple(c): g for c, g in zip(sinput.C.tolist(), sinput.F.grad)}
+
+    shard = ME.SpatialShard([16], dimension=D)
+    sharded_layers = [ME.MinkowskiShardedConvolution(l, shard) for l in layers]
+    local_input = shard.scatter(sinput.C, sinput.F.detach())
+    local_input.F.requires_grad_()
+    local_output = _forward(sharded_layers, local_input)
+    local_output.F.sum().backward()
+
+    assert shard.owned(soutput.C).sum() == len(local_output)
+    for c, f in zip(local_output.C.tolist(), local_output.F.detach()):
+        assert torch.allclose(ref[tuple(c)], f)
+    for c, g in zip(local_input.C.tolist(), local_input.F.grad):
+        assert torch.allclose(ref_grad[tuple(c)], g)
+    dist.destroy_process_group()
+
+
+class TestSpatialShard(unittest.TestCase):
+    def test_sharded_conv(self):
+        if not dist.is_available():
+            return
+        world_size = 2
+        with tempfile.TemporaryDirectory() as tmpdir:
+            mp.spawn(
+                _sharded_conv,
+                args=(world_size, os.path.join(tmpdir, "init")),
+                nprocs=world_size,
+            )
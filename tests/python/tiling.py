@@ -0,0 +1,73 @@
+# Copyright (c) 2020 NVIDIA CORPORATION.
+# Copyright (c) Chris Choy (chrischoy@ai.stanford.edu).
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+# of the Software, and to permit persons to whom the Software is furnished to do
+# so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+# Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+# Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+# of the code.
+import torch
+import torch.nn as nn
+import unittest
+
+import MinkowskiEngine as ME
+from MinkowskiEngine import SparseTensor
+from MinkowskiEngine.utils import TiledInference, receptive_field
+
+
+class TestTiledInference(unittest.TestCase):
+    def _model(self):
+        D = 2
+        return nn.Sequential(
+            ME.MinkowskiConvolution(3, 8, kernel_size=3, dimension=D),
+            ME.MinkowskiReLU(),
+            ME.MinkowskiConvolution(8, 8, kernel_size=2, stride=2, dimension=D),
+            ME.MinkowskiReLU(),
+            ME.MinkowskiConvolution(8, 8, kernel_size=3, dimension=D),
+            ME.MinkowskiConvolutionTranspose(
+                8, 4, kernel_size=2, stride=2, dimension=D
+            ),
+        ).double()
+
+    def test_receptive_field(self):
+        halo, max_stride = receptive_field(self._model())
+        self.assertEqual(max_stride, 2)
+        self.assertEqual(halo, 8)
+
+    def test_tiled_inference(self):
+        coords = torch.randint(-30, 30, (512, 3)).int()
+        coords[:, 0] = torch.randint(0, 2, (512,))
+        sinput = SparseTensor(torch.rand(512, 3).double(), coords)
+        model = self._model().eval()
+        soutput = model(sinput)
+        ref = {tuple(c): f for c, f in zip(soutput.C.tolist(), soutput.F)}
+
+        # the first run builds the block index of the crop
+        TiledInference(model, tile_size=16)(sinput)
+        manager_state = str(sinput.coordinate_manager)
+        for max_workers in [1, 2]:
+            tiled = TiledInference(model, tile_size=16, max_workers=max_workers)
+            tiled_output = tiled(sinput)
+            # no crop maps left in the input manager and no graph on the workers
+            self.assertEqual(str(sinput.coordinate_manager), manager_state)
+            self.assertFalse(tiled_output.F.requires_grad)
+            self.assertEqual(len(tiled_output), len(soutput))
+            self.assertEqual(tiled_output.tensor_stride, soutput.tensor_stride)
+            for c, f in zip(tiled_output.C.tolist(), tiled_output.F):
+                self.assertTrue(torch.allclose(ref[tuple(c)], f))
@@ -0,0 +1,93 @@
+# Copyright (c) 2020 NVIDIA CORPORATION.
+# Copyright (c) Chris Choy (chrischoy@ai.stanford.edu).
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+# of the Software, and to permit persons to whom the Software is furnished to do
+# so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+# Please cite "4D Spatio-Temporal ConvNets: Minkowski Convolutional Neural
+# Networks", CVPR'19 (https://arxiv.org/abs/1904.08755) if you use any part
+# of the code.
+import torch
+import unittest
+from typing import Tuple
+
+import MinkowskiEngine as ME
+
+# Enum arguments are ints in TorchScript
+HYPER_CUBE = int(ME.RegionType.HYPER_CUBE)
+GLOBAL_AVG_POOLING = int(ME.PoolingMode.GLOBAL_AVG_POOLING_DEFAULT)
+
+
+@torch.jit.script
+def scripted_conv_pool(
+    coordinates: torch.Tensor, features: torch.Tensor, kernel: torch.Tensor
+) -> Tuple[torch.Tensor, torch.Tensor, torch.Tensor]:
+    manager = torch.classes.MinkowskiEngine.CoordinateManager(1)
+    in_key, unique_map, inverse_map = manager.insert_and_map(
+        coordinates, [1, 1], ""
+    )
+    out_key = torch.classes.MinkowskiEngine.CoordinateMapKey(3)
+    offset = torch.empty(0, dtype=torch.int)
+    out_feat = torch.ops.MinkowskiEngine.convolution_forward(
+        features[unique_map],
+        kernel,
+        [3, 3],
+        [2, 2],
+        [1, 1],
+        HYPER_CUBE,
+        offset,
+        False,
+        0,
+        in_key,
+        out_key,
+        manager,
+    )
+    glob_key = torch.classes.MinkowskiEngine.CoordinateMapKey(3)
+    glob_feat, num_nonzero = torch.ops.MinkowskiEngine.global_pooling_forward(
+        out_feat,
+        GLOBAL_AVG_POOLING,
+        out_key,
+        glob_key,
+        manager,
+    )
+    return manager.get_coordinates(out_key), out_feat, glob_feat
+
+
+class TestTorchLibrary(unittest.TestCase):
+    def test_scripted_ops(self):
+        coords = torch.randint(0, 16, (256, 3)).int()
+        coords[:, 0] = coords[:, 0] % 2
+        coords = torch.unique(coords, dim=0)
+        feats = torch.rand(len(coords), 4).double()
+        conv = ME.MinkowskiConvolution(
+            4, 8, kernel_size=3, stride=2, bias=False, dimension=2
+        ).double()
+
+        out_coords, out_feat, glob_feat = scripted_conv_pool(
+            coords, feats, conv.kernel.detach()
+        )
+
+        input = ME.SparseTensor(feats, coordinates=coords)
+        output = conv(input)
+        ref = {tuple(c.tolist()): f for c, f in zip(output.C, output.F.detach())}
+        self.assertEqual(len(ref), len(out_coords))
+        for c, f in zip(out_coords, out_feat):
+            self.assertTrue(torch.allclose(ref[tuple(c.tolist())], f))
+
+        glob = ME.MinkowskiGlobalAvgPooling()(output)
+        self.assertTrue(torch.allclose(glob.F.detach(), glob_feat))
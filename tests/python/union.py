@@ -26,7 +26,8 @@ import torch
 import unittest
 
 import MinkowskiEngine as ME
-from MinkowskiEngine import SparseTensor, MinkowskiUnion
+from MinkowskiEngine import SparseTensor, MinkowskiUnion, MinkowskiUnionFunction
+from utils.gradcheck import gradcheck
 
 
 class TestUnion(unittest.TestCase):
@@ -60,6 +61,43 @@ class TestUnion(unittest.TestCase):
         self.assertTrue(torch.prod(input1.F.grad) == 1)
         self.assertTrue(torch.prod(input2.F.grad) == 1)
 
+    def test_union_accumulation(self):
+        coords1 = torch.randint(0, 8, (64, 3)).int()
+        coords2 = torch.randint(0, 8, (64, 3)).int()
+        coords1[:, 0] = coords2[:, 0] = 0
+        input1 = SparseTensor(torch.rand(64, 2).double(), coords1)
+        input2 = SparseTensor(
+            torch.rand(64, 2).double(),
+            coords2,
+            coordinate_manager=input1.coordinate_manager,
+        )
+        output = MinkowskiUnion()(input1, input2)
+
+        reference = {}
+        for input in (input1, input2):
+            for coord, feat in zip(input.C.tolist(), input.F):
+                key = tuple(coord)
+                reference[key] = reference.get(key, 0) + feat
+        self.assertEqual(len(output), len(reference))
+        for coord, feat in zip(output.C.tolist(), output.F):
+            self.assertTrue(torch.allclose(feat, reference[tuple(coord)]))
+
+        input1.F.requires_grad_()
+        input2.F.requires_grad_()
+        fn = MinkowskiUnionFunction()
+        self.assertTrue(
+            gradcheck(
+                fn,
+                (
+                    [input1.coordinate_map_key, input2.coordinate_map_key],
+                    output.coordinate_map_key,
+                    input1.coordinate_manager,
+                    input1.F,
+                    input2.F,
+                ),
+            )
+        )
+
     def test_union_gpu(self):
         device = torch.device("cuda")
 